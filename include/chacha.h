@@ -7,9 +7,23 @@
 extern "C" {
 #endif
 
+// keystream cores, CHACHA_AUTO picks the widest the cpu supports on first use
+#define CHACHA_REF 0
+#define CHACHA_SSE2 1
+#define CHACHA_AVX2 2
+#define CHACHA_NEON 3
+#define CHACHA_AUTO 255
+
+// force a core (testing/benchmarks), unsupported ones fall back to CHACHA_REF, returns the one in use
+uint8_t chacha20_core(uint8_t core);
+const char *chacha20_core_name(uint8_t core);
+
 // a convert-in-place utility
 uint8_t *chacha20(uint8_t *key, uint8_t *nonce, uint8_t *bytes, uint32_t len);
 
+// same but the IETF variant, 12 byte nonce and starting block counter
+uint8_t *chacha20_ietf(uint8_t *key, uint8_t *nonce, uint32_t counter, uint8_t *bytes, uint32_t len);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
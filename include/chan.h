@@ -18,6 +18,7 @@ struct chan_struct
   // timer stuff
   uint32_t tsent, trecv; // last send, recv at
   uint32_t timeout; // when in the future to trigger timeout
+  uint32_t packets_in, packets_out;
   
   // direct handler
   void *arg;
@@ -53,6 +54,9 @@ chan_t chan_process(chan_t c, uint32_t now);
 // set up internal handler for all incoming packets on this channel
 chan_t chan_handle(chan_t c, void (*handle)(chan_t c, void *arg), void *arg);
 
+// {"c":id,"in":n,"out":n,"queued":bytes}
+lob_t chan_metrics(chan_t c);
+
 // convenience functions, accessors
 chan_t chan_next(chan_t c); // c->next
 uint32_t chan_id(chan_t c); // c->id
@@ -45,6 +45,9 @@ uint8_t *e3x_hash(uint8_t *in, size_t len, uint8_t *out32);
 // local endpoint state management
 #include "e3x_self.h"
 
+// in-order completion for async cipher sets
+#include "e3x_async.h"
+
 // a single exchange (a session w/ local endpoint and remote endpoint)
 #include "e3x_exchange.h"
 
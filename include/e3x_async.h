@@ -0,0 +1,48 @@
+#ifndef e3x_async_h
+#define e3x_async_h
+
+#include <stdint.h>
+#include "lob.h"
+
+// in-order completion of async cipher set operations
+// one owning thread pushes, flushes and pops, the cipher set may finish them on any thread and in any order
+// results only come back out in the order they were pushed, so packets keep their order across the crypto
+
+typedef struct e3x_async_struct *e3x_async_t;
+
+// hands a cipher set up to count staged packets, each w/ e3x_async_done and its slots[i], returns how many it took (a prefix)
+typedef uint32_t (*e3x_async_submit_t)(void *ctx, lob_t *packets, void **slots, uint32_t count);
+
+// depth is rounded up to a power of 2, ready(arg) (optional) is called from whichever thread finishes one
+e3x_async_t e3x_async_new(uint32_t depth, void (*ready)(void *arg), void *arg);
+
+// waits for anything in flight and frees every packet still held
+void e3x_async_free(e3x_async_t q);
+
+// stage a packet (taken) to be submitted by the next flush, user is kept w/ it, 0 when depth are already held (packet freed)
+uint8_t e3x_async_push(e3x_async_t q, lob_t packet, void *user);
+
+// submit staged packets in order, up to E3X_BATCH per call to submit, returns how many were taken
+uint32_t e3x_async_flush(e3x_async_t q, e3x_async_submit_t submit, void *ctx);
+
+// the e3x_cipher_done_t for every submitted slot, result is NULL when it failed, must be called exactly once per slot
+void e3x_async_done(lob_t result, void *slot);
+
+// the packet and user a slot was pushed w/, for wrapping e3x_async_done
+lob_t e3x_async_packet(void *slot);
+void *e3x_async_user(void *slot);
+
+// the oldest result once everything pushed before it has finished, 0 if none yet
+// otherwise 1 w/ the pushed packet and the result (NULL if failed) handed back to the caller
+uint8_t e3x_async_pop(e3x_async_t q, lob_t *packet, lob_t *result);
+
+// pushed and not submitted yet
+uint32_t e3x_async_staged(e3x_async_t q);
+
+// submitted and not finished yet, safe from any thread
+uint32_t e3x_async_pending(e3x_async_t q);
+
+// block the owner until nothing is in flight (yields while waiting), before freeing anything the cipher set may be using
+void e3x_async_wait(e3x_async_t q);
+
+#endif
@@ -8,6 +8,12 @@
 #define remote_t void*
 #define ephemeral_t void*
 
+// most signatures handed to a remote_validate_batch (or packets to an ephemeral_submit_batch) at once
+#define E3X_BATCH 32
+
+// how an async operation finishes, result is NULL if it failed and is then owned by the callee
+typedef void (*e3x_cipher_done_t)(lob_t result, void *arg);
+
 // this is the overall holder for each cipher set, function pointers to cs specific implementations
 typedef struct e3x_cipher_struct
 {
@@ -31,22 +37,76 @@ typedef struct e3x_cipher_struct
   uint8_t (*remote_verify)(remote_t remote, local_t local, lob_t outer);
   lob_t (*remote_encrypt)(remote_t remote, local_t local, lob_t inner);
   uint8_t (*remote_validate)(remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len);
+  // optional, replaces the ephemeral keypair used in new handshakes and writes the new token
+  uint8_t (*remote_rekey)(remote_t remote, uint8_t *token);
+  // optional, validates up to E3X_BATCH at once, sets each errs[i] to what remote_validate would return
+  void (*remote_validate_batch)(remote_t *remotes, lob_t *args, lob_t *sigs, uint8_t **data, size_t *lens, uint8_t *errs, uint32_t count);
   
   // an active session to a remote for channel packets
   ephemeral_t (*ephemeral_new)(remote_t remote, lob_t outer);
   void (*ephemeral_free)(ephemeral_t ephemeral);
   lob_t (*ephemeral_encrypt)(ephemeral_t ephemeral, lob_t inner);
   lob_t (*ephemeral_decrypt)(ephemeral_t ephemeral, lob_t outer);
+  // optional, the replay window of an ephemeral for its drop counters
+  struct e3x_replay_struct *(*ephemeral_replay)(ephemeral_t ephemeral);
+
+  // optional async variants for offload engines (hardware, kernel crypto, worker pools), see e3x_async.h
+  // the packet stays the caller's but is left alone until done(result, arg) is called, exactly once, from any thread
+  // done may come before the submit returns but must never need the submitting thread to return first
+  // the cipher set keeps its own local/ephemeral state consistent across submits, nothing else touches it while any are in flight
+  // returns 0 if it wasn't taken (busy), done won't be called for it
+  uint8_t (*local_decrypt_submit)(local_t local, lob_t outer, e3x_cipher_done_t done, void *arg);
+  uint8_t (*ephemeral_encrypt_submit)(ephemeral_t ephemeral, lob_t inner, e3x_cipher_done_t done, void *arg);
+  uint8_t (*ephemeral_decrypt_submit)(ephemeral_t ephemeral, lob_t outer, e3x_cipher_done_t done, void *arg);
+  // optional, submits up to E3X_BATCH packets together (encrypt when 1, else decrypt), args[i] goes w/ packets[i], returns how many were taken (a prefix)
+  uint32_t (*ephemeral_submit_batch)(ephemeral_t ephemeral, uint8_t encrypt, lob_t *packets, uint32_t count, e3x_cipher_done_t done, void **args);
+
+  // optional, to resume exchanges after a restart, the state is in the body and includes secrets
+  lob_t (*remote_save)(remote_t remote); // just the ephemeral keypair
+  uint8_t (*remote_load)(remote_t remote, lob_t saved, uint8_t *token); // writes the token like remote_new
+  lob_t (*ephemeral_save)(ephemeral_t ephemeral); // versioned, fixed byte order, see e3x_replay_save()
+  ephemeral_t (*ephemeral_load)(lob_t saved); // skips E3X_RESUME_SKIP seqs ahead
+
+  // optional, generate one ephemeral keypair (keylen/secretlen bytes) so they can be pooled ahead of time
+  uint8_t (*keypair)(uint8_t *key, uint8_t *secret);
+  uint16_t keylen, secretlen;
+  struct e3x_pool_struct *pool;
 
   uint8_t id, csid;
   char hex[3], *alg;
 } *e3x_cipher_t;
 
+// pre-generated ephemeral keypairs for a cipher set, pairs holds depth * (keylen+secretlen) bytes
+typedef struct e3x_pool_struct
+{
+  uint8_t *pairs;
+  uint16_t depth, count;
+  uint32_t hits, misses, filled; // taken from the pool, generated inline when empty, generated ahead
+} *e3x_pool_t;
+
+// seqs a resumed ephemeral skips in case more packets were sent after it was saved
+#ifndef E3X_RESUME_SKIP
+#define E3X_RESUME_SKIP 65536
+#endif
+
+// sliding window of accepted incoming channel packet seqs, one per ephemeral
+#ifndef E3X_REPLAY_WINDOW
+#define E3X_REPLAY_WINDOW 1024 // must be a multiple of 32
+#endif
+typedef struct e3x_replay_struct
+{
+  uint64_t top; // highest seq accepted so far
+  uint32_t bits[E3X_REPLAY_WINDOW/32]; // bit (seq % window) is set once seq within the window has been accepted
+  uint32_t dups, stale; // dropped as already seen, dropped as older than the window
+  uint8_t started;
+} *e3x_replay_t;
+
 
 // all possible cipher sets, as index into cipher_sets global
 #define CS_1c 0
 #define CS_3a 1
-#define CS_MAX 2
+#define CS_3b 2
+#define CS_MAX 3
 
 extern e3x_cipher_t e3x_cipher_sets[]; // all created
 extern e3x_cipher_t e3x_cipher_default; // just one of them for the rand/hash utils
@@ -57,8 +117,37 @@ uint8_t e3x_cipher_init(lob_t options);
 // return by id or hex
 e3x_cipher_t e3x_cipher_set(uint8_t csid, char *hex);
 
+// keep up to depth keypairs ready for every cipher set that supports it, 0 disables and frees (the default)
+// lock/unlock are optional, only needed when refilling from another thread
+// the depth may change while fills run (it's done under the current lock), but the lock itself only before any fill has started
+uint8_t e3x_cipher_pool(uint16_t depth, void (*lock)(void *arg), void (*unlock)(void *arg), void *arg);
+
+// generate up to max keypairs into any pools below depth, returns how many were made (call when idle or from a worker)
+uint16_t e3x_cipher_pool_fill(uint16_t max);
+
+// used by the cipher sets, takes a pooled keypair or makes one inline when empty, 0 on failure
+uint8_t e3x_cipher_keypair(e3x_cipher_t cs, uint8_t *key, uint8_t *secret);
+
+// returns json stats for each pool, {"1c":{"depth":8,"count":8,"hits":0,"misses":0,"filled":8}}
+lob_t e3x_cipher_pool_stats(void);
+
+// cheap check before any mac/decrypt work, returns 0 if seq may be new, otherwise counts the drop and returns 1
+uint8_t e3x_replay_check(e3x_replay_t w, uint64_t seq);
+
+// mark seq as seen and slide the window forward, only call once the packet has authenticated
+void e3x_replay_accept(e3x_replay_t w, uint64_t seq);
+
+// the window in a fixed big-endian layout for ephemeral_save (top, started, window size, bits), out must hold E3X_REPLAY_SAVE_BYTES
+#define E3X_REPLAY_SAVE_BYTES (8+1+2+E3X_REPLAY_WINDOW/8)
+size_t e3x_replay_save(e3x_replay_t w, uint8_t *out);
+
+// loads a saved window, returns how many bytes it used or 0 if invalid
+// one saved w/ a different E3X_REPLAY_WINDOW comes back as everything up to its top already seen
+size_t e3x_replay_load(e3x_replay_t w, uint8_t *in, size_t len);
+
 // init functions for each
 e3x_cipher_t cs1c_init(lob_t options);
 e3x_cipher_t cs3a_init(lob_t options);
+e3x_cipher_t cs3b_init(lob_t options);
 
 #endif
@@ -4,6 +4,12 @@
 #include <stdint.h>
 #include "e3x_cipher.h"
 #include "e3x_self.h"
+#include "e3x_async.h"
+
+// how many channel packets each direction can have waiting on async crypto before dropping
+#ifndef E3X_ASYNC_DEPTH
+#define E3X_ASYNC_DEPTH 256
+#endif
 
 // apps should only use accessor functions for values in this struct
 typedef struct e3x_exchange_struct
@@ -12,10 +18,17 @@ typedef struct e3x_exchange_struct
   e3x_self_t self;
   remote_t remote;
   ephemeral_t ephem;
+  ephemeral_t ephem_old; // the previous one, still decrypts until e3x_exchange_expire()
   uint32_t in, out;
   uint32_t cid, last;
+  uint32_t replays; // dropped by earlier ephemerals
+  uint32_t replays_last; // last total read, reported while decrypts are in flight
+  uint32_t packets; // sent on the current keys
+  uint64_t bytes;
+  e3x_async_t sending, receiving; // only when async is on, see e3x_exchange_async()
   uint8_t token[16], eid[16];
-  uint8_t csid, order;
+  uint8_t token_old[16]; // still routes to us while rekeyed is set
+  uint8_t csid, order, rekeyed;
   char hex[3];
 } *e3x_exchange_t;
 
@@ -28,6 +41,8 @@ void e3x_exchange_free(e3x_exchange_t x);
 lob_t e3x_exchange_message(e3x_exchange_t x, lob_t inner);
 uint8_t e3x_exchange_verify(e3x_exchange_t x, lob_t outer);
 uint8_t e3x_exchange_validate(e3x_exchange_t x, lob_t args, lob_t sig, uint8_t *data, size_t len);
+// validates count signatures, together where the cipher set can, optional xs (one per sig), errs[i] as from validate, returns number valid
+uint32_t e3x_exchange_validate_batch(e3x_exchange_t *xs, lob_t *args, lob_t *sigs, uint8_t **data, size_t *lens, uint8_t *errs, uint32_t count);
 
 // return the current incoming at value, optional arg to update it
 uint32_t e3x_exchange_in(e3x_exchange_t x, uint32_t at);
@@ -48,9 +63,43 @@ lob_t e3x_exchange_handshake(e3x_exchange_t x, lob_t inner);
 lob_t e3x_exchange_receive(e3x_exchange_t x, lob_t outer); // goes to channel, validates cid
 lob_t e3x_exchange_send(e3x_exchange_t x, lob_t inner); // comes from channel 
 
+// use the cipher set's async submit/complete crypto for channel packets, when it has it, returns 0 if not
+// ready(arg) is called from whichever thread finishes one, so the owner knows to e3x_exchange_flush() and take the results
+// NULL ready turns it back off, waiting for anything in flight and dropping any results not taken yet
+uint8_t e3x_exchange_async(e3x_exchange_t x, void (*ready)(void *arg), void *arg);
+
+// queue a channel packet (taken) for async encrypt/decrypt, submitted in batches by e3x_exchange_flush() or once E3X_BATCH are waiting
+// returns 0 and frees it if async isn't on or E3X_ASYNC_DEPTH are already waiting
+uint8_t e3x_exchange_send_async(e3x_exchange_t x, lob_t inner);
+uint8_t e3x_exchange_receive_async(e3x_exchange_t x, lob_t outer);
+
+// submit everything queued, returns how many the cipher set took
+uint32_t e3x_exchange_flush(e3x_exchange_t x);
+
+// the oldest finished result in the order they were queued, 0 if none (yet), otherwise 1 w/ the packet or NULL if that one failed
+uint8_t e3x_exchange_sent(e3x_exchange_t x, lob_t *outer);
+uint8_t e3x_exchange_received(e3x_exchange_t x, lob_t *inner);
+
 // validate the next incoming channel id from the packet, or return the next avail outgoing channel id
 uint32_t e3x_exchange_cid(e3x_exchange_t x, lob_t incoming);
 
+// new ephemeral keys for the next handshake (send one w/ a higher out), the current ones keep working until the peer syncs
+e3x_exchange_t e3x_exchange_rekey(e3x_exchange_t x);
+
+// stop decrypting w/ the previous ephemeral and stop routing the previous token, ends a rekey overlap
+e3x_exchange_t e3x_exchange_expire(e3x_exchange_t x);
+
+// current session state to resume from after a restart w/o a new handshake, NULL if no session or not supported
+// includes secrets, the caller must keep it confidential, and nothing should be sent on x after saving
+lob_t e3x_exchange_save(e3x_exchange_t x);
+
+// restores saved state onto a new exchange made from the same key, returns x if it matched
+e3x_exchange_t e3x_exchange_load(e3x_exchange_t x, lob_t saved);
+
+// channel packets dropped as replays (duplicate or older than the window), across all ephemerals so far
+// doesn't wait on async decrypts, the last known count is returned while any are in flight
+uint32_t e3x_exchange_replays(e3x_exchange_t x);
+
 // get the 16-byte token value to this exchange
 uint8_t *e3x_exchange_token(e3x_exchange_t x);
 
@@ -16,6 +16,9 @@ void e3x_self_free(e3x_self_t self); // any exchanges must have been free'd firs
 // try to decrypt any message sent to us, returns the inner
 lob_t e3x_self_decrypt(e3x_self_t self, lob_t message);
 
+// the same through the cipher set's local_decrypt_submit, done(inner, arg) is called once unless this returns 0 (unsupported or busy)
+uint8_t e3x_self_decrypt_submit(e3x_self_t self, lob_t message, e3x_cipher_done_t done, void *arg);
+
 // generate a signature for the data
 lob_t e3x_self_sign(e3x_self_t self, lob_t args, uint8_t *data, size_t len);
 
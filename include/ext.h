@@ -9,10 +9,10 @@
 #include "ext_block.h"
 #include "ext_path.h"
 #include "ext_peer.h"
+#include "ext_sock.h"
 
 //#include "chat.h"
 //#include "thtp.h"
 //#include "connect.h"
-//#include "sock.h"
 
 #endif
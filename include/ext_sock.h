@@ -1,61 +1,82 @@
 #ifndef ext_sock_h
 #define ext_sock_h
-/*
-#include "ext.h"
+
+#include "mesh.h"
 
 #define SOCKC_NEW 0
 #define SOCKC_OPEN 1
 #define SOCKC_CLOSED 2
 
-typedef struct sockc_struct 
+// size of each of the read/write ring buffers
+#ifndef SOCKC_BUFSIZE
+#define SOCKC_BUFSIZE 8192
+#endif
+
+// default max body bytes per outgoing channel packet
+#ifndef SOCKC_MTU
+#define SOCKC_MTU 1024
+#endif
+
+// fixed size byte ring, at is the read offset and len the bytes buffered
+typedef struct sockc_ring_struct
+{
+  uint8_t *buf;
+  uint32_t size, at, len;
+} sockc_ring_s;
+
+typedef struct sockc_struct
 {
   uint8_t state;
-  uint32_t readable, writing;
-  uint8_t *readbuf, *writebuf, *zwrite;
+  uint8_t ended; // remote sent an end/err, closes once all read
+  uint32_t mtu; // max body per packet, defaults to SOCKC_MTU
+  sockc_ring_s readbuf, writebuf;
+  lob_t pending; // partially consumed incoming packet when readbuf is full
+  uint32_t pending_at;
   lob_t opts;
   chan_t c;
   int fd; // convenience for app usage, initialized to -1
 } *sockc_t;
 
-// process channel for new incoming sock channel, any returned sockc must have a read or close function called
-// state is SOCKC_OPEN or SOCKC_NEW (until sockc_accept())
-// it's set to SOCKC_CLOSED after all the data is read on an ended channel or sockc_close() is called
-sockc_t ext_sock(chan_t c);
+// call from a mesh_on_open handler, returns a new sockc (taking the open) if it's a sock channel, else NULL
+// state is SOCKC_NEW until sockc_accept(), any returned sockc must eventually be sockc_close()'d
+sockc_t ext_sock(link_t link, lob_t open);
 
 // changes state from SOCKC_NEW to SOCKC_OPEN
-void sockc_accept(sockc_t sc);
+sockc_t sockc_accept(sockc_t sc);
 
-// create a sock channel to this hn, optional opts (ip, port), sets state=SOCKC_OPEN
-sockc_t sockc_connect(switch_t s, char *hn, lob_t opts);
+// create a sock channel to this link, optional opts (ip, port) are copied into the open, sets state=SOCKC_OPEN
+sockc_t sockc_connect(link_t link, lob_t opts);
 
-// tries to flush and end, cleans up, sets SOCKC_CLOSED
-sockc_t sockc_close(sockc_t sock);
+// flushes any buffered writes and ends the channel, frees sc, always returns NULL
+sockc_t sockc_close(sockc_t sc);
 
-// must be called to free up sc resources (internally calls sockc_close to be sure)
-sockc_t sockc_free(sockc_t sc);
+// nonblocking, returns bytes read into buf up to len, 0 if none yet, -1 once closed and drained
+int sockc_read(sockc_t sc, uint8_t *buf, int len);
 
-// -1 on err, returns bytes read into buf up to len, sets SOCKC_CLOSED when channel ended
-int sockc_read(sockc_t sock, uint8_t *buf, int len);
+// nonblocking, buffers up to len (bounded by free space) and sends any full packets, returns bytes taken or -1
+int sockc_write(sockc_t sc, uint8_t *buf, int len);
 
-// -1 on err, returns len and will always buffer up to len 
-int sockc_write(sockc_t sock, uint8_t *buf, int len);
+// sends everything buffered, including any partial packet
+sockc_t sockc_flush(sockc_t sc);
 
-// general flush outgoing buffer into a packet
-void sockc_flush(chan_t c);
+// returns contiguous readable bytes at *len for zero-copy reading, advance with sockc_zread()
+uint8_t *sockc_zpeek(sockc_t sc, uint32_t *len);
 
-// advances readbuf by this len, for use when doing zero-copy reading directly from ->readbuf
-// sets SOCKC_CLOSED when channel ended
+// advances the read buffer by this len, sets SOCKC_CLOSED when the channel ended and all is read
 void sockc_zread(sockc_t sc, int len);
 
-// creates zero-copy buffer space of requested len at sc->zwrite or returns 0
-int sockc_zwrite(sockc_t sc, int len);
+// returns contiguous writeable space at *len for zero-copy writing, or NULL if full
+uint8_t *sockc_zwrite(sockc_t sc, uint32_t *len);
 
-// must use after writing anything to ->zwrite, adds len to outgoing buffer and resets sc->zwrite, returns len
+// must use after filling space from sockc_zwrite(), adds len to the outgoing buffer, returns len
 int sockc_zwritten(sockc_t sc, int len);
 
-// serial-style single character interface
+// buffered bytes available to read / free space to write, -1 on err
 int sockc_available(sockc_t sc);
-uint8_t sockc_sread(sockc_t sc);
-uint8_t sockc_swrite(sockc_t sc, uint8_t byte);
-*/
+int sockc_writeable(sockc_t sc);
+
+// serial-style single character interface
+int sockc_sread(sockc_t sc);
+int sockc_swrite(sockc_t sc, uint8_t byte);
+
 #endif
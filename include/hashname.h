@@ -14,15 +14,22 @@ typedef struct hashname_struct
 hashname_t hashname_dup(hashname_t hn);
 hashname_t hashname_free(hashname_t hn);
 
-// everything else returns a pointer to a static global for temporary use
+// everything else returns a pointer to a per-thread global for temporary use
 hashname_t hashname_vchar(const char *str); // from a string
 hashname_t hashname_vbin(const uint8_t *bin);
 hashname_t hashname_vkeys(lob_t keys);
 hashname_t hashname_vkey(lob_t key, uint8_t id); // key is body, intermediates in json
 
+// the _r versions fill in the caller's out and return it (or NULL), safe to hold across other calls
+hashname_t hashname_vchar_r(const char *str, hashname_t out);
+hashname_t hashname_vbin_r(const uint8_t *bin, hashname_t out);
+hashname_t hashname_vkeys_r(lob_t keys, hashname_t out);
+hashname_t hashname_vkey_r(lob_t key, uint8_t id, hashname_t out);
+
 // accessors
 uint8_t *hashname_bin(hashname_t hn); // 32 bytes
 char *hashname_char(hashname_t hn); // 52 byte base32 string w/ \0 (TEMPORARY)
+char *hashname_char_r(hashname_t hn, char *out); // out must be 53 bytes
 
 // utilities related to hashnames
 int hashname_cmp(hashname_t a, hashname_t b);  // memcmp shortcut
@@ -31,9 +38,12 @@ lob_t hashname_im(lob_t keys, uint8_t id); // intermediate hashes in the json, o
 
 // working with short hashnames (5 bin bytes, 8 char bytes)
 char *hashname_short(hashname_t hn); // 8 byte base32 string w/ \0 (TEMPORARY)
+char *hashname_short_r(hashname_t hn, char *out); // out must be 9 bytes
 int hashname_scmp(hashname_t a, hashname_t b);  // short only comparison
 hashname_t hashname_schar(const char *str); // 8 char string, temp hn
+hashname_t hashname_schar_r(const char *str, hashname_t out);
 hashname_t hashname_sbin(const uint8_t *bin); // 5 bytes, temp hn
+hashname_t hashname_sbin_r(const uint8_t *bin, hashname_t out);
 hashname_t hashname_isshort(hashname_t hn); // NULL unless is short
 
 #endif
@@ -23,6 +23,7 @@ uint32_t jwt_len(lob_t token); // length of raw bytes
 
 lob_t jwt_claims(lob_t token); // just returns the claims from the token
 lob_t jwt_verify(lob_t token, e3x_exchange_t x); // checks signature, optional x for pk algs
+uint32_t jwt_verify_batch(lob_t *tokens, e3x_exchange_t *xs, uint8_t *valid, uint32_t count); // checks many at once, optional xs (one per token), returns number valid
 lob_t jwt_sign(lob_t token, e3x_self_t self); // attaches signature to the claims, optional self for pk algs
 
 // checks if this alg is supported
@@ -5,6 +5,8 @@
 #include "lob.h"
 #include "murmur.h"
 #include "chacha.h"
+#include "poly1305.h"
+#include "x25519.h"
 #include "xht.h"
 #include "aes128.h"
 #include "sha256.h"
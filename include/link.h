@@ -13,6 +13,11 @@ struct link_struct
   lob_t key, handshake;
   chan_t chans;
   uint32_t state; // peer's current state
+  lob_t cookie; // challenge from a busy peer, echoed w/ our handshakes
+  mesh_metrics_s metrics;
+  uint32_t rtt; // smoothed handshake round trip in ms
+  uint32_t last; // seconds anything was last received
+  uint32_t queued; // bytes buffered in the pipe, set by transports that frame packets
 
   // transport plumbing
   void *send_arg;
@@ -20,6 +25,9 @@ struct link_struct
   
   // these are for internal link management only
   link_t next;
+  uint32_t pinged; // ms a handshake round trip started
+  uint32_t cookied; // ms a cookie challenge was last echoed
+  uint32_t keyed, expire; // link_process() time the current keys were first seen, and when the previous ones stop decrypting
   uint8_t csid;
 };
 
@@ -35,6 +43,9 @@ lob_t link_key(link_t link);
 // get link info json
 lob_t link_json(link_t link);
 
+// counters and gauges json for just this link
+lob_t link_metrics(link_t link);
+
 // removes from mesh
 void link_free(link_t link);
 
@@ -56,6 +67,15 @@ link_t link_send(link_t link, lob_t outer);
 // encrypt and send this packet
 link_t link_direct(link_t link, lob_t inner);
 
+// encrypt (takes inner) and send, behind anything still being encrypted when the crypto is async
+link_t link_seal(link_t link, lob_t inner);
+
+// turn the exchange's async crypto on or off to match the mesh's
+link_t link_async(link_t link);
+
+// submit batched async crypto and apply what's finished in order, sends go out and received packets are processed, returns how many
+uint32_t link_flush(link_t link);
+
 // return current handshake (caller free's)
 lob_t link_handshake(link_t link);
 
@@ -65,6 +85,9 @@ link_t link_sync(link_t link);
 // force generate new encrypted handshake(s) and sync
 link_t link_resync(link_t link);
 
+// new ephemeral keys and resync, the previous ones keep decrypting for the mesh's rekey overlap
+link_t link_rekey(link_t link);
+
 // is the other endpoint connected and the link available, NULL if not
 link_t link_up(link_t link);
 
@@ -10,9 +10,60 @@ typedef struct chan_struct *chan_t;
 #include "e3x.h"
 #include "lib.h"
 #include "util.h"
+
+// traffic counters, plain adds by whichever thread drives the mesh, each link keeps its own and they're summed on read
+typedef struct mesh_metrics_struct
+{
+  uint64_t packets_in, packets_out, bytes_in, bytes_out;
+  uint32_t decrypt_fails; // channel packets that failed the mac/decrypt
+  uint32_t handshakes_in, handshakes_out, handshakes_rejected;
+  uint32_t dropped; // unknown tokens/routes, packets too small to be anything, or no room left for async crypto
+} mesh_metrics_s;
+
 #include "chan.h"
 #include "link.h"
 
+// cookie lifetime, issued cookies are honored for one to two of these
+#ifndef MESH_COOKIE_SECS
+#define MESH_COOKIE_SECS 60
+#endif
+
+// a link answers at most one cookie challenge this often, and only while its own handshake is unanswered
+#ifndef MESH_COOKIE_MS
+#define MESH_COOKIE_MS 1000
+#endif
+
+// handshake admission control state, see mesh_admission()
+typedef struct mesh_admit_struct
+{
+  uint32_t rate, burst; // per-source handshakes/sec and bucket size, 0 rate is unlimited
+  uint32_t total; // handshakes/sec across all sources, 0 is unlimited
+  uint8_t cookies; // require a stateless cookie round trip before decrypting
+  uint8_t secret[32]; // cookie key
+  uint32_t since; // seconds the ms clock starts at
+  util_bucket_s bucket; // for total
+  uint32_t admitted, dropped, challenged, cookied;
+} *mesh_admit_t;
+
+// seconds the previous keys keep decrypting after a link rekeys
+#ifndef MESH_REKEY_OVERLAP
+#define MESH_REKEY_OVERLAP 10
+#endif
+
+// packets sent before a link rekeys by default, well under where any cipher set's seq runs out
+#ifndef MESH_REKEY_PACKETS
+#define MESH_REKEY_PACKETS (1UL << 30)
+#endif
+
+// proactive rekeying thresholds, see mesh_rekey()
+typedef struct mesh_rekey_struct
+{
+  uint32_t packets, secs; // 0 is unlimited
+  uint64_t bytes;
+  uint32_t overlap;
+  uint32_t rekeys; // how many links have rekeyed
+} mesh_rekey_s;
+
 struct mesh_struct
 {
   hashname_t id;
@@ -21,6 +72,16 @@ struct mesh_struct
   void *on; // internal list of triggers
   uint32_t state; // our current state (from app)
   link_t links;
+  mesh_admit_t admit; // NULL unless mesh_admission() enabled
+  mesh_rekey_s rekey;
+  uint8_t resume[32]; // seals mesh_save() state, derived from the secrets
+  mesh_metrics_s metrics; // anything received before it's known which link it's for
+  uint32_t since; // seconds the ms clock for link rtt starts at
+  uint8_t (*offload)(mesh_t mesh, lob_t outer, void *arg); // see mesh_offload()
+  void *offload_arg;
+  void (*async)(mesh_t mesh, void *arg); // see mesh_async()
+  void *async_arg;
+  e3x_async_t handshakes; // waiting on async local decrypts
 };
 
 mesh_t mesh_new(void);
@@ -55,9 +116,61 @@ mesh_t mesh_unlink(link_t link);
 // processes incoming packet, it will take ownership of packet, returns link delivered to if success
 link_t mesh_receive(mesh_t mesh, lob_t packet);
 
+// shed handshake floods before the expensive decrypt, rate/burst are per-source handshakes/sec, total is across all sources (0 is unlimited)
+// when cookies is set, handshakes must first echo a stateless cookie back, all 0 disables admission
+// this only has an effect on transports that call mesh_admit() (udp4, serial, loopback, sim), others hand handshakes straight to mesh_receive()
+mesh_t mesh_admission(mesh_t mesh, uint32_t rate, uint32_t burst, uint32_t total, uint8_t cookies);
+
+// transports call this w/ the source's bucket and address before mesh_receive(), takes ownership of packet
+// returns the packet to receive or NULL if dropped, any cookie challenge to send back to the source is set in *reply
+lob_t mesh_admit(mesh_t mesh, lob_t packet, util_bucket_s *bucket, uint8_t *src, size_t srclen, lob_t *reply);
+
+// returns {"admitted":n,"dropped":n,"challenged":n,"cookied":n}, or NULL if not enabled
+lob_t mesh_admission_stats(mesh_t mesh);
+
+// links rekey once they've sent this many packets or bytes on the same keys, or the keys are this many seconds old (0 is unlimited)
+// the previous keys keep decrypting for overlap seconds so nothing in flight is lost, defaults are MESH_REKEY_PACKETS and MESH_REKEY_OVERLAP
+mesh_t mesh_rekey(mesh_t mesh, uint32_t packets, uint64_t bytes, uint32_t secs, uint32_t overlap);
+
+// snapshot of the mesh counters summed w/ all of its links, plus links/channels/queued/replays gauges
+lob_t mesh_metrics(mesh_t mesh);
+
+// sets each counter as a json number
+lob_t mesh_metrics_set(lob_t json, mesh_metrics_s *metrics);
+
+// the same snapshot and every link's as prometheus text exposition in the body
+lob_t mesh_prometheus(mesh_t mesh);
+
+// session state of every up link so a restart can resume them w/o new handshakes, sealed w/ a key from this identity's secrets
+// the links should not send anything more after saving, returns NULL if none
+lob_t mesh_save(mesh_t mesh);
+
+// resume the links in mesh_save() state, the mesh must be loaded w/ the same secrets, returns how many resumed
+// resumed links are up right away and only need a pipe, link events fire for each
+// a saved state is single use, it's wiped once opened and must never be restored again from another copy
+uint32_t mesh_restore(mesh_t mesh, lob_t saved);
+
 // process any unencrypted handshake packet
 link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake);
 
+// hand the decrypt of incoming handshakes to offload (e.g. a thread pool) instead of doing it inline, NULL to stop
+// offload takes ownership of the outer unless it returns 0 to have it decrypted inline after all
+void mesh_offload(mesh_t mesh, uint8_t (*offload)(mesh_t mesh, lob_t outer, void *arg), void *arg);
+
+// finish an offloaded handshake w/ the result of e3x_self_decrypt(mesh->self, outer) (NULL if failed), on the mesh's own thread
+// takes ownership of both, returns the link like mesh_receive()
+link_t mesh_receive_decrypted(mesh_t mesh, lob_t outer, lob_t inner);
+
+// use the cipher sets' async submit/complete crypto (see e3x_async.h) where they have it, for channel packets and handshakes
+// ready(mesh, arg) is called from whichever thread finishes some, the app must then mesh_flush() on the mesh's own thread
+// NULL ready turns it off, anything still in flight is waited for and dropped, set it only once while on
+// handshakes decrypted this way return NULL from mesh_receive() like mesh_offload(), so transports should link peers ahead
+mesh_t mesh_async(mesh_t mesh, void (*ready)(mesh_t mesh, void *arg), void *arg);
+
+// submit batched async crypto and apply whatever's finished in the order it arrived or was sent, returns how many
+// call after each burst of mesh_receive()/chan_send() and whenever ready fires, mesh_process() does too
+uint32_t mesh_flush(mesh_t mesh);
+
 // process any channel timeouts based on the current/given time
 mesh_t mesh_process(mesh_t mesh, uint32_t now);
 
@@ -0,0 +1,57 @@
+#ifndef mesh_workers_h
+#define mesh_workers_h
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#include "mesh.h"
+
+// spreads many meshes (identities) across threads, each mesh is owned by exactly one worker thread once started
+// everything else reaches a mesh only through its worker's lock-free queue, so no mesh or link is ever shared
+// e3x_init() (and any e3x_cipher_pool(), given a lock) must be done before starting, the cipher sets are read-only after that
+
+// most meshes one pool can hold
+#define MESH_WORKERS_MAX 255
+
+// slots in the channel token -> mesh routing table
+#ifndef MESH_WORKERS_TOKENS
+#define MESH_WORKERS_TOKENS 4096
+#endif
+
+typedef struct mesh_workers_struct *mesh_workers_t;
+
+// a pipe's send, new links from received packets are given it w/ the arg on their worker thread so it must be thread-safe
+typedef link_t (*mesh_workers_pipe_t)(link_t link, lob_t packet, void *arg);
+
+// threads to run (0 is one per cpu), depth is how many packets/calls each worker can have queued before dropping
+mesh_workers_t mesh_workers_new(uint8_t threads, uint32_t depth);
+
+// stops and joins the threads, anything still queued is dropped, the meshes are the caller's again (not freed)
+mesh_workers_t mesh_workers_free(mesh_workers_t w);
+
+// assigns a loaded mesh to a worker (round robin), only before mesh_workers_start(), returns the worker index or -1
+int mesh_workers_add(mesh_workers_t w, mesh_t mesh);
+
+// decrypt incoming handshakes on this many separate crypto threads instead of inline on the mesh's worker, only before starting
+// they're applied back on the owning worker in order w/ its other packets, when depth are already waiting new ones are dropped
+mesh_workers_t mesh_workers_offload(mesh_workers_t w, uint8_t threads, uint32_t depth);
+
+// start the threads, each one drains its queue and runs mesh_process() every second for its meshes
+mesh_workers_t mesh_workers_start(mesh_workers_t w);
+
+// run fn(mesh, arg) on the mesh's worker thread, the only safe way to touch a mesh once started, 0 if the queue is full
+uint8_t mesh_workers_call(mesh_workers_t w, mesh_t mesh, void (*fn)(mesh_t mesh, void *arg), void *arg);
+
+// hand a received packet to the mesh it's for, takes ownership of packet, safe from any thread
+// channel packets route by their token, routed packets by hashname, handshakes and json go to every mesh that could take them
+// returns how many meshes it was queued for, 0 if dropped
+uint8_t mesh_workers_receive(mesh_workers_t w, lob_t packet, mesh_workers_pipe_t pipe, void *arg);
+
+// when the transport already knows which mesh it's for (a socket per identity), takes ownership of packet
+uint8_t mesh_workers_deliver(mesh_workers_t w, mesh_t mesh, lob_t packet, mesh_workers_pipe_t pipe, void *arg);
+
+// {"routed":n,"broadcast":n,"unrouted":n,"processed":n,"dropped":n}, w/ "offloaded","decrypted","offload_dropped" when offloading
+lob_t mesh_workers_stats(mesh_workers_t w);
+
+#endif // POSIX
+
+#endif // mesh_workers_h
@@ -6,6 +6,7 @@
 typedef struct net_loopback_struct
 {
   mesh_t a, b;
+  util_bucket_s ab, ba; // handshake admission for each direction
 } *net_loopback_t;
 
 // connect two mesh instances with each other for packet delivery
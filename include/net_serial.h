@@ -10,20 +10,33 @@ extern "C" {
 
 #include "mesh.h"
 
+// process loops w/o any line activity before a stalled framed pipe is resynced
+#ifndef NET_SERIAL_STALL
+#define NET_SERIAL_STALL 100
+#endif
+
+typedef struct pipe_serial_struct *pipe_serial_t;
+
 // overall server
 typedef struct net_serial_struct
 {
   mesh_t mesh;
-  xht_t pipes;
+  pipe_serial_t pipes;
 } *net_serial_t;
 
 // create a new serial hub
 net_serial_t net_serial_new(mesh_t mesh, lob_t options);
 void net_serial_free(net_serial_t net);
 
-// add a named serial pipe and I/O callbacks for it
+// add a named serial pipe and I/O callbacks for it, read returns one byte or -1 when empty
 net_serial_t net_serial_add(net_serial_t net, const char *name, int (*read)(void), int (*write)(uint8_t *buf, size_t len), uint8_t buffer);
 
+// same but read fills buf w/ up to len bytes and returns how many, 0 when empty
+net_serial_t net_serial_add_bulk(net_serial_t net, const char *name, int (*read)(uint8_t *buf, size_t len), int (*write)(uint8_t *buf, size_t len), uint8_t buffer);
+
+// switch a named pipe to windowed chunks w/ a sync marker and crc32 so line noise is dropped and recovered from, both ends must match
+net_serial_t net_serial_framed(net_serial_t net, const char *name, uint16_t size, uint8_t window);
+
 // manually send a packet down a named pipe (discovery, etc)
 net_serial_t net_serial_send(net_serial_t net, const char *name, lob_t packet);
 
@@ -0,0 +1,51 @@
+#ifndef net_sim_h
+#define net_sim_h
+
+#include "mesh.h"
+
+// deterministic simulated network between any number of meshes in one process, for reproducible throughput/latency tests
+// packets are queued as events on a virtual clock and only delivered from net_sim_run(), never by recursing from a send
+
+// how each direction of a pipe behaves, all zeros is an ideal pipe
+typedef struct net_sim_cfg_struct
+{
+  uint32_t latency, jitter; // one way delay and +/- random spread, microseconds
+  uint32_t bandwidth; // bytes/sec, packets serialize behind each other, 0 is unlimited
+  uint32_t queue; // bytes allowed to wait for bandwidth before dropping, 0 is unlimited
+  uint32_t loss, reorder; // chance per million packets of being lost, or held back an extra latency so later ones pass it
+  uint32_t mtu; // bigger packets are dropped, 0 is unlimited
+} net_sim_cfg_s;
+
+// per direction counters
+typedef struct net_sim_stats_struct
+{
+  uint32_t sent, delivered, lost, reordered, mtu, queue;
+  uint64_t bytes;
+} net_sim_stats_s;
+
+typedef struct net_sim_struct *net_sim_t;
+
+// seed drives every random choice the network makes
+net_sim_t net_sim_new(uint32_t seed);
+void net_sim_free(net_sim_t sim);
+
+// connect two meshes, cfg (copied) applies to both directions, NULL is ideal, can be called again to change it
+net_sim_t net_sim_pipe(net_sim_t sim, mesh_t a, mesh_t b, net_sim_cfg_s *cfg);
+
+// change only the from->to direction
+net_sim_t net_sim_direction(net_sim_t sim, mesh_t from, mesh_t to, net_sim_cfg_s *cfg);
+
+// the from->to direction's counters, NULL if not connected
+net_sim_stats_s *net_sim_stats(net_sim_t sim, mesh_t from, mesh_t to);
+
+// virtual time in microseconds, it starts at 0 and only moves in net_sim_run()
+uint64_t net_sim_now(net_sim_t sim);
+
+// deliver everything due in the next us microseconds in time order, every mesh gets mesh_process() as each virtual second passes
+// returns how many packets were delivered
+uint32_t net_sim_run(net_sim_t sim, uint64_t us);
+
+// packets still in flight
+uint32_t net_sim_pending(net_sim_t sim);
+
+#endif
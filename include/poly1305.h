@@ -0,0 +1,38 @@
+#ifndef poly1305_h
+#define poly1305_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLY1305_KEYLEN 32
+#define POLY1305_TAGLEN 16
+
+// incremental state, 26-bit limbs so it only needs 32x32->64 multiplies
+typedef struct poly1305_struct
+{
+  uint32_t r[5], h[5], pad[4];
+  uint8_t buffer[16];
+  uint8_t leftover, final;
+} poly1305_s;
+
+void poly1305_init(poly1305_s *st, const uint8_t *key);
+void poly1305_update(poly1305_s *st, const uint8_t *m, size_t len);
+void poly1305_finish(poly1305_s *st, uint8_t *mac); // also wipes the state
+
+// one-shot, key must only ever be used once
+uint8_t *poly1305(const uint8_t *key, const uint8_t *m, size_t len, uint8_t *mac);
+
+// RFC 8439 AEAD w/ a 32 byte key and 12 byte nonce, both convert bytes in place
+// seal encrypts and writes the 16 byte tag, open checks the tag first and only then decrypts, both return 0 on failure
+uint8_t chacha20poly1305_seal(uint8_t *key, uint8_t *nonce, const uint8_t *aad, size_t aad_len, uint8_t *bytes, uint32_t len, uint8_t *tag);
+uint8_t chacha20poly1305_open(uint8_t *key, uint8_t *nonce, const uint8_t *aad, size_t aad_len, uint8_t *bytes, uint32_t len, const uint8_t *tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -35,6 +35,35 @@ faster somewhat faster, but increases the code size. */
     #define uECC_SQUARE_FUNC 0
 #endif
 
+/* uECC_FIXED_BASE_COMB - If enabled (defined as nonzero), key generation and signing on secp256r1
+use a precomputed comb table of generator multiples instead of the generic point multiplication,
+which is several times faster. The table is built on first use (or by uECC_precompute()) and takes
+uECC_COMB_TABLES * 2^uECC_COMB_TEETH points of RAM, 8KB with the defaults on 64-bit platforms.
+Disabled by default on memory-constrained (avr/arm) builds. */
+#ifndef uECC_FIXED_BASE_COMB
+    #if defined(__AVR__) || defined(__arm__) || defined(__thumb__)
+        #define uECC_FIXED_BASE_COMB 0
+    #else
+        #define uECC_FIXED_BASE_COMB 1
+    #endif
+#endif
+#ifndef uECC_COMB_TEETH
+    #define uECC_COMB_TEETH 6
+#endif
+#ifndef uECC_COMB_TABLES
+    #define uECC_COMB_TABLES 2
+#endif
+
+/* uECC_BATCH_SIZE - The number of signatures uECC_verify_batch() verifies together, sharing
+each modular inversion between them. Each one takes about 13 curve-sized words of stack. */
+#ifndef uECC_BATCH_SIZE
+    #if defined(__AVR__) || defined(__arm__) || defined(__thumb__)
+        #define uECC_BATCH_SIZE 4
+    #else
+        #define uECC_BATCH_SIZE 16
+    #endif
+#endif
+
 /* uECC_VLI_NATIVE_LITTLE_ENDIAN - If enabled (defined as nonzero), this will switch to native
 little-endian format for *all* arrays passed in and out of the public API. This includes public 
 and private keys, shared secrets, signatures and message hashes. 
@@ -130,6 +159,14 @@ Returns the function that will be used to generate random bytes.
 */
 uECC_RNG_Function uECC_get_rng(void);
 
+/* uECC_precompute() function.
+Build any fixed-base tables for the curve now instead of on first use (see uECC_FIXED_BASE_COMB).
+Call this once before using the curve from multiple threads.
+
+Returns 1 if the curve has a table, 0 if it uses the generic point multiplication.
+*/
+int uECC_precompute(uECC_Curve curve);
+
 /* uECC_curve_private_key_size() function.
 
 Returns the size of a private key for the curve in bytes.
@@ -353,6 +390,32 @@ int uECC_verify(const uint8_t *public_key,
                 const uint8_t *signature,
                 uECC_Curve curve);
 
+/* uECC_verify_batch() function.
+Verify several ECDSA signatures at once. Results match calling uECC_verify() on each, but the
+three modular inversions each verification needs are shared across every uECC_BATCH_SIZE
+signatures (Montgomery's trick), and the G + Q point used by Shamir's trick is only computed
+once per distinct public key in the batch.
+
+Inputs:
+    public_keys    - The signers' public keys, one per signature (may repeat).
+    message_hashes - The hashes of the signed data, one per signature.
+    hash_size      - The size of each message hash in bytes.
+    signatures     - The signature values.
+    num            - The number of signatures.
+
+Outputs:
+    valid - Set to 1 for each valid signature, 0 for each invalid one.
+
+Returns the number of valid signatures.
+*/
+unsigned uECC_verify_batch(const uint8_t * const *public_keys,
+                           const uint8_t * const *message_hashes,
+                           unsigned hash_size,
+                           const uint8_t * const *signatures,
+                           unsigned num,
+                           uint8_t *valid,
+                           uECC_Curve curve);
+
 #ifdef __cplusplus
 } /* end of extern "C" */
 #endif
@@ -5,13 +5,31 @@
 #include <stdlib.h>
 #include <string.h>
 
+// the library's temporary buffers are per-thread, define as empty for toolchains w/o thread-local storage
+#ifndef UTIL_TLS
+#define UTIL_TLS __thread
+#endif
+
+// token bucket, refills rate tokens/sec up to burst, kept in thousandths of a token (up here since mesh.h needs it)
+typedef struct util_bucket_struct
+{
+  uint32_t tokens;
+  uint32_t at; // ms of the last take, 0 is a new (full) bucket
+} util_bucket_s;
+
 #include "util_sys.h"
 #include "util_uri.h"
 #include "util_chunks.h"
 #include "util_frames.h"
 #include "util_unix.h"
+#include "util_trace.h"
+
+// NULL out uses a fixed per-thread buffer (nothing to free at thread exit), longer input is cut to this many bytes
+#ifndef UTIL_HEX_TMP
+#define UTIL_HEX_TMP 128
+#endif
 
-// make sure out is 2*len + 1
+// make sure out is 2*len + 1, or NULL returns a per-thread buffer (TEMPORARY)
 char *util_hex(uint8_t *in, size_t len, char *out);
 // out must be len/2
 uint8_t *util_unhex(char *in, size_t len, uint8_t *out);
@@ -34,6 +52,19 @@ uint32_t util_since(uint64_t at); // get ms since the at
 // Use a constant time comparison function to avoid timing attacks
 int util_ct_memcmp(const void* s1, const void* s2, size_t n);
 
+// wipe secrets, won't be optimized away like a memset before free
+void util_zero(void *ptr, size_t len);
+
+// big-endian (network byte order) unsigned ints of 1-8 bytes, for anything that has to mean the same on every host
+uint8_t *util_put_be(uint64_t val, uint8_t *out, uint8_t bytes);
+uint64_t util_get_be(const uint8_t *in, uint8_t bytes);
+
+// standard crc32 (ieee 802.3), pass 0 to start or a previous result to continue
+uint32_t util_crc32(uint32_t crc, const uint8_t *buf, size_t len);
+
+// takes one token at now (in ms, never 0), returns 0 if empty, a 0 rate is unlimited
+uint8_t util_bucket_take(util_bucket_s *bucket, uint32_t rate, uint32_t burst, uint32_t now);
+
 // embedded may not have strdup but it's a kinda handy shortcut
 char *util_strdup(const char *str);
 #ifndef strdup
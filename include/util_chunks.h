@@ -24,13 +24,62 @@ typedef struct util_chunks_struct
   uint8_t readat; // always less than a max chunk, offset into reading
 
   uint8_t cap;
-  uint8_t blocked:1, blocking:1, ack:1, err:1; // bool flags
+  uint8_t blocked:1, blocking:1, ack:1, err:1, v2:1; // bool flags
+
+  // v2 only, 16-bit chunk lengths w/ a window of unacked chunks
+  uint16_t max; // max bytes per chunk
+  uint16_t size; // current outgoing chunk data size
+  uint8_t head[4], tail[4]; // current outgoing chunk header (w/ sync when framed) and crc
+  uint8_t body[6]; // data of an outgoing reset/resume
+  uint8_t ready:1, framed:1, reset:1, resume:1, resync:1, flushed:1; // header is set, using sync/crc, owe a reset, owe a resume, discarding till resume, waiting on the flush ack
+  uint8_t ask:1, skip:1, control:1, readodd:1, writeodd:1, resumeodd:1; // our reset asks for theirs, drop the rest of this packet (lost or too big), sending a body, parity of packets received/sent/they've received
+  size_t resumeat; // where they asked us to resume the current packet
+  uint8_t resets, resumeseq; // our last reset, and theirs to answer
+  uint8_t window, unacked; // max and current chunks in flight
+  uint16_t acks; // incoming chunks not yet acked
+  lob_t received; // reassembled packets
+  uint8_t *readbuf; // reassembly buffer, reused across packets
+  size_t readlen, readcap;
+  uint16_t readsize, readgot; // current incoming chunk
+  uint8_t readhead[4], readheadat;
+  uint8_t readcrc[4], readcrcat;
+  uint32_t errors; // framed chunks dropped for a bad crc/header
 } *util_chunks_t;
 
+// largest v2 chunk, the high bit of a v2 length flags a control: an ack of that many chunks, or reset/resume
+#define UTIL_CHUNKS_V2_MAX 0x7fff
+#define UTIL_CHUNKS_V2_ACKS 0x7ffd
+#define UTIL_CHUNKS_V2_RESET 0xffff // receiver lost sync and tells the sender how much of the current packet it has
+#define UTIL_CHUNKS_V2_RESUME 0xfffe // answers a reset, the sender's packet continues from there
+
+// resets and resumes have a body of flags, the reset's sequence, and a 4-byte big-endian offset into the packet
+#define UTIL_CHUNKS_V2_BODY 6
+#define UTIL_CHUNKS_V2_ASK 0x01 // a reset asking for theirs too, when our acks may have been lost
+#define UTIL_CHUNKS_V2_ODD 0x02 // an odd number of packets received so far
+
+// largest v2 packet reassembled, anything bigger is dropped as it arrives
+#ifndef UTIL_CHUNKS_PACKET_MAX
+#define UTIL_CHUNKS_PACKET_MAX 65536
+#endif
+
+// framed v2 chunks start w/ this marker and end w/ a crc32 of the header and data
+#define UTIL_CHUNKS_SYNC0 0xa5
+#define UTIL_CHUNKS_SYNC1 0x5a
+
 
 // size of each chunk, 0 == MAX (256)
 util_chunks_t util_chunks_new(uint8_t size);
 
+// switch to v2 chunking (before any use) w/ up to size bytes per chunk (0 == UTIL_CHUNKS_V2_MAX) and window chunks in flight before blocking for acks, both sides must match
+// v2 is for the stream-based api only
+util_chunks_t util_chunks_v2(util_chunks_t chunks, uint16_t size, uint8_t window);
+
+// add a sync marker and crc32 to every v2 chunk so a noisy stream recovers by itself (implies v2), both sides must match
+util_chunks_t util_chunks_framed(util_chunks_t chunks);
+
+// framed only, when stalled (lost acks or a partial chunk) both sides resume their packets from the last whole chunk the other got
+util_chunks_t util_chunks_resync(util_chunks_t chunks);
+
 util_chunks_t util_chunks_free(util_chunks_t chunks);
 
 // turn this packet into chunks and append, free's out
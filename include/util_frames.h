@@ -4,6 +4,10 @@
 #include <stdint.h>
 #include "lob.h"
 
+// initial packet slots in each of the inbox/outbox rings, they double when full
+#ifndef UTIL_FRAMES_QUEUE
+#define UTIL_FRAMES_QUEUE 8
+#endif
 
 typedef struct util_frames_s util_frames_s, *util_frames_t;
 
@@ -44,4 +48,13 @@ util_frames_t util_frames_sent(util_frames_t frames);
 // active sending and/or receiving
 util_frames_t util_frames_busy(util_frames_t frames);
 
+// datagram mode, each packet is one datagram prefixed w/ a compact header (16-bit magic, 16-bit length)
+#define UTIL_FRAMES_DGRAM_HDR 4
+
+// writes the header for the next outbox packet into hdr and returns its raw bytes, send both in one datagram then call util_frames_sent()
+uint8_t *util_frames_dgram_outbox(util_frames_t frames, uint8_t *hdr, uint32_t *len);
+
+// parses one whole datagram straight into an inbox packet
+util_frames_t util_frames_dgram_inbox(util_frames_t frames, uint8_t *data, uint32_t len);
+
 #endif
@@ -9,6 +9,9 @@ at_t util_sys_seconds();
 // number of milliseconds since given epoch seconds value
 unsigned long long util_sys_ms(long epoch);
 
+// monotonic nanoseconds for timing, only differences are meaningful
+uint64_t util_sys_ns(void);
+
 unsigned short util_sys_short(unsigned short x);
 unsigned long util_sys_long(unsigned long x);
 
@@ -19,11 +22,34 @@ long util_sys_random(void);
 // -1 toggles debug, 0 disable, 1 enable
 void util_sys_logging(int enabled);
 
+// highest syslog level printed while logging is enabled, default is everything (8)
+void util_sys_log_level(int level);
+
+// the runtime filter the LOG macros check before evaluating any arguments, -1 when logging is off
+extern int util_sys_log_max;
+
 // returns NULL for convenient return logging
 void *util_sys_log(uint8_t level, const char *file, int line, const char *function, const char * format, ...);
 
+// queue log lines in a lock-free ring of slots (rounded up to a power of two) instead of writing to stderr every time
+// producers never block, lines are dropped when it's full, 0 goes back to writing directly (only change modes while idle)
+uint8_t util_sys_log_async(uint16_t slots);
+
+// write out queued lines, from one thread at a time, returns how many
+uint32_t util_sys_log_flush(void);
+
+// lines dropped because the ring was full
+uint32_t util_sys_log_dropped(void);
+
+// highest level compiled in, anything above it is removed entirely along w/ its arguments (-DLOG_COMPILE_LEVEL=4 keeps WARN and worse)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 8
+#endif
+
 // use syslog levels https://en.wikipedia.org/wiki/Syslog#Severity_level
-#define LOG_LEVEL(level, fmt, ...) util_sys_log(level, __FILE__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+// arguments are only evaluated when the level is compiled in and enabled at runtime
+#define LOG_LEVEL(level, fmt, ...) (((level) <= LOG_COMPILE_LEVEL && (level) <= util_sys_log_max) ? util_sys_log(level, __FILE__, __LINE__, __func__, fmt, ## __VA_ARGS__) : util_sys_nolog())
+static inline void *util_sys_nolog(void) { return NULL; } // so a compiled out LOG is still a statement w/ an effect
 
 // default LOG is DEBUG level and compile-time optional
 #ifndef LOG_DEBUG
@@ -35,15 +61,15 @@ void *util_sys_log(uint8_t level, const char *file, int line, const char *functi
 #define LOG_ERROR LOG
 #define LOG_CRAZY LOG
 #else
-#define LOG(fmt, ...) util_sys_log(7, __FILE__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+#define LOG(fmt, ...) LOG_LEVEL(7, fmt, ## __VA_ARGS__)
 #define LOG_DEBUG LOG
-#define LOG_INFO(fmt, ...) util_sys_log(6, __FILE__, __LINE__, __func__, fmt, ## __VA_ARGS__)
-#define LOG_WARN(fmt, ...) util_sys_log(4, __FILE__, __LINE__, __func__, fmt, ## __VA_ARGS__)
-#define LOG_ERROR(fmt, ...) util_sys_log(3, __FILE__, __LINE__, __func__, fmt, ## __VA_ARGS__)
-#define LOG_CRAZY(fmt, ...) util_sys_log(8, __FILE__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+#define LOG_INFO(fmt, ...) LOG_LEVEL(6, fmt, ## __VA_ARGS__)
+#define LOG_WARN(fmt, ...) LOG_LEVEL(4, fmt, ## __VA_ARGS__)
+#define LOG_ERROR(fmt, ...) LOG_LEVEL(3, fmt, ## __VA_ARGS__)
+#define LOG_CRAZY(fmt, ...) LOG_LEVEL(8, fmt, ## __VA_ARGS__)
 #endif
 #else
-#define LOG(fmt, ...) util_sys_log(7, __FILE__, __LINE__, __func__, fmt, ## __VA_ARGS__)
+#define LOG(fmt, ...) LOG_LEVEL(7, fmt, ## __VA_ARGS__)
 #endif
 
 // most things just need these
@@ -0,0 +1,62 @@
+#ifndef util_trace_h
+#define util_trace_h
+
+#include <stdint.h>
+#include "lob.h"
+
+// where per-packet time goes, each stage includes the ones nested in it
+enum util_trace_stage {
+  UTIL_TRACE_TRANSPORT, // a transport's mesh_admit() before handing a packet to mesh_receive()
+  UTIL_TRACE_MESH, // all of mesh_receive()
+  UTIL_TRACE_HANDSHAKE, // e3x_self_decrypt() of a handshake
+  UTIL_TRACE_EXCHANGE, // e3x_exchange_receive() of a channel packet
+  UTIL_TRACE_PARSE, // lob_parse()
+  UTIL_TRACE_LINK, // link_receive()
+  UTIL_TRACE_CHAN, // a channel's handler
+  UTIL_TRACE_STAGES
+};
+
+// log-linear histogram buckets, 16 per power of two (~6% precision) up to 2^64 ns
+#define UTIL_TRACE_BUCKETS 976
+
+// the probes are only compiled in w/ -DTELEHASH_TRACE, otherwise TRACE() is just the statement
+// -DTELEHASH_TRACE_USDT also fires a telehash:trace(stage, ns) systemtap/dtrace marker for each sample
+#ifdef TELEHASH_TRACE
+extern uint32_t util_trace_every;
+#define TRACE(stage, ...) do { \
+    if(__atomic_load_n(&util_trace_every, __ATOMIC_RELAXED) && util_trace_sample(stage)) { \
+      uint64_t _trace_at = util_sys_ns(); \
+      __VA_ARGS__; \
+      util_trace(stage, util_sys_ns() - _trace_at); \
+    }else{ __VA_ARGS__; } \
+  } while(0)
+#else
+#define TRACE(stage, ...) do { __VA_ARGS__; } while(0)
+#endif
+
+// the histograms are shared, any thread may sample and record into them
+// start sampling 1 of every so many timings per stage into the histograms and the hook, 0 stops
+void util_trace_start(uint32_t every);
+
+// called w/ every sampled timing, NULL to remove
+void util_trace_hook(void (*hook)(uint8_t stage, uint64_t ns, void *arg), void *arg);
+
+// true when this stage's next timing should be sampled
+uint8_t util_trace_sample(uint8_t stage);
+
+// record a timing, the probes call this
+void util_trace(uint8_t stage, uint64_t ns);
+
+// clear the histograms
+void util_trace_reset(void);
+
+// samples recorded and the value at a percentile (0-100), accurate to the bucket
+uint64_t util_trace_count(uint8_t stage);
+uint64_t util_trace_percentile(uint8_t stage, double percentile);
+
+char *util_trace_name(uint8_t stage);
+
+// {"mesh":{"count":n,"p50":ns,"p90":ns,"p99":ns,"p999":ns,"max":ns},...} for every stage w/ samples
+lob_t util_trace_json(void);
+
+#endif
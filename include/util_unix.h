@@ -8,6 +8,13 @@
 // load a json file into packet
 lob_t util_fjson(char *file);
 
+// mesh_save() state to a file only we can read, replaced atomically
+mesh_t util_fsave(mesh_t mesh, char *file);
+
+// mesh_restore() from a util_fsave() file, returns how many links resumed
+// the file is removed first so the same state can't be resumed twice, util_fsave() again for the next restart
+uint32_t util_frestore(mesh_t mesh, char *file);
+
 // load an array of hashnames from a file and add them as links
 mesh_t util_links(mesh_t mesh, char *file);
 
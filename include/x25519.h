@@ -0,0 +1,22 @@
+#ifndef x25519_h
+#define x25519_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define X25519_BYTES 32
+
+// RFC 7748 scalar multiplication, constant time, returns 0 if the result is all zeros (low order point)
+uint8_t x25519(uint8_t *out, const uint8_t *scalar, const uint8_t *point);
+
+// public key from a secret, secret should be 32 random bytes (clamped internally)
+uint8_t x25519_base(uint8_t *key, const uint8_t *secret);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
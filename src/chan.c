@@ -83,6 +83,7 @@ chan_t chan_receive(chan_t c, lob_t inner)
   if(!c || !inner) return LOG("bad args");
   
   c->in = lob_push(c->in, inner);
+  c->packets_in++;
   return c;
 }
 
@@ -145,9 +146,9 @@ chan_t chan_send(chan_t c, lob_t inner)
     return LOG("dropping packet, no link");
   }
 
-  link_send(c->link, e3x_exchange_send(c->link->x, inner));
-
-  lob_free(inner);
+  // in order behind anything still being encrypted
+  link_seal(c->link, inner);
+  c->packets_out++;
 
   return c;
 }
@@ -189,7 +190,7 @@ chan_t chan_process(chan_t c, uint32_t now)
   }
   
   // fire receiving handlers
-  if(c->in && c->handle) c->handle(c, c->arg);
+  if(c->in && c->handle) TRACE(UTIL_TRACE_CHAN, c->handle(c, c->arg));
 
   if(c->state == CHAN_ENDED)
   {
@@ -218,6 +219,18 @@ uint32_t chan_size(chan_t c)
   return size;
 }
 
+lob_t chan_metrics(chan_t c)
+{
+  lob_t json;
+  if(!c) return LOG("bad args");
+  json = lob_new();
+  lob_set_uint(json,"c",c->id);
+  lob_set_uint(json,"in",c->packets_in);
+  lob_set_uint(json,"out",c->packets_out);
+  lob_set_uint(json,"queued",chan_size(c));
+  return json;
+}
+
 // set up internal handler for all incoming packets on this channel
 chan_t chan_handle(chan_t c, void (*handle)(chan_t c, void *arg), void *arg)
 {
@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "telehash.h"
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+#include <sched.h>
+#define ASYNC_YIELD() sched_yield()
+#else
+#define ASYNC_YIELD()
+#endif
+
+// spins this many times before giving the cpu away while waiting
+#define ASYNC_SPINS 64
+
+// slot states, only the owner moves them except pending -> done
+#define ASYNC_FREE 0
+#define ASYNC_STAGED 1
+#define ASYNC_PENDING 2
+#define ASYNC_DONE 3
+
+typedef struct async_slot_struct
+{
+  e3x_async_t q;
+  lob_t packet, result;
+  void *user;
+  uint8_t state;
+} *async_slot_t;
+
+struct e3x_async_struct
+{
+  async_slot_t slots;
+  uint32_t mask;
+  uint32_t head, sent, tail; // next to push, next to submit, oldest not popped yet (owner only)
+  uint32_t pending; // atomic, finished by the cipher set
+  void (*ready)(void *arg);
+  void *arg;
+};
+
+e3x_async_t e3x_async_new(uint32_t depth, void (*ready)(void *arg), void *arg)
+{
+  e3x_async_t q;
+  uint32_t size = 1, i;
+
+  if(!depth) return LOG("bad args");
+  while(size < depth) size <<= 1;
+  if(!(q = malloc(sizeof (struct e3x_async_struct)))) return LOG("OOM");
+  memset(q,0,sizeof (struct e3x_async_struct));
+  if(!(q->slots = malloc(size * sizeof (struct async_slot_struct))))
+  {
+    free(q);
+    return LOG("OOM");
+  }
+  memset(q->slots,0,size * sizeof (struct async_slot_struct));
+  for(i = 0; i < size; i++) q->slots[i].q = q;
+  q->mask = size - 1;
+  q->ready = ready;
+  q->arg = arg;
+  return q;
+}
+
+void e3x_async_free(e3x_async_t q)
+{
+  async_slot_t slot;
+  if(!q) return;
+  e3x_async_wait(q);
+  for(; q->tail != q->head; q->tail++)
+  {
+    slot = &q->slots[q->tail & q->mask];
+    lob_free(slot->packet);
+    lob_free(slot->result);
+  }
+  free(q->slots);
+  free(q);
+}
+
+uint8_t e3x_async_push(e3x_async_t q, lob_t packet, void *user)
+{
+  async_slot_t slot;
+  if(!q || !packet)
+  {
+    lob_free(packet);
+    return 0;
+  }
+  if(q->head - q->tail > q->mask)
+  {
+    lob_free(packet);
+    LOG("async queue full, dropping");
+    return 0;
+  }
+  slot = &q->slots[q->head++ & q->mask];
+  slot->packet = packet;
+  slot->result = NULL;
+  slot->user = user;
+  slot->state = ASYNC_STAGED;
+  return 1;
+}
+
+uint32_t e3x_async_flush(e3x_async_t q, e3x_async_submit_t submit, void *ctx)
+{
+  lob_t packets[E3X_BATCH];
+  void *slots[E3X_BATCH];
+  async_slot_t slot;
+  uint32_t count, taken, total = 0, i;
+
+  if(!q || !submit) return 0;
+  while((count = q->head - q->sent))
+  {
+    if(count > E3X_BATCH) count = E3X_BATCH;
+    for(i = 0; i < count; i++)
+    {
+      slot = &q->slots[(q->sent + i) & q->mask];
+      slot->state = ASYNC_PENDING;
+      packets[i] = slot->packet;
+      slots[i] = slot;
+    }
+
+    // counted first since any of them may finish before submit even returns
+    __atomic_add_fetch(&q->pending, count, __ATOMIC_ACQ_REL);
+    taken = submit(ctx, packets, slots, count);
+    if(taken > count) taken = count;
+    for(i = taken; i < count; i++) ((async_slot_t)slots[i])->state = ASYNC_STAGED;
+    if(taken < count) __atomic_sub_fetch(&q->pending, count - taken, __ATOMIC_ACQ_REL);
+
+    q->sent += taken;
+    total += taken;
+    if(taken < count) break; // busy, the rest wait for the next flush
+  }
+  return total;
+}
+
+void e3x_async_done(lob_t result, void *arg)
+{
+  async_slot_t slot = arg;
+  e3x_async_t q = slot->q;
+
+  // the owner may pop and reuse the slot as soon as it's done, but q stays until nothing is pending
+  slot->result = result;
+  __atomic_store_n(&slot->state, ASYNC_DONE, __ATOMIC_RELEASE);
+  if(q->ready) q->ready(q->arg);
+  __atomic_sub_fetch(&q->pending, 1, __ATOMIC_RELEASE);
+}
+
+lob_t e3x_async_packet(void *slot)
+{
+  if(!slot) return NULL;
+  return ((async_slot_t)slot)->packet;
+}
+
+void *e3x_async_user(void *slot)
+{
+  if(!slot) return NULL;
+  return ((async_slot_t)slot)->user;
+}
+
+uint8_t e3x_async_pop(e3x_async_t q, lob_t *packet, lob_t *result)
+{
+  async_slot_t slot;
+  if(!q || q->tail == q->sent) return 0;
+  slot = &q->slots[q->tail & q->mask];
+  if(__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != ASYNC_DONE) return 0;
+  q->tail++;
+  if(packet) *packet = slot->packet;
+  else lob_free(slot->packet);
+  if(result) *result = slot->result;
+  else lob_free(slot->result);
+  slot->packet = slot->result = NULL;
+  slot->state = ASYNC_FREE;
+  return 1;
+}
+
+uint32_t e3x_async_staged(e3x_async_t q)
+{
+  if(!q) return 0;
+  return q->head - q->sent;
+}
+
+uint32_t e3x_async_pending(e3x_async_t q)
+{
+  if(!q) return 0;
+  return __atomic_load_n(&q->pending, __ATOMIC_ACQUIRE);
+}
+
+void e3x_async_wait(e3x_async_t q)
+{
+  uint32_t spins = 0;
+  if(!q) return;
+  // most finish within a few spins, otherwise let the workers have the cpu
+  while(__atomic_load_n(&q->pending, __ATOMIC_ACQUIRE))
+  {
+    if(++spins < ASYNC_SPINS) continue;
+    spins = 0;
+    ASYNC_YIELD();
+  }
+}
@@ -3,7 +3,6 @@
 #include <stdint.h>
 #include <string.h>
 
-#include "telehash.h"
 #include "telehash.h"
 
 e3x_cipher_t e3x_cipher_sets[CS_MAX];
@@ -14,6 +13,11 @@ uint8_t e3x_cipher_init(lob_t options)
   e3x_cipher_default = NULL;
   memset(e3x_cipher_sets, 0, CS_MAX * sizeof(e3x_cipher_t));
   
+  // the last one registered is the default for e3x_rand/e3x_hash, 3b is only that when it's alone
+  e3x_cipher_sets[CS_3b] = cs3b_init(options);
+  if(e3x_cipher_sets[CS_3b]) e3x_cipher_default = e3x_cipher_sets[CS_3b];
+  if(lob_get(options, "err")) return 1;
+
   e3x_cipher_sets[CS_1c] = cs1c_init(options);
   if(e3x_cipher_sets[CS_1c]) e3x_cipher_default = e3x_cipher_sets[CS_1c];
   if(lob_get(options, "err")) return 1;
@@ -42,3 +46,229 @@ e3x_cipher_t e3x_cipher_set(uint8_t csid, char *str)
   return NULL;
 }
 
+
+// optional locking for the pools
+static void (*pool_lock)(void *arg) = NULL;
+static void (*pool_unlock)(void *arg) = NULL;
+static void *pool_arg = NULL;
+#define POOL_LOCK() if(pool_lock) pool_lock(pool_arg)
+#define POOL_UNLOCK() if(pool_unlock) pool_unlock(pool_arg)
+
+uint8_t e3x_cipher_pool(uint16_t depth, void (*lock)(void *arg), void (*unlock)(void *arg), void *arg)
+{
+  uint8_t i;
+  e3x_cipher_t cs;
+  void (*held)(void *arg) = pool_unlock;
+  void *heldarg = pool_arg;
+
+  // resized under the current lock so a running fill never sees it half done
+  POOL_LOCK();
+  for(i=0; i<CS_MAX; i++)
+  {
+    if(!(cs = e3x_cipher_sets[i]) || !cs->keypair) continue;
+    size_t size = cs->keylen + cs->secretlen;
+    e3x_pool_t pool = cs->pool;
+
+    // shrinking drops (and wipes) the newest pairs
+    if(pool && pool->count > depth)
+    {
+      util_zero(pool->pairs + (depth * size), (pool->count - depth) * size);
+      pool->count = depth;
+    }
+
+    if(!depth)
+    {
+      if(pool) free(pool->pairs);
+      free(pool);
+      cs->pool = NULL;
+      continue;
+    }
+
+    if(!pool)
+    {
+      if(!(pool = malloc(sizeof (struct e3x_pool_struct)))) break;
+      memset(pool,0,sizeof (struct e3x_pool_struct));
+      cs->pool = pool;
+    }
+    uint8_t *pairs = util_reallocf(pool->pairs, depth * size);
+    if(!pairs)
+    {
+      pool->depth = pool->count = 0;
+      pool->pairs = NULL;
+      break;
+    }
+    pool->pairs = pairs;
+    pool->depth = depth;
+  }
+
+  // the new lock only takes over once the old one is let go
+  pool_lock = lock;
+  pool_unlock = unlock;
+  pool_arg = arg;
+  if(held) held(heldarg);
+
+  return (i == CS_MAX) ? 0 : 1;
+}
+
+uint16_t e3x_cipher_pool_fill(uint16_t max)
+{
+  uint8_t i, pair[256];
+  uint16_t made = 0;
+  e3x_cipher_t cs;
+
+  for(i=0; i<CS_MAX && made < max; i++)
+  {
+    if(!(cs = e3x_cipher_sets[i]) || !cs->keypair) continue;
+    size_t size = cs->keylen + cs->secretlen;
+    if(size > sizeof(pair)) continue;
+    while(made < max)
+    {
+      // check w/o generating under the lock, it can take a while
+      POOL_LOCK();
+      uint8_t full = (!cs->pool || cs->pool->count >= cs->pool->depth);
+      POOL_UNLOCK();
+      if(full) break;
+
+      if(!cs->keypair(pair, pair+cs->keylen)) return made;
+      made++;
+
+      POOL_LOCK();
+      e3x_pool_t pool = cs->pool;
+      if(pool && pool->count < pool->depth)
+      {
+        memcpy(pool->pairs + (pool->count * size), pair, size);
+        pool->count++;
+        pool->filled++;
+      }
+      POOL_UNLOCK();
+    }
+  }
+
+  util_zero(pair,sizeof(pair));
+  return made;
+}
+
+uint8_t e3x_cipher_keypair(e3x_cipher_t cs, uint8_t *key, uint8_t *secret)
+{
+  if(!cs || !cs->keypair || !key || !secret) return 0;
+
+  POOL_LOCK();
+  e3x_pool_t pool = cs->pool;
+  if(pool && pool->count)
+  {
+    pool->count--;
+    uint8_t *pair = pool->pairs + (pool->count * (cs->keylen + cs->secretlen));
+    memcpy(key, pair, cs->keylen);
+    memcpy(secret, pair + cs->keylen, cs->secretlen);
+    util_zero(pair, cs->keylen + cs->secretlen);
+    pool->hits++;
+    POOL_UNLOCK();
+    return 1;
+  }
+  if(pool) pool->misses++;
+  POOL_UNLOCK();
+
+  return cs->keypair(key, secret);
+}
+
+lob_t e3x_cipher_pool_stats(void)
+{
+  uint8_t i;
+  e3x_cipher_t cs;
+  lob_t stats = lob_new();
+
+  POOL_LOCK();
+  for(i=0; i<CS_MAX; i++)
+  {
+    if(!(cs = e3x_cipher_sets[i]) || !cs->pool) continue;
+    lob_t one = lob_new();
+    lob_set_uint(one,"depth",cs->pool->depth);
+    lob_set_uint(one,"count",cs->pool->count);
+    lob_set_uint(one,"hits",cs->pool->hits);
+    lob_set_uint(one,"misses",cs->pool->misses);
+    lob_set_uint(one,"filled",cs->pool->filled);
+    lob_set_raw(stats,cs->hex,2,lob_json(one),0);
+    lob_free(one);
+  }
+  POOL_UNLOCK();
+
+  return stats;
+}
+
+uint8_t e3x_replay_check(e3x_replay_t w, uint64_t seq)
+{
+  int64_t diff;
+
+  if(!w) return 1;
+  if(!w->started) return 0;
+
+  // signed distance so wrapping seqs still compare correctly
+  diff = (int64_t)(seq - w->top);
+  if(diff > 0) return 0;
+  if(diff <= -E3X_REPLAY_WINDOW)
+  {
+    w->stale++;
+    return 1;
+  }
+  if(w->bits[(seq % E3X_REPLAY_WINDOW) / 32] & (1u << (seq % 32)))
+  {
+    w->dups++;
+    return 1;
+  }
+  return 0;
+}
+
+size_t e3x_replay_save(e3x_replay_t w, uint8_t *out)
+{
+  uint32_t i;
+
+  if(!w || !out) return 0;
+  util_put_be(w->top,out,8);
+  out[8] = w->started;
+  util_put_be(E3X_REPLAY_WINDOW,out+9,2);
+  for(i=0;i<E3X_REPLAY_WINDOW/32;i++) util_put_be(w->bits[i],out+11+(i*4),4);
+  return E3X_REPLAY_SAVE_BYTES;
+}
+
+size_t e3x_replay_load(e3x_replay_t w, uint8_t *in, size_t len)
+{
+  uint32_t window, i;
+
+  if(!w || !in || len < 11) return 0;
+  window = (uint32_t)util_get_be(in+9,2);
+  if(!window || window % 32 || len < 11 + (size_t)(window/8)) return 0;
+  memset(w,0,sizeof(struct e3x_replay_struct));
+  w->top = util_get_be(in,8);
+  w->started = in[8] ? 1 : 0;
+
+  // bits are placed by seq % window, so another size can't be mapped back, never accept anything it may have seen
+  if(window != E3X_REPLAY_WINDOW) memset(w->bits,0xff,sizeof(w->bits));
+  else for(i=0;i<E3X_REPLAY_WINDOW/32;i++) w->bits[i] = (uint32_t)util_get_be(in+11+(i*4),4);
+  return 11 + (window/8);
+}
+
+void e3x_replay_accept(e3x_replay_t w, uint64_t seq)
+{
+  int64_t diff;
+  uint64_t at;
+
+  if(!w) return;
+  if(!w->started)
+  {
+    w->started = 1;
+    w->top = seq;
+    memset(w->bits,0,sizeof(w->bits));
+  }
+
+  // clear the slots being reused as the top moves forward
+  diff = (int64_t)(seq - w->top);
+  if(diff >= E3X_REPLAY_WINDOW)
+  {
+    memset(w->bits,0,sizeof(w->bits));
+  }else{
+    for(at = w->top+1; diff > 0; at++, diff--) w->bits[(at % E3X_REPLAY_WINDOW) / 32] &= ~(1u << (at % 32));
+  }
+  if((int64_t)(seq - w->top) > 0) w->top = seq;
+
+  w->bits[(seq % E3X_REPLAY_WINDOW) / 32] |= (1u << (seq % 32));
+}
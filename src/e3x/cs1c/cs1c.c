@@ -11,50 +11,69 @@
 #define SHARED_BYTES 32
 #define curve uECC_secp256r1()
 
-// undefine the void* aliases so we can define them locally
-#undef local_t
-#undef remote_t
-#undef ephemeral_t
+// how many recent handshake ephemeral secrets to remember
+#ifndef CS1C_DECRYPT_CACHE
+#define CS1C_DECRYPT_CACHE 8
+#endif
 
-typedef struct local_struct
+// our own types behind the void* aliases, prefixed like everything file-local so every cipher set can share one translation unit
+typedef struct cs1c_local_struct
 {
   uint8_t secret[SECRET_BYTES], key[KEY_BYTES];
-} *local_t;
-
-typedef struct remote_struct
+  uint32_t id; // random, never 0, identifies this local to cached remote secrets
+  // resent handshakes from a remote reuse its ephemeral key, so keep the last few ECDH results
+  struct {
+    uint8_t ecomp[COMP_BYTES], shared[SHARED_BYTES];
+  } cache[CS1C_DECRYPT_CACHE];
+  uint8_t cached, cache_at;
+  uint8_t cache_lock; // decrypts run on any thread (mesh_workers.h), only held to copy in/out of the cache
+} *cs1c_local_t;
+
+typedef struct cs1c_remote_struct
 {
   uint8_t key[KEY_BYTES];
   uint8_t esecret[SECRET_BYTES], ekey[KEY_BYTES], ecomp[COMP_BYTES];
   uint32_t seq;
-} *remote_t;
+  uint8_t shared[SHARED_BYTES]; // static-static ECDH w/ the local identified by shared_id
+  uint32_t shared_id;
+} *cs1c_remote_t;
 
-typedef struct ephemeral_struct
+typedef struct cs1c_ephemeral_struct
 {
   uint8_t enckey[16], deckey[16], token[16];
-  uint32_t seq;
-} *ephemeral_t;
+  uint32_t seq, sent; // the iv must never repeat for a key, so sending stops before seq wraps back around
+  struct e3x_replay_struct replay; // incoming seqs, unwrapped to 64 bits
+} *cs1c_ephemeral_t;
 
 // these are all the locally implemented handlers defined in e3x_cipher.h
 
-static uint8_t *cipher_hash(uint8_t *input, size_t len, uint8_t *output);
-static uint8_t *cipher_err(void);
-static uint8_t cipher_generate(lob_t keys, lob_t secrets);
-
-static local_t local_new(lob_t keys, lob_t secrets);
-static void local_free(local_t local);
-static lob_t local_decrypt(local_t local, lob_t outer);
-static lob_t local_sign(local_t local, lob_t args, uint8_t *data, size_t len);
-
-static remote_t remote_new(lob_t key, uint8_t *token);
-static void remote_free(remote_t remote);
-static uint8_t remote_verify(remote_t remote, local_t local, lob_t outer);
-static lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner);
-static uint8_t remote_validate(remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len);
-
-static ephemeral_t ephemeral_new(remote_t remote, lob_t outer);
-static void ephemeral_free(ephemeral_t ephemeral);
-static lob_t ephemeral_encrypt(ephemeral_t ephemeral, lob_t inner);
-static lob_t ephemeral_decrypt(ephemeral_t ephemeral, lob_t outer);
+static uint8_t *cs1c_cipher_hash(uint8_t *input, size_t len, uint8_t *output);
+static uint8_t *cs1c_cipher_err(void);
+static uint8_t cs1c_cipher_generate(lob_t keys, lob_t secrets);
+static uint8_t cs1c_cipher_keypair(uint8_t *key, uint8_t *secret);
+
+static cs1c_local_t cs1c_local_new(lob_t keys, lob_t secrets);
+static void cs1c_local_free(cs1c_local_t local);
+static lob_t cs1c_local_decrypt(cs1c_local_t local, lob_t outer);
+static lob_t cs1c_local_sign(cs1c_local_t local, lob_t args, uint8_t *data, size_t len);
+
+static cs1c_remote_t cs1c_remote_new(lob_t key, uint8_t *token);
+static void cs1c_remote_free(cs1c_remote_t remote);
+static uint8_t cs1c_remote_rekey(cs1c_remote_t remote, uint8_t *token);
+static lob_t cs1c_remote_save(cs1c_remote_t remote);
+static uint8_t cs1c_remote_load(cs1c_remote_t remote, lob_t saved, uint8_t *token);
+static uint8_t cs1c_remote_verify(cs1c_remote_t remote, cs1c_local_t local, lob_t outer);
+static lob_t cs1c_remote_encrypt(cs1c_remote_t remote, cs1c_local_t local, lob_t inner);
+static uint8_t cs1c_remote_validate(cs1c_remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len);
+static void cs1c_remote_validate_batch(cs1c_remote_t *remotes, lob_t *args, lob_t *sigs, uint8_t **data, size_t *lens, uint8_t *errs, uint32_t count);
+
+static cs1c_ephemeral_t cs1c_ephemeral_new(cs1c_remote_t remote, lob_t outer);
+static void cs1c_ephemeral_free(cs1c_ephemeral_t ephemeral);
+static lob_t cs1c_ephemeral_encrypt(cs1c_ephemeral_t ephemeral, lob_t inner);
+static lob_t cs1c_ephemeral_decrypt(cs1c_ephemeral_t ephemeral, lob_t outer);
+static e3x_replay_t cs1c_ephemeral_replay(cs1c_ephemeral_t ephemeral);
+static lob_t cs1c_ephemeral_save(cs1c_ephemeral_t ephemeral);
+static cs1c_ephemeral_t cs1c_ephemeral_load(lob_t saved);
 
 
 static int RNG(uint8_t *p_dest, unsigned p_size)
@@ -63,6 +82,33 @@ static int RNG(uint8_t *p_dest, unsigned p_size)
   return 1;
 }
 
+// ES256 signatures are checked together, sharing the curve math
+static void cs1c_remote_validate_batch(cs1c_remote_t *remotes, lob_t *args, lob_t *sigs, uint8_t **data, size_t *lens, uint8_t *errs, uint32_t count)
+{
+  uint8_t hashes[E3X_BATCH][32], valid[E3X_BATCH];
+  const uint8_t *keys[E3X_BATCH], *hashp[E3X_BATCH], *sigp[E3X_BATCH];
+  uint32_t at[E3X_BATCH];
+  uint32_t i, n = 0;
+
+  if(count > E3X_BATCH) count = E3X_BATCH;
+  for(i=0;i<count;i++)
+  {
+    if(!remotes[i] || !args[i] || !sigs[i] || !data[i] || !lens[i] || sigs[i]->body_len != KEY_BYTES || lob_get_cmp(args[i],"alg","ES256") != 0)
+    {
+      errs[i] = cs1c_remote_validate(remotes[i], args[i], sigs[i], data[i], lens[i]);
+      continue;
+    }
+    e3x_hash(data[i],lens[i],hashes[n]);
+    keys[n] = remotes[i]->key;
+    hashp[n] = hashes[n];
+    sigp[n] = sigs[i]->body;
+    at[n++] = i;
+  }
+
+  uECC_verify_batch(keys, hashp, 32, sigp, n, valid, curve);
+  for(i=0;i<n;i++) errs[at[i]] = valid[i] ? 0 : 3;
+}
+
 e3x_cipher_t cs1c_init(lob_t options)
 {
   e3x_cipher_t ret = malloc(sizeof(struct e3x_cipher_struct));
@@ -77,44 +123,55 @@ e3x_cipher_t cs1c_init(lob_t options)
   // which alg's we support
   ret->alg = "HS256 ES256 JWK";
 
-  // normal init stuff
+  // normal init stuff, build any keygen tables now so pool workers don't race on it
   uECC_set_rng(&RNG);
+  uECC_precompute(curve);
 
   // configure our callbacks (no RNG, default to platform's)
-  ret->hash = cipher_hash;
-  ret->err = cipher_err;
-  ret->generate = cipher_generate;
+  ret->hash = cs1c_cipher_hash;
+  ret->err = cs1c_cipher_err;
+  ret->generate = cs1c_cipher_generate;
+  ret->keypair = cs1c_cipher_keypair;
+  ret->keylen = KEY_BYTES;
+  ret->secretlen = SECRET_BYTES;
 
   // need to cast these to map our struct types to voids
-  ret->local_new = (void *(*)(lob_t, lob_t))local_new;
-  ret->local_free = (void (*)(void *))local_free;
-  ret->local_decrypt = (lob_t (*)(void *, lob_t))local_decrypt;
-  ret->local_sign = (lob_t (*)(void *, lob_t, uint8_t *, size_t))local_sign;
-  ret->remote_new = (void *(*)(lob_t, uint8_t *))remote_new;
-  ret->remote_free = (void (*)(void *))remote_free;
-  ret->remote_verify = (uint8_t (*)(void *, void *, lob_t))remote_verify;
-  ret->remote_encrypt = (lob_t (*)(void *, void *, lob_t))remote_encrypt;
-  ret->remote_validate = (uint8_t (*)(void *, lob_t, lob_t, uint8_t *, size_t))remote_validate;
-  ret->ephemeral_new = (void *(*)(void *, lob_t))ephemeral_new;
-  ret->ephemeral_free = (void (*)(void *))ephemeral_free;
-  ret->ephemeral_encrypt = (lob_t (*)(void *, lob_t))ephemeral_encrypt;
-  ret->ephemeral_decrypt = (lob_t (*)(void *, lob_t))ephemeral_decrypt;
+  ret->local_new = (void *(*)(lob_t, lob_t))cs1c_local_new;
+  ret->local_free = (void (*)(void *))cs1c_local_free;
+  ret->local_decrypt = (lob_t (*)(void *, lob_t))cs1c_local_decrypt;
+  ret->local_sign = (lob_t (*)(void *, lob_t, uint8_t *, size_t))cs1c_local_sign;
+  ret->remote_new = (void *(*)(lob_t, uint8_t *))cs1c_remote_new;
+  ret->remote_free = (void (*)(void *))cs1c_remote_free;
+  ret->remote_rekey = (uint8_t (*)(void *, uint8_t *))cs1c_remote_rekey;
+  ret->remote_verify = (uint8_t (*)(void *, void *, lob_t))cs1c_remote_verify;
+  ret->remote_encrypt = (lob_t (*)(void *, void *, lob_t))cs1c_remote_encrypt;
+  ret->remote_validate = (uint8_t (*)(void *, lob_t, lob_t, uint8_t *, size_t))cs1c_remote_validate;
+  ret->remote_validate_batch = (void (*)(void **, lob_t *, lob_t *, uint8_t **, size_t *, uint8_t *, uint32_t))cs1c_remote_validate_batch;
+  ret->ephemeral_new = (void *(*)(void *, lob_t))cs1c_ephemeral_new;
+  ret->ephemeral_free = (void (*)(void *))cs1c_ephemeral_free;
+  ret->ephemeral_encrypt = (lob_t (*)(void *, lob_t))cs1c_ephemeral_encrypt;
+  ret->ephemeral_decrypt = (lob_t (*)(void *, lob_t))cs1c_ephemeral_decrypt;
+  ret->ephemeral_replay = (e3x_replay_t (*)(void *))cs1c_ephemeral_replay;
+  ret->remote_save = (lob_t (*)(void *))cs1c_remote_save;
+  ret->remote_load = (uint8_t (*)(void *, lob_t, uint8_t *))cs1c_remote_load;
+  ret->ephemeral_save = (lob_t (*)(void *))cs1c_ephemeral_save;
+  ret->ephemeral_load = (void *(*)(lob_t))cs1c_ephemeral_load;
 
   return ret;
 }
 
-uint8_t *cipher_hash(uint8_t *input, size_t len, uint8_t *output)
+uint8_t *cs1c_cipher_hash(uint8_t *input, size_t len, uint8_t *output)
 {
   sha256(input,len,output,0);
   return output;
 }
 
-uint8_t *cipher_err(void)
+uint8_t *cs1c_cipher_err(void)
 {
   return 0;
 }
 
-uint8_t cipher_generate(lob_t keys, lob_t secrets)
+uint8_t cs1c_cipher_generate(lob_t keys, lob_t secrets)
 {
   uint8_t secret[SECRET_BYTES], key[KEY_BYTES], comp[COMP_BYTES];
 
@@ -126,6 +183,11 @@ uint8_t cipher_generate(lob_t keys, lob_t secrets)
   return 0;
 }
 
+uint8_t cs1c_cipher_keypair(uint8_t *key, uint8_t *secret)
+{
+  return uECC_make_key(key, secret, curve) ? 1 : 0;
+}
+
 static void fold1(uint8_t in[32], uint8_t out[16])
 {
   uint8_t i;
@@ -140,9 +202,9 @@ static void fold3(uint8_t in[32], uint8_t out[4])
   for(i=0;i<4;i++) out[i] = buf[i] ^ buf[i+4];
 }
 
-local_t local_new(lob_t keys, lob_t secrets)
+cs1c_local_t cs1c_local_new(lob_t keys, lob_t secrets)
 {
-  local_t local = NULL;
+  cs1c_local_t local = NULL;
 
   // support new from jwk
   if(lob_get_cmp(keys,"kty","EC") == 0 && lob_get_cmp(keys,"crv","P-256") == 0)
@@ -169,11 +231,13 @@ local_t local_new(lob_t keys, lob_t secrets)
       return LOG("invalid key size");
     }
 
-    if(!(local = malloc(sizeof(struct local_struct)))) return LOG("OOM");
-    memset(local,0,sizeof (struct local_struct));
+    if(!(local = malloc(sizeof(struct cs1c_local_struct)))) return LOG("OOM");
+    memset(local,0,sizeof (struct cs1c_local_struct));
     memcpy(local->secret,d->body,d->body_len);
     memcpy(local->key,x->body,x->body_len);
     memcpy(local->key+x->body_len,y->body,y->body_len);
+    e3x_rand((uint8_t*)&(local->id),4);
+    local->id |= 1;
     lob_free(d);
     lob_free(x);
     lob_free(y);
@@ -189,13 +253,15 @@ local_t local_new(lob_t keys, lob_t secrets)
 
   if(key->body_len == COMP_BYTES && secret->body_len == SECRET_BYTES)
   {
-    if((local = malloc(sizeof(struct local_struct))))
+    if((local = malloc(sizeof(struct cs1c_local_struct))))
     {
-      memset(local,0,sizeof (struct local_struct));
+      memset(local,0,sizeof (struct cs1c_local_struct));
 
       // copy in key/secret data
       uECC_decompress(key->body,local->key, curve);
       memcpy(local->secret,secret->body,secret->body_len);
+      e3x_rand((uint8_t*)&(local->id),4);
+      local->id |= 1;
 
     }else{
       LOG("OOM");
@@ -211,15 +277,63 @@ local_t local_new(lob_t keys, lob_t secrets)
   return local;
 }
 
-void local_free(local_t local)
+void cs1c_local_free(cs1c_local_t local)
 {
+  if(!local) return;
+  util_zero(local,sizeof (struct cs1c_local_struct));
   free(local);
   return;
 }
 
-lob_t local_decrypt(local_t local, lob_t outer)
+static void cache_lock(cs1c_local_t local)
 {
-  uint8_t keybuf[KEY_BYTES], shared[SECRET_BYTES], iv[16], hash[32];
+  while(__atomic_test_and_set(&local->cache_lock, __ATOMIC_ACQUIRE));
+}
+
+static void cache_unlock(cs1c_local_t local)
+{
+  __atomic_clear(&local->cache_lock, __ATOMIC_RELEASE);
+}
+
+// static-ephemeral secret for an incoming handshake copied into shared, cached by their ephemeral key
+static uint8_t local_shared(cs1c_local_t local, uint8_t *ecomp, uint8_t *shared)
+{
+  uint8_t i, ekey[KEY_BYTES];
+
+  cache_lock(local);
+  for(i=0;i<local->cached;i++) if(memcmp(local->cache[i].ecomp,ecomp,COMP_BYTES) == 0)
+  {
+    memcpy(shared,local->cache[i].shared,SHARED_BYTES);
+    cache_unlock(local);
+    return 1;
+  }
+  cache_unlock(local);
+
+  // the slow part happens unlocked, racing misses for the same key just both cache it
+  uECC_decompress(ecomp,ekey, curve);
+  if(!uECC_shared_secret(ekey, local->secret, shared, curve)) return 0;
+  cache_lock(local);
+  i = local->cache_at;
+  memcpy(local->cache[i].ecomp,ecomp,COMP_BYTES);
+  memcpy(local->cache[i].shared,shared,SHARED_BYTES);
+  local->cache_at = (i + 1) % CS1C_DECRYPT_CACHE;
+  if(local->cached < CS1C_DECRYPT_CACHE) local->cached++;
+  cache_unlock(local);
+  return 1;
+}
+
+// static-static secret never changes for a remote, only compute it once per local
+static uint8_t *cs1c_remote_shared(cs1c_remote_t remote, cs1c_local_t local)
+{
+  if(remote->shared_id == local->id) return remote->shared;
+  if(!uECC_shared_secret(remote->key, local->secret, remote->shared, curve)) return NULL;
+  remote->shared_id = local->id;
+  return remote->shared;
+}
+
+lob_t cs1c_local_decrypt(cs1c_local_t local, lob_t outer)
+{
+  uint8_t shared[SHARED_BYTES], iv[16], hash[32];
 
   lob_t key = lob_linked(outer);
   char *req = lob_get(key,"req");
@@ -229,9 +343,12 @@ lob_t local_decrypt(local_t local, lob_t outer)
     if(strstr(req,"ECDH"))
     {
       lob_t epk = lob_get_json(outer,"epk");
-      remote_t remote = remote_new(epk, NULL);
+      cs1c_remote_t remote = cs1c_remote_new(epk, NULL);
       if(!remote) return LOG_WARN("failed to load epk");
-      if(!uECC_shared_secret(remote->key, local->secret, hash, curve)) return LOG_WARN("ECDH failed");
+      uint8_t *shared = cs1c_remote_shared(remote, local);
+      if(shared) memcpy(hash, shared, SHARED_BYTES);
+      cs1c_remote_free(remote);
+      if(!shared) return LOG_WARN("ECDH failed");
       lob_body(key, hash, 32);
     }
     // HKDF
@@ -278,9 +395,9 @@ lob_t local_decrypt(local_t local, lob_t outer)
   if(!lob_body(tmp,NULL,outer->body_len-(4+33+4))) return lob_free(tmp);
 
   // get the shared secret to create the iv+key for the open aes
-  uECC_decompress(outer->body,keybuf, curve);
-  if(!uECC_shared_secret(keybuf, local->secret, shared, curve)) return lob_free(tmp);
+  if(!local_shared(local, outer->body, shared)) return lob_free(tmp);
   e3x_hash(shared,SHARED_BYTES,hash);
+  util_zero(shared,SHARED_BYTES);
   fold1(hash,hash);
   memset(iv,0,16);
   memcpy(iv,outer->body+33,4);
@@ -294,7 +411,7 @@ lob_t local_decrypt(local_t local, lob_t outer)
   return inner;
 }
 
-lob_t local_sign(local_t local, lob_t args, uint8_t *data, size_t len)
+lob_t cs1c_local_sign(cs1c_local_t local, lob_t args, uint8_t *data, size_t len)
 {
   uint8_t hash[32], sig[KEY_BYTES];
 
@@ -329,10 +446,9 @@ lob_t local_sign(local_t local, lob_t args, uint8_t *data, size_t len)
   return NULL;
 }
 
-remote_t remote_new(lob_t key, uint8_t *token)
+cs1c_remote_t cs1c_remote_new(lob_t key, uint8_t *token)
 {
-  uint8_t hash[32];
-  remote_t remote;
+  cs1c_remote_t remote;
   if(!key) return LOG("missing key");
 
   // support new from jwk
@@ -360,17 +476,15 @@ remote_t remote_new(lob_t key, uint8_t *token)
 
   if(key->body_len != COMP_BYTES) return LOG("invalid key %d != %d",key->body_len,COMP_BYTES);
 
-  if(!(remote = malloc(sizeof(struct remote_struct)))) return NULL;
-  memset(remote,0,sizeof (struct remote_struct));
+  if(!(remote = malloc(sizeof(struct cs1c_remote_struct)))) return NULL;
+  memset(remote,0,sizeof (struct cs1c_remote_struct));
 
   // copy in key and make ephemeral ones
   uECC_decompress(key->body,remote->key, curve);
-  uECC_make_key(remote->ekey, remote->esecret, curve);
-  uECC_compress(remote->ekey, remote->ecomp, curve);
-  if(token)
+  if(!cs1c_remote_rekey(remote, token))
   {
-    cipher_hash(remote->ecomp,16,hash);
-    memcpy(token,hash,16);
+    cs1c_remote_free(remote);
+    return LOG("ephemeral keygen failed");
   }
 
   // generate a random seq starting point for message IV's
@@ -379,20 +493,65 @@ remote_t remote_new(lob_t key, uint8_t *token)
   return remote;
 }
 
-void remote_free(remote_t remote)
+void cs1c_remote_free(cs1c_remote_t remote)
 {
+  if(!remote) return;
+  util_zero(remote,sizeof (struct cs1c_remote_struct));
   free(remote);
 }
 
-uint8_t remote_verify(remote_t remote, local_t local, lob_t outer)
+uint8_t cs1c_remote_rekey(cs1c_remote_t remote, uint8_t *token)
 {
-  uint8_t shared[SHARED_BYTES+4], hash[32];
+  uint8_t hash[32];
+  if(!remote) return 0;
+  if(!e3x_cipher_keypair(e3x_cipher_set(0x1c,NULL), remote->ekey, remote->esecret)) return 0;
+  uECC_compress(remote->ekey, remote->ecomp, curve);
+  if(token)
+  {
+    cs1c_cipher_hash(remote->ecomp,16,hash);
+    memcpy(token,hash,16);
+  }
+  return 1;
+}
+
+lob_t cs1c_remote_save(cs1c_remote_t remote)
+{
+  lob_t saved;
+  if(!remote) return NULL;
+  saved = lob_new();
+  if(!lob_body(saved,NULL,KEY_BYTES+SECRET_BYTES+4)) return lob_free(saved);
+  memcpy(saved->body,remote->ekey,KEY_BYTES);
+  memcpy(saved->body+KEY_BYTES,remote->esecret,SECRET_BYTES);
+  util_put_be(remote->seq,saved->body+KEY_BYTES+SECRET_BYTES,4);
+  return saved;
+}
+
+uint8_t cs1c_remote_load(cs1c_remote_t remote, lob_t saved, uint8_t *token)
+{
+  uint8_t hash[32];
+  if(!remote || !saved || saved->body_len != KEY_BYTES+SECRET_BYTES+4) return 0;
+  memcpy(remote->ekey,saved->body,KEY_BYTES);
+  memcpy(remote->esecret,saved->body+KEY_BYTES,SECRET_BYTES);
+  remote->seq = (uint32_t)util_get_be(saved->body+KEY_BYTES+SECRET_BYTES,4);
+  uECC_compress(remote->ekey, remote->ecomp, curve);
+  if(token)
+  {
+    cs1c_cipher_hash(remote->ecomp,16,hash);
+    memcpy(token,hash,16);
+  }
+  return 1;
+}
+
+uint8_t cs1c_remote_verify(cs1c_remote_t remote, cs1c_local_t local, lob_t outer)
+{
+  uint8_t shared[SHARED_BYTES+4], hash[32], *secret;
 
   if(!remote || !local || !outer) return 1;
   if(outer->head_len != 1 || outer->head[0] != 0x1c) return 2;
 
   // generate the key for the hmac, combining the shared secret and IV
-  if(!uECC_shared_secret(remote->key, local->secret, shared, curve)) return 3;
+  if(!(secret = cs1c_remote_shared(remote, local))) return 3;
+  memcpy(shared,secret,SHARED_BYTES);
   memcpy(shared+SHARED_BYTES,outer->body+33,4);
 
   // verify
@@ -407,9 +566,9 @@ uint8_t remote_verify(remote_t remote, local_t local, lob_t outer)
   return 0;
 }
 
-lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner)
+lob_t cs1c_remote_encrypt(cs1c_remote_t remote, cs1c_local_t local, lob_t inner)
 {
-  uint8_t shared[SHARED_BYTES+4], iv[16], hash[32], csid = 0x1c;
+  uint8_t shared[SHARED_BYTES+4], iv[16], hash[32], *secret, csid = 0x1c;
   lob_t outer;
   size_t inner_len;
 
@@ -420,8 +579,8 @@ lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner)
       // shared secret
     if(strstr(req,"ECDH"))
     {
-      if(!uECC_shared_secret(remote->key, local->secret, hash, curve)) return LOG_WARN("ECDH failed");
-      lob_body(key, hash, 32);
+      if(!(secret = cs1c_remote_shared(remote, local))) return LOG_WARN("ECDH failed");
+      lob_body(key, secret, 32);
     }
     // HKDF
     if(strstr(req,"HK256"))
@@ -476,7 +635,8 @@ lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner)
   aes_128_ctr(hash,inner_len,iv,lob_raw(inner),outer->body+33+4);
 
   // generate secret for hmac
-  if(!uECC_shared_secret(remote->key, local->secret, shared, curve)) return lob_free(outer);
+  if(!(secret = cs1c_remote_shared(remote, local))) return lob_free(outer);
+  memcpy(shared,secret,SHARED_BYTES);
   memcpy(shared+SHARED_BYTES,outer->body+33,4); // use the IV too
 
   hmac_256(shared,SHARED_BYTES+4,outer->body,33+4+inner_len,hash);
@@ -485,7 +645,7 @@ lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner)
   return outer;
 }
 
-uint8_t remote_validate(remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len)
+uint8_t cs1c_remote_validate(cs1c_remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len)
 {
   uint8_t hash[32];
   if(!args || !sig || !data || !len) return 1;
@@ -508,16 +668,16 @@ uint8_t remote_validate(remote_t remote, lob_t args, lob_t sig, uint8_t *data, s
   return 4;
 }
 
-ephemeral_t ephemeral_new(remote_t remote, lob_t outer)
+cs1c_ephemeral_t cs1c_ephemeral_new(cs1c_remote_t remote, lob_t outer)
 {
-  uint8_t ekey[KEY_BYTES], shared[SHARED_BYTES+((COMP_BYTES)*2)], hash[32];
-  ephemeral_t ephem;
+  uint8_t ekey[KEY_BYTES], shared[SHARED_BYTES+((COMP_BYTES)*2)], hash[32] = {0};
+  cs1c_ephemeral_t ephem;
 
   if(!remote) return NULL;
   if(!outer || outer->body_len < (COMP_BYTES)) return LOG("invalid outer");
 
-  if(!(ephem = malloc(sizeof(struct ephemeral_struct)))) return NULL;
-  memset(ephem,0,sizeof (struct ephemeral_struct));
+  if(!(ephem = malloc(sizeof(struct cs1c_ephemeral_struct)))) return NULL;
+  memset(ephem,0,sizeof (struct cs1c_ephemeral_struct));
 
   // create and copy in the exchange routing token
   e3x_hash(outer->body,16,hash);
@@ -530,7 +690,7 @@ ephemeral_t ephemeral_new(remote_t remote, lob_t outer)
   uECC_decompress(outer->body,ekey, curve);
   if(!uECC_shared_secret(ekey, remote->esecret, shared, curve))
   {
-    ephemeral_free(ephem);
+    cs1c_ephemeral_free(ephem);
     return LOG("ECDH failed");
   }
 
@@ -548,17 +708,36 @@ ephemeral_t ephemeral_new(remote_t remote, lob_t outer)
   return ephem;
 }
 
-void ephemeral_free(ephemeral_t ephem)
+void cs1c_ephemeral_free(cs1c_ephemeral_t ephem)
 {
+  if(!ephem) return;
+  util_zero(ephem,sizeof (struct cs1c_ephemeral_struct));
   free(ephem);
 }
 
-lob_t ephemeral_encrypt(ephemeral_t ephem, lob_t inner)
+// the channel iv's seq is little-endian, what every existing peer puts on the wire, so the replay window agrees across hosts
+static void iv_seq_put(uint32_t seq, uint8_t *iv)
+{
+  iv[0] = (uint8_t)seq;
+  iv[1] = (uint8_t)(seq >> 8);
+  iv[2] = (uint8_t)(seq >> 16);
+  iv[3] = (uint8_t)(seq >> 24);
+}
+
+static uint32_t iv_seq_get(uint8_t *iv)
+{
+  return (uint32_t)iv[0] | ((uint32_t)iv[1] << 8) | ((uint32_t)iv[2] << 16) | ((uint32_t)iv[3] << 24);
+}
+
+lob_t cs1c_ephemeral_encrypt(cs1c_ephemeral_t ephem, lob_t inner)
 {
   lob_t outer;
   uint8_t iv[16], hmac[32];
   size_t inner_len;
 
+  if(ephem->sent == UINT32_MAX) return LOG("seq exhausted, needs a rekey");
+  ephem->sent++;
+
   outer = lob_new();
   inner_len = lob_len(inner);
   if(!lob_body(outer,NULL,16+4+inner_len+4)) return lob_free(outer);
@@ -566,7 +745,7 @@ lob_t ephemeral_encrypt(ephemeral_t ephem, lob_t inner)
   // copy in token and create/copy iv
   memcpy(outer->body,ephem->token,16);
   memset(iv,0,16);
-  memcpy(iv,&(ephem->seq),4);
+  iv_seq_put(ephem->seq,iv);
   ephem->seq++;
   memcpy(outer->body+16,iv,4);
 
@@ -582,13 +761,24 @@ lob_t ephemeral_encrypt(ephemeral_t ephem, lob_t inner)
   return outer;
 }
 
-lob_t ephemeral_decrypt(ephemeral_t ephem, lob_t outer)
+lob_t cs1c_ephemeral_decrypt(cs1c_ephemeral_t ephem, lob_t outer)
 {
   uint8_t iv[16], hmac[32];
+  uint32_t seq32;
+  uint64_t seq;
+
+  if(!ephem || !outer) return NULL;
+  if(outer->body_len < (16+4+4)) return LOG("invalid outer");
 
   memset(iv,0,16);
   memcpy(iv,outer->body+16,4);
 
+  // the wire seq is only 32 bits, place it nearest the highest one seen
+  seq32 = iv_seq_get(iv);
+  seq = ephem->replay.top + (int64_t)(int32_t)(seq32 - (uint32_t)ephem->replay.top);
+  if(!ephem->replay.started) seq = seq32;
+  if(e3x_replay_check(&(ephem->replay),seq)) return LOG("replayed seq %u",seq32);
+
   memcpy(hmac,ephem->deckey,16);
   memcpy(hmac+16,iv,4);
   // mac just the ciphertext
@@ -596,6 +786,7 @@ lob_t ephemeral_decrypt(ephemeral_t ephem, lob_t outer)
   fold3(hmac,hmac);
 
   if(util_ct_memcmp(hmac,outer->body+(outer->body_len-4),4) != 0) return LOG("hmac failed");
+  e3x_replay_accept(&(ephem->replay),seq);
 
   // decrypt in place
   aes_128_ctr(ephem->deckey,outer->body_len-(16+4+4),iv,outer->body+16+4,outer->body+16+4);
@@ -603,3 +794,61 @@ lob_t ephemeral_decrypt(ephemeral_t ephem, lob_t outer)
   // return parse attempt
   return lob_parse(outer->body+16+4, outer->body_len-(16+4+4));
 }
+
+e3x_replay_t cs1c_ephemeral_replay(cs1c_ephemeral_t ephem)
+{
+  if(!ephem) return NULL;
+  return &(ephem->replay);
+}
+
+// versioned w/ every field in a fixed big-endian layout, so it survives rebuilds and moving hosts
+#define CS1C_SAVE_VERSION 1
+#define CS1C_SAVE_BYTES (1+16+16+16+4+4)
+
+lob_t cs1c_ephemeral_save(cs1c_ephemeral_t ephem)
+{
+  lob_t saved;
+  uint8_t *at;
+  if(!ephem) return NULL;
+  saved = lob_new();
+  if(!(at = lob_body(saved,NULL,CS1C_SAVE_BYTES+E3X_REPLAY_SAVE_BYTES))) return lob_free(saved);
+  at[0] = CS1C_SAVE_VERSION;
+  memcpy(at+1,ephem->enckey,16);
+  memcpy(at+17,ephem->deckey,16);
+  memcpy(at+33,ephem->token,16);
+  util_put_be(ephem->seq,at+49,4);
+  util_put_be(ephem->sent,at+53,4);
+  e3x_replay_save(&(ephem->replay),at+CS1C_SAVE_BYTES);
+  return saved;
+}
+
+cs1c_ephemeral_t cs1c_ephemeral_load(lob_t saved)
+{
+  cs1c_ephemeral_t ephem;
+  uint8_t *at;
+  size_t rest;
+  if(!saved || saved->body_len < CS1C_SAVE_BYTES || saved->body[0] != CS1C_SAVE_VERSION) return LOG("invalid saved ephemeral");
+  if(!(ephem = malloc(sizeof(struct cs1c_ephemeral_struct)))) return NULL;
+  memset(ephem,0,sizeof (struct cs1c_ephemeral_struct));
+  at = saved->body;
+  rest = saved->body_len - CS1C_SAVE_BYTES;
+  if(e3x_replay_load(&(ephem->replay),at+CS1C_SAVE_BYTES,rest) != rest)
+  {
+    free(ephem);
+    return LOG("invalid saved replay window");
+  }
+  memcpy(ephem->enckey,at+1,16);
+  memcpy(ephem->deckey,at+17,16);
+  memcpy(ephem->token,at+33,16);
+  ephem->seq = (uint32_t)util_get_be(at+49,4) + E3X_RESUME_SKIP;
+  ephem->sent = (uint32_t)util_get_be(at+53,4);
+  ephem->sent = (ephem->sent > UINT32_MAX - E3X_RESUME_SKIP) ? UINT32_MAX : ephem->sent + E3X_RESUME_SKIP;
+  return ephem;
+}
+
+// file-local, the amalgamation keeps going after us
+#undef KEY_BYTES
+#undef COMP_BYTES
+#undef SECRET_BYTES
+#undef SHARED_BYTES
+#undef curve
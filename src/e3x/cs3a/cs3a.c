@@ -7,49 +7,46 @@
 #include "telehash.h"
 #include "telehash.h"
 
-// undefine the void* aliases so we can define them locally
-#undef local_t
-#undef remote_t
-#undef ephemeral_t
-
-typedef struct local_struct
+// our own types behind the void* aliases, prefixed like everything file-local so every cipher set can share one translation unit
+typedef struct cs3a_local_struct
 {
   uint8_t secret[crypto_box_SECRETKEYBYTES], key[crypto_box_PUBLICKEYBYTES];
-} *local_t;
+} *cs3a_local_t;
 
-typedef struct remote_struct
+typedef struct cs3a_remote_struct
 {
   uint8_t key[crypto_box_PUBLICKEYBYTES];
   uint8_t esecret[crypto_box_SECRETKEYBYTES], ekey[crypto_box_PUBLICKEYBYTES];
-} *remote_t;
+} *cs3a_remote_t;
 
-typedef struct ephemeral_struct
+typedef struct cs3a_ephemeral_struct
 {
   uint8_t enckey[32], deckey[32], token[16];
-} *ephemeral_t;
+} *cs3a_ephemeral_t;
 
 // these are all the locally implemented handlers defined in e3x_cipher.h
 
-static uint8_t *cipher_hash(uint8_t *input, size_t len, uint8_t *output);
-static uint8_t *cipher_err(void);
-static uint8_t cipher_generate(lob_t keys, lob_t secrets);
+static uint8_t *cs3a_cipher_hash(uint8_t *input, size_t len, uint8_t *output);
+static uint8_t *cs3a_cipher_err(void);
+static uint8_t cs3a_cipher_generate(lob_t keys, lob_t secrets);
+static uint8_t cs3a_cipher_keypair(uint8_t *key, uint8_t *secret);
 static uint8_t *cipher_rand(uint8_t *bytes, size_t len);
 
-static local_t local_new(lob_t keys, lob_t secrets);
-static void local_free(local_t local);
-static lob_t local_decrypt(local_t local, lob_t outer);
-static lob_t local_sign(local_t local, lob_t args, uint8_t *data, size_t len);
+static cs3a_local_t cs3a_local_new(lob_t keys, lob_t secrets);
+static void cs3a_local_free(cs3a_local_t local);
+static lob_t cs3a_local_decrypt(cs3a_local_t local, lob_t outer);
+static lob_t cs3a_local_sign(cs3a_local_t local, lob_t args, uint8_t *data, size_t len);
 
-static remote_t remote_new(lob_t key, uint8_t *token);
-static void remote_free(remote_t remote);
-static uint8_t remote_verify(remote_t remote, local_t local, lob_t outer);
-static lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner);
-static uint8_t remote_validate(remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len);
+static cs3a_remote_t cs3a_remote_new(lob_t key, uint8_t *token);
+static void cs3a_remote_free(cs3a_remote_t remote);
+static uint8_t cs3a_remote_verify(cs3a_remote_t remote, cs3a_local_t local, lob_t outer);
+static lob_t cs3a_remote_encrypt(cs3a_remote_t remote, cs3a_local_t local, lob_t inner);
+static uint8_t cs3a_remote_validate(cs3a_remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len);
 
-static ephemeral_t ephemeral_new(remote_t remote, lob_t outer);
-static void ephemeral_free(ephemeral_t ephemeral);
-static lob_t ephemeral_encrypt(ephemeral_t ephemeral, lob_t inner);
-static lob_t ephemeral_decrypt(ephemeral_t ephemeral, lob_t outer);
+static cs3a_ephemeral_t cs3a_ephemeral_new(cs3a_remote_t remote, lob_t outer);
+static void cs3a_ephemeral_free(cs3a_ephemeral_t ephemeral);
+static lob_t cs3a_ephemeral_encrypt(cs3a_ephemeral_t ephemeral, lob_t inner);
+static lob_t cs3a_ephemeral_decrypt(cs3a_ephemeral_t ephemeral, lob_t outer);
 
 
 e3x_cipher_t cs3a_init(lob_t options)
@@ -78,36 +75,39 @@ e3x_cipher_t cs3a_init(lob_t options)
   randombytes_stir();
 
   // configure our callbacks
-  ret->hash = cipher_hash;
+  ret->hash = cs3a_cipher_hash;
   ret->rand = cipher_rand;
-  ret->err = cipher_err;
-  ret->generate = cipher_generate;
+  ret->err = cs3a_cipher_err;
+  ret->generate = cs3a_cipher_generate;
+  ret->keypair = cs3a_cipher_keypair;
+  ret->keylen = crypto_box_PUBLICKEYBYTES;
+  ret->secretlen = crypto_box_SECRETKEYBYTES;
 
   // need to cast these to map our struct types to voids
-  ret->local_new = (void *(*)(lob_t, lob_t))local_new;
-  ret->local_free = (void (*)(void *))local_free;
-  ret->local_decrypt = (lob_t (*)(void *, lob_t))local_decrypt;
-  ret->local_sign = (lob_t (*)(void *, lob_t, uint8_t *, size_t))local_sign;
-  ret->remote_new = (void *(*)(lob_t, uint8_t *))remote_new;
-  ret->remote_free = (void (*)(void *))remote_free;
-  ret->remote_verify = (uint8_t (*)(void *, void *, lob_t))remote_verify;
-  ret->remote_encrypt = (lob_t (*)(void *, void *, lob_t))remote_encrypt;
-  ret->remote_validate = (uint8_t (*)(void *, lob_t, lob_t, uint8_t *, size_t))remote_validate;
-  ret->ephemeral_new = (void *(*)(void *, lob_t))ephemeral_new;
-  ret->ephemeral_free = (void (*)(void *))ephemeral_free;
-  ret->ephemeral_encrypt = (lob_t (*)(void *, lob_t))ephemeral_encrypt;
-  ret->ephemeral_decrypt = (lob_t (*)(void *, lob_t))ephemeral_decrypt;
+  ret->local_new = (void *(*)(lob_t, lob_t))cs3a_local_new;
+  ret->local_free = (void (*)(void *))cs3a_local_free;
+  ret->local_decrypt = (lob_t (*)(void *, lob_t))cs3a_local_decrypt;
+  ret->local_sign = (lob_t (*)(void *, lob_t, uint8_t *, size_t))cs3a_local_sign;
+  ret->remote_new = (void *(*)(lob_t, uint8_t *))cs3a_remote_new;
+  ret->remote_free = (void (*)(void *))cs3a_remote_free;
+  ret->remote_verify = (uint8_t (*)(void *, void *, lob_t))cs3a_remote_verify;
+  ret->remote_encrypt = (lob_t (*)(void *, void *, lob_t))cs3a_remote_encrypt;
+  ret->remote_validate = (uint8_t (*)(void *, lob_t, lob_t, uint8_t *, size_t))cs3a_remote_validate;
+  ret->ephemeral_new = (void *(*)(void *, lob_t))cs3a_ephemeral_new;
+  ret->ephemeral_free = (void (*)(void *))cs3a_ephemeral_free;
+  ret->ephemeral_encrypt = (lob_t (*)(void *, lob_t))cs3a_ephemeral_encrypt;
+  ret->ephemeral_decrypt = (lob_t (*)(void *, lob_t))cs3a_ephemeral_decrypt;
 
   return ret;
 }
 
-uint8_t *cipher_hash(uint8_t *input, size_t len, uint8_t *output)
+uint8_t *cs3a_cipher_hash(uint8_t *input, size_t len, uint8_t *output)
 {
   crypto_hash_sha256(output,input,(unsigned long)len);
   return output;
 }
 
-uint8_t *cipher_err(void)
+uint8_t *cs3a_cipher_err(void)
 {
   return 0;
 }
@@ -118,7 +118,7 @@ uint8_t *cipher_rand(uint8_t *bytes, size_t len)
   return bytes;
 }
 
-uint8_t cipher_generate(lob_t keys, lob_t secrets)
+uint8_t cs3a_cipher_generate(lob_t keys, lob_t secrets)
 {
   uint8_t secret[crypto_box_SECRETKEYBYTES], key[crypto_box_PUBLICKEYBYTES];
 
@@ -131,10 +131,15 @@ uint8_t cipher_generate(lob_t keys, lob_t secrets)
   return 0;
 }
 
+uint8_t cs3a_cipher_keypair(uint8_t *key, uint8_t *secret)
+{
+  return (crypto_box_keypair(key,secret) == 0) ? 1 : 0;
+}
+
 
-local_t local_new(lob_t keys, lob_t secrets)
+cs3a_local_t cs3a_local_new(lob_t keys, lob_t secrets)
 {
-  local_t local;
+  cs3a_local_t local;
   lob_t key, secret;
 
   if(!keys) keys = lob_linked(secrets); // for convenience
@@ -146,8 +151,8 @@ local_t local_new(lob_t keys, lob_t secrets)
   if(!secret) return LOG("missing secret");
   if(secret->body_len != crypto_box_SECRETKEYBYTES) return LOG("invalid secret %d != %d",secret->body_len,crypto_box_SECRETKEYBYTES);
 
-  if(!(local = malloc(sizeof(struct local_struct)))) return NULL;
-  memset(local,0,sizeof (struct local_struct));
+  if(!(local = malloc(sizeof(struct cs3a_local_struct)))) return NULL;
+  memset(local,0,sizeof (struct cs3a_local_struct));
 
   // copy in key/secret data
   memcpy(local->key,key->body,key->body_len);
@@ -158,13 +163,13 @@ local_t local_new(lob_t keys, lob_t secrets)
   return local;
 }
 
-void local_free(local_t local)
+void cs3a_local_free(cs3a_local_t local)
 {
   free(local);
   return;
 }
 
-lob_t local_decrypt(local_t local, lob_t outer)
+lob_t cs3a_local_decrypt(cs3a_local_t local, lob_t outer)
 {
   uint8_t secret[crypto_box_BEFORENMBYTES];
   lob_t inner, tmp;
@@ -195,7 +200,7 @@ lob_t local_decrypt(local_t local, lob_t outer)
   return inner;
 }
 
-lob_t local_sign(local_t local, lob_t args, uint8_t *data, size_t len)
+lob_t cs3a_local_sign(cs3a_local_t local, lob_t args, uint8_t *data, size_t len)
 {
 //  uint8_t hash[32];
 
@@ -209,37 +214,41 @@ lob_t local_sign(local_t local, lob_t args, uint8_t *data, size_t len)
   return NULL;
 }
 
-remote_t remote_new(lob_t key, uint8_t *token)
+cs3a_remote_t cs3a_remote_new(lob_t key, uint8_t *token)
 {
   uint8_t hash[32];
-  remote_t remote;
+  cs3a_remote_t remote;
 
   if(!key) return LOG("missing key");
   if(key->body_len != crypto_box_PUBLICKEYBYTES) return LOG("invalid key %d != %d",key->body_len,crypto_box_PUBLICKEYBYTES);
 
-  if(!(remote = malloc(sizeof(struct remote_struct)))) return NULL;
-  memset(remote,0,sizeof (struct remote_struct));
+  if(!(remote = malloc(sizeof(struct cs3a_remote_struct)))) return NULL;
+  memset(remote,0,sizeof (struct cs3a_remote_struct));
 
   // copy in key and make ephemeral ones
   memcpy(remote->key,key->body,key->body_len);
-  crypto_box_keypair(remote->ekey,remote->esecret);
+  if(!e3x_cipher_keypair(e3x_cipher_set(0x3a,NULL), remote->ekey, remote->esecret))
+  {
+    cs3a_remote_free(remote);
+    return LOG("ephemeral keygen failed");
+  }
 
   // set token if wanted
   if(token)
   {
-    cipher_hash(remote->ekey,16,hash);
+    cs3a_cipher_hash(remote->ekey,16,hash);
     memcpy(token,hash,16);
   }
 
   return remote;
 }
 
-void remote_free(remote_t remote)
+void cs3a_remote_free(cs3a_remote_t remote)
 {
   free(remote);
 }
 
-uint8_t remote_verify(remote_t remote, local_t local, lob_t outer)
+uint8_t cs3a_remote_verify(cs3a_remote_t remote, cs3a_local_t local, lob_t outer)
 {
   uint8_t secret[crypto_box_BEFORENMBYTES], shared[24+crypto_box_BEFORENMBYTES], hash[32];
 
@@ -264,7 +273,7 @@ uint8_t remote_verify(remote_t remote, local_t local, lob_t outer)
   return 0;
 }
 
-lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner)
+lob_t cs3a_remote_encrypt(cs3a_remote_t remote, cs3a_local_t local, lob_t inner)
 {
   uint8_t secret[crypto_box_BEFORENMBYTES], nonce[24], shared[24+crypto_box_BEFORENMBYTES], hash[32], csid = 0x3a;
   lob_t outer;
@@ -300,7 +309,7 @@ lob_t remote_encrypt(remote_t remote, local_t local, lob_t inner)
   return outer;
 }
 
-uint8_t remote_validate(remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len)
+uint8_t cs3a_remote_validate(cs3a_remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len)
 {
 //  uint8_t hash[32];
   if(!args || !sig || !data || !len) return 1;
@@ -316,16 +325,16 @@ uint8_t remote_validate(remote_t remote, lob_t args, lob_t sig, uint8_t *data, s
   return 3;
 }
 
-ephemeral_t ephemeral_new(remote_t remote, lob_t outer)
+cs3a_ephemeral_t cs3a_ephemeral_new(cs3a_remote_t remote, lob_t outer)
 {
   uint8_t shared[crypto_box_BEFORENMBYTES+(crypto_box_PUBLICKEYBYTES*2)], hash[32];
-  ephemeral_t ephem;
+  cs3a_ephemeral_t ephem;
 
   if(!remote) return NULL;
   if(!outer || outer->body_len < crypto_box_PUBLICKEYBYTES) return LOG("invalid outer");
 
-  if(!(ephem = malloc(sizeof(struct ephemeral_struct)))) return NULL;
-  memset(ephem,0,sizeof (struct ephemeral_struct));
+  if(!(ephem = malloc(sizeof(struct cs3a_ephemeral_struct)))) return NULL;
+  memset(ephem,0,sizeof (struct cs3a_ephemeral_struct));
 
   // create and copy in the exchange routing token
   e3x_hash(outer->body,16,hash);
@@ -346,12 +355,12 @@ ephemeral_t ephemeral_new(remote_t remote, lob_t outer)
   return ephem;
 }
 
-void ephemeral_free(ephemeral_t ephem)
+void cs3a_ephemeral_free(cs3a_ephemeral_t ephem)
 {
   free(ephem);
 }
 
-lob_t ephemeral_encrypt(ephemeral_t ephem, lob_t inner)
+lob_t cs3a_ephemeral_encrypt(cs3a_ephemeral_t ephem, lob_t inner)
 {
   lob_t outer;
   size_t inner_len;
@@ -374,7 +383,7 @@ lob_t ephemeral_encrypt(ephemeral_t ephem, lob_t inner)
 
 }
 
-lob_t ephemeral_decrypt(ephemeral_t ephem, lob_t outer)
+lob_t cs3a_ephemeral_decrypt(cs3a_ephemeral_t ephem, lob_t outer)
 {
   crypto_secretbox_open_easy(outer->body+16+24,
     outer->body+16+24,
@@ -0,0 +1,600 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "telehash.h"
+
+// keys and nonces come straight from the kernel's csprng, never the platform's random()
+#if defined(__linux__)
+#include <errno.h>
+#include <sys/random.h>
+#define CS3B_GETRANDOM
+#elif !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+#include <stdio.h>
+#define CS3B_URANDOM
+#endif
+
+// X25519 + ChaCha20-Poly1305, all in-tree and AES free for small cores w/o crypto extensions
+
+#define KEY_BYTES 32
+#define SECRET_BYTES 32
+#define NONCE_BYTES 12
+#define SEQ_BYTES 8
+#define TAG_BYTES 16
+#define AUTH_BYTES 16
+
+// our own types behind the void* aliases, prefixed like everything file-local so every cipher set can share one translation unit
+typedef struct cs3b_local_struct
+{
+  uint8_t secret[SECRET_BYTES], key[KEY_BYTES];
+  uint32_t id; // random, never 0, identifies this local to cached remote secrets
+} *cs3b_local_t;
+
+typedef struct cs3b_remote_struct
+{
+  uint8_t key[KEY_BYTES];
+  uint8_t esecret[SECRET_BYTES], ekey[KEY_BYTES];
+  uint8_t shared[KEY_BYTES]; // static-static DH w/ the local identified by shared_id
+  uint32_t shared_id;
+} *cs3b_remote_t;
+
+typedef struct cs3b_ephemeral_struct
+{
+  uint8_t enckey[32], deckey[32], token[16];
+  uint64_t seq;
+  struct e3x_replay_struct replay; // incoming seqs
+} *cs3b_ephemeral_t;
+
+// these are all the locally implemented handlers defined in e3x_cipher.h
+
+static uint8_t *cs3b_cipher_hash(uint8_t *input, size_t len, uint8_t *output);
+static uint8_t *cs3b_cipher_err(void);
+static uint8_t *cs3b_cipher_rand(uint8_t *bytes, size_t len);
+static uint8_t cs3b_cipher_generate(lob_t keys, lob_t secrets);
+static uint8_t cs3b_cipher_keypair(uint8_t *key, uint8_t *secret);
+
+static cs3b_local_t cs3b_local_new(lob_t keys, lob_t secrets);
+static void cs3b_local_free(cs3b_local_t local);
+static lob_t cs3b_local_decrypt(cs3b_local_t local, lob_t outer);
+static lob_t cs3b_local_sign(cs3b_local_t local, lob_t args, uint8_t *data, size_t len);
+
+static cs3b_remote_t cs3b_remote_new(lob_t key, uint8_t *token);
+static void cs3b_remote_free(cs3b_remote_t remote);
+static uint8_t cs3b_remote_rekey(cs3b_remote_t remote, uint8_t *token);
+static lob_t cs3b_remote_save(cs3b_remote_t remote);
+static uint8_t cs3b_remote_load(cs3b_remote_t remote, lob_t saved, uint8_t *token);
+static uint8_t cs3b_remote_verify(cs3b_remote_t remote, cs3b_local_t local, lob_t outer);
+static lob_t cs3b_remote_encrypt(cs3b_remote_t remote, cs3b_local_t local, lob_t inner);
+static uint8_t cs3b_remote_validate(cs3b_remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len);
+
+static cs3b_ephemeral_t cs3b_ephemeral_new(cs3b_remote_t remote, lob_t outer);
+static void cs3b_ephemeral_free(cs3b_ephemeral_t ephemeral);
+static lob_t cs3b_ephemeral_encrypt(cs3b_ephemeral_t ephemeral, lob_t inner);
+static lob_t cs3b_ephemeral_decrypt(cs3b_ephemeral_t ephemeral, lob_t outer);
+static e3x_replay_t cs3b_ephemeral_replay(cs3b_ephemeral_t ephemeral);
+static lob_t cs3b_ephemeral_save(cs3b_ephemeral_t ephemeral);
+static cs3b_ephemeral_t cs3b_ephemeral_load(lob_t saved);
+
+
+e3x_cipher_t cs3b_init(lob_t options)
+{
+  e3x_cipher_t ret;
+
+  ret = malloc(sizeof(struct e3x_cipher_struct));
+  if(!ret) return NULL;
+  memset(ret,0,sizeof (struct e3x_cipher_struct));
+
+  // identifying markers
+  ret->id = CS_3b;
+  ret->csid = 0x3b;
+  memcpy(ret->hex,"3b",3);
+
+  // no signing alg's yet
+  ret->alg = NULL;
+
+  // configure our callbacks
+  ret->rand = cs3b_cipher_rand;
+  ret->hash = cs3b_cipher_hash;
+  ret->err = cs3b_cipher_err;
+  ret->generate = cs3b_cipher_generate;
+  ret->keypair = cs3b_cipher_keypair;
+  ret->keylen = KEY_BYTES;
+  ret->secretlen = SECRET_BYTES;
+
+  // need to cast these to map our struct types to voids
+  ret->local_new = (void *(*)(lob_t, lob_t))cs3b_local_new;
+  ret->local_free = (void (*)(void *))cs3b_local_free;
+  ret->local_decrypt = (lob_t (*)(void *, lob_t))cs3b_local_decrypt;
+  ret->local_sign = (lob_t (*)(void *, lob_t, uint8_t *, size_t))cs3b_local_sign;
+  ret->remote_new = (void *(*)(lob_t, uint8_t *))cs3b_remote_new;
+  ret->remote_free = (void (*)(void *))cs3b_remote_free;
+  ret->remote_rekey = (uint8_t (*)(void *, uint8_t *))cs3b_remote_rekey;
+  ret->remote_verify = (uint8_t (*)(void *, void *, lob_t))cs3b_remote_verify;
+  ret->remote_encrypt = (lob_t (*)(void *, void *, lob_t))cs3b_remote_encrypt;
+  ret->remote_validate = (uint8_t (*)(void *, lob_t, lob_t, uint8_t *, size_t))cs3b_remote_validate;
+  ret->ephemeral_new = (void *(*)(void *, lob_t))cs3b_ephemeral_new;
+  ret->ephemeral_free = (void (*)(void *))cs3b_ephemeral_free;
+  ret->ephemeral_encrypt = (lob_t (*)(void *, lob_t))cs3b_ephemeral_encrypt;
+  ret->ephemeral_decrypt = (lob_t (*)(void *, lob_t))cs3b_ephemeral_decrypt;
+  ret->ephemeral_replay = (e3x_replay_t (*)(void *))cs3b_ephemeral_replay;
+  ret->remote_save = (lob_t (*)(void *))cs3b_remote_save;
+  ret->remote_load = (uint8_t (*)(void *, lob_t, uint8_t *))cs3b_remote_load;
+  ret->ephemeral_save = (lob_t (*)(void *))cs3b_ephemeral_save;
+  ret->ephemeral_load = (void *(*)(lob_t))cs3b_ephemeral_load;
+
+  return ret;
+}
+
+uint8_t *cs3b_cipher_hash(uint8_t *input, size_t len, uint8_t *output)
+{
+  sha256(input,len,output,0);
+  return output;
+}
+
+uint8_t *cs3b_cipher_err(void)
+{
+  return 0;
+}
+
+// NULL when there's no csprng to be had, nothing falls back to a predictable one
+uint8_t *cs3b_cipher_rand(uint8_t *bytes, size_t len)
+{
+  size_t at = 0;
+#if defined(CS3B_GETRANDOM)
+  ssize_t got;
+  while(at < len)
+  {
+    if((got = getrandom(bytes+at, len-at, 0)) < 0)
+    {
+      if(errno == EINTR) continue;
+      return LOG("getrandom failed");
+    }
+    at += (size_t)got;
+  }
+  return bytes;
+#elif defined(CS3B_URANDOM)
+  FILE *f = fopen("/dev/urandom", "rb");
+  if(!f) return LOG("no /dev/urandom");
+  at = fread(bytes, 1, len, f);
+  fclose(f);
+  if(at != len) return LOG("short read from /dev/urandom");
+  return bytes;
+#else
+  // the platform has to have registered a real source w/ e3x_random()
+  (void)at;
+  return e3x_rand(bytes, len);
+#endif
+}
+
+uint8_t cs3b_cipher_keypair(uint8_t *key, uint8_t *secret)
+{
+  if(!cs3b_cipher_rand(secret,SECRET_BYTES)) return 0;
+  return x25519_base(key, secret);
+}
+
+uint8_t cs3b_cipher_generate(lob_t keys, lob_t secrets)
+{
+  uint8_t secret[SECRET_BYTES], key[KEY_BYTES];
+
+  if(!cs3b_cipher_keypair(key, secret)) return 1;
+  lob_set_base32(keys,"3b",key,KEY_BYTES);
+  lob_set_base32(secrets,"3b",secret,SECRET_BYTES);
+  util_zero(secret,SECRET_BYTES);
+
+  return 0;
+}
+
+// the handshake body key, hashed w/ the sender's ephemeral key
+static uint8_t *handshake_key(uint8_t *shared, uint8_t *ekey, uint8_t *key)
+{
+  uint8_t buf[KEY_BYTES*2];
+  memcpy(buf,shared,KEY_BYTES);
+  memcpy(buf+KEY_BYTES,ekey,KEY_BYTES);
+  e3x_hash(buf,KEY_BYTES*2,key);
+  util_zero(buf,KEY_BYTES*2);
+  return key;
+}
+
+// static-static secret never changes for a remote, only compute it once per local
+static uint8_t *cs3b_remote_shared(cs3b_remote_t remote, cs3b_local_t local)
+{
+  if(remote->shared_id == local->id) return remote->shared;
+  if(!x25519(remote->shared, local->secret, remote->key)) return NULL;
+  remote->shared_id = local->id;
+  return remote->shared;
+}
+
+// one-time poly1305 key over the handshake, from its nonce and the static secret
+static uint8_t *handshake_auth(uint8_t *shared, lob_t outer, uint8_t *mac)
+{
+  uint8_t buf[NONCE_BYTES+KEY_BYTES], hash[32];
+  memcpy(buf,outer->body+KEY_BYTES,NONCE_BYTES);
+  memcpy(buf+NONCE_BYTES,shared,KEY_BYTES);
+  e3x_hash(buf,NONCE_BYTES+KEY_BYTES,hash);
+  poly1305(hash,outer->body,outer->body_len-AUTH_BYTES,mac);
+  util_zero(hash,32);
+  return mac;
+}
+
+cs3b_local_t cs3b_local_new(lob_t keys, lob_t secrets)
+{
+  cs3b_local_t local;
+  lob_t key, secret;
+
+  if(!keys) keys = lob_linked(secrets); // for convenience
+  key = lob_get_base32(keys,"3b");
+  if(!key) return LOG("missing key");
+  if(key->body_len != KEY_BYTES)
+  {
+    lob_free(key);
+    return LOG("invalid key size");
+  }
+
+  secret = lob_get_base32(secrets,"3b");
+  if(!secret || secret->body_len != SECRET_BYTES)
+  {
+    lob_free(key);
+    lob_free(secret);
+    return LOG("invalid secret");
+  }
+
+  if(!(local = malloc(sizeof(struct cs3b_local_struct)))) return NULL;
+  memset(local,0,sizeof (struct cs3b_local_struct));
+
+  // copy in key/secret data
+  memcpy(local->key,key->body,key->body_len);
+  memcpy(local->secret,secret->body,secret->body_len);
+  lob_free(key);
+  util_zero(secret->body,secret->body_len);
+  lob_free(secret);
+
+  while(!local->id)
+  {
+    if(cs3b_cipher_rand((uint8_t*)&(local->id),4)) continue;
+    cs3b_local_free(local);
+    return NULL;
+  }
+
+  return local;
+}
+
+void cs3b_local_free(cs3b_local_t local)
+{
+  if(!local) return;
+  util_zero(local,sizeof (struct cs3b_local_struct));
+  free(local);
+  return;
+}
+
+lob_t cs3b_local_decrypt(cs3b_local_t local, lob_t outer)
+{
+  uint8_t shared[KEY_BYTES], key[32];
+  lob_t inner, tmp;
+  size_t len;
+
+//  * `KEY` - 32 bytes, the sending exchange's ephemeral public key
+//  * `NONCE` - 12 bytes, randomly generated
+//  * `CIPHERTEXT` - the inner packet bytes sealed w/ chacha20-poly1305, keyed by SHA256(secret + `KEY`) from the recipient's endpoint key and `KEY`, `KEY` is the aad
+//  * `TAG` - 16 bytes, the AEAD tag
+//  * `AUTH` - 16 bytes, poly1305(everything before it, SHA256(`NONCE` + secret)) using the shared secret derived from both endpoint keys
+
+  if(!local || !outer) return NULL;
+  if(outer->body_len <= (KEY_BYTES+NONCE_BYTES+TAG_BYTES+AUTH_BYTES)) return NULL;
+  len = outer->body_len-(KEY_BYTES+NONCE_BYTES+TAG_BYTES+AUTH_BYTES);
+
+  // the outer is verified after decrypting, so open a copy
+  tmp = lob_new();
+  if(!lob_body(tmp,outer->body+KEY_BYTES+NONCE_BYTES,len)) return lob_free(tmp);
+
+  if(!x25519(shared, local->secret, outer->body)) return lob_free(tmp);
+  handshake_key(shared,outer->body,key);
+  util_zero(shared,KEY_BYTES);
+
+  if(!chacha20poly1305_open(key, outer->body+KEY_BYTES, outer->body, KEY_BYTES, tmp->body, (uint32_t)len, outer->body+KEY_BYTES+NONCE_BYTES+len))
+  {
+    util_zero(key,32);
+    LOG("handshake tag failed");
+    return lob_free(tmp);
+  }
+  util_zero(key,32);
+
+  // load inner packet
+  inner = lob_parse(tmp->body,tmp->body_len);
+  lob_free(tmp);
+
+  return inner;
+}
+
+lob_t cs3b_local_sign(cs3b_local_t local, lob_t args, uint8_t *data, size_t len)
+{
+  return NULL;
+}
+
+cs3b_remote_t cs3b_remote_new(lob_t key, uint8_t *token)
+{
+  cs3b_remote_t remote;
+
+  if(!key) return LOG("missing key");
+  if(key->body_len != KEY_BYTES) return LOG("invalid key %d != %d",key->body_len,KEY_BYTES);
+
+  if(!(remote = malloc(sizeof(struct cs3b_remote_struct)))) return NULL;
+  memset(remote,0,sizeof (struct cs3b_remote_struct));
+
+  // copy in key and make ephemeral ones
+  memcpy(remote->key,key->body,key->body_len);
+  if(!cs3b_remote_rekey(remote, token))
+  {
+    cs3b_remote_free(remote);
+    return LOG("ephemeral keygen failed");
+  }
+
+  return remote;
+}
+
+void cs3b_remote_free(cs3b_remote_t remote)
+{
+  if(!remote) return;
+  util_zero(remote,sizeof (struct cs3b_remote_struct));
+  free(remote);
+}
+
+uint8_t cs3b_remote_rekey(cs3b_remote_t remote, uint8_t *token)
+{
+  uint8_t hash[32];
+  if(!remote) return 0;
+  if(!e3x_cipher_keypair(e3x_cipher_set(0x3b,NULL), remote->ekey, remote->esecret)) return 0;
+
+  // set token if wanted
+  if(token)
+  {
+    cs3b_cipher_hash(remote->ekey,16,hash);
+    memcpy(token,hash,16);
+  }
+  return 1;
+}
+
+lob_t cs3b_remote_save(cs3b_remote_t remote)
+{
+  lob_t saved;
+  if(!remote) return NULL;
+  saved = lob_new();
+  if(!lob_body(saved,NULL,KEY_BYTES+SECRET_BYTES)) return lob_free(saved);
+  memcpy(saved->body,remote->ekey,KEY_BYTES);
+  memcpy(saved->body+KEY_BYTES,remote->esecret,SECRET_BYTES);
+  return saved;
+}
+
+uint8_t cs3b_remote_load(cs3b_remote_t remote, lob_t saved, uint8_t *token)
+{
+  uint8_t hash[32];
+  if(!remote || !saved || saved->body_len != KEY_BYTES+SECRET_BYTES) return 0;
+  memcpy(remote->ekey,saved->body,KEY_BYTES);
+  memcpy(remote->esecret,saved->body+KEY_BYTES,SECRET_BYTES);
+  if(token)
+  {
+    cs3b_cipher_hash(remote->ekey,16,hash);
+    memcpy(token,hash,16);
+  }
+  return 1;
+}
+
+uint8_t cs3b_remote_verify(cs3b_remote_t remote, cs3b_local_t local, lob_t outer)
+{
+  uint8_t mac[AUTH_BYTES], *secret;
+
+  if(!remote || !local || !outer) return 1;
+  if(outer->head_len != 1 || outer->head[0] != 0x3b) return 2;
+  if(outer->body_len <= (KEY_BYTES+NONCE_BYTES+TAG_BYTES+AUTH_BYTES)) return 2;
+
+  if(!(secret = cs3b_remote_shared(remote, local))) return 3;
+  handshake_auth(secret,outer,mac);
+  if(util_ct_memcmp(mac,outer->body+(outer->body_len-AUTH_BYTES),AUTH_BYTES) != 0)
+  {
+    LOG("auth failed");
+    return 4;
+  }
+
+  return 0;
+}
+
+lob_t cs3b_remote_encrypt(cs3b_remote_t remote, cs3b_local_t local, lob_t inner)
+{
+  uint8_t shared[KEY_BYTES], key[32], *secret, csid = 0x3b;
+  lob_t outer;
+  size_t inner_len;
+
+  if(!remote || !local || !inner) return NULL;
+  if(!(secret = cs3b_remote_shared(remote, local))) return LOG("DH failed");
+
+  outer = lob_new();
+  lob_head(outer,&csid,1);
+  inner_len = lob_len(inner);
+  if(!lob_body(outer,NULL,KEY_BYTES+NONCE_BYTES+inner_len+TAG_BYTES+AUTH_BYTES)) return lob_free(outer);
+
+  // copy in the ephemeral public key/nonce
+  memcpy(outer->body, remote->ekey, KEY_BYTES);
+  if(!cs3b_cipher_rand(outer->body+KEY_BYTES, NONCE_BYTES)) return lob_free(outer);
+
+  // body key from our ephemeral and their endpoint key
+  if(!x25519(shared, remote->esecret, remote->key)) return lob_free(outer);
+  handshake_key(shared,remote->ekey,key);
+  util_zero(shared,KEY_BYTES);
+
+  memcpy(outer->body+KEY_BYTES+NONCE_BYTES, lob_raw(inner), inner_len);
+  chacha20poly1305_seal(key, outer->body+KEY_BYTES, outer->body, KEY_BYTES, outer->body+KEY_BYTES+NONCE_BYTES, (uint32_t)inner_len, outer->body+KEY_BYTES+NONCE_BYTES+inner_len);
+  util_zero(key,32);
+
+  // authenticate it all w/ the static secret
+  handshake_auth(secret,outer,outer->body+(outer->body_len-AUTH_BYTES));
+
+  return outer;
+}
+
+uint8_t cs3b_remote_validate(cs3b_remote_t remote, lob_t args, lob_t sig, uint8_t *data, size_t len)
+{
+  if(!args || !sig || !data || !len) return 1;
+  return 3;
+}
+
+cs3b_ephemeral_t cs3b_ephemeral_new(cs3b_remote_t remote, lob_t outer)
+{
+  uint8_t shared[KEY_BYTES*3], hash[32] = {0};
+  cs3b_ephemeral_t ephem;
+
+  if(!remote) return NULL;
+  if(!outer || outer->body_len < KEY_BYTES) return LOG("invalid outer");
+
+  if(!(ephem = malloc(sizeof(struct cs3b_ephemeral_struct)))) return NULL;
+  memset(ephem,0,sizeof (struct cs3b_ephemeral_struct));
+
+  // create and copy in the exchange routing token
+  e3x_hash(outer->body,16,hash);
+  memcpy(ephem->token,hash,16);
+
+  // random seq starting point for channel nonces, each direction has its own key
+  if(!cs3b_cipher_rand((uint8_t*)&(ephem->seq),sizeof(ephem->seq)))
+  {
+    cs3b_ephemeral_free(ephem);
+    return NULL;
+  }
+
+  // do the diffie hellman
+  if(!x25519(shared, remote->esecret, outer->body))
+  {
+    cs3b_ephemeral_free(ephem);
+    return LOG("DH failed");
+  }
+
+  // combine inputs to create the digest-derived keys
+  memcpy(shared+KEY_BYTES,remote->ekey,KEY_BYTES);
+  memcpy(shared+(KEY_BYTES*2),outer->body,KEY_BYTES);
+  e3x_hash(shared,KEY_BYTES*3,ephem->enckey);
+
+  memcpy(shared+KEY_BYTES,outer->body,KEY_BYTES);
+  memcpy(shared+(KEY_BYTES*2),remote->ekey,KEY_BYTES);
+  e3x_hash(shared,KEY_BYTES*3,ephem->deckey);
+  util_zero(shared,KEY_BYTES*3);
+
+  return ephem;
+}
+
+void cs3b_ephemeral_free(cs3b_ephemeral_t ephem)
+{
+  if(!ephem) return;
+  util_zero(ephem,sizeof (struct cs3b_ephemeral_struct));
+  free(ephem);
+}
+
+// channel nonce is 4 zero bytes and the 8 byte sequence from the wire
+static uint8_t *ephemeral_nonce(uint8_t *seq, uint8_t *nonce)
+{
+  memset(nonce,0,NONCE_BYTES-SEQ_BYTES);
+  memcpy(nonce+(NONCE_BYTES-SEQ_BYTES),seq,SEQ_BYTES);
+  return nonce;
+}
+
+//  * `TOKEN` - 16 bytes, the exchange routing token, also the aad
+//  * `SEQ` - 8 bytes big-endian (network byte order, so the replay window agrees across hosts), the nonce, never repeated for a key
+//  * `CIPHERTEXT` - the inner packet sealed w/ chacha20-poly1305
+//  * `TAG` - 16 bytes
+lob_t cs3b_ephemeral_encrypt(cs3b_ephemeral_t ephem, lob_t inner)
+{
+  lob_t outer;
+  uint8_t nonce[NONCE_BYTES];
+  size_t inner_len;
+
+  if(!ephem || !inner) return NULL;
+  outer = lob_new();
+  inner_len = lob_len(inner);
+  if(!lob_body(outer,NULL,16+SEQ_BYTES+inner_len+TAG_BYTES)) return lob_free(outer);
+
+  // copy in token and seq
+  memcpy(outer->body,ephem->token,16);
+  util_put_be(ephem->seq,outer->body+16,SEQ_BYTES);
+  ephem->seq++;
+  ephemeral_nonce(outer->body+16,nonce);
+
+  memcpy(outer->body+16+SEQ_BYTES,lob_raw(inner),inner_len);
+  chacha20poly1305_seal(ephem->enckey, nonce, outer->body, 16, outer->body+16+SEQ_BYTES, (uint32_t)inner_len, outer->body+16+SEQ_BYTES+inner_len);
+
+  return outer;
+}
+
+lob_t cs3b_ephemeral_decrypt(cs3b_ephemeral_t ephem, lob_t outer)
+{
+  uint8_t nonce[NONCE_BYTES];
+  uint64_t seq;
+  uint32_t len;
+
+  if(!ephem || !outer) return NULL;
+  if(outer->body_len <= (16+SEQ_BYTES+TAG_BYTES)) return LOG("invalid outer");
+  len = (uint32_t)(outer->body_len-(16+SEQ_BYTES+TAG_BYTES));
+
+  // drop replays before doing any work
+  seq = util_get_be(outer->body+16,SEQ_BYTES);
+  if(e3x_replay_check(&(ephem->replay),seq)) return LOG("replayed seq");
+
+  // tag is checked before anything is decrypted in place
+  ephemeral_nonce(outer->body+16,nonce);
+  if(!chacha20poly1305_open(ephem->deckey, nonce, outer->body, 16, outer->body+16+SEQ_BYTES, len, outer->body+16+SEQ_BYTES+len)) return LOG("tag failed");
+  e3x_replay_accept(&(ephem->replay),seq);
+
+  // return parse attempt
+  return lob_parse(outer->body+16+SEQ_BYTES, len);
+}
+
+e3x_replay_t cs3b_ephemeral_replay(cs3b_ephemeral_t ephem)
+{
+  if(!ephem) return NULL;
+  return &(ephem->replay);
+}
+
+// versioned w/ every field in a fixed big-endian layout, so it survives rebuilds and moving hosts
+#define CS3B_SAVE_VERSION 1
+#define CS3B_SAVE_BYTES (1+32+32+16+SEQ_BYTES)
+
+lob_t cs3b_ephemeral_save(cs3b_ephemeral_t ephem)
+{
+  lob_t saved;
+  uint8_t *at;
+  if(!ephem) return NULL;
+  saved = lob_new();
+  if(!(at = lob_body(saved,NULL,CS3B_SAVE_BYTES+E3X_REPLAY_SAVE_BYTES))) return lob_free(saved);
+  at[0] = CS3B_SAVE_VERSION;
+  memcpy(at+1,ephem->enckey,32);
+  memcpy(at+33,ephem->deckey,32);
+  memcpy(at+65,ephem->token,16);
+  util_put_be(ephem->seq,at+81,SEQ_BYTES);
+  e3x_replay_save(&(ephem->replay),at+CS3B_SAVE_BYTES);
+  return saved;
+}
+
+cs3b_ephemeral_t cs3b_ephemeral_load(lob_t saved)
+{
+  cs3b_ephemeral_t ephem;
+  uint8_t *at;
+  size_t rest;
+  if(!saved || saved->body_len < CS3B_SAVE_BYTES || saved->body[0] != CS3B_SAVE_VERSION) return LOG("invalid saved ephemeral");
+  if(!(ephem = malloc(sizeof(struct cs3b_ephemeral_struct)))) return NULL;
+  memset(ephem,0,sizeof (struct cs3b_ephemeral_struct));
+  at = saved->body;
+  rest = saved->body_len - CS3B_SAVE_BYTES;
+  if(e3x_replay_load(&(ephem->replay),at+CS3B_SAVE_BYTES,rest) != rest)
+  {
+    free(ephem);
+    return LOG("invalid saved replay window");
+  }
+  memcpy(ephem->enckey,at+1,32);
+  memcpy(ephem->deckey,at+33,32);
+  memcpy(ephem->token,at+65,16);
+  ephem->seq = util_get_be(at+81,SEQ_BYTES) + E3X_RESUME_SKIP;
+  return ephem;
+}
+
+// file-local, the amalgamation keeps going after us
+#undef KEY_BYTES
+#undef SECRET_BYTES
+#undef NONCE_BYTES
+#undef SEQ_BYTES
+#undef TAG_BYTES
+#undef AUTH_BYTES
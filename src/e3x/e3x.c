@@ -47,7 +47,13 @@ lob_t e3x_generate(void)
 }
 
 
-static uint8_t (*frandom)(void) = (uint8_t (*)(void))util_sys_random;
+// the platform's, narrowed to a byte
+static uint8_t random_byte(void)
+{
+  return (uint8_t)util_sys_random();
+}
+
+static uint8_t (*frandom)(void) = random_byte;
 
 // set a callback for random
 void e3x_random(uint8_t (*frand)(void))
@@ -51,11 +51,26 @@ e3x_exchange_t e3x_exchange_new(e3x_self_t self, uint8_t csid, lob_t key)
   return x;
 }
 
+// keeps the replay drop counts of an ephemeral before it goes away
+static void exchange_ephem_free(e3x_exchange_t x, ephemeral_t ephem)
+{
+  e3x_replay_t w;
+  // async crypto in flight may be using it, and the ephemerals don't change until that's done
+  e3x_async_wait(x->sending);
+  e3x_async_wait(x->receiving);
+  if(!ephem) return;
+  if(x->cs->ephemeral_replay && (w = x->cs->ephemeral_replay(ephem))) x->replays += w->dups + w->stale;
+  x->cs->ephemeral_free(ephem);
+}
+
 void e3x_exchange_free(e3x_exchange_t x)
 {
   if(!x) return;
+  e3x_async_free(x->sending);
+  e3x_async_free(x->receiving);
   x->cs->remote_free(x->remote);
-  x->cs->ephemeral_free(x->ephem);
+  exchange_ephem_free(x, x->ephem);
+  exchange_ephem_free(x, x->ephem_old);
   free(x);
 }
 
@@ -90,6 +105,54 @@ uint8_t e3x_exchange_validate(e3x_exchange_t x, lob_t args, lob_t sig, uint8_t *
   return cs->remote_validate(remote,args,sig,data,len);
 }
 
+uint32_t e3x_exchange_validate_batch(e3x_exchange_t *xs, lob_t *args, lob_t *sigs, uint8_t **data, size_t *lens, uint8_t *errs, uint32_t count)
+{
+  remote_t remotes[E3X_BATCH];
+  lob_t bargs[E3X_BATCH], bsigs[E3X_BATCH];
+  uint8_t *bdata[E3X_BATCH], berrs[E3X_BATCH];
+  size_t blens[E3X_BATCH];
+  uint32_t at[E3X_BATCH];
+  uint32_t i, n, done, valid = 0;
+  uint8_t c;
+  e3x_cipher_t cs;
+  char *alg;
+
+  if(!args || !sigs || !data || !lens || !errs) return 0;
+  memset(errs, 0xff, count); // pending
+
+  // hand each cipher set its own signatures a window at a time
+  for(c=0; c<CS_MAX; c++)
+  {
+    if(!(cs = e3x_cipher_sets[c]) || !cs->remote_validate_batch) continue;
+    for(done = 0; done < count; done += E3X_BATCH)
+    {
+      for(n = 0, i = done; i < count && i < done + E3X_BATCH; i++)
+      {
+        if(errs[i] != 0xff || !(alg = lob_get(args[i],"alg")) || e3x_cipher_set(0,alg) != cs) continue;
+        at[n] = i;
+        remotes[n] = (xs && xs[i] && xs[i]->cs == cs) ? xs[i]->remote : NULL;
+        bargs[n] = args[i];
+        bsigs[n] = sigs[i];
+        bdata[n] = data[i];
+        blens[n] = lens[i];
+        n++;
+      }
+      if(!n) continue;
+      cs->remote_validate_batch(remotes, bargs, bsigs, bdata, blens, berrs, n);
+      for(i = 0; i < n; i++) errs[at[i]] = berrs[i];
+    }
+  }
+
+  // the rest one at a time
+  for(i = 0; i < count; i++)
+  {
+    if(errs[i] == 0xff) errs[i] = e3x_exchange_validate(xs ? xs[i] : NULL, args[i], sigs[i], data[i], lens[i]);
+    if(!errs[i]) valid++;
+  }
+
+  return valid;
+}
+
 // will return the current outgoing at value, optional arg to update it
 uint32_t e3x_exchange_out(e3x_exchange_t x, uint32_t at)
 {
@@ -127,9 +190,10 @@ e3x_exchange_t e3x_exchange_down(e3x_exchange_t x)
 {
   if(!x) return NULL;
   x->out = 0;
+  e3x_exchange_expire(x);
   if(x->ephem)
   {
-    x->cs->ephemeral_free(x->ephem);
+    exchange_ephem_free(x, x->ephem);
     x->ephem = NULL;
     memset(x->eid,0,16);
     x->last = 0;
@@ -151,11 +215,15 @@ e3x_exchange_t e3x_exchange_sync(e3x_exchange_t x, lob_t outer)
   {
     ephem = x->cs->ephemeral_new(x->remote,outer);
     if(!ephem) return LOG("ephemeral creation failed %s",x->cs->err());
-    x->cs->ephemeral_free(x->ephem);
+    // the previous one keeps decrypting anything still in flight until expired
+    exchange_ephem_free(x, x->ephem_old);
+    x->ephem_old = x->ephem;
     x->ephem = ephem;
     memcpy(x->eid,outer->body,16);
     // reset incoming channel id validation
     x->last = 0;
+    x->packets = 0;
+    x->bytes = 0;
   }
 
   return x;
@@ -204,9 +272,22 @@ lob_t e3x_exchange_handshake(e3x_exchange_t x, lob_t inner)
 lob_t e3x_exchange_receive(e3x_exchange_t x, lob_t outer)
 {
   lob_t inner;
+  e3x_replay_t w = NULL;
+  uint32_t dups = 0, stale = 0;
   if(!x || !outer) return LOG("invalid args");
   if(!x->ephem) return LOG("no handshake");
+  // a packet for the previous keys isn't a replay on the current ones, so don't count it as one
+  if(x->ephem_old && x->cs->ephemeral_replay && (w = x->cs->ephemeral_replay(x->ephem)))
+  {
+    dups = w->dups;
+    stale = w->stale;
+  }
   inner = x->cs->ephemeral_decrypt(x->ephem,outer);
+  if(!inner && x->ephem_old && (inner = x->cs->ephemeral_decrypt(x->ephem_old,outer)) && w)
+  {
+    w->dups = dups;
+    w->stale = stale;
+  }
   if(!inner) return LOG("decryption failed %s",x->cs->err());
   LOG("decrypted head %d body %d",inner->head_len,inner->body_len);
   return inner;
@@ -221,9 +302,119 @@ lob_t e3x_exchange_send(e3x_exchange_t x, lob_t inner)
   LOG("encrypting head %d body %d",inner->head_len,inner->body_len);
   outer = x->cs->ephemeral_encrypt(x->ephem,inner);
   if(!outer) return LOG("encryption failed %s",x->cs->err());
+  x->packets++;
+  x->bytes += outer->body_len;
   return outer;
 }
 
+// hands the cipher set a batch of channel packets to encrypt w/ the current keys
+static uint32_t exchange_encrypt(void *ctx, lob_t *packets, void **slots, uint32_t count)
+{
+  e3x_exchange_t x = ctx;
+  uint32_t i;
+  if(!x->ephem)
+  {
+    for(i = 0; i < count; i++) e3x_async_done(NULL, slots[i]);
+    return count;
+  }
+  if(x->cs->ephemeral_submit_batch) return x->cs->ephemeral_submit_batch(x->ephem, 1, packets, count, e3x_async_done, slots);
+  for(i = 0; i < count && x->cs->ephemeral_encrypt_submit(x->ephem, packets[i], e3x_async_done, slots[i]); i++);
+  return i;
+}
+
+// what the current keys can't decrypt may still be for the previous ones, nothing changes them while this is pending
+static void exchange_decrypted(lob_t inner, void *slot)
+{
+  e3x_exchange_t x = e3x_async_user(slot);
+  if(!inner && x->ephem_old && x->cs->ephemeral_decrypt_submit(x->ephem_old, e3x_async_packet(slot), e3x_async_done, slot)) return;
+  e3x_async_done(inner, slot);
+}
+
+static uint32_t exchange_decrypt(void *ctx, lob_t *packets, void **slots, uint32_t count)
+{
+  e3x_exchange_t x = ctx;
+  uint32_t i;
+  if(!x->ephem)
+  {
+    for(i = 0; i < count; i++) e3x_async_done(NULL, slots[i]);
+    return count;
+  }
+  if(x->cs->ephemeral_submit_batch) return x->cs->ephemeral_submit_batch(x->ephem, 0, packets, count, exchange_decrypted, slots);
+  for(i = 0; i < count && x->cs->ephemeral_decrypt_submit(x->ephem, packets[i], exchange_decrypted, slots[i]); i++);
+  return i;
+}
+
+uint8_t e3x_exchange_async(e3x_exchange_t x, void (*ready)(void *arg), void *arg)
+{
+  if(!x) return 0;
+  if(ready && x->sending) return 1;
+
+  e3x_async_free(x->sending);
+  e3x_async_free(x->receiving);
+  x->sending = x->receiving = NULL;
+  if(!ready || !x->cs->ephemeral_encrypt_submit || !x->cs->ephemeral_decrypt_submit) return 0;
+
+  x->sending = e3x_async_new(E3X_ASYNC_DEPTH, ready, arg);
+  x->receiving = e3x_async_new(E3X_ASYNC_DEPTH, ready, arg);
+  if(x->sending && x->receiving) return 1;
+  e3x_async_free(x->sending);
+  e3x_async_free(x->receiving);
+  x->sending = x->receiving = NULL;
+  return 0;
+}
+
+uint8_t e3x_exchange_send_async(e3x_exchange_t x, lob_t inner)
+{
+  if(!x || !x->sending)
+  {
+    lob_free(inner);
+    return 0;
+  }
+  if(!e3x_async_push(x->sending, inner, x)) return 0;
+  if(e3x_async_staged(x->sending) >= E3X_BATCH) e3x_async_flush(x->sending, exchange_encrypt, x);
+  return 1;
+}
+
+uint8_t e3x_exchange_receive_async(e3x_exchange_t x, lob_t outer)
+{
+  if(!x || !x->receiving)
+  {
+    lob_free(outer);
+    return 0;
+  }
+  if(!e3x_async_push(x->receiving, outer, x)) return 0;
+  if(e3x_async_staged(x->receiving) >= E3X_BATCH) e3x_async_flush(x->receiving, exchange_decrypt, x);
+  return 1;
+}
+
+uint32_t e3x_exchange_flush(e3x_exchange_t x)
+{
+  if(!x) return 0;
+  return e3x_async_flush(x->sending, exchange_encrypt, x) + e3x_async_flush(x->receiving, exchange_decrypt, x);
+}
+
+uint8_t e3x_exchange_sent(e3x_exchange_t x, lob_t *outer)
+{
+  lob_t inner;
+  if(!x || !outer || !e3x_async_pop(x->sending, &inner, outer)) return 0;
+  lob_free(inner);
+  if(!*outer) LOG("async encryption failed");
+  else{
+    x->packets++;
+    x->bytes += (*outer)->body_len;
+  }
+  return 1;
+}
+
+uint8_t e3x_exchange_received(e3x_exchange_t x, lob_t *inner)
+{
+  lob_t outer;
+  if(!x || !inner || !e3x_async_pop(x->receiving, &outer, inner)) return 0;
+  lob_free(outer);
+  if(!*inner) LOG("async decryption failed");
+  return 1;
+}
+
 // validate the next incoming channel id from the packet, or return the next avail outgoing channel id
 uint32_t e3x_exchange_cid(e3x_exchange_t x, lob_t incoming)
 {
@@ -252,3 +443,108 @@ uint8_t *e3x_exchange_token(e3x_exchange_t x)
   if(!x) return NULL;
   return x->token;
 }
+
+e3x_exchange_t e3x_exchange_rekey(e3x_exchange_t x)
+{
+  uint8_t token[16];
+  if(!x) return LOG("bad args");
+  if(!x->cs->remote_rekey) return LOG("no rekey support for %s",x->cs->hex);
+  if(!x->cs->remote_rekey(x->remote, token)) return LOG("rekey failed %s",x->cs->err());
+
+  // end any earlier overlap, but a peer that never synced to the last rekey still uses the oldest token
+  if(x->ephem_old) e3x_exchange_expire(x);
+  if(!x->rekeyed) memcpy(x->token_old,x->token,16);
+  memcpy(x->token,token,16);
+  x->rekeyed = 1;
+
+  // next handshake from them makes a new ephemeral w/ our new keys
+  memset(x->eid,0,16);
+  x->packets = 0;
+  x->bytes = 0;
+
+  return x;
+}
+
+e3x_exchange_t e3x_exchange_expire(e3x_exchange_t x)
+{
+  if(!x) return NULL;
+  exchange_ephem_free(x, x->ephem_old);
+  x->ephem_old = NULL;
+  memset(x->token_old,0,16);
+  x->rekeyed = 0;
+  return x;
+}
+
+lob_t e3x_exchange_save(e3x_exchange_t x)
+{
+  lob_t saved, tmp;
+  if(!x || !x->ephem) return LOG("no session");
+  if(!x->cs->remote_save || !x->cs->ephemeral_save) return LOG("no resume support for %s",x->cs->hex);
+
+  saved = lob_new();
+  lob_set(saved,"csid",x->cs->hex);
+  lob_set_uint(saved,"in",x->in);
+  lob_set_uint(saved,"out",x->out);
+  lob_set_uint(saved,"cid",x->cid);
+  lob_set_uint(saved,"last",x->last);
+  lob_set_base32(saved,"eid",x->eid,16);
+  if(!(tmp = x->cs->remote_save(x->remote))) return lob_free(saved);
+  lob_set_base32(saved,"remote",tmp->body,tmp->body_len);
+  lob_free(tmp);
+  if(!(tmp = x->cs->ephemeral_save(x->ephem))) return lob_free(saved);
+  lob_set_base32(saved,"ephem",tmp->body,tmp->body_len);
+  lob_free(tmp);
+
+  return saved;
+}
+
+e3x_exchange_t e3x_exchange_load(e3x_exchange_t x, lob_t saved)
+{
+  lob_t remote, ephem, eid;
+  ephemeral_t loaded = NULL;
+
+  if(!x || !saved) return LOG("bad args");
+  if(lob_get_cmp(saved,"csid",x->cs->hex) != 0) return LOG("csid mismatch");
+  if(!x->cs->remote_load || !x->cs->ephemeral_load) return LOG("no resume support for %s",x->cs->hex);
+
+  remote = lob_get_base32(saved,"remote");
+  ephem = lob_get_base32(saved,"ephem");
+  eid = lob_get_base32(saved,"eid");
+  if(lob_body_len(eid) == 16 && (loaded = x->cs->ephemeral_load(ephem)))
+  {
+    // our ephemeral keypair comes back too, it's what the peer's session and the token were made from
+    if(x->cs->remote_load(x->remote,remote,x->token))
+    {
+      e3x_exchange_expire(x);
+      exchange_ephem_free(x, x->ephem);
+      x->ephem = loaded;
+      memcpy(x->eid,eid->body,16);
+      x->in = lob_get_uint(saved,"in");
+      x->out = lob_get_uint(saved,"out");
+      x->cid = lob_get_uint(saved,"cid");
+      x->last = lob_get_uint(saved,"last");
+      x->packets = 0;
+      x->bytes = 0;
+    }else{
+      x->cs->ephemeral_free(loaded);
+      loaded = NULL;
+    }
+  }
+  lob_free(remote);
+  lob_free(ephem);
+  lob_free(eid);
+
+  if(!loaded) return LOG("invalid saved state");
+  return x;
+}
+
+uint32_t e3x_exchange_replays(e3x_exchange_t x)
+{
+  e3x_replay_t w;
+  if(!x) return 0;
+  // the window belongs to any async crypto until it's done, don't hold up a metrics read for it
+  if(e3x_async_pending(x->receiving)) return x->replays_last;
+  x->replays_last = x->replays;
+  if(x->ephem && x->cs->ephemeral_replay && (w = x->cs->ephemeral_replay(x->ephem))) x->replays_last += w->dups + w->stale;
+  return x->replays_last;
+}
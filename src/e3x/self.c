@@ -65,6 +65,15 @@ lob_t e3x_self_decrypt(e3x_self_t self, lob_t message)
   return cs->local_decrypt(self->locals[cs->id],message);
 }
 
+uint8_t e3x_self_decrypt_submit(e3x_self_t self, lob_t message, e3x_cipher_done_t done, void *arg)
+{
+  e3x_cipher_t cs;
+  if(!self || !message || !done || message->head_len != 1) return 0;
+  cs = e3x_cipher_set(message->head[0],NULL);
+  if(!cs || !cs->local_decrypt_submit) return 0;
+  return cs->local_decrypt_submit(self->locals[cs->id],message,done,arg);
+}
+
 // generate a signature for the data
 lob_t e3x_self_sign(e3x_self_t self, lob_t args, uint8_t *data, size_t len)
 {
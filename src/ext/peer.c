@@ -37,16 +37,18 @@ void peer_send(pipe_t pipe, lob_t packet, link_t link)
 
 pipe_t peer_pipe(mesh_t mesh, hashname_t peer)
 {
-  char *sn = hashname_short(peer);
+  char sn[9];
   pipe_t pipe, pipes = NULL;
 
+  if(!hashname_short_r(peer, sn)) return NULL;
+
   // get existing one for this peer
   pipes = xht_get(mesh->index, "ext_peer_pipes");
   for(pipe = pipes;pipe;pipe = pipe->next) if(util_cmp(pipe->id,sn) == 0) return pipe;
 
   // make a new one
   if(!(pipe = pipe_new("peer"))) return NULL;
-  pipe->id = strdup(hashname_short(peer));
+  pipe->id = strdup(sn);
   pipe->arg = hashname_dup(peer);
   pipe->send = peer_send;
   pipe->next = pipes;
@@ -58,15 +60,15 @@ pipe_t peer_pipe(mesh_t mesh, hashname_t peer)
 pipe_t peer_path(link_t link, lob_t path)
 {
   char *peer;
-  hashname_t id;
+  struct hashname_struct id;
 
   // just sanity check the path first
   if(!link || !path) return NULL;
   if(util_cmp("peer",lob_get(path,"type"))) return NULL;
   if(!(peer = lob_get(path,"peer"))) return LOG("missing peer");
-  if(!(id = hashname_vchar(peer))) return LOG("invalid peer");
+  if(!hashname_vchar_r(peer, &id)) return LOG("invalid peer");
   
-  return peer_pipe(link->mesh, id);
+  return peer_pipe(link->mesh, &id);
 }
 
 // handle an incoming connect request
@@ -1,238 +1,338 @@
+#include <string.h>
+#include <stdlib.h>
 #include "telehash.h"
+#include "ext_sock.h"
 
-sockc_t sockc_new(chan_t c)
+// ring helpers, data is at buf[at] wrapping at size
+
+static uint8_t ring_init(sockc_ring_s *r, uint32_t size)
+{
+  if(!(r->buf = malloc(size))) return 0;
+  r->size = size;
+  r->at = r->len = 0;
+  return 1;
+}
+
+// copies in up to len, returns amount taken
+static uint32_t ring_put(sockc_ring_s *r, const uint8_t *data, uint32_t len)
+{
+  uint32_t end, part;
+  if(len > r->size - r->len) len = r->size - r->len;
+  end = (r->at + r->len) % r->size;
+  part = r->size - end;
+  if(part > len) part = len;
+  memcpy(r->buf+end, data, part);
+  memcpy(r->buf, data+part, len-part);
+  r->len += len;
+  return len;
+}
+
+// copies out up to len without consuming
+static uint32_t ring_peek(sockc_ring_s *r, uint8_t *data, uint32_t len)
+{
+  uint32_t part;
+  if(len > r->len) len = r->len;
+  part = r->size - r->at;
+  if(part > len) part = len;
+  memcpy(data, r->buf+r->at, part);
+  memcpy(data+part, r->buf, len-part);
+  return len;
+}
+
+static void ring_drop(sockc_ring_s *r, uint32_t len)
+{
+  if(len > r->len) len = r->len;
+  r->len -= len;
+  r->at = r->len ? (r->at + len) % r->size : 0;
+}
+
+// forward declare
+static void sockc_handler(chan_t c, void *arg);
+
+static sockc_t sockc_new(chan_t c, lob_t opts)
 {
   sockc_t sc;
 
-  sc = malloc(sizeof(struct sockc_struct));
+  if(!c) return LOG("bad args");
+  if(!(sc = malloc(sizeof (struct sockc_struct)))) return LOG("OOM");
   memset(sc,0,sizeof (struct sockc_struct));
+  if(!ring_init(&sc->readbuf, SOCKC_BUFSIZE) || !ring_init(&sc->writebuf, SOCKC_BUFSIZE))
+  {
+    free(sc->readbuf.buf);
+    free(sc);
+    return LOG("OOM");
+  }
   sc->state = SOCKC_NEW;
+  sc->mtu = SOCKC_MTU;
   sc->fd = -1; // for app usage
+  sc->opts = opts;
   sc->c = c;
-  c->arg = (void*)sc;
+  chan_handle(c, sockc_handler, sc);
   return sc;
 }
 
-// process channel for new incoming sock channel
-sockc_t ext_sock(chan_t c)
+// detached channels just discard anything else until they're ended and free'd by the link
+static void sockc_drain(chan_t c, void *arg)
 {
   lob_t p;
-  sockc_t sc = (sockc_t)c->arg;
+  while((p = chan_receiving(c))) lob_free(p);
+}
+
+static void sockc_detach(sockc_t sc)
+{
+  if(!sc->c) return;
+  chan_handle(sc->c, sockc_drain, NULL);
+  sc->c = NULL;
+}
+
+// end a channel that never got a sockc, the link frees it once the end is processed
+static void sockc_abandon(chan_t c)
+{
+  chan_handle(c, sockc_drain, NULL);
+  chan_err(c, "OOM");
+}
+
+// copy body of the pending packet into the readbuf, returns 0 if it didn't all fit
+static uint8_t sockc_import(sockc_t sc)
+{
+  lob_t p = sc->pending;
+  if(!p) return 1;
+  sc->pending_at += ring_put(&sc->readbuf, p->body+sc->pending_at, p->body_len-sc->pending_at);
+  if(sc->pending_at < p->body_len) return 0;
+  sc->pending = lob_free(p);
+  sc->pending_at = 0;
+  return 1;
+}
 
-  DEBUG_PRINTF("sockc active %d",sc);
-  while((p = chan_pop(c)))
+// move as many incoming packets as fit into the readbuf, the rest stay queued on the channel
+static void sockc_pull(sockc_t sc)
+{
+  lob_t p;
+  while(sockc_import(sc) && sc->c && (p = chan_receiving(sc->c)))
   {
-    if(!sc)
+    if(lob_get(p,"err")) LOG("sock channel %d error %s",chan_id(sc->c),lob_get(p,"err"));
+    if(chan_state(sc->c) == CHAN_ENDED)
     {
-      sc = sockc_new(c);
-      sc->opts = lob_new();
-      lob_set_json(sc->opts,p);
+      sc->ended = 1;
+      sockc_detach(sc);
     }
-    
-    DEBUG_PRINTF("sock packet %d %d", sc->state, p->body_len);
+    sc->pending = p;
+    sc->pending_at = 0;
+  }
 
-    // copy in any payload
-    if(p->body_len)
-    {
-      if(!(sc->readbuf = realloc(sc->readbuf,sc->readable+p->body_len)))
-      {
-        chan_fail(c,"oom");
-      }else{
-        memcpy(sc->readbuf+sc->readable,p->body,p->body_len);
-        sc->readable += p->body_len;
-      }
-    }
+  // if the channel is ending and the data all read, the sock is now closed
+  if(sc->ended && !sc->pending && !sc->readbuf.len) sc->state = SOCKC_CLOSED;
+}
+
+static void sockc_handler(chan_t c, void *arg)
+{
+  sockc_t sc = (sockc_t)arg;
+  if(!sc) return;
+  sockc_pull(sc);
+}
+
+// sends one packet of up to mtu from the writebuf, optionally ending the channel
+static uint8_t sockc_chunk(sockc_t sc, uint8_t end)
+{
+  lob_t p;
+  uint32_t len;
+
+  if(!sc->c) return 0;
+  len = sc->writebuf.len;
+  if(len > sc->mtu) len = sc->mtu;
+  if(!len && !end) return 0;
+
+  if(!(p = chan_packet(sc->c))) return 0;
+  if(len && !lob_body(p, NULL, len))
+  {
     lob_free(p);
+    return 0;
+  }
+  ring_peek(&sc->writebuf, p->body, len);
+  ring_drop(&sc->writebuf, len);
+  if(end && !sc->writebuf.len) lob_set_raw(p,"end",3,"true",4);
+  chan_send(sc->c, p);
+  return 1;
+}
+
+// process a new incoming sock channel open
+sockc_t ext_sock(link_t link, lob_t open)
+{
+  chan_t c;
+  sockc_t sc;
+
+  if(!link || !open) return NULL;
+  if(lob_get_cmp(open,"type","sock")) return NULL;
+
+  if(!(c = link_chan(link, open)))
+  {
+    LOG("invalid sock open %s",lob_json(open));
+    lob_free(open);
+    return NULL;
   }
-  
+  if(!(sc = sockc_new(c, open)))
+  {
+    sockc_abandon(c);
+    lob_free(open);
+    return NULL;
+  }
+
+  // opens may carry data too
+  sc->pending = lob_copy(open);
+  sockc_pull(sc);
+
+  LOG("incoming sock channel %d",chan_id(c));
   return sc;
 }
 
-void sockc_accept(sockc_t sc)
+sockc_t sockc_accept(sockc_t sc)
 {
-  if(!sc || sc->state != SOCKC_NEW) return;
+  if(!sc || sc->state != SOCKC_NEW) return NULL;
   sc->state = SOCKC_OPEN;
   // send an empty packet (no options) to accept
-  chan_send(sc->c,chan_packet(sc->c));
+  if(sc->c) chan_send(sc->c, chan_packet(sc->c));
+  return sc;
 }
 
-// create a sock channel to this hn, optional opts (ip, port)
-sockc_t sockc_connect(switch_t s, char *hn, lob_t opts)
+// create a sock channel to this link, optional opts (ip, port)
+sockc_t sockc_connect(link_t link, lob_t opts)
 {
-  lob_t p;
+  lob_t open;
+  chan_t c;
   sockc_t sc;
 
-  sc = sockc_new(chan_start(s, hn, "sock"));
-  if(!sc) return NULL;
+  if(!link) return LOG("bad args");
+
+  open = lob_new();
+  if(opts) lob_set_json(open, opts);
+  lob_set(open,"type","sock");
+  if(!(c = link_chan(link, open)))
+  {
+    lob_free(open);
+    return NULL;
+  }
+  if(!(sc = sockc_new(c, open)))
+  {
+    sockc_abandon(c);
+    lob_free(open);
+    return NULL;
+  }
   sc->state = SOCKC_OPEN;
-  p = chan_packet(sc->c);
-  lob_set_json(p,opts);
-  lob_free(opts);
-  chan_send(sc->c, p);
+  chan_send(c, lob_copy(open));
   return sc;
 }
 
-// util to just send a closing signal
-void sockc_shutdown(sockc_t sc)
-{
-  if(!sc || sc->state == SOCKC_CLOSED) return;
-  DEBUG_PRINTF("sockc shutdown %d",sc->c->id);
-  sc->state = SOCKC_CLOSED;
-    // try to flush any data and send the end w/ it
-  sockc_flush(sc->c);
-  // hard fail the channel if we couldn't flush
-  if(sc->writing) chan_fail(sc->c,"overflow");
-}
-
-// tries to flush and end, cleans up/frees sc
+// flush anything buffered and end, then free
 sockc_t sockc_close(sockc_t sc)
 {
   if(!sc) return NULL;
-  sockc_shutdown(sc);
-  // remove channel reference
-  sc->c->arg = NULL;
-  sc->c->tick = NULL;
-  sc->c = NULL;
-  if(sc->readbuf) free(sc->readbuf);
-  if(sc->writebuf) free(sc->writebuf);
+  LOG("sockc close %d",chan_id(sc->c));
+
+  if(sc->c)
+  {
+    // send the end w/ the last of the data
+    while(sockc_chunk(sc, 1) && sc->writebuf.len);
+    chan_err(sc->c, "closed"); // local end so the link will free the channel
+    sockc_detach(sc);
+  }
+  sc->state = SOCKC_CLOSED;
+
+  lob_free(sc->pending);
   lob_free(sc->opts);
+  free(sc->readbuf.buf);
+  free(sc->writebuf.buf);
   free(sc);
   return NULL;
 }
 
-// -1 on err, returns bytes read into buf up to len
 int sockc_read(sockc_t sc, uint8_t *buf, int len)
 {
-  if(!sc || sc->state != SOCKC_OPEN) return -1;
-  if(len > (int)sc->readable) len = (int)sc->readable;
-  memcpy(buf,sc->readbuf,len);
-  sockc_zread(sc,len);
+  if(!sc || !buf || len < 0) return -1;
+  if(sc->state == SOCKC_CLOSED) return -1;
+  len = (int)ring_peek(&sc->readbuf, buf, (uint32_t)len);
+  sockc_zread(sc, len);
   return len;
 }
 
-// send just one chunk
-uint8_t sockc_chunk(sockc_t sc)
+int sockc_write(sockc_t sc, uint8_t *buf, int len)
 {
-  lob_t p;
-  uint32_t len;
-  if(!sc) return 0;
-  // if nothing to do, try sending an ack
-  if(!sc->readable && !sc->writing && sc->state == SOCKC_OPEN)
-  {
-    chan_ack(sc->c);
-    return 0;
-  }
-  // we've got something to say
-  len = sc->writing;
-  p = chan_packet(sc->c);
-  if(!p) return 0;
-  if(len > lob_space(p)) len = lob_space(p);
-  lob_append(p,sc->writebuf,len);
-  sc->writing -= len;
-  // optionally end with the last packet if we're closed
-  if(sc->state == SOCKC_CLOSED && !sc->writing) chan_end(sc->c,p);
-  else chan_send(sc->c,p);
-  memmove(sc->writebuf,sc->writebuf+len,sc->writing);
-  return 1;
+  if(!sc || !buf || len < 0) return -1;
+  if(sc->state == SOCKC_CLOSED || !sc->c) return -1;
+
+  len = (int)ring_put(&sc->writebuf, buf, (uint32_t)len);
+
+  // send any full packets right away, partial ones wait for a flush
+  while(sc->writebuf.len >= sc->mtu && sockc_chunk(sc, 0));
+
+  return len;
 }
 
-// flush current packet buffer out
-void sockc_flush(chan_t c)
+sockc_t sockc_flush(sockc_t sc)
 {
-  sockc_t sc;
-  if(!c) return;
-  if(!(sc = (sockc_t)c->arg)) return;
-  // send anything waiting
-  while(sockc_chunk(sc));
-  // come back again if there's more waiting
-  sc->c->tick = (sc->state == SOCKC_OPEN && sc->writing) ? sockc_flush : NULL;
+  if(!sc || !sc->c) return NULL;
+  while(sockc_chunk(sc, 0));
+  return sc;
 }
 
-// -1 on err, returns len and will always buffer up to len 
-int sockc_write(sockc_t sc, uint8_t *buf, int len)
+uint8_t *sockc_zpeek(sockc_t sc, uint32_t *len)
 {
-  uint8_t *writebuf;
-  if(!sc) return -1;
-  if(len <= 0) return len;
-
-  writebuf = realloc(sc->writebuf,sc->writing+len);
-  if(!writebuf) return -1;
-  sc->writebuf = writebuf;
-  memcpy(sc->writebuf+sc->writing,buf,len);
-  sc->writing += len;
-  sc->c->tick = sockc_flush; // create packet(s) during tick flush
-  
-  return len;
+  uint32_t part;
+  if(!sc || !len) return NULL;
+  part = sc->readbuf.size - sc->readbuf.at;
+  *len = (sc->readbuf.len < part) ? sc->readbuf.len : part;
+  return *len ? sc->readbuf.buf+sc->readbuf.at : NULL;
+}
+
+void sockc_zread(sockc_t sc, int len)
+{
+  if(!sc || len < 0) return;
+  ring_drop(&sc->readbuf, (uint32_t)len);
+
+  // make room for anything still queued, updates state
+  sockc_pull(sc);
 }
 
-int sockc_zwrite(sockc_t sc, int len)
+uint8_t *sockc_zwrite(sockc_t sc, uint32_t *len)
 {
-  uint8_t *writebuf;
-  if(!sc) return 0;
-  
-  // create requested writeable space at the end
-  writebuf = realloc(sc->writebuf,sc->writing+len);
-  if(!writebuf) return 0;
-  sc->writebuf = writebuf;
-  sc->zwrite = sc->writebuf + sc->writing;
-  return len;
+  uint32_t end, part;
+  if(!sc || !len) return NULL;
+  *len = 0;
+  if(sc->state == SOCKC_CLOSED || !sc->c) return NULL;
+  end = (sc->writebuf.at + sc->writebuf.len) % sc->writebuf.size;
+  part = (end < sc->writebuf.at || sc->writebuf.len == sc->writebuf.size) ? sc->writebuf.at - end : sc->writebuf.size - end;
+  *len = part;
+  return part ? sc->writebuf.buf+end : NULL;
 }
 
-// advance the written after using zwrite
 int sockc_zwritten(sockc_t sc, int len)
 {
-  if(!sc) return -1;
-  if(len > 0)
-  {
-    sc->writing += len;
-    sc->c->tick = sockc_flush; // create packet(s) during tick flush
-  }
-  sc->zwrite = NULL;
+  if(!sc || len < 0) return -1;
+  if((uint32_t)len > sc->writebuf.size - sc->writebuf.len) len = (int)(sc->writebuf.size - sc->writebuf.len);
+  sc->writebuf.len += (uint32_t)len;
+  while(sc->writebuf.len >= sc->mtu && sockc_chunk(sc, 0));
   return len;
 }
 
-// advance the read buf, useful when accessing it directly for zero-copy
-void sockc_zread(sockc_t sc, int len)
+int sockc_available(sockc_t sc)
 {
-  if(!sc || len == 0) return;
-    // incoming error causes close/fail
-  if(len < 0)
-  {
-    DEBUG_PRINTF("sockc read error %d",len);
-    len = sc->readable;
-    sockc_shutdown(sc);
-  }
-  
-  // zero out given read buffer
-  if(len > (int)sc->readable) len = (int)sc->readable;
-  sc->readable -= (uint32_t)len;
-  memmove(sc->readbuf,sc->readbuf+len,sc->readable);
-  if(!(sc->readbuf = realloc(sc->readbuf,sc->readable))) sc->readable = 0;
-  
-  // more data to read yet
-  if(sc->readable) return; 
-  
-  // if the channel is ending and the data all read, the sock is now closed
-  if(sc->c->ended) sockc_shutdown(sc);
-
-  // always try to flush when done reading, sends ack
-  sockc_flush(sc->c);
+  if(!sc || sc->state == SOCKC_CLOSED) return -1;
+  return (int)sc->readbuf.len;
 }
 
-int sockc_available(sockc_t sc)
+int sockc_writeable(sockc_t sc)
 {
-  if(!sc || sc->state != SOCKC_OPEN) return -1;
-  return (int)sc->readable;
+  if(!sc || sc->state == SOCKC_CLOSED || !sc->c) return -1;
+  return (int)(sc->writebuf.size - sc->writebuf.len);
 }
 
-uint8_t sockc_sread(sockc_t sc)
+int sockc_sread(sockc_t sc)
 {
-  // TODO
-  return 0;
+  uint8_t byte;
+  if(sockc_read(sc, &byte, 1) != 1) return -1;
+  return byte;
 }
 
-uint8_t sockc_swrite(sockc_t sc, uint8_t byte)
+int sockc_swrite(sockc_t sc, uint8_t byte)
 {
-  // TODO
-  return 0;
+  return sockc_write(sc, &byte, 1);
 }
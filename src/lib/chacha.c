@@ -111,7 +111,8 @@ void chacha_ivsetup (chacha_ctx *x, const u8 *iv, const u8 *counter)
 	x->input[15] = U8TO32_LITTLE(iv + 4);
 }
 
-void chacha_encrypt_bytes (chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
+// the original scalar code, also the reference the simd cores are checked against
+static void chacha_encrypt_ref (chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
 {
 	u32 x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
 	u32 j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
@@ -245,6 +246,281 @@ void chacha_encrypt_bytes (chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
 	}
 }
 
+// wide cores, each computes a group of blocks in parallel w/ one state word per register
+// they only run whole groups and never carry the counter into input[13], the scalar code does the rest
+
+#ifndef CHACHA_NO_SIMD
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CHACHA_X86
+#include <immintrin.h>
+#endif
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__ARM_BIG_ENDIAN)
+#define CHACHA_NEON_OK
+#include <arm_neon.h>
+#endif
+#endif
+
+#define DOUBLEROUND(QR,x) \
+  QR(x[0], x[4], x[ 8], x[12]) \
+  QR(x[1], x[5], x[ 9], x[13]) \
+  QR(x[2], x[6], x[10], x[14]) \
+  QR(x[3], x[7], x[11], x[15]) \
+  QR(x[0], x[5], x[10], x[15]) \
+  QR(x[1], x[6], x[11], x[12]) \
+  QR(x[2], x[7], x[ 8], x[13]) \
+  QR(x[3], x[4], x[ 9], x[14])
+
+#ifdef CHACHA_X86
+
+#define SSE_ROTL(v,n) _mm_or_si128(_mm_slli_epi32(v,n), _mm_srli_epi32(v,32-(n)))
+#define SSE_QR(a,b,c,d) \
+  a = _mm_add_epi32(a,b); d = SSE_ROTL(_mm_xor_si128(d,a),16); \
+  c = _mm_add_epi32(c,d); b = SSE_ROTL(_mm_xor_si128(b,c),12); \
+  a = _mm_add_epi32(a,b); d = SSE_ROTL(_mm_xor_si128(d,a), 8); \
+  c = _mm_add_epi32(c,d); b = SSE_ROTL(_mm_xor_si128(b,c), 7);
+#define SSE_XOR16(v,off) \
+  _mm_storeu_si128((__m128i *)(c+(off)), _mm_xor_si128(v, _mm_loadu_si128((const __m128i *)(m+(off)))))
+
+// 4 blocks per 256 bytes
+__attribute__((target("sse2")))
+static void chacha_blocks_sse2 (const u32 *input, const u8 *m, u8 *c, u32 blocks)
+{
+  __m128i s[16], x[16], t0, t1, t2, t3;
+  u32 ctr = input[12];
+  int i, k;
+
+  for(i=0;i<16;i++) s[i] = _mm_set1_epi32((int)input[i]);
+  for(; blocks >= 4; blocks -= 4, ctr += 4, m += 256, c += 256)
+  {
+    s[12] = _mm_add_epi32(_mm_set1_epi32((int)ctr), _mm_set_epi32(3,2,1,0));
+    for(i=0;i<16;i++) x[i] = s[i];
+    for(i=0;i<10;i++)
+    {
+      DOUBLEROUND(SSE_QR,x)
+    }
+    for(i=0;i<16;i++) x[i] = _mm_add_epi32(x[i],s[i]);
+
+    // transpose each 4 words so every register is 16 bytes of one block
+    for(k=0;k<16;k+=4)
+    {
+      t0 = _mm_unpacklo_epi32(x[k],x[k+1]);
+      t1 = _mm_unpacklo_epi32(x[k+2],x[k+3]);
+      t2 = _mm_unpackhi_epi32(x[k],x[k+1]);
+      t3 = _mm_unpackhi_epi32(x[k+2],x[k+3]);
+      SSE_XOR16(_mm_unpacklo_epi64(t0,t1), 4*k);
+      SSE_XOR16(_mm_unpackhi_epi64(t0,t1), 64+4*k);
+      SSE_XOR16(_mm_unpacklo_epi64(t2,t3), 128+4*k);
+      SSE_XOR16(_mm_unpackhi_epi64(t2,t3), 192+4*k);
+    }
+  }
+}
+
+#define AVX_ROTL(v,n) _mm256_or_si256(_mm256_slli_epi32(v,n), _mm256_srli_epi32(v,32-(n)))
+#define AVX_QR(a,b,c,d) \
+  a = _mm256_add_epi32(a,b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d,a),r16); \
+  c = _mm256_add_epi32(c,d); b = AVX_ROTL(_mm256_xor_si256(b,c),12); \
+  a = _mm256_add_epi32(a,b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d,a),r8); \
+  c = _mm256_add_epi32(c,d); b = AVX_ROTL(_mm256_xor_si256(b,c), 7);
+#define AVX_XOR16(v,off) \
+  _mm_storeu_si128((__m128i *)(c+(off)), _mm_xor_si128(v, _mm_loadu_si128((const __m128i *)(m+(off)))))
+
+// 8 blocks per 512 bytes, the unpacks work per 128-bit lane so the high half is blocks 4-7
+__attribute__((target("avx2")))
+static void chacha_blocks_avx2 (const u32 *input, const u8 *m, u8 *c, u32 blocks)
+{
+  __m256i s[16], x[16], t0, t1, t2, t3, v;
+  const __m256i r16 = _mm256_set_epi8(13,12,15,14,9,8,11,10,5,4,7,6,1,0,3,2,13,12,15,14,9,8,11,10,5,4,7,6,1,0,3,2);
+  const __m256i r8 = _mm256_set_epi8(14,13,12,15,10,9,8,11,6,5,4,7,2,1,0,3,14,13,12,15,10,9,8,11,6,5,4,7,2,1,0,3);
+  u32 ctr = input[12];
+  int i, k;
+
+  for(i=0;i<16;i++) s[i] = _mm256_set1_epi32((int)input[i]);
+  for(; blocks >= 8; blocks -= 8, ctr += 8, m += 512, c += 512)
+  {
+    s[12] = _mm256_add_epi32(_mm256_set1_epi32((int)ctr), _mm256_set_epi32(7,6,5,4,3,2,1,0));
+    for(i=0;i<16;i++) x[i] = s[i];
+    for(i=0;i<10;i++)
+    {
+      DOUBLEROUND(AVX_QR,x)
+    }
+    for(i=0;i<16;i++) x[i] = _mm256_add_epi32(x[i],s[i]);
+
+    for(k=0;k<16;k+=4)
+    {
+      t0 = _mm256_unpacklo_epi32(x[k],x[k+1]);
+      t1 = _mm256_unpacklo_epi32(x[k+2],x[k+3]);
+      t2 = _mm256_unpackhi_epi32(x[k],x[k+1]);
+      t3 = _mm256_unpackhi_epi32(x[k+2],x[k+3]);
+      v = _mm256_unpacklo_epi64(t0,t1);
+      AVX_XOR16(_mm256_castsi256_si128(v), 4*k);
+      AVX_XOR16(_mm256_extracti128_si256(v,1), 256+4*k);
+      v = _mm256_unpackhi_epi64(t0,t1);
+      AVX_XOR16(_mm256_castsi256_si128(v), 64+4*k);
+      AVX_XOR16(_mm256_extracti128_si256(v,1), 320+4*k);
+      v = _mm256_unpacklo_epi64(t2,t3);
+      AVX_XOR16(_mm256_castsi256_si128(v), 128+4*k);
+      AVX_XOR16(_mm256_extracti128_si256(v,1), 384+4*k);
+      v = _mm256_unpackhi_epi64(t2,t3);
+      AVX_XOR16(_mm256_castsi256_si128(v), 192+4*k);
+      AVX_XOR16(_mm256_extracti128_si256(v,1), 448+4*k);
+    }
+  }
+}
+
+#endif // CHACHA_X86
+
+#ifdef CHACHA_NEON_OK
+
+#define NEON_ROTL(v,n) vsriq_n_u32(vshlq_n_u32(v,n), v, 32-(n))
+#define NEON_ROTL16(v) vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(v)))
+#define NEON_QR(a,b,c,d) \
+  a = vaddq_u32(a,b); d = NEON_ROTL16(veorq_u32(d,a)); \
+  c = vaddq_u32(c,d); b = NEON_ROTL(veorq_u32(b,c),12); \
+  a = vaddq_u32(a,b); d = NEON_ROTL(veorq_u32(d,a), 8); \
+  c = vaddq_u32(c,d); b = NEON_ROTL(veorq_u32(b,c), 7);
+#define NEON_XOR16(v,off) \
+  vst1q_u8(c+(off), veorq_u8(vreinterpretq_u8_u32(v), vld1q_u8(m+(off))))
+
+// 4 blocks per 256 bytes
+static void chacha_blocks_neon (const u32 *input, const u8 *m, u8 *c, u32 blocks)
+{
+  static const u32 lanes[4] = {0,1,2,3};
+  uint32x4_t s[16], x[16];
+  uint32x4x2_t p01, p23;
+  u32 ctr = input[12];
+  int i, k;
+
+  for(i=0;i<16;i++) s[i] = vdupq_n_u32(input[i]);
+  for(; blocks >= 4; blocks -= 4, ctr += 4, m += 256, c += 256)
+  {
+    s[12] = vaddq_u32(vdupq_n_u32(ctr), vld1q_u32(lanes));
+    for(i=0;i<16;i++) x[i] = s[i];
+    for(i=0;i<10;i++)
+    {
+      DOUBLEROUND(NEON_QR,x)
+    }
+    for(i=0;i<16;i++) x[i] = vaddq_u32(x[i],s[i]);
+
+    for(k=0;k<16;k+=4)
+    {
+      p01 = vtrnq_u32(x[k],x[k+1]);
+      p23 = vtrnq_u32(x[k+2],x[k+3]);
+      NEON_XOR16(vcombine_u32(vget_low_u32(p01.val[0]), vget_low_u32(p23.val[0])), 4*k);
+      NEON_XOR16(vcombine_u32(vget_low_u32(p01.val[1]), vget_low_u32(p23.val[1])), 64+4*k);
+      NEON_XOR16(vcombine_u32(vget_high_u32(p01.val[0]), vget_high_u32(p23.val[0])), 128+4*k);
+      NEON_XOR16(vcombine_u32(vget_high_u32(p01.val[1]), vget_high_u32(p23.val[1])), 192+4*k);
+    }
+  }
+}
+
+#endif // CHACHA_NEON_OK
+
+// each core w/ how many blocks it does at once, ref has none and only finishes the tail
+typedef struct chacha_core_struct
+{
+  uint8_t id;
+  void (*blocks)(const u32 *input, const u8 *m, u8 *c, u32 blocks);
+  u32 width;
+} chacha_core_s;
+
+static const chacha_core_s chacha_cores[] = {
+  {CHACHA_REF, NULL, 0},
+#ifdef CHACHA_X86
+  {CHACHA_SSE2, chacha_blocks_sse2, 4},
+  {CHACHA_AVX2, chacha_blocks_avx2, 8},
+#endif
+#ifdef CHACHA_NEON_OK
+  {CHACHA_NEON, chacha_blocks_neon, 4},
+#endif
+};
+
+// the active core, picked on first use and swapped as a whole so any thread sees blocks w/ its own width
+static const chacha_core_s *chacha_active = NULL;
+
+static uint8_t chacha_supported (uint8_t core)
+{
+  switch(core)
+  {
+    case CHACHA_REF:
+      return 1;
+#ifdef CHACHA_X86
+    case CHACHA_SSE2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse2") ? 1 : 0;
+    case CHACHA_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+#ifdef CHACHA_NEON_OK
+    case CHACHA_NEON:
+      return 1;
+#endif
+  }
+  return 0;
+}
+
+uint8_t chacha20_core (uint8_t core)
+{
+  u32 i;
+
+  // best first
+  if(core == CHACHA_AUTO)
+  {
+    if(chacha_supported(CHACHA_AVX2)) core = CHACHA_AVX2;
+    else if(chacha_supported(CHACHA_NEON)) core = CHACHA_NEON;
+    else if(chacha_supported(CHACHA_SSE2)) core = CHACHA_SSE2;
+    else core = CHACHA_REF;
+  }
+  if(!chacha_supported(core)) core = CHACHA_REF;
+
+  for(i=0;i<sizeof(chacha_cores)/sizeof(chacha_cores[0]);i++) if(chacha_cores[i].id == core)
+  {
+    __atomic_store_n(&chacha_active, &chacha_cores[i], __ATOMIC_RELEASE);
+    break;
+  }
+  return core;
+}
+
+const char *chacha20_core_name (uint8_t core)
+{
+  switch(core)
+  {
+    case CHACHA_REF: return "ref";
+    case CHACHA_SSE2: return "sse2";
+    case CHACHA_AVX2: return "avx2";
+    case CHACHA_NEON: return "neon";
+  }
+  return "auto";
+}
+
+void chacha_encrypt_bytes (chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
+{
+  const chacha_core_s *core;
+  u32 blocks;
+
+  if(!(core = __atomic_load_n(&chacha_active, __ATOMIC_ACQUIRE)))
+  {
+    chacha20_core(CHACHA_AUTO);
+    core = __atomic_load_n(&chacha_active, __ATOMIC_ACQUIRE);
+  }
+
+  // whole groups go wide as long as the 32-bit counter doesn't wrap in them
+  if(core->blocks && bytes >= core->width * 64)
+  {
+    blocks = (bytes / 64) - ((bytes / 64) % core->width);
+    if(x->input[12] <= 0xffffffff - blocks)
+    {
+      core->blocks(x->input, m, c, blocks);
+      x->input[12] += blocks;
+      m += blocks * 64;
+      c += blocks * 64;
+      bytes -= blocks * 64;
+    }
+  }
+
+  chacha_encrypt_ref(x, m, c, bytes);
+}
+
 
 uint8_t *chacha20(uint8_t *key, uint8_t *nonce, uint8_t *bytes, uint32_t len)
 {
@@ -258,4 +534,20 @@ uint8_t *chacha20(uint8_t *key, uint8_t *nonce, uint8_t *bytes, uint32_t len)
   return bytes;
 }
 
+// RFC 8439 layout, 32-bit block counter and 96-bit nonce
+uint8_t *chacha20_ietf(uint8_t *key, uint8_t *nonce, uint32_t counter, uint8_t *bytes, uint32_t len)
+{
+  struct chacha_ctx ctx;
+  if(!len) return bytes;
+
+  chacha_keysetup (&ctx, key, 32 * 8);
+  ctx.input[12] = counter;
+  ctx.input[13] = U8TO32_LITTLE(nonce + 0);
+  ctx.input[14] = U8TO32_LITTLE(nonce + 4);
+  ctx.input[15] = U8TO32_LITTLE(nonce + 8);
+
+  chacha_encrypt_bytes (&ctx, bytes, bytes, len);
+  return bytes;
+}
+
 #undef ROTL32
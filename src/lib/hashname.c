@@ -9,8 +9,8 @@
 // how many csids can be used to make a hashname
 #define MAX_CSIDS 8
 
-// v* methods return this
-static struct hashname_struct hn_vtmp;
+// v* methods return this, one per thread
+static UTIL_TLS struct hashname_struct hn_vtmp;
 
 hashname_t hashname_dup(hashname_t id)
 {
@@ -28,29 +28,40 @@ hashname_t hashname_free(hashname_t hn)
   return NULL;
 }
 
-// validate a str is a base32 hashname, returns TEMPORARY hashname
-hashname_t hashname_vchar(const char *str)
+// validate a str is a base32 hashname into out
+hashname_t hashname_vchar_r(const char *str, hashname_t out)
 {
-  if(!str) return NULL;
+  if(!str || !out) return NULL;
   // decode will stop reading the first non-b32 char it sees, like a \0
-  if(base32_decode(str,52,hn_vtmp.bin,32) != 32) return NULL;
-  return &hn_vtmp;
+  if(base32_decode(str,52,out->bin,32) != 32) return NULL;
+  return out;
+}
+
+// returns TEMPORARY hashname
+hashname_t hashname_vchar(const char *str)
+{
+  return hashname_vchar_r(str, &hn_vtmp);
+}
+
+hashname_t hashname_vbin_r(const uint8_t *bin, hashname_t out)
+{
+  if(!bin || !out) return NULL;
+  memmove(out->bin,bin,32);
+  return out;
 }
 
 hashname_t hashname_vbin(const uint8_t *bin)
 {
-  if(!bin) return NULL;
-  memcpy(&hn_vtmp,bin,32);
-  return &hn_vtmp;
+  return hashname_vbin_r(bin, &hn_vtmp);
 }
 
-// temp hashname from intermediate values as hex/base32 key/value pairs
-hashname_t hashname_vkey(lob_t key, uint8_t csid)
+// hashname from intermediate values as hex/base32 key/value pairs
+hashname_t hashname_vkey_r(lob_t key, uint8_t csid, hashname_t out)
 {
   unsigned int i, start;
   uint8_t hash[64];
   char *id, *value, hexid[3];
-  if(!key) return LOG("invalid args");
+  if(!key || !out) return LOG("invalid args");
   util_hex(&csid, 1, hexid);
   memset(hash,0,64);
 
@@ -85,21 +96,31 @@ hashname_t hashname_vkey(lob_t key, uint8_t csid)
   if(!keys) return LOG("no keys found in %s",lob_json(key));
   if(!i || i % 2 != 0) return LOG("invalid keys %d",i);
   
-  return hashname_vbin(hash);
+  return hashname_vbin_r(hash, out);
 }
 
-hashname_t hashname_vkeys(lob_t keys)
+hashname_t hashname_vkey(lob_t key, uint8_t csid)
+{
+  return hashname_vkey_r(key, csid, &hn_vtmp);
+}
+
+hashname_t hashname_vkeys_r(lob_t keys, hashname_t out)
 {
   hashname_t hn;
   lob_t im;
 
-  if(!keys) return LOG("bad args");
+  if(!keys || !out) return LOG("bad args");
   im = hashname_im(keys,0);
-  hn = hashname_vkey(im,0);
+  hn = hashname_vkey_r(im,0,out);
   lob_free(im);
   return hn;
 }
 
+hashname_t hashname_vkeys(lob_t keys)
+{
+  return hashname_vkeys_r(keys, &hn_vtmp);
+}
+
 // accessors
 uint8_t *hashname_bin(hashname_t hn)
 {
@@ -107,13 +128,19 @@ uint8_t *hashname_bin(hashname_t hn)
   return hn->bin;
 }
 
-// 52 byte base32 string w/ \0 (TEMPORARY)
-static char hn_ctmp[53];
+// 52 byte base32 string w/ \0 into out
+char *hashname_char_r(hashname_t hn, char *out)
+{
+  if(!hn || !out) return NULL;
+  base32_encode(hn->bin,32,out,53);
+  return out;
+}
+
+// (TEMPORARY)
+static UTIL_TLS char hn_ctmp[53];
 char *hashname_char(hashname_t hn)
 {
-  if(!hn) return NULL;
-  base32_encode(hn->bin,32,hn_ctmp,53);
-  return hn_ctmp;
+  return hashname_char_r(hn, hn_ctmp);
 }
 
 int hashname_cmp(hashname_t a, hashname_t b)
@@ -185,14 +212,20 @@ lob_t hashname_im(lob_t keys, uint8_t id)
 
 // working with short hashnames (5 bin bytes, 8 char bytes)
 
-// 8 byte base32 string w/ \0 (TEMPORARY)
+// 8 byte base32 string w/ \0 into out (9 bytes)
+char *hashname_short_r(hashname_t hn, char *out)
+{
+  if(!hn || !out) return NULL;
+  base32_encode(hn->bin,5,out,9);
+  return out;
+}
+
+// (TEMPORARY)
 char *hashname_short(hashname_t hn)
 {
-  static uint8_t tog = 1;
-  if(!hn) return NULL;
+  static UTIL_TLS uint8_t tog = 1;
   tog = tog ? 0 : 26; // fit two short names in hn_ctmp for easier LOG() args
-  base32_encode(hn->bin,5,hn_ctmp+tog,53-tog);
-  return hn_ctmp+tog;
+  return hashname_short_r(hn, hn_ctmp+tog);
 }
 
 
@@ -204,20 +237,32 @@ int hashname_scmp(hashname_t a, hashname_t b)
 }
 
 
+hashname_t hashname_schar_r(const char *str, hashname_t out)
+{
+  if(!str || !out) return NULL;
+  memset(out->bin,0,32);
+  if(base32_decode(str,8,out->bin,5) != 5) return NULL;
+  return out;
+}
+
 hashname_t hashname_schar(const char *str)
 {
-  if(!str) return NULL;
-  memset(hn_vtmp.bin,0,32);
-  if(base32_decode(str,8,hn_vtmp.bin,5) != 5) return NULL;
-  return &hn_vtmp;
+  return hashname_schar_r(str, &hn_vtmp);
+}
+
+hashname_t hashname_sbin_r(const uint8_t *bin, hashname_t out)
+{
+  uint8_t tmp[5];
+  if(!bin || !out) return NULL;
+  memcpy(tmp,bin,5); // bin may be in out
+  memset(out->bin,0,32);
+  memcpy(out->bin,tmp,5);
+  return out;
 }
 
 hashname_t hashname_sbin(const uint8_t *bin)
 {
-  if(!bin) return NULL;
-  memset(hn_vtmp.bin,0,32);
-  memcpy(hn_vtmp.bin,bin,5);
-  return &hn_vtmp;
+  return hashname_sbin_r(bin, &hn_vtmp);
 }
 
 // NULL unless is short
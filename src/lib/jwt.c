@@ -122,6 +122,45 @@ lob_t jwt_verify(lob_t token, e3x_exchange_t x)
   return token;
 }
 
+// same as jwt_verify on each, but the signatures are validated together
+uint32_t jwt_verify_batch(lob_t *tokens, e3x_exchange_t *xs, uint8_t *valid, uint32_t count)
+{
+  lob_t claims[E3X_BATCH];
+  char *encoded[E3X_BATCH];
+  uint8_t *data[E3X_BATCH], errs[E3X_BATCH];
+  size_t lens[E3X_BATCH];
+  uint32_t i, n, done, ok = 0;
+
+  if(!tokens || !valid) return 0;
+  for(done = 0; done < count; done += n)
+  {
+    n = (count - done < E3X_BATCH) ? count - done : E3X_BATCH;
+
+    // generate the temporary encoded data for each
+    for(i = 0; i < n; i++)
+    {
+      char *dot = NULL;
+      claims[i] = jwt_claims(tokens[done+i]);
+      encoded[i] = (tokens[done+i] && claims[i]) ? jwt_encode(tokens[done+i]) : NULL;
+      if(encoded[i] && (dot = strchr(encoded[i],'.'))) dot = strchr(dot+1,'.');
+      data[i] = (uint8_t*)encoded[i];
+      lens[i] = dot ? (size_t)(dot - encoded[i]) : 0;
+    }
+
+    e3x_exchange_validate_batch(xs ? xs+done : NULL, tokens+done, claims, data, lens, errs, n);
+
+    for(i = 0; i < n; i++)
+    {
+      free(encoded[i]);
+      valid[done+i] = (errs[i] == 0) ? 1 : 0;
+      if(valid[done+i]) ok++;
+      else LOG("validate failed: %d",errs[i]);
+    }
+  }
+
+  return ok;
+}
+
 // sign this token, adds signature to the claims body
 lob_t jwt_sign(lob_t token, e3x_self_t self)
 {
@@ -95,10 +95,12 @@ lob_t lob_parse(const uint8_t *raw, size_t len)
   hlen = util_sys_short(nlen);
   if(hlen > len - 2) return LOG_DEBUG("invalid head len");
 
+  lob_t p;
   uint8_t *raw2 = NULL;
   if(!(raw2 = malloc(len))) return LOG_DEBUG("OOM");
   memcpy(raw2,raw,len);
-  return lob_direct(raw2, len); 
+  TRACE(UTIL_TRACE_PARSE, p = lob_direct(raw2, len));
+  return p;
 }
 
 lob_t lob_direct(uint8_t *raw, size_t len)
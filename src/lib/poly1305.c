@@ -0,0 +1,251 @@
+#include <string.h>
+#include "poly1305.h"
+#include "chacha.h"
+
+// poly1305 after the public domain poly1305-donna 32bit version (Andrew Moon)
+
+#define U8TO32(p) \
+  (((uint32_t)((p)[0])) | ((uint32_t)((p)[1]) << 8) | \
+   ((uint32_t)((p)[2]) << 16) | ((uint32_t)((p)[3]) << 24))
+
+static void U32TO8(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v);
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+void poly1305_init(poly1305_s *st, const uint8_t *key)
+{
+  // r &= 0xffffffc0ffffffc0ffffffc0fffffff
+  st->r[0] = (U8TO32(&key[ 0])     ) & 0x3ffffff;
+  st->r[1] = (U8TO32(&key[ 3]) >> 2) & 0x3ffff03;
+  st->r[2] = (U8TO32(&key[ 6]) >> 4) & 0x3ffc0ff;
+  st->r[3] = (U8TO32(&key[ 9]) >> 6) & 0x3f03fff;
+  st->r[4] = (U8TO32(&key[12]) >> 8) & 0x00fffff;
+
+  memset(st->h,0,sizeof(st->h));
+
+  st->pad[0] = U8TO32(&key[16]);
+  st->pad[1] = U8TO32(&key[20]);
+  st->pad[2] = U8TO32(&key[24]);
+  st->pad[3] = U8TO32(&key[28]);
+
+  st->leftover = 0;
+  st->final = 0;
+}
+
+static void poly1305_blocks(poly1305_s *st, const uint8_t *m, size_t len)
+{
+  const uint32_t hibit = st->final ? 0 : (1UL << 24); // 1 << 128
+  uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+  uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+  uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+  uint64_t d0, d1, d2, d3, d4;
+  uint32_t c;
+
+  while(len >= 16)
+  {
+    // h += m[i]
+    h0 += (U8TO32(m+ 0)     ) & 0x3ffffff;
+    h1 += (U8TO32(m+ 3) >> 2) & 0x3ffffff;
+    h2 += (U8TO32(m+ 6) >> 4) & 0x3ffffff;
+    h3 += (U8TO32(m+ 9) >> 6) & 0x3ffffff;
+    h4 += (U8TO32(m+12) >> 8) | hibit;
+
+    // h *= r
+    d0 = ((uint64_t)h0 * r0) + ((uint64_t)h1 * s4) + ((uint64_t)h2 * s3) + ((uint64_t)h3 * s2) + ((uint64_t)h4 * s1);
+    d1 = ((uint64_t)h0 * r1) + ((uint64_t)h1 * r0) + ((uint64_t)h2 * s4) + ((uint64_t)h3 * s3) + ((uint64_t)h4 * s2);
+    d2 = ((uint64_t)h0 * r2) + ((uint64_t)h1 * r1) + ((uint64_t)h2 * r0) + ((uint64_t)h3 * s4) + ((uint64_t)h4 * s3);
+    d3 = ((uint64_t)h0 * r3) + ((uint64_t)h1 * r2) + ((uint64_t)h2 * r1) + ((uint64_t)h3 * r0) + ((uint64_t)h4 * s4);
+    d4 = ((uint64_t)h0 * r4) + ((uint64_t)h1 * r3) + ((uint64_t)h2 * r2) + ((uint64_t)h3 * r1) + ((uint64_t)h4 * r0);
+
+    // (partial) h %= p
+                  c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+    d1 += c;      c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+    d2 += c;      c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+    d3 += c;      c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+    d4 += c;      c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+    h0 += c * 5;  c = (h0 >> 26); h0 = h0 & 0x3ffffff;
+    h1 += c;
+
+    m += 16;
+    len -= 16;
+  }
+
+  st->h[0] = h0;
+  st->h[1] = h1;
+  st->h[2] = h2;
+  st->h[3] = h3;
+  st->h[4] = h4;
+}
+
+void poly1305_update(poly1305_s *st, const uint8_t *m, size_t len)
+{
+  size_t want;
+
+  if(!m || !len) return;
+
+  // finish any partial block first
+  if(st->leftover)
+  {
+    want = 16 - st->leftover;
+    if(want > len) want = len;
+    memcpy(st->buffer+st->leftover, m, want);
+    len -= want;
+    m += want;
+    st->leftover += (uint8_t)want;
+    if(st->leftover < 16) return;
+    poly1305_blocks(st, st->buffer, 16);
+    st->leftover = 0;
+  }
+
+  // process full blocks directly
+  if(len >= 16)
+  {
+    want = len & ~(size_t)15;
+    poly1305_blocks(st, m, want);
+    m += want;
+    len -= want;
+  }
+
+  // keep the rest
+  if(len)
+  {
+    memcpy(st->buffer+st->leftover, m, len);
+    st->leftover += (uint8_t)len;
+  }
+}
+
+void poly1305_finish(poly1305_s *st, uint8_t *mac)
+{
+  uint32_t h0, h1, h2, h3, h4, c;
+  uint32_t g0, g1, g2, g3, g4;
+  uint64_t f;
+  uint32_t mask;
+
+  // process the remaining block
+  if(st->leftover)
+  {
+    st->buffer[st->leftover] = 1;
+    memset(st->buffer+st->leftover+1, 0, 16-st->leftover-1);
+    st->final = 1;
+    poly1305_blocks(st, st->buffer, 16);
+  }
+
+  // fully carry h
+  h0 = st->h[0];
+  h1 = st->h[1];
+  h2 = st->h[2];
+  h3 = st->h[3];
+  h4 = st->h[4];
+
+               c = h1 >> 26; h1 = h1 & 0x3ffffff;
+  h2 +=     c; c = h2 >> 26; h2 = h2 & 0x3ffffff;
+  h3 +=     c; c = h3 >> 26; h3 = h3 & 0x3ffffff;
+  h4 +=     c; c = h4 >> 26; h4 = h4 & 0x3ffffff;
+  h0 += c * 5; c = h0 >> 26; h0 = h0 & 0x3ffffff;
+  h1 +=     c;
+
+  // compute h + -p
+  g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+  g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+  g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+  g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+  g4 = h4 + c - (1UL << 26);
+
+  // select h if h < p, or h + -p if h >= p, in constant time
+  mask = (g4 >> 31) - 1;
+  g0 &= mask;
+  g1 &= mask;
+  g2 &= mask;
+  g3 &= mask;
+  g4 &= mask;
+  mask = ~mask;
+  h0 = (h0 & mask) | g0;
+  h1 = (h1 & mask) | g1;
+  h2 = (h2 & mask) | g2;
+  h3 = (h3 & mask) | g3;
+  h4 = (h4 & mask) | g4;
+
+  // h = h % (2^128)
+  h0 = ((h0      ) | (h1 << 26)) & 0xffffffff;
+  h1 = ((h1 >>  6) | (h2 << 20)) & 0xffffffff;
+  h2 = ((h2 >> 12) | (h3 << 14)) & 0xffffffff;
+  h3 = ((h3 >> 18) | (h4 <<  8)) & 0xffffffff;
+
+  // mac = (h + pad) % (2^128)
+  f = (uint64_t)h0 + st->pad[0]            ; h0 = (uint32_t)f;
+  f = (uint64_t)h1 + st->pad[1] + (f >> 32); h1 = (uint32_t)f;
+  f = (uint64_t)h2 + st->pad[2] + (f >> 32); h2 = (uint32_t)f;
+  f = (uint64_t)h3 + st->pad[3] + (f >> 32); h3 = (uint32_t)f;
+
+  U32TO8(mac +  0, h0);
+  U32TO8(mac +  4, h1);
+  U32TO8(mac +  8, h2);
+  U32TO8(mac + 12, h3);
+
+  // zero out the state
+  memset(st, 0, sizeof(poly1305_s));
+}
+
+uint8_t *poly1305(const uint8_t *key, const uint8_t *m, size_t len, uint8_t *mac)
+{
+  poly1305_s st;
+  poly1305_init(&st, key);
+  poly1305_update(&st, m, len);
+  poly1305_finish(&st, mac);
+  return mac;
+}
+
+// the AEAD tag covers aad and ciphertext, each zero padded to 16, then both lengths
+static void aead_tag(uint8_t *key, uint8_t *nonce, const uint8_t *aad, size_t aad_len, const uint8_t *bytes, uint32_t len, uint8_t *tag)
+{
+  static const uint8_t zeros[16] = {0};
+  uint8_t otk[64], lens[16];
+  poly1305_s st;
+  uint8_t i;
+
+  // one-time key is the first half of block 0
+  memset(otk, 0, 64);
+  chacha20_ietf(key, nonce, 0, otk, 64);
+  poly1305_init(&st, otk);
+  memset(otk, 0, 64);
+
+  poly1305_update(&st, aad, aad_len);
+  if(aad_len % 16) poly1305_update(&st, zeros, 16 - (aad_len % 16));
+  poly1305_update(&st, bytes, len);
+  if(len % 16) poly1305_update(&st, zeros, 16 - (len % 16));
+  for(i=0;i<8;i++)
+  {
+    lens[i] = (uint8_t)((uint64_t)aad_len >> (8*i));
+    lens[8+i] = (uint8_t)((uint64_t)len >> (8*i));
+  }
+  poly1305_update(&st, lens, 16);
+  poly1305_finish(&st, tag);
+}
+
+uint8_t chacha20poly1305_seal(uint8_t *key, uint8_t *nonce, const uint8_t *aad, size_t aad_len, uint8_t *bytes, uint32_t len, uint8_t *tag)
+{
+  if(!key || !nonce || !tag || (len && !bytes) || (aad_len && !aad)) return 0;
+  chacha20_ietf(key, nonce, 1, bytes, len);
+  aead_tag(key, nonce, aad, aad_len, bytes, len, tag);
+  return 1;
+}
+
+uint8_t chacha20poly1305_open(uint8_t *key, uint8_t *nonce, const uint8_t *aad, size_t aad_len, uint8_t *bytes, uint32_t len, const uint8_t *tag)
+{
+  uint8_t check[POLY1305_TAGLEN], diff = 0;
+  uint8_t i;
+
+  if(!key || !nonce || !tag || (len && !bytes) || (aad_len && !aad)) return 0;
+  aead_tag(key, nonce, aad, aad_len, bytes, len, check);
+
+  // constant time compare
+  for(i=0;i<POLY1305_TAGLEN;i++) diff |= check[i] ^ tag[i];
+  if(diff) return 0;
+
+  chacha20_ietf(key, nonce, 1, bytes, len);
+  return 1;
+}
@@ -473,7 +473,7 @@ uint32_t      okm_len
 {
   uint32_t hash_len;
   uint32_t N;
-  uint8_t T[SHA256_DIGEST_SIZE];
+  uint8_t T[SHA256_DIGEST_SIZE] = {0};
   uint32_t Tlen;
   uint32_t pos;
   uint32_t i;
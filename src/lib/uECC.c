@@ -912,19 +912,236 @@ static uECC_word_t regularize_k(const uECC_word_t * const k,
     return carry;
 }
 
-static uECC_word_t EccPoint_compute_public_key(uECC_word_t *result,
-                                               uECC_word_t *private,
-                                               uECC_Curve curve) {
+#if uECC_FIXED_BASE_COMB && uECC_SUPPORTS_secp256r1
+
+/* Fixed-base comb for the secp256r1 generator (Lim-Lee, uECC_COMB_TABLES tables of
+   2^uECC_COMB_TEETH affine points). The 256-bit scalar is split into uECC_COMB_TEETH spans of
+   uECC_COMB_SPAN bits, each span into uECC_COMB_TABLES blocks of uECC_COMB_COLS bits, and
+   table s entry j = sum over the set bits t of j of 2^(t * span + s * cols) * G. */
+#define uECC_COMB_ENTRIES (1 << uECC_COMB_TEETH)
+#define uECC_COMB_COLS ((256 + uECC_COMB_TEETH * uECC_COMB_TABLES - 1) / (uECC_COMB_TEETH * uECC_COMB_TABLES))
+#define uECC_COMB_SPAN (uECC_COMB_COLS * uECC_COMB_TABLES)
+
+static uECC_word_t comb_table[uECC_COMB_TABLES][uECC_COMB_ENTRIES][uECC_MAX_WORDS * 2];
+static volatile uint8_t comb_ready = 0;
+
+/* (X1, Y1, Z1) += (x2, y2) in jacobian + affine coordinates, result may not be doubled or
+   zero (handled by the caller) */
+static void comb_add_mixed(uECC_word_t * X1,
+                           uECC_word_t * Y1,
+                           uECC_word_t * Z1,
+                           const uECC_word_t * const point,
+                           uECC_Curve curve) {
+    uECC_word_t t1[uECC_MAX_WORDS];
+    uECC_word_t t2[uECC_MAX_WORDS];
+    uECC_word_t t3[uECC_MAX_WORDS];
+    uECC_word_t t4[uECC_MAX_WORDS];
+    wordcount_t num_words = curve->num_words;
+
+    uECC_vli_modSquare_fast(t1, Z1, curve);                   /* t1 = z1^2 */
+    uECC_vli_modMult_fast(t2, point, t1, curve);              /* t2 = x2*z1^2 = U2 */
+    uECC_vli_modMult_fast(t1, t1, Z1, curve);                 /* t1 = z1^3 */
+    uECC_vli_modMult_fast(t1, t1, point + num_words, curve);  /* t1 = y2*z1^3 = S2 */
+    uECC_vli_modSub(t2, t2, X1, curve->p, num_words);         /* t2 = U2 - x1 = H */
+    uECC_vli_modSub(t1, t1, Y1, curve->p, num_words);         /* t1 = S2 - y1 = r */
+    uECC_vli_modMult_fast(Z1, Z1, t2, curve);                 /* z3 = z1*H */
+    uECC_vli_modSquare_fast(t3, t2, curve);                   /* t3 = H^2 */
+    uECC_vli_modMult_fast(t2, t2, t3, curve);                 /* t2 = H^3 */
+    uECC_vli_modMult_fast(t3, t3, X1, curve);                 /* t3 = x1*H^2 = V */
+    uECC_vli_modSquare_fast(t4, t1, curve);                   /* t4 = r^2 */
+    uECC_vli_modSub(t4, t4, t2, curve->p, num_words);         /* t4 = r^2 - H^3 */
+    uECC_vli_modSub(t4, t4, t3, curve->p, num_words);         /* t4 = r^2 - H^3 - V */
+    uECC_vli_modSub(X1, t4, t3, curve->p, num_words);         /* x3 = r^2 - H^3 - 2V */
+    uECC_vli_modSub(t3, t3, X1, curve->p, num_words);         /* t3 = V - x3 */
+    uECC_vli_modMult_fast(t3, t3, t1, curve);                 /* t3 = r*(V - x3) */
+    uECC_vli_modMult_fast(t2, t2, Y1, curve);                 /* t2 = y1*H^3 */
+    uECC_vli_modSub(Y1, t3, t2, curve->p, num_words);         /* y3 = r*(V - x3) - y1*H^3 */
+}
+
+/* (X, Y, Z) => affine result */
+static void comb_affine(uECC_word_t * result,
+                        uECC_word_t * X,
+                        uECC_word_t * Y,
+                        const uECC_word_t * const Z,
+                        uECC_Curve curve) {
+    uECC_word_t z[uECC_MAX_WORDS];
+    wordcount_t num_words = curve->num_words;
+
+    uECC_vli_modInv(z, Z, curve->p, num_words);
+    apply_z(X, Y, z, curve);
+    uECC_vli_set(result, X, num_words);
+    uECC_vli_set(result + num_words, Y, num_words);
+}
+
+/* builds the tables, only the one-time cost so it uses the simple (slow) affine steps */
+static void comb_precompute(uECC_Curve curve) {
+    uECC_word_t base[uECC_COMB_TEETH][uECC_MAX_WORDS * 2];
+    uECC_word_t X[uECC_MAX_WORDS];
+    uECC_word_t Y[uECC_MAX_WORDS];
+    uECC_word_t Z[uECC_MAX_WORDS];
+    wordcount_t num_words = curve->num_words;
+    int s, t, j, i;
+
+    /* base[t] = 2^(t * span) * G */
+    uECC_vli_set(base[0], curve->G, num_words * 2);
+    for (t = 1; t < uECC_COMB_TEETH; ++t) {
+        uECC_vli_set(X, base[t - 1], num_words);
+        uECC_vli_set(Y, base[t - 1] + num_words, num_words);
+        uECC_vli_clear(Z, num_words);
+        Z[0] = 1;
+        for (i = 0; i < uECC_COMB_SPAN; ++i) {
+            curve->double_jacobian(X, Y, Z, curve);
+        }
+        comb_affine(base[t], X, Y, Z, curve);
+    }
+
+    for (s = 0; s < uECC_COMB_TABLES; ++s) {
+        /* entry 0 is never used as a point, G keeps the masked adds well defined */
+        uECC_vli_set(comb_table[s][0], curve->G, num_words * 2);
+        for (j = 1; j < uECC_COMB_ENTRIES; ++j) {
+            for (t = uECC_COMB_TEETH - 1; !(j & (1 << t)); --t) {
+            }
+            if (j == (1 << t)) {
+                uECC_vli_set(comb_table[s][j], base[t], num_words * 2);
+                continue;
+            }
+            /* lower teeth plus the top one, distinct multiples so never a doubling */
+            uECC_vli_set(X, comb_table[s][j ^ (1 << t)], num_words);
+            uECC_vli_set(Y, comb_table[s][j ^ (1 << t)] + num_words, num_words);
+            uECC_vli_clear(Z, num_words);
+            Z[0] = 1;
+            comb_add_mixed(X, Y, Z, base[t], curve);
+            comb_affine(comb_table[s][j], X, Y, Z, curve);
+        }
+
+        /* next table is shifted by one block of columns */
+        for (t = 0; s + 1 < uECC_COMB_TABLES && t < uECC_COMB_TEETH; ++t) {
+            uECC_vli_set(X, base[t], num_words);
+            uECC_vli_set(Y, base[t] + num_words, num_words);
+            uECC_vli_clear(Z, num_words);
+            Z[0] = 1;
+            for (i = 0; i < uECC_COMB_COLS; ++i) {
+                curve->double_jacobian(X, Y, Z, curve);
+            }
+            comb_affine(base[t], X, Y, Z, curve);
+        }
+    }
+    comb_ready = 1;
+}
+
+/* constant-time select of an entry, always touches the whole table */
+static void comb_select(uECC_word_t * point, int s, uECC_word_t index, wordcount_t num_words) {
+    uECC_word_t j;
+    wordcount_t i;
+
+    uECC_vli_clear(point, num_words * 2);
+    for (j = 0; j < uECC_COMB_ENTRIES; ++j) {
+        uECC_word_t mask = (uECC_word_t)0 - (uECC_word_t)(j == index);
+        for (i = 0; i < num_words * 2; ++i) {
+            point[i] |= comb_table[s][j][i] & mask;
+        }
+    }
+}
+
+/* result = k * G using the comb, k must be in [1, n-1]; same sequence of operations for
+   every scalar */
+static void EccPoint_mult_comb(uECC_word_t * result,
+                               const uECC_word_t * const k,
+                               uECC_Curve curve) {
+    uECC_word_t R[3][uECC_MAX_WORDS];
+    uECC_word_t S[3][uECC_MAX_WORDS];
+    uECC_word_t point[uECC_MAX_WORDS * 2];
+    uECC_word_t index, bit, infinity = 1;
+    wordcount_t num_words = curve->num_words;
+    int i, s, t, n;
+
+    if (!comb_ready) {
+        comb_precompute(curve);
+    }
+
+    for (n = 0; n < 3; ++n) {
+        uECC_vli_clear(R[n], num_words);
+    }
+
+    for (i = uECC_COMB_COLS - 1; i >= 0; --i) {
+        curve->double_jacobian(R[0], R[1], R[2], curve);
+        for (s = 0; s < uECC_COMB_TABLES; ++s) {
+            index = 0;
+            for (t = 0; t < uECC_COMB_TEETH; ++t) {
+                bitcount_t b = (bitcount_t)(t * uECC_COMB_SPAN + s * uECC_COMB_COLS + i);
+                bit = (b < curve->num_n_bits) ? !!uECC_vli_testBit(k, b) : 0;
+                index |= bit << t;
+            }
+            comb_select(point, s, index, num_words);
+
+            for (n = 0; n < 3; ++n) {
+                uECC_vli_set(S[n], R[n], num_words);
+            }
+            comb_add_mixed(S[0], S[1], S[2], point, curve);
+
+            /* R = index ? (infinity ? point : R + point) : R */
+            {
+                uECC_word_t use_sum = (uECC_word_t)0 - ((index != 0) & !infinity);
+                uECC_word_t use_point = (uECC_word_t)0 - ((index != 0) & infinity);
+                wordcount_t w;
+                for (w = 0; w < num_words; ++w) {
+                    R[0][w] = (R[0][w] & ~(use_sum | use_point)) | (S[0][w] & use_sum) |
+                        (point[w] & use_point);
+                    R[1][w] = (R[1][w] & ~(use_sum | use_point)) | (S[1][w] & use_sum) |
+                        (point[num_words + w] & use_point);
+                    R[2][w] = (R[2][w] & ~(use_sum | use_point)) | (S[2][w] & use_sum) |
+                        ((uECC_word_t)(w == 0) & use_point);
+                }
+                infinity &= (index == 0);
+            }
+        }
+    }
+
+    comb_affine(result, R[0], R[1], R[2], curve);
+}
+
+#endif /* uECC_FIXED_BASE_COMB && uECC_SUPPORTS_secp256r1 */
+
+int uECC_precompute(uECC_Curve curve) {
+#if uECC_FIXED_BASE_COMB && uECC_SUPPORTS_secp256r1
+    if (curve == uECC_secp256r1()) {
+        if (!comb_ready) {
+            comb_precompute(curve);
+        }
+        return 1;
+    }
+#endif
+    (void)curve;
+    return 0;
+}
+
+/* result = k * G, the comb is used when there's a table for this curve */
+static void EccPoint_mult_G(uECC_word_t * result,
+                            const uECC_word_t * const k,
+                            uECC_Curve curve) {
     uECC_word_t tmp1[uECC_MAX_WORDS];
     uECC_word_t tmp2[uECC_MAX_WORDS];
     uECC_word_t *p2[2] = {tmp1, tmp2};
     uECC_word_t carry;
 
+#if uECC_FIXED_BASE_COMB && uECC_SUPPORTS_secp256r1
+    if (curve == uECC_secp256r1()) {
+        EccPoint_mult_comb(result, k, curve);
+        return;
+    }
+#endif
+
     /* Regularize the bitcount for the private key so that attackers cannot use a side channel
        attack to learn the number of leading zeros. */
-    carry = regularize_k(private, tmp1, tmp2, curve);
+    carry = regularize_k(k, tmp1, tmp2, curve);
 
     EccPoint_mult(result, curve->G, p2[!carry], 0, curve->num_n_bits + 1, curve);
+}
+
+static uECC_word_t EccPoint_compute_public_key(uECC_word_t *result,
+                                               uECC_word_t *private,
+                                               uECC_Curve curve) {
+    EccPoint_mult_G(result, private, curve);
 
     if (EccPoint_isZero(result, curve)) {
         return 0;
@@ -1238,24 +1455,20 @@ static int uECC_sign_with_k(const uint8_t *private_key,
 
     uECC_word_t tmp[uECC_MAX_WORDS];
     uECC_word_t s[uECC_MAX_WORDS];
-    uECC_word_t *k2[2] = {tmp, s};
 #if uECC_VLI_NATIVE_LITTLE_ENDIAN
     uECC_word_t *p = (uECC_word_t *)signature;
 #else
     uECC_word_t p[uECC_MAX_WORDS * 2];
 #endif
-    uECC_word_t carry;
     wordcount_t num_words = curve->num_words;
     wordcount_t num_n_words = BITS_TO_WORDS(curve->num_n_bits);
-    bitcount_t num_n_bits = curve->num_n_bits;
 
     /* Make sure 0 < k < curve_n */
     if (uECC_vli_isZero(k, num_words) || uECC_vli_cmp(curve->n, k, num_n_words) != 1) {
         return 0;
     }
 
-    carry = regularize_k(k, tmp, s, curve);
-    EccPoint_mult(p, curve->G, k2[!carry], 0, num_n_bits + 1, curve);
+    EccPoint_mult_G(p, k, curve);
     if (uECC_vli_isZero(p, num_words)) {
         return 0;
     }
@@ -1563,6 +1776,325 @@ int uECC_verify(const uint8_t *public_key,
     return (int)(uECC_vli_equal(rx, r, num_words));
 }
 
+/* Montgomery's trick: replaces each of the num (nonzero) values with its inverse mod n, or mod p
+   if a curve is given, using a single modInv and 3 * (num - 1) multiplications. acc is num
+   words of scratch. */
+static void vli_batch_modInv(uECC_word_t **values,
+                             uECC_word_t (*acc)[uECC_MAX_WORDS],
+                             unsigned num,
+                             const uECC_word_t *mod,
+                             wordcount_t num_words,
+                             uECC_Curve curve) {
+    uECC_word_t inv[uECC_MAX_WORDS];
+    uECC_word_t tmp[uECC_MAX_WORDS];
+    unsigned i;
+
+    if (!num) {
+        return;
+    }
+    uECC_vli_set(acc[0], values[0], num_words);
+    for (i = 1; i < num; ++i) {
+        if (curve) {
+            uECC_vli_modMult_fast(acc[i], acc[i - 1], values[i], curve);
+        } else {
+            uECC_vli_modMult(acc[i], acc[i - 1], values[i], mod, num_words);
+        }
+    }
+    uECC_vli_modInv(inv, acc[num - 1], mod, num_words);
+    for (i = num - 1; i > 0; --i) {
+        if (curve) {
+            uECC_vli_modMult_fast(tmp, inv, acc[i - 1], curve);   /* 1 / values[i] */
+            uECC_vli_modMult_fast(inv, inv, values[i], curve);    /* 1 / (values[0] .. values[i - 1]) */
+        } else {
+            uECC_vli_modMult(tmp, inv, acc[i - 1], mod, num_words);
+            uECC_vli_modMult(inv, inv, values[i], mod, num_words);
+        }
+        uECC_vli_set(values[i], tmp, num_words);
+    }
+    uECC_vli_set(values[0], inv, num_words);
+}
+
+static int same_key(const uint8_t *left, const uint8_t *right, unsigned num_bytes) {
+    unsigned i;
+    if (left == right) {
+        return 1;
+    }
+    for (i = 0; i < num_bytes; ++i) {
+        if (left[i] != right[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Batches interleave width-5 NAFs of u1 and u2 over tables of the odd multiples 1P .. 15P of G
+   and of each distinct key, about 43 additions per scalar instead of 192 for both in the
+   binary Shamir's trick. */
+#define BATCH_WINDOW 5
+#define BATCH_ODD (1 << (BATCH_WINDOW - 2))
+#define BATCH_NAF (uECC_MAX_WORDS * uECC_WORD_BITS + 1)
+
+/* Width-w NAF of the scalar, each digit is 0 or odd in (-2^(w-1), 2^(w-1)). Returns the length. */
+static bitcount_t wnaf_recode(int8_t *naf, const uECC_word_t *scalar, wordcount_t num_words) {
+    uECC_word_t k[uECC_MAX_WORDS + 1];
+    uECC_word_t d[uECC_MAX_WORDS + 1];
+    bitcount_t len = 0;
+    int digit;
+
+    uECC_vli_set(k, scalar, num_words);
+    k[num_words] = 0;
+    uECC_vli_clear(d, num_words + 1);
+    while (!uECC_vli_isZero(k, num_words + 1)) {
+        digit = 0;
+        if (k[0] & 1) {
+            digit = (int)(k[0] & ((1 << BATCH_WINDOW) - 1));
+            if (digit >= (1 << (BATCH_WINDOW - 1))) {
+                digit -= (1 << BATCH_WINDOW);
+                d[0] = (uECC_word_t)(-digit);
+                uECC_vli_add(k, k, d, num_words + 1);
+            } else {
+                d[0] = (uECC_word_t)digit;
+                uECC_vli_sub(k, k, d, num_words + 1);
+            }
+        }
+        naf[len++] = (int8_t)digit;
+        uECC_vli_rshift1(k, num_words + 1);
+    }
+    return len;
+}
+
+/* Fills odd with the Jacobian odd multiples 1P .. (2 * BATCH_ODD - 1)P of the affine point,
+   their Z values in z (odd[0] is P itself, z[0] = 1). */
+static void odd_multiples(uECC_word_t (*odd)[uECC_MAX_WORDS * 2],
+                          uECC_word_t (*z)[uECC_MAX_WORDS],
+                          const uECC_word_t *point,
+                          uECC_Curve curve) {
+    uECC_word_t tx[uECC_MAX_WORDS], ty[uECC_MAX_WORDS], tz[uECC_MAX_WORDS], zz[uECC_MAX_WORDS];
+    wordcount_t num_words = curve->num_words;
+    unsigned k;
+
+    uECC_vli_set(odd[0], point, num_words);
+    uECC_vli_set(odd[0] + num_words, point + num_words, num_words);
+    uECC_vli_clear(z[0], num_words);
+    z[0][0] = 1;
+
+    /* T = 2P, and P co-Z w/ it */
+    uECC_vli_set(tx, point, num_words);
+    uECC_vli_set(ty, point + num_words, num_words);
+    uECC_vli_set(zz, z[0], num_words);
+    curve->double_jacobian(tx, ty, zz, curve);
+    uECC_vli_set(odd[1], point, num_words);
+    uECC_vli_set(odd[1] + num_words, point + num_words, num_words);
+    apply_z(odd[1], odd[1] + num_words, zz, curve);
+
+    /* each next odd multiple is T + the last, co-Z additions keep T's Z in step */
+    for (k = 1; k < BATCH_ODD; ++k) {
+        if (k > 1) {
+            uECC_vli_set(odd[k], odd[k - 1], num_words * 2);
+        }
+        uECC_vli_modSub(tz, odd[k], tx, curve->p, num_words); /* Z = x2 - x1 */
+        XYcZ_add(tx, ty, odd[k], odd[k] + num_words, curve);
+        uECC_vli_modMult_fast(zz, zz, tz, curve);
+        uECC_vli_set(z[k], zz, num_words);
+    }
+}
+
+static unsigned verify_batch(const uint8_t * const *public_keys,
+                             const uint8_t * const *message_hashes,
+                             unsigned hash_size,
+                             const uint8_t * const *signatures,
+                             unsigned num,
+                             uint8_t *valid,
+                             uECC_Curve curve) {
+    uECC_word_t u1[uECC_BATCH_SIZE][uECC_MAX_WORDS], u2[uECC_BATCH_SIZE][uECC_MAX_WORDS];
+    uECC_word_t r[uECC_BATCH_SIZE][uECC_MAX_WORDS], s[uECC_BATCH_SIZE][uECC_MAX_WORDS];
+    uECC_word_t rx[uECC_BATCH_SIZE][uECC_MAX_WORDS], ry[uECC_BATCH_SIZE][uECC_MAX_WORDS];
+    uECC_word_t z[uECC_BATCH_SIZE][uECC_MAX_WORDS];
+    uECC_word_t acc[(uECC_BATCH_SIZE + 1) * BATCH_ODD][uECC_MAX_WORDS];
+    uECC_word_t *inv[(uECC_BATCH_SIZE + 1) * BATCH_ODD];
+    /* odd multiples of G in table 0, then each distinct key */
+    uECC_word_t odd[uECC_BATCH_SIZE + 1][BATCH_ODD][uECC_MAX_WORDS * 2];
+    uECC_word_t oddz[uECC_BATCH_SIZE + 1][BATCH_ODD][uECC_MAX_WORDS];
+    uECC_word_t public[uECC_MAX_WORDS * 2];
+    uECC_word_t tx[uECC_MAX_WORDS], ty[uECC_MAX_WORDS], tz[uECC_MAX_WORDS];
+    int8_t naf[2][BATCH_NAF];
+    bitcount_t len[2];
+    unsigned live[uECC_BATCH_SIZE]; /* signatures still being checked */
+    unsigned table[uECC_BATCH_SIZE]; /* odd table for each signature's key */
+    const uECC_word_t *point;
+    unsigned i, j, k, t, tables, num_live = 0, num_inv, count = 0;
+    int digit, started;
+    bitcount_t b;
+    wordcount_t num_words = curve->num_words;
+    wordcount_t num_n_words = BITS_TO_WORDS(curve->num_n_bits);
+
+    /* r, s must be in [1, n - 1]. */
+    for (i = 0; i < num; ++i) {
+        valid[i] = 0;
+        r[i][num_n_words - 1] = 0;
+        s[i][num_n_words - 1] = 0;
+        rx[i][num_n_words - 1] = 0;
+    #if uECC_VLI_NATIVE_LITTLE_ENDIAN
+        bcopy((uint8_t *) r[i], signatures[i], curve->num_bytes);
+        bcopy((uint8_t *) s[i], signatures[i] + curve->num_bytes, curve->num_bytes);
+    #else
+        uECC_vli_bytesToNative(r[i], signatures[i], curve->num_bytes);
+        uECC_vli_bytesToNative(s[i], signatures[i] + curve->num_bytes, curve->num_bytes);
+    #endif
+        if (uECC_vli_isZero(r[i], num_words) || uECC_vli_isZero(s[i], num_words) ||
+                uECC_vli_cmp_unsafe(curve->n, r[i], num_n_words) != 1 ||
+                uECC_vli_cmp_unsafe(curve->n, s[i], num_n_words) != 1) {
+            continue;
+        }
+        live[num_live++] = i;
+    }
+    if (!num_live) {
+        return 0;
+    }
+
+    /* Calculate u1 = e/s and u2 = r/s, sharing the inversion of every s. */
+    for (j = 0; j < num_live; ++j) {
+        inv[j] = s[live[j]];
+    }
+    vli_batch_modInv(inv, acc, num_live, curve->n, num_n_words, 0);
+    for (j = 0; j < num_live; ++j) {
+        i = live[j];
+        u1[i][num_n_words - 1] = 0;
+        bits2int(u1[i], message_hashes[i], hash_size, curve);
+        uECC_vli_modMult(u1[i], u1[i], s[i], curve->n, num_n_words);
+        uECC_vli_modMult(u2[i], r[i], s[i], curve->n, num_n_words);
+    }
+
+    /* Odd multiples of G and once per distinct key, sharing the inversion of all their Zs. */
+    odd_multiples(odd[0], oddz[0], curve->G, curve);
+    tables = 1;
+    for (j = 0; j < num_live; ++j) {
+        i = live[j];
+        for (k = 0; k < j; ++k) {
+            if (same_key(public_keys[live[k]], public_keys[i], curve->num_bytes * 2)) {
+                break;
+            }
+        }
+        if (k < j) {
+            table[i] = table[live[k]];
+            continue;
+        }
+    #if uECC_VLI_NATIVE_LITTLE_ENDIAN
+        bcopy((uint8_t *) public, public_keys[i], curve->num_bytes * 2);
+    #else
+        uECC_vli_bytesToNative(public, public_keys[i], curve->num_bytes);
+        uECC_vli_bytesToNative(
+            public + num_words, public_keys[i] + curve->num_bytes, curve->num_bytes);
+    #endif
+        odd_multiples(odd[tables], oddz[tables], public, curve);
+        table[i] = tables++;
+    }
+    num_inv = 0;
+    for (t = 0; t < tables; ++t) {
+        for (k = 1; k < BATCH_ODD; ++k) {
+            if (uECC_vli_isZero(oddz[t][k], num_words)) {
+                uECC_vli_clear(odd[t][k], num_words * 2); /* a small order point, never verifies */
+                continue;
+            }
+            inv[num_inv++] = oddz[t][k];
+        }
+    }
+    vli_batch_modInv(inv, acc, num_inv, curve->p, num_words, curve);
+    for (t = 0; t < tables; ++t) {
+        for (k = 1; k < BATCH_ODD; ++k) {
+            apply_z(odd[t][k], odd[t][k] + num_words, oddz[t][k], curve);
+        }
+    }
+
+    /* u1*G + u2*Q for each signature, one shared doubling chain for both NAFs. */
+    for (j = 0; j < num_live; ++j) {
+        i = live[j];
+        len[0] = wnaf_recode(naf[0], u1[i], num_n_words);
+        len[1] = wnaf_recode(naf[1], u2[i], num_n_words);
+        started = 0;
+        for (b = smax(len[0], len[1]) - 1; b >= 0; --b) {
+            if (started) {
+                curve->double_jacobian(rx[i], ry[i], z[i], curve);
+            }
+            for (t = 0; t < 2; ++t) {
+                digit = (b < len[t]) ? naf[t][b] : 0;
+                if (!digit) {
+                    continue;
+                }
+                point = odd[t ? table[i] : 0][(digit < 0 ? -digit : digit) >> 1];
+                uECC_vli_set(tx, point, num_words);
+                if (digit < 0) {
+                    uECC_vli_sub(ty, curve->p, point + num_words, num_words);
+                } else {
+                    uECC_vli_set(ty, point + num_words, num_words);
+                }
+                if (!started) {
+                    uECC_vli_set(rx[i], tx, num_words);
+                    uECC_vli_set(ry[i], ty, num_words);
+                    uECC_vli_clear(z[i], num_words);
+                    z[i][0] = 1;
+                    started = 1;
+                    continue;
+                }
+                apply_z(tx, ty, z[i], curve);
+                uECC_vli_modSub(tz, rx[i], tx, curve->p, num_words); /* Z = x2 - x1 */
+                XYcZ_add(tx, ty, rx[i], ry[i], curve);
+                uECC_vli_modMult_fast(z[i], z[i], tz, curve);
+            }
+        }
+        if (!started) {
+            uECC_vli_clear(z[i], num_words);
+        }
+    }
+
+    /* Back to affine x, sharing the inversion of every Z. A zero Z is the point at infinity. */
+    num_inv = 0;
+    for (j = 0; j < num_live; ++j) {
+        i = live[j];
+        if (uECC_vli_isZero(z[i], num_words)) {
+            live[j--] = live[--num_live];
+            continue;
+        }
+        inv[num_inv++] = z[i];
+    }
+    vli_batch_modInv(inv, acc, num_inv, curve->p, num_words, curve);
+
+    for (j = 0; j < num_live; ++j) {
+        i = live[j];
+        apply_z(rx[i], ry[i], z[i], curve);
+
+        /* v = x1 (mod n) */
+        if (uECC_vli_cmp_unsafe(curve->n, rx[i], num_n_words) != 1) {
+            uECC_vli_sub(rx[i], rx[i], curve->n, num_n_words);
+        }
+
+        /* Accept only if v == r. */
+        valid[i] = (uint8_t)uECC_vli_equal(rx[i], r[i], num_words);
+        count += valid[i];
+    }
+    return count;
+}
+
+unsigned uECC_verify_batch(const uint8_t * const *public_keys,
+                           const uint8_t * const *message_hashes,
+                           unsigned hash_size,
+                           const uint8_t * const *signatures,
+                           unsigned num,
+                           uint8_t *valid,
+                           uECC_Curve curve) {
+    unsigned done, count = 0;
+    for (done = 0; done < num; done += uECC_BATCH_SIZE) {
+        count += verify_batch(public_keys + done,
+                              message_hashes + done,
+                              hash_size,
+                              signatures + done,
+                              (num - done < uECC_BATCH_SIZE) ? num - done : uECC_BATCH_SIZE,
+                              valid + done,
+                              curve);
+    }
+    return count;
+}
+
 #if uECC_ENABLE_VLI_API
 
 unsigned uECC_curve_num_words(uECC_Curve curve) {
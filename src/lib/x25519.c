@@ -0,0 +1,177 @@
+#include <string.h>
+#include "x25519.h"
+
+// curve25519 montgomery ladder after the public domain tweetnacl, field elements are 16 limbs of 16 bits
+// slow but small and portable, only used for handshakes
+
+typedef int64_t gf[16];
+
+static const gf _121665 = {0xDB41, 1};
+
+static void car25519(gf o)
+{
+  int i;
+  int64_t c;
+  for(i=0;i<16;i++)
+  {
+    o[i] += (1LL << 16);
+    c = o[i] >> 16;
+    o[(i+1)*(i<15)] += c-1 + 37*(c-1)*(i==15);
+    o[i] -= c * (1LL << 16);
+  }
+}
+
+// swap p and q if b is 1, in constant time
+static void sel25519(gf p, gf q, int b)
+{
+  int64_t t, c = ~(b-1);
+  int i;
+  for(i=0;i<16;i++)
+  {
+    t = c & (p[i] ^ q[i]);
+    p[i] ^= t;
+    q[i] ^= t;
+  }
+}
+
+static void pack25519(uint8_t *o, const gf n)
+{
+  int i, j, b;
+  gf m, t;
+  for(i=0;i<16;i++) t[i] = n[i];
+  car25519(t);
+  car25519(t);
+  car25519(t);
+  for(j=0;j<2;j++)
+  {
+    m[0] = t[0] - 0xffed;
+    for(i=1;i<15;i++)
+    {
+      m[i] = t[i] - 0xffff - ((m[i-1] >> 16) & 1);
+      m[i-1] &= 0xffff;
+    }
+    m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+    b = (int)((m[15] >> 16) & 1);
+    m[14] &= 0xffff;
+    sel25519(t, m, 1-b);
+  }
+  for(i=0;i<16;i++)
+  {
+    o[2*i] = (uint8_t)(t[i] & 0xff);
+    o[2*i+1] = (uint8_t)(t[i] >> 8);
+  }
+}
+
+static void unpack25519(gf o, const uint8_t *n)
+{
+  int i;
+  for(i=0;i<16;i++) o[i] = n[2*i] + ((int64_t)n[2*i+1] << 8);
+  o[15] &= 0x7fff;
+}
+
+static void A(gf o, const gf a, const gf b)
+{
+  int i;
+  for(i=0;i<16;i++) o[i] = a[i] + b[i];
+}
+
+static void Z(gf o, const gf a, const gf b)
+{
+  int i;
+  for(i=0;i<16;i++) o[i] = a[i] - b[i];
+}
+
+static void M(gf o, const gf a, const gf b)
+{
+  int64_t t[31];
+  int i, j;
+  for(i=0;i<31;i++) t[i] = 0;
+  for(i=0;i<16;i++) for(j=0;j<16;j++) t[i+j] += a[i] * b[j];
+  for(i=0;i<15;i++) t[i] += 38 * t[i+16];
+  for(i=0;i<16;i++) o[i] = t[i];
+  car25519(o);
+  car25519(o);
+}
+
+static void S(gf o, const gf a)
+{
+  M(o, a, a);
+}
+
+// a^(p-2)
+static void inv25519(gf o, const gf i)
+{
+  gf c;
+  int a;
+  for(a=0;a<16;a++) c[a] = i[a];
+  for(a=253;a>=0;a--)
+  {
+    S(c, c);
+    if(a != 2 && a != 4) M(c, c, i);
+  }
+  for(a=0;a<16;a++) o[a] = c[a];
+}
+
+uint8_t x25519(uint8_t *out, const uint8_t *scalar, const uint8_t *point)
+{
+  uint8_t z[32], zero = 0;
+  gf x, a, b, c, d, e, f;
+  int i, r;
+
+  if(!out || !scalar || !point) return 0;
+
+  // clamp
+  memcpy(z, scalar, 32);
+  z[31] = (z[31] & 127) | 64;
+  z[0] &= 248;
+
+  unpack25519(x, point);
+  for(i=0;i<16;i++)
+  {
+    b[i] = x[i];
+    d[i] = a[i] = c[i] = 0;
+  }
+  a[0] = d[0] = 1;
+
+  for(i=254;i>=0;--i)
+  {
+    r = (z[i>>3] >> (i&7)) & 1;
+    sel25519(a, b, r);
+    sel25519(c, d, r);
+    A(e, a, c);
+    Z(a, a, c);
+    A(c, b, d);
+    Z(b, b, d);
+    S(d, e);
+    S(f, a);
+    M(a, c, a);
+    M(c, b, e);
+    A(e, a, c);
+    Z(a, a, c);
+    S(b, a);
+    Z(c, d, f);
+    M(a, c, _121665);
+    A(a, a, d);
+    M(c, c, a);
+    M(a, d, f);
+    M(d, b, x);
+    S(b, e);
+    sel25519(a, b, r);
+    sel25519(c, d, r);
+  }
+
+  inv25519(c, c);
+  M(a, a, c);
+  pack25519(out, a);
+  memset(z, 0, 32);
+
+  // reject the all-zero output from low order points
+  for(i=0;i<32;i++) zero |= out[i];
+  return zero ? 1 : 0;
+}
+
+uint8_t x25519_base(uint8_t *key, const uint8_t *secret)
+{
+  static const uint8_t nine[32] = {9};
+  return x25519(key, secret, nine);
+}
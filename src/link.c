@@ -61,6 +61,7 @@ void link_free(link_t link)
   hashname_free(link->id);
   lob_free(link->key);
   lob_free(link->handshake);
+  lob_free(link->cookie);
   free(link);
 }
 
@@ -92,7 +93,7 @@ chan_t link_chan_get(link_t link, uint32_t id)
   chan_t c;
   if(!link || !id) return NULL;
   for(c = link->chans;c;c = chan_next(c)) {
-    LOG("<%d><%d>",chan_id(c), id);
+    LOG_CRAZY("<%d><%d>",chan_id(c), id);
     if(chan_id(c) == id) return c;
   }
   return NULL;
@@ -115,6 +116,25 @@ lob_t link_json(link_t link)
   return json;
 }
 
+lob_t link_metrics(link_t link)
+{
+  chan_t c;
+  uint32_t chans = 0;
+  lob_t json;
+  if(!link) return LOG("bad args");
+
+  json = lob_new();
+  lob_set(json,"hashname",hashname_char(link->id));
+  mesh_metrics_set(json,&link->metrics);
+  lob_set_uint(json,"replays",e3x_exchange_replays(link->x));
+  for(c = link->chans;c;c = chan_next(c)) chans++;
+  lob_set_uint(json,"channels",chans);
+  lob_set_uint(json,"queued",link->queued);
+  lob_set_uint(json,"rtt",link->rtt);
+  lob_set_uint(json,"last",link->last);
+  return json;
+}
+
 link_t link_get_keys(mesh_t mesh, lob_t keys)
 {
   uint8_t csid;
@@ -131,11 +151,12 @@ link_t link_get_keys(mesh_t mesh, lob_t keys)
 link_t link_get_key(mesh_t mesh, lob_t key, uint8_t csid)
 {
   link_t link;
+  struct hashname_struct id;
 
   if(!mesh || !key) return LOG("invalid args");
   if(hashname_id(mesh->keys,key) > csid) return LOG("invalid csid");
 
-  link = link_get(mesh, hashname_vkey(key, csid));
+  link = link_get(mesh, hashname_vkey_r(key, csid, &id));
   if(!link) return LOG("invalid key");
 
   // load key if it's not yet
@@ -180,6 +201,7 @@ link_t link_load(link_t link, uint8_t csid, lob_t key)
   link->key = copy;
 
   e3x_exchange_out(link->x, util_sys_seconds());
+  link_async(link);
   LOG("new exchange session to %s",hashname_short(link->id));
 
   return link;
@@ -213,7 +235,7 @@ link_t link_up(link_t link)
 // process an incoming handshake
 link_t link_receive_handshake(link_t link, lob_t inner)
 {
-  uint32_t out, at, err;
+  uint32_t out, at, err, ms;
   uint8_t csid = 0;
   lob_t outer = lob_linked(inner);
 
@@ -232,13 +254,24 @@ link_t link_receive_handshake(link_t link, lob_t inner)
 
   if((err = e3x_exchange_verify(link->x,outer)))
   {
+    link->metrics.handshakes_rejected++;
     lob_free(inner);
     return LOG("handshake verification fail: %d",err);
   }
 
+  // any handshake back since we sent ours is a round trip sample
+  link->last = util_sys_seconds();
+  if(link->pinged)
+  {
+    ms = (uint32_t)util_sys_ms(link->mesh->since) + 1 - link->pinged;
+    link->rtt = link->rtt ? (link->rtt*7 + ms)/8 : ms;
+    link->pinged = 0;
+  }
+
   out = e3x_exchange_out(link->x,0);
   at = lob_get_uint(inner,"at");
   link_t ready = link_up(link);
+  ephemeral_t ephem = link->x->ephem;
 
   // if bad at, always send current handshake
   if(e3x_exchange_in(link->x, at) < out)
@@ -256,9 +289,20 @@ link_t link_receive_handshake(link_t link, lob_t inner)
     return LOG("sync failed");
   }
 
+  // new keys, link_process() times them and how long the previous ones still decrypt
+  if(ephem != link->x->ephem)
+  {
+    link->keyed = link->expire = 0;
+    if(!link->mesh->rekey.overlap) e3x_exchange_expire(link->x);
+  }
+
   // we may need to re-sync
   if(out != e3x_exchange_out(link->x,0)) link_sync(link);
 
+  // they took a handshake and any re-sync above carried the cookie, stop echoing it
+  lob_free(link->cookie);
+  link->cookie = NULL;
+
   // notify of ready state change
   if(!ready && link_up(link))
   {
@@ -274,7 +318,7 @@ link_t link_receive_handshake(link_t link, lob_t inner)
 // forward declare
 chan_t link_process_chan(chan_t c, uint32_t now);
 // process a decrypted channel packet
-link_t link_receive(link_t link, lob_t inner)
+static link_t link_receive_inner(link_t link, lob_t inner)
 {
   chan_t c;
 
@@ -316,9 +360,17 @@ link_t link_receive(link_t link, lob_t inner)
   return link;
 }
 
+link_t link_receive(link_t link, lob_t inner)
+{
+  link_t ret;
+  TRACE(UTIL_TRACE_LINK, ret = link_receive_inner(link, inner));
+  return ret;
+}
+
 // deliver this packet
 link_t link_send(link_t link, lob_t outer)
 {
+  size_t len;
   if(!outer) return LOG_INFO("send packet missing");
   if(!link || !link->send_cb)
   {
@@ -326,11 +378,22 @@ link_t link_send(link_t link, lob_t outer)
     return LOG_WARN("no network");
   }
 
+  len = lob_len(outer);
   if(!link->send_cb(link, outer, link->send_arg))
   {
     lob_free(outer);
     return LOG_WARN("delivery failed");
   }
+  link->metrics.packets_out++;
+  link->metrics.bytes_out += len;
+
+  // rekey before the current keys have been used too much
+  mesh_rekey_s *rekey = &(link->mesh->rekey);
+  if(link->x && link->x->ephem && ((rekey->packets && link->x->packets >= rekey->packets) || (rekey->bytes && link->x->bytes >= rekey->bytes)))
+  {
+    LOG("rekeying after %u packets %llu bytes",link->x->packets,(unsigned long long)link->x->bytes);
+    link_rekey(link);
+  }
 
   return link;
 }
@@ -361,7 +424,23 @@ link_t link_sync(link_t link)
   if(!link->x) return LOG("no exchange");
   if(!link->send_cb) return LOG("no network");
 
-  return link_send(link, link_handshake(link));
+  lob_t outer = link_handshake(link);
+
+  // a busy peer wants its cookie back w/ the handshake
+  if(outer && link->cookie)
+  {
+    lob_t wrap = lob_new();
+    lob_set(wrap,"cookie",lob_get(link->cookie,"cookie"));
+    lob_body(wrap,lob_raw(outer),lob_len(outer));
+    lob_free(outer);
+    outer = wrap;
+  }
+
+  // start the round trip first, a synchronous transport may answer (or challenge) inside the send
+  if(!link->pinged) link->pinged = (uint32_t)util_sys_ms(link->mesh->since) + 1;
+  if(!link_send(link, outer)) return NULL;
+  link->metrics.handshakes_out++;
+  return link;
 }
 
 // trigger a new exchange sync
@@ -375,6 +454,16 @@ link_t link_resync(link_t link)
   return link_sync(link);
 }
 
+// new ephemeral keys and resync
+link_t link_rekey(link_t link)
+{
+  if(!link) return LOG("bad args");
+  if(!e3x_exchange_rekey(link->x)) return LOG("rekey failed");
+  link->keyed = link->expire = 0;
+  link->mesh->rekey.rekeys++;
+  return link_resync(link);
+}
+
 // create/track a new channel for this open
 chan_t link_chan(link_t link, lob_t open)
 {
@@ -407,12 +496,78 @@ link_t link_direct(link_t link, lob_t inner)
   // add an outgoing cid if none set
   if(!lob_get_int(inner,"c")) lob_set_uint(inner,"c",e3x_exchange_cid(link->x, NULL));
 
-  lob_t outer = e3x_exchange_send(link->x, inner);
-  lob_free(inner);
+  return link_seal(link, inner);
+}
 
+link_t link_seal(link_t link, lob_t inner)
+{
+  lob_t outer;
+  if(!link || !inner)
+  {
+    lob_free(inner);
+    return LOG("bad args");
+  }
+
+  // async results are sent in order by link_flush()
+  if(link->x && link->x->sending)
+  {
+    if(e3x_exchange_send_async(link->x, inner)) return link;
+    link->metrics.dropped++;
+    return LOG_WARN("async crypto queue full, dropping");
+  }
+
+  outer = e3x_exchange_send(link->x, inner);
+  lob_free(inner);
   return link_send(link, outer);
 }
 
+// called from whichever thread finished the crypto
+static void link_ready(void *arg)
+{
+  mesh_t mesh = arg;
+  if(mesh->async) mesh->async(mesh, mesh->async_arg);
+}
+
+link_t link_async(link_t link)
+{
+  if(!link || !link->x) return NULL;
+  e3x_exchange_async(link->x, link->mesh->async ? link_ready : NULL, link->mesh);
+  return link;
+}
+
+uint32_t link_flush(link_t link)
+{
+  lob_t packet;
+  uint32_t count = 0, pass;
+  if(!link || !link->x) return 0;
+
+  // anything received may send more, so go until nothing's left
+  do
+  {
+    pass = 0;
+    e3x_exchange_flush(link->x);
+    while(e3x_exchange_sent(link->x, &packet))
+    {
+      pass++;
+      if(packet) link_send(link, packet);
+    }
+    while(e3x_exchange_received(link->x, &packet))
+    {
+      pass++;
+      if(!packet)
+      {
+        link->metrics.decrypt_fails++;
+        continue;
+      }
+      link->last = util_sys_seconds();
+      link_receive(link, packet);
+    }
+    count += pass;
+  }while(pass);
+
+  return count;
+}
+
 // force link down, end channels and generate all events
 link_t link_down(link_t link)
 {
@@ -462,7 +617,19 @@ link_t link_process(link_t link, uint32_t now)
 {
   if(!link || !now) return LOG("bad args");
   link->chans = link_process_chan(link->chans, now);
-  if(link->csid) return link;
+  if(link->csid)
+  {
+    // end any rekey overlap, and rekey when the keys get old
+    if(!link->keyed) link->keyed = now;
+    if(link->x && link->x->ephem_old && !link->expire) link->expire = now + link->mesh->rekey.overlap;
+    if(link->expire && now >= link->expire)
+    {
+      e3x_exchange_expire(link->x);
+      link->expire = 0;
+    }
+    if(link->mesh->rekey.secs && link_up(link) && now - link->keyed >= link->mesh->rekey.secs) link_rekey(link);
+    return link;
+  }
 
   // flagged to remove, do that now
   link_down(link);
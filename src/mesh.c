@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stddef.h>
 #include "telehash.h"
 
 // internally handle list of triggers active on the mesh
@@ -30,6 +31,9 @@ mesh_t mesh_new(void)
   if(!(mesh = malloc(sizeof (struct mesh_struct)))) return NULL;
   memset(mesh, 0, sizeof(struct mesh_struct));
   mesh->handshake = lob_new(); // empty blank
+  mesh->rekey.packets = MESH_REKEY_PACKETS;
+  mesh->rekey.overlap = MESH_REKEY_OVERLAP;
+  mesh->since = util_sys_seconds();
   
   LOG_INFO("mesh created version %d.%d.%d",TELEHASH_VERSION_MAJOR,TELEHASH_VERSION_MINOR,TELEHASH_VERSION_PATCH);
 
@@ -41,6 +45,9 @@ mesh_t mesh_free(mesh_t mesh)
   on_t on;
   if(!mesh) return NULL;
 
+  // nothing async may finish after this
+  e3x_async_free(mesh->handshakes);
+
   // free all links first
   link_t link, next;
   for(link = mesh->links;link;link = next)
@@ -49,6 +56,12 @@ mesh_t mesh_free(mesh_t mesh)
     link_free(link);
   }
   
+  if(mesh->admit)
+  {
+    util_zero(mesh->admit, sizeof (struct mesh_admit_struct));
+    free(mesh->admit);
+  }
+
   // free any triggers first
   while(mesh->on)
   {
@@ -65,6 +78,7 @@ mesh_t mesh_free(mesh_t mesh)
   hashname_free(mesh->id);
   e3x_self_free(mesh->self);
 
+  util_zero(mesh->resume,32);
   free(mesh);
   return NULL;
 }
@@ -75,7 +89,23 @@ uint8_t mesh_load(mesh_t mesh, lob_t secrets, lob_t keys)
   if(!mesh || !secrets || !keys) return 1;
   if(!(mesh->self = e3x_self_new(secrets, keys))) return 2;
   mesh->keys = lob_copy(keys);
-  mesh->id = hashname_dup(hashname_vkeys(mesh->keys));
+
+  // resume key is bound to every secret
+  uint8_t i;
+  char *secret;
+  struct hashname_struct id;
+  SHA256_CTX ctx;
+  SHA256_Init(&ctx);
+  SHA256_Update(&ctx,"resume",6);
+  for(i=0; i<CS_MAX; i++)
+  {
+    if(!e3x_cipher_sets[i] || !(secret = lob_get(secrets,e3x_cipher_sets[i]->hex))) continue;
+    SHA256_Update(&ctx,e3x_cipher_sets[i]->hex,2);
+    SHA256_Update(&ctx,secret,strlen(secret));
+  }
+  SHA256_Final(mesh->resume,&ctx);
+  util_zero(&ctx,sizeof(ctx));
+  mesh->id = hashname_dup(hashname_vkeys_r(mesh->keys, &id));
   LOG_INFO("mesh is %s",hashname_short(mesh->id));
   return 0;
 }
@@ -132,29 +162,435 @@ lob_t mesh_links(mesh_t mesh)
   return links;
 }
 
+// every counter in mesh_metrics_s by name, wide ones are 64-bit
+static const struct { char *name; size_t at; uint8_t wide; } mesh_metrics_fields[] = {
+  {"packets_in", offsetof(mesh_metrics_s,packets_in), 1},
+  {"packets_out", offsetof(mesh_metrics_s,packets_out), 1},
+  {"bytes_in", offsetof(mesh_metrics_s,bytes_in), 1},
+  {"bytes_out", offsetof(mesh_metrics_s,bytes_out), 1},
+  {"decrypt_fails", offsetof(mesh_metrics_s,decrypt_fails), 0},
+  {"handshakes_in", offsetof(mesh_metrics_s,handshakes_in), 0},
+  {"handshakes_out", offsetof(mesh_metrics_s,handshakes_out), 0},
+  {"handshakes_rejected", offsetof(mesh_metrics_s,handshakes_rejected), 0},
+  {"dropped", offsetof(mesh_metrics_s,dropped), 0},
+};
+#define MESH_METRICS_FIELDS (sizeof(mesh_metrics_fields)/sizeof(mesh_metrics_fields[0]))
+
+static uint64_t mesh_metrics_get(mesh_metrics_s *m, uint8_t i)
+{
+  uint8_t *at = (uint8_t*)m + mesh_metrics_fields[i].at;
+  return mesh_metrics_fields[i].wide ? *(uint64_t*)at : *(uint32_t*)at;
+}
+
+lob_t mesh_metrics_set(lob_t json, mesh_metrics_s *m)
+{
+  char num[21];
+  uint8_t i;
+  if(!json || !m) return NULL;
+  for(i=0;i<MESH_METRICS_FIELDS;i++)
+  {
+    snprintf(num,sizeof(num),"%llu",(unsigned long long)mesh_metrics_get(m,i));
+    lob_set_raw(json,mesh_metrics_fields[i].name,0,num,strlen(num));
+  }
+  return json;
+}
+
+// links are only ever touched by the mesh's thread, so summing on read needs no locking
+static void mesh_metrics_sum(mesh_t mesh, mesh_metrics_s *total, uint32_t *links, uint32_t *chans, uint32_t *queued, uint32_t *replays)
+{
+  link_t link;
+  chan_t c;
+  *total = mesh->metrics;
+  *links = *chans = *queued = *replays = 0;
+  for(link = mesh->links;link;link = link->next)
+  {
+    total->packets_in += link->metrics.packets_in;
+    total->packets_out += link->metrics.packets_out;
+    total->bytes_in += link->metrics.bytes_in;
+    total->bytes_out += link->metrics.bytes_out;
+    total->decrypt_fails += link->metrics.decrypt_fails;
+    total->handshakes_in += link->metrics.handshakes_in;
+    total->handshakes_out += link->metrics.handshakes_out;
+    total->handshakes_rejected += link->metrics.handshakes_rejected;
+    total->dropped += link->metrics.dropped;
+    (*links)++;
+    for(c = link->chans;c;c = chan_next(c)) (*chans)++;
+    *queued += link->queued;
+    *replays += e3x_exchange_replays(link->x);
+  }
+}
+
+lob_t mesh_metrics(mesh_t mesh)
+{
+  mesh_metrics_s total;
+  uint32_t links, chans, queued, replays;
+  lob_t json;
+  if(!mesh || !mesh->id) return LOG("bad args");
+
+  mesh_metrics_sum(mesh, &total, &links, &chans, &queued, &replays);
+  json = lob_new();
+  lob_set(json,"hashname",hashname_char(mesh->id));
+  mesh_metrics_set(json,&total);
+  lob_set_uint(json,"replays",replays);
+  lob_set_uint(json,"links",links);
+  lob_set_uint(json,"channels",chans);
+  lob_set_uint(json,"queued",queued);
+  return json;
+}
+
+// one sample line
+static void mesh_prom(lob_t out, char *name, char *labels, uint64_t val)
+{
+  char line[160];
+  snprintf(line,sizeof(line),"telehash_%s{%s} %llu\n",name,labels,(unsigned long long)val);
+  lob_append_str(out,line);
+}
+
+static void mesh_prom_type(lob_t out, char *name, char *type)
+{
+  char line[96];
+  snprintf(line,sizeof(line),"# TYPE telehash_%s %s\n",name,type);
+  lob_append_str(out,line);
+}
+
+static char *mesh_link_gauges[] = {"rtt_ms","last_seen_seconds","channels","queued_bytes"};
+
+static uint32_t mesh_link_gauge(link_t link, uint8_t which)
+{
+  uint32_t count = 0;
+  chan_t c;
+  switch(which)
+  {
+    case 0: return link->rtt;
+    case 1: return link->last;
+    case 2:
+      for(c = link->chans;c;c = chan_next(c)) count++;
+      return count;
+  }
+  return link->queued;
+}
+
+lob_t mesh_prometheus(mesh_t mesh)
+{
+  mesh_metrics_s total;
+  uint32_t links, chans, queued, replays;
+  char name[64], labels[64], mlabel[32], short_id[9];
+  uint8_t i;
+  link_t link;
+  lob_t out;
+  if(!mesh || !mesh->id) return LOG("bad args");
+
+  mesh_metrics_sum(mesh, &total, &links, &chans, &queued, &replays);
+  snprintf(mlabel,sizeof(mlabel),"mesh=\"%s\"",hashname_short_r(mesh->id,short_id));
+  out = lob_new();
+
+  // mesh wide totals
+  for(i=0;i<MESH_METRICS_FIELDS;i++)
+  {
+    snprintf(name,sizeof(name),"%s_total",mesh_metrics_fields[i].name);
+    mesh_prom_type(out,name,"counter");
+    mesh_prom(out,name,mlabel,mesh_metrics_get(&total,i));
+  }
+  mesh_prom_type(out,"replays_total","counter");
+  mesh_prom(out,"replays_total",mlabel,replays);
+  mesh_prom_type(out,"links","gauge");
+  mesh_prom(out,"links",mlabel,links);
+  mesh_prom_type(out,"channels","gauge");
+  mesh_prom(out,"channels",mlabel,chans);
+  mesh_prom_type(out,"queued_bytes","gauge");
+  mesh_prom(out,"queued_bytes",mlabel,queued);
+
+  // then each link, in their own families so sums don't double count
+  for(i=0;i<MESH_METRICS_FIELDS+4;i++)
+  {
+    if(i < MESH_METRICS_FIELDS) snprintf(name,sizeof(name),"link_%s_total",mesh_metrics_fields[i].name);
+    else snprintf(name,sizeof(name),"link_%s",mesh_link_gauges[i-MESH_METRICS_FIELDS]);
+    mesh_prom_type(out,name,(i < MESH_METRICS_FIELDS)?"counter":"gauge");
+    for(link = mesh->links;link;link = link->next)
+    {
+      snprintf(labels,sizeof(labels),"%s,link=\"%s\"",mlabel,hashname_short_r(link->id,short_id));
+      if(i < MESH_METRICS_FIELDS) mesh_prom(out,name,labels,mesh_metrics_get(&link->metrics,i));
+      else mesh_prom(out,name,labels,mesh_link_gauge(link,i-MESH_METRICS_FIELDS));
+    }
+  }
+
+  return out;
+}
+
+// the body is each link's exchange state packet back to back, sealed w/ the head as the aad
+lob_t mesh_save(mesh_t mesh)
+{
+  lob_t one, saved;
+  link_t link;
+  uint32_t count = 0;
+  uint8_t tag[16];
+  size_t len;
+
+  if(!mesh || !mesh->id) return LOG("bad args");
+
+  saved = lob_new();
+  lob_set(saved,"hashname",hashname_char(mesh->id));
+  lob_body(saved,NULL,12);
+  e3x_rand(saved->body,12);
+  for(link = mesh->links;link;link = link->next)
+  {
+    if(!link_up(link) || !(one = e3x_exchange_save(link->x))) continue;
+    lob_set(one,"hashname",hashname_char(link->id));
+    lob_set_base32(one,"key",link->key->body,link->key->body_len);
+    lob_append(saved,lob_raw(one),lob_len(one));
+    util_zero(lob_raw(one),lob_len(one));
+    lob_free(one);
+    count++;
+  }
+  if(!count)
+  {
+    lob_free(saved);
+    return LOG("no links to save");
+  }
+
+  len = saved->body_len - 12;
+  memset(tag,0,16);
+  if(!lob_append(saved,tag,16)) return lob_free(saved);
+  chacha20poly1305_seal(mesh->resume, saved->body, saved->head, saved->head_len, saved->body+12, (uint32_t)len, saved->body+12+len);
+
+  return saved;
+}
+
+uint32_t mesh_restore(mesh_t mesh, lob_t saved)
+{
+  lob_t one, key;
+  link_t link;
+  struct hashname_struct id;
+  uint8_t csid;
+  uint32_t count = 0;
+  uint8_t *buf;
+  size_t len, at, one_len;
+
+  if(!mesh || !mesh->id || !saved) return 0;
+  if(lob_get_cmp(saved,"hashname",hashname_char(mesh->id)) != 0)
+  {
+    LOG("saved state is for another hashname");
+    return 0;
+  }
+  if(saved->body_len <= 12+16) return 0;
+
+  // open a copy so the caller's stays intact if it fails
+  len = saved->body_len - (12+16);
+  if(!(buf = malloc(len))) return 0;
+  memcpy(buf,saved->body+12,len);
+  if(!chacha20poly1305_open(mesh->resume, saved->body, saved->head, saved->head_len, buf, (uint32_t)len, saved->body+12+len))
+  {
+    free(buf);
+    LOG("saved state failed authentication");
+    return 0;
+  }
+
+  // single use, resuming the same seqs twice would reuse their nonces
+  util_zero(saved->body,saved->body_len);
+  lob_body(saved,NULL,0);
+
+  for(at = 0; at+2 <= len; at += one_len)
+  {
+    one_len = 2 + (size_t)((buf[at] << 8) | buf[at+1]);
+    if(at+one_len > len || !(one = lob_parse(buf+at,one_len))) break;
+    // the hashname was sealed w/ the key, so it can be trusted here
+    key = lob_get_base32(one,"key");
+    csid = 0;
+    util_unhex(lob_get(one,"csid"),2,&csid);
+    link = link_get(mesh,hashname_vchar_r(lob_get(one,"hashname"),&id));
+    if(link && !link_load(link,csid,key)) link = NULL;
+    lob_free(key);
+    if(!link || !link->x || link->x->csid != csid)
+    {
+      LOG("can't restore link %s",lob_get(one,"hashname"));
+    }else if(!link_up(link) && e3x_exchange_load(link->x,one)){
+      LOG("resumed link %s",hashname_short(link->id));
+      mesh_link(mesh, link);
+      count++;
+    }
+    util_zero(lob_raw(one),lob_len(one));
+    lob_free(one);
+  }
+  util_zero(buf,len);
+  free(buf);
+
+  return count;
+}
+
 // process any channel timeouts based on the current/given time
 mesh_t mesh_process(mesh_t mesh, uint32_t now)
 {
   link_t link, next;
   if(!mesh || !now) return LOG("bad args");
+  if(mesh->async) mesh_flush(mesh);
   for(link = mesh->links;link;link = next)
   {
     next = link->next;
     link_process(link, now);
   }
-  
+
+  // top up any ephemeral keypair pool a little each pass so handshakes don't wait on keygen
+  e3x_cipher_pool_fill(1);
+
+  return mesh;
+}
+
+mesh_t mesh_admission(mesh_t mesh, uint32_t rate, uint32_t burst, uint32_t total, uint8_t cookies)
+{
+  if(!mesh) return LOG("bad args");
+
+  if(!rate && !total && !cookies)
+  {
+    if(mesh->admit)
+    {
+      util_zero(mesh->admit, sizeof (struct mesh_admit_struct));
+      free(mesh->admit);
+    }
+    mesh->admit = NULL;
+    return mesh;
+  }
+
+  if(!mesh->admit)
+  {
+    if(!(mesh->admit = malloc(sizeof (struct mesh_admit_struct)))) return LOG("OOM");
+    memset(mesh->admit, 0, sizeof (struct mesh_admit_struct));
+    e3x_rand(mesh->admit->secret, sizeof(mesh->admit->secret));
+    mesh->admit->since = util_sys_seconds();
+  }
+  mesh->admit->rate = rate;
+  mesh->admit->burst = burst;
+  mesh->admit->total = total;
+  mesh->admit->cookies = cookies;
+  LOG_INFO("handshake admission %u/%u per source, %u total, cookies %s",rate,burst,total,cookies?"on":"off");
+
   return mesh;
 }
 
+mesh_t mesh_rekey(mesh_t mesh, uint32_t packets, uint64_t bytes, uint32_t secs, uint32_t overlap)
+{
+  if(!mesh) return LOG("bad args");
+  mesh->rekey.packets = packets;
+  mesh->rekey.bytes = bytes;
+  mesh->rekey.secs = secs;
+  mesh->rekey.overlap = overlap;
+  LOG_INFO("rekey after %u packets, %llu bytes, %u secs, overlap %u",packets,(unsigned long long)bytes,secs,overlap);
+  return mesh;
+}
+
+// a cookie is a mac of the time window, handshake token, and source
+static uint8_t *mesh_cookie(mesh_admit_t admit, uint32_t window, uint8_t *token, uint8_t *src, size_t srclen, uint8_t *cookie)
+{
+  uint8_t buf[4+16+64], mac[32];
+  if(srclen > 64) srclen = 64;
+  buf[0] = (uint8_t)(window >> 24);
+  buf[1] = (uint8_t)(window >> 16);
+  buf[2] = (uint8_t)(window >> 8);
+  buf[3] = (uint8_t)window;
+  memcpy(buf+4, token, 16);
+  if(src) memcpy(buf+20, src, srclen);
+  else srclen = 0;
+  hmac_256(admit->secret, sizeof(admit->secret), buf, 20+srclen, mac);
+  memcpy(cookie, mac, 16);
+  return cookie;
+}
+
+lob_t mesh_admit(mesh_t mesh, lob_t packet, util_bucket_s *bucket, uint8_t *src, size_t srclen, lob_t *reply)
+{
+  mesh_admit_t admit;
+  lob_t handshake, cookie = NULL;
+  uint8_t token[32], check[16];
+  uint32_t now, window;
+
+  if(reply) *reply = NULL;
+  if(!mesh || !packet)
+  {
+    lob_free(packet);
+    return LOG("bad args");
+  }
+  if(!(admit = mesh->admit)) return packet;
+
+  // only handshakes are expensive, everything else goes straight through
+  if(packet->head_len == 1)
+  {
+    handshake = packet;
+  }else if(packet->head_len > 5 && (cookie = lob_get_base32(packet,"cookie"))){
+    handshake = lob_parse(packet->body, packet->body_len);
+    lob_free(packet);
+  }else{
+    return packet;
+  }
+
+  if(!handshake || handshake->head_len != 1 || handshake->body_len < 16)
+  {
+    LOG("dropping invalid handshake");
+    lob_free(handshake);
+    lob_free(cookie);
+    admit->dropped++;
+    return NULL;
+  }
+
+  // the same token the sender's exchange will recognize
+  e3x_hash(handshake->body, 16, token);
+
+  if(admit->cookies)
+  {
+    window = util_sys_seconds() / MESH_COOKIE_SECS;
+    if(!cookie || cookie->body_len != 16 || (util_ct_memcmp(cookie->body, mesh_cookie(admit, window, token, src, srclen, check), 16) && util_ct_memcmp(cookie->body, mesh_cookie(admit, window-1, token, src, srclen, check), 16)))
+    {
+      LOG_DEBUG("challenging handshake w/o a valid cookie");
+      if(reply)
+      {
+        *reply = lob_new();
+        lob_set(*reply,"type","cookie");
+        lob_set_base32(*reply,"token",token,16);
+        lob_set_base32(*reply,"cookie",mesh_cookie(admit, window, token, src, srclen, check),16);
+        admit->challenged++;
+      }
+      lob_free(handshake);
+      lob_free(cookie);
+      admit->dropped++;
+      return NULL;
+    }
+    admit->cookied++;
+  }
+  lob_free(cookie);
+
+  // per-source then overall limits
+  now = (uint32_t)util_sys_ms(admit->since) + 1;
+  if((bucket && !util_bucket_take(bucket, admit->rate, admit->burst, now)) || !util_bucket_take(&admit->bucket, admit->total, admit->total, now))
+  {
+    LOG_DEBUG("handshake over the rate limit");
+    lob_free(handshake);
+    admit->dropped++;
+    return NULL;
+  }
+
+  admit->admitted++;
+  return handshake;
+}
+
+lob_t mesh_admission_stats(mesh_t mesh)
+{
+  lob_t stats;
+  if(!mesh || !mesh->admit) return NULL;
+  stats = lob_new();
+  lob_set_uint(stats,"admitted",mesh->admit->admitted);
+  lob_set_uint(stats,"dropped",mesh->admit->dropped);
+  lob_set_uint(stats,"challenged",mesh->admit->challenged);
+  lob_set_uint(stats,"cookied",mesh->admit->cookied);
+  return stats;
+}
+
 link_t mesh_add(mesh_t mesh, lob_t json)
 {
   link_t link;
+  struct hashname_struct id;
   lob_t keys, paths;
   uint8_t csid;
 
   if(!mesh || !json) return LOG("bad args");
   LOG("mesh add %s",lob_json(json));
-  link = link_get(mesh, hashname_vchar(lob_get(json,"hashname")));
+  link = link_get(mesh, hashname_vchar_r(lob_get(json,"hashname"),&id));
   keys = lob_get_json(json,"keys");
   paths = lob_get_array(json,"paths");
   if(!link) link = link_get_keys(mesh, keys);
@@ -176,10 +612,11 @@ link_t mesh_add(mesh_t mesh, lob_t json)
 link_t mesh_linked(mesh_t mesh, char *hn, size_t len)
 {
   link_t link;
+  char str[53];
   if(!mesh || !hn) return NULL;
   if(!len) len = strlen(hn);
   
-  for(link = mesh->links;link;link = link->next) if(strncmp(hashname_char(link->id),hn,len) == 0) return link;
+  for(link = mesh->links;link;link = link->next) if(strncmp(hashname_char_r(link->id,str),hn,len) == 0) return link;
   
   return NULL;
 }
@@ -286,6 +723,8 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
 {
   uint32_t now;
   hashname_t from = NULL;
+  struct hashname_struct fromid; // held across mesh_discover() callbacks
+  char str[53];
   link_t link;
 
   if(!mesh || !handshake) return LOG("bad args");
@@ -326,7 +765,7 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
       
     // get attached hashname
     lob_t tmp = lob_parse(handshake->body, handshake->body_len);
-    from = hashname_vkey(tmp, csid);
+    from = hashname_vkey_r(tmp, csid, &fromid);
     if(!from)
     {
       LOG("bad link handshake, no hashname: %s",lob_json(handshake));
@@ -335,7 +774,7 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
       return NULL;
     }
     lob_set(handshake,"csid",hexid);
-    lob_set(handshake,"hashname",hashname_char(from));
+    lob_set(handshake,"hashname",hashname_char_r(from,str));
     lob_set_raw(handshake,hexid,2,"true",4); // intermediate format
     lob_body(handshake, tmp->body, tmp->body_len); // re-attach as raw key
     lob_free(tmp);
@@ -343,7 +782,7 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
     // short-cut, if it's a key from an existing link, pass it on
     // TODO: using mesh_linked here is a stack issue during loopback peer test!
     if((link = mesh_linkid(mesh,from))) return link_receive_handshake(link, handshake);
-    LOG("no link found for handshake from %s",hashname_char(from));
+    LOG("no link found for handshake from %s",str);
 
     // extend the key json to make it compatible w/ normal patterns
     tmp = lob_new();
@@ -358,25 +797,148 @@ link_t mesh_receive_handshake(mesh_t mesh, lob_t handshake)
   return from == NULL ? NULL : mesh_linkid(mesh, from);
 }
 
+// a decrypted (or failed, inner NULL) handshake, len is what arrived
+static link_t mesh_handshake(mesh_t mesh, lob_t outer, lob_t inner, size_t len)
+{
+  char token[17] = {0};
+  link_t link;
+  mesh_metrics_s *metrics;
+
+  if(!inner)
+  {
+    mesh->metrics.packets_in++;
+    mesh->metrics.bytes_in += len;
+    mesh->metrics.handshakes_in++;
+    mesh->metrics.handshakes_rejected++;
+    LOG_WARN("%02x handshake failed %s",outer->head[0],e3x_err());
+    lob_free(outer);
+    return NULL;
+  }
+
+  // couple the two together, inner->outer
+  lob_link(inner,outer);
+
+  // set the unique id string based on some of the first 16 (routing token) bytes in the body
+  base32_encode(outer->body,10,token,17);
+  lob_set(inner,"id",token);
+
+  // process the handshake, counted on the link when there is one
+  link = mesh_receive_handshake(mesh, inner);
+  metrics = link ? &link->metrics : &mesh->metrics;
+  metrics->packets_in++;
+  metrics->bytes_in += len;
+  metrics->handshakes_in++;
+  return link;
+}
+
+void mesh_offload(mesh_t mesh, uint8_t (*offload)(mesh_t mesh, lob_t outer, void *arg), void *arg)
+{
+  if(!mesh) return;
+  mesh->offload = offload;
+  mesh->offload_arg = arg;
+}
+
+// called from whichever thread finished the decrypt
+static void mesh_ready(void *arg)
+{
+  mesh_t mesh = arg;
+  if(mesh->async) mesh->async(mesh, mesh->async_arg);
+}
+
+// hands queued handshakes to their cipher sets, only ones w/ a local_decrypt_submit are queued
+static uint32_t mesh_decrypt(void *ctx, lob_t *packets, void **slots, uint32_t count)
+{
+  mesh_t mesh = ctx;
+  uint32_t i;
+  for(i = 0; i < count && e3x_self_decrypt_submit(mesh->self, packets[i], e3x_async_done, slots[i]); i++);
+  return i;
+}
+
+mesh_t mesh_async(mesh_t mesh, void (*ready)(mesh_t mesh, void *arg), void *arg)
+{
+  link_t link;
+  if(!mesh) return LOG("bad args");
+
+  if(ready)
+  {
+    mesh->async = ready;
+    mesh->async_arg = arg;
+    if(!mesh->handshakes && !(mesh->handshakes = e3x_async_new(E3X_ASYNC_DEPTH, mesh_ready, mesh))) return LOG("OOM");
+    for(link = mesh->links;link;link = link->next) link_async(link);
+    return mesh;
+  }
+
+  // apply what's done, the rest is waited for and dropped before anything stops being called
+  mesh_flush(mesh);
+  e3x_async_free(mesh->handshakes);
+  mesh->handshakes = NULL;
+  for(link = mesh->links;link;link = link->next) if(link->x) e3x_exchange_async(link->x, NULL, NULL);
+  mesh->async = NULL;
+  mesh->async_arg = NULL;
+  return mesh;
+}
+
+uint32_t mesh_flush(mesh_t mesh)
+{
+  link_t link, next;
+  lob_t outer, inner;
+  uint32_t count = 0;
+  if(!mesh) return 0;
+
+  // handshakes first, they may bring up the keys the channel packets need
+  e3x_async_flush(mesh->handshakes, mesh_decrypt, mesh);
+  while(e3x_async_pop(mesh->handshakes, &outer, &inner))
+  {
+    count++;
+    mesh_handshake(mesh, outer, inner, lob_len(outer));
+  }
+
+  for(link = mesh->links;link;link = next)
+  {
+    next = link->next;
+    count += link_flush(link);
+  }
+  return count;
+}
+
+link_t mesh_receive_decrypted(mesh_t mesh, lob_t outer, lob_t inner)
+{
+  if(!mesh || !outer || outer->head_len != 1)
+  {
+    lob_free(outer);
+    lob_free(inner);
+    return LOG("bad args");
+  }
+  return mesh_handshake(mesh, outer, inner, lob_len(outer));
+}
+
 // processes incoming packet, it will take ownership of outer
-link_t mesh_receive(mesh_t mesh, lob_t outer)
+static link_t mesh_receive_outer(mesh_t mesh, lob_t outer)
 {
   lob_t inner = NULL;
   link_t link = NULL;
-  char token[17] = {0};
+  char str[53];
   hashname_t id;
+  struct hashname_struct sid;
+  e3x_cipher_t cs;
+  size_t len;
+  uint32_t now;
 
   if(!mesh || !outer) return LOG("bad args");
+  len = lob_len(outer);
   
   LOG("mesh receiving %s to %s",outer->head_len?"handshake":"channel",hashname_short(mesh->id));
 
   // redirect modern routed packets
   if(outer->head_len == 5)
   {
-    id = hashname_sbin(outer->head);
+    id = hashname_sbin_r(outer->head, &sid);
     link = mesh_linkid(mesh, id);
+    mesh->metrics.packets_in++;
+    mesh->metrics.bytes_in += len;
     if(!link)
     {
+      mesh->metrics.dropped++;
       LOG_WARN("unknown id for route request: %s",hashname_short(id));
       lob_free(outer);
       return NULL;
@@ -389,26 +951,41 @@ link_t mesh_receive(mesh_t mesh, lob_t outer)
     return NULL; // don't know the sender
   }
 
-  // process handshakes
-  if(outer->head_len == 1)
+  // unwrap cookie-echoing handshakes, any admission checks already happened in the transport
+  if(outer->head_len > 5 && lob_get(outer,"cookie") && outer->body_len)
   {
-    inner = e3x_self_decrypt(mesh->self, outer);
-    if(!inner)
+    // we never challenge w/o admission, so nothing legit sends these
+    if(!mesh->admit)
     {
-      LOG_WARN("%02x handshake failed %s",outer->head[0],e3x_err());
+      mesh->metrics.dropped++;
       lob_free(outer);
-      return NULL;
+      return LOG("cookie handshake w/o admission enabled");
     }
-    
-    // couple the two together, inner->outer
-    lob_link(inner,outer);
-
-    // set the unique id string based on some of the first 16 (routing token) bytes in the body
-    base32_encode(outer->body,10,token,17);
-    lob_set(inner,"id",token);
+    inner = lob_parse(outer->body,outer->body_len);
+    lob_free(outer);
+    if(!inner || inner->head_len != 1)
+    {
+      lob_free(inner);
+      return LOG("invalid cookie handshake");
+    }
+    outer = inner;
+    inner = NULL;
+  }
 
-    // process the handshake
-    return mesh_receive_handshake(mesh, inner);
+  // process handshakes, the decrypt may happen elsewhere and come back through mesh_receive_decrypted()
+  if(outer->head_len == 1)
+  {
+    if(mesh->offload && mesh->offload(mesh, outer, mesh->offload_arg)) return NULL;
+    if(mesh->handshakes && (cs = e3x_cipher_set(outer->head[0],NULL)) && cs->local_decrypt_submit)
+    {
+      if(e3x_async_push(mesh->handshakes, outer, NULL)) return NULL;
+      mesh->metrics.packets_in++;
+      mesh->metrics.bytes_in += len;
+      mesh->metrics.dropped++;
+      return NULL;
+    }
+    TRACE(UTIL_TRACE_HANDSHAKE, inner = e3x_self_decrypt(mesh->self, outer));
+    return mesh_handshake(mesh, outer, inner, len);
   }
 
   // handle channel packets
@@ -416,22 +993,47 @@ link_t mesh_receive(mesh_t mesh, lob_t outer)
   {
     if(outer->body_len < 16)
     {
+      mesh->metrics.packets_in++;
+      mesh->metrics.bytes_in += len;
+      mesh->metrics.dropped++;
       LOG("packet too small %d",outer->body_len);
       lob_free(outer);
       return NULL;
     }
 
-    for(link = mesh->links;link;link = link->next) if(link->x && memcmp(link->x->token,outer->body,8) == 0) break;
+    for(link = mesh->links;link;link = link->next)
+    {
+      if(!link->x) continue;
+      if(memcmp(link->x->token,outer->body,8) == 0) break;
+      // packets from a peer that hasn't synced to our rekey yet
+      if(link->x->rekeyed && memcmp(link->x->token_old,outer->body,8) == 0) break;
+    }
 
     if(!link)
     {
+      mesh->metrics.packets_in++;
+      mesh->metrics.bytes_in += len;
+      mesh->metrics.dropped++;
       LOG("no link found for token %s",util_hex(outer->body,8,NULL));
       lob_free(outer);
       return NULL;
     }
     
-    inner = e3x_exchange_receive(link->x, outer);
+    // async decrypts are applied in order by mesh_flush()
+    if(link->x->receiving)
+    {
+      link->metrics.packets_in++;
+      link->metrics.bytes_in += len;
+      if(!e3x_exchange_receive_async(link->x, outer)) link->metrics.dropped++;
+      return link;
+    }
+
+    TRACE(UTIL_TRACE_EXCHANGE, inner = e3x_exchange_receive(link->x, outer));
     lob_free(outer);
+    link->metrics.packets_in++;
+    link->metrics.bytes_in += len;
+    if(!inner) link->metrics.decrypt_fails++;
+    else link->last = util_sys_seconds();
     if(!inner) return LOG("channel decryption fail for link %s %s",hashname_short(link->id),e3x_err());
     
     LOG("channel packet %d bytes from %s",lob_len(inner),hashname_short(link->id));
@@ -439,12 +1041,45 @@ link_t mesh_receive(mesh_t mesh, lob_t outer)
     
   }
 
+  // everything else is just counted on the mesh
+  mesh->metrics.packets_in++;
+  mesh->metrics.bytes_in += len;
+
+  // a busy peer is asking for a cookie back w/ our handshake
+  if(lob_get_cmp(outer,"type","cookie") == 0 && (inner = lob_get_base32(outer,"token")))
+  {
+    for(link = mesh->links;link;link = link->next) if(link->x && inner->body_len == 16 && memcmp(link->x->token,inner->body,16) == 0) break;
+    lob_free(inner);
+    if(!link)
+    {
+      LOG("no link found for cookie challenge");
+      lob_free(outer);
+      return NULL;
+    }
+
+    // challenges are unauthenticated, only answer one while our handshake is outstanding, not too often, and only w/ a new cookie
+    now = (uint32_t)util_sys_ms(mesh->since) + 1;
+    if(!link->pinged || (link->cookied && now - link->cookied < MESH_COOKIE_MS) || (link->cookie && lob_get_cmp(link->cookie,"cookie",lob_get(outer,"cookie")) == 0))
+    {
+      LOG_DEBUG("ignoring cookie challenge from %s",hashname_short(link->id));
+      mesh->metrics.dropped++;
+      lob_free(outer);
+      return NULL;
+    }
+    LOG("echoing cookie to %s",hashname_short(link->id));
+    lob_free(link->cookie);
+    link->cookie = outer;
+    link->cookied = now;
+    link_sync(link);
+    return NULL;
+  }
+
   // transform incoming bare link json format into handshake for discovery
   if((inner = lob_get_json(outer,"keys")))
   {
-    if((id = hashname_vkeys(inner)))
+    if((id = hashname_vkeys_r(inner, &sid)))
     {
-      lob_set(outer,"hashname",hashname_char(id));
+      lob_set(outer,"hashname",hashname_char_r(id, str));
       lob_set_int(outer,"at",0);
       lob_set(outer,"type","link");
       LOG("bare incoming link json being discovered %s",lob_json(outer));
@@ -459,3 +1094,10 @@ link_t mesh_receive(mesh_t mesh, lob_t outer)
 
   return link;
 }
+
+link_t mesh_receive(mesh_t mesh, lob_t outer)
+{
+  link_t link;
+  TRACE(UTIL_TRACE_MESH, link = mesh_receive_outer(mesh, outer));
+  return link;
+}
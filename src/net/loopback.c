@@ -1,13 +1,22 @@
 #include <string.h>
 #include "net_loopback.h"
 
+// deliver through the receiver's admission, any cookie challenge goes right back
+static void pair_deliver(mesh_t to, mesh_t from, util_bucket_s *bucket, lob_t packet)
+{
+  lob_t reply = NULL;
+  TRACE(UTIL_TRACE_TRANSPORT, packet = mesh_admit(to, packet, bucket, from->id->bin, sizeof(from->id->bin), &reply));
+  if(packet) mesh_receive(to, packet);
+  else if(reply) mesh_receive(from, reply);
+}
+
 link_t pair_send(link_t link, lob_t packet, void *arg)
 {
   net_loopback_t pair = (net_loopback_t)arg;
   if(!pair || !packet || !link) return link;
   LOG("pair pipe from %s",hashname_short(link->id));
-  if(link->mesh == pair->a) mesh_receive(pair->b,packet);
-  else if(link->mesh == pair->b) mesh_receive(pair->a,packet);
+  if(link->mesh == pair->a) pair_deliver(pair->b,pair->a,&pair->ab,packet);
+  else if(link->mesh == pair->b) pair_deliver(pair->a,pair->b,&pair->ba,packet);
   else lob_free(packet);
   return link;
 }
@@ -3,150 +3,237 @@
 #include <string.h>
 #include "net_serial.h"
 
-
 // individual pipe local info
-typedef struct pipe_serial_struct
+struct pipe_serial_struct
 {
+  char *name;
   int (*read)(void);
+  int (*readbulk)(uint8_t *buf, size_t len);
   int (*write)(uint8_t *buf, size_t len);
   net_serial_t net;
+  link_t link;
   util_chunks_t chunks;
-} *pipe_serial_t;
+  uint32_t idle; // loops w/o any line activity
+  util_bucket_s bucket; // handshake admission for this line
+  pipe_serial_t next;
+};
+
+// forward declare
+link_t serial_send(link_t link, lob_t packet, void *arg);
+
+static pipe_serial_t serial_get(net_serial_t net, const char *name)
+{
+  pipe_serial_t to;
+  for(to = net->pipes; to; to = to->next) if(strcmp(to->name, name) == 0) return to;
+  return NULL;
+}
 
 // do all chunk/socket stuff
-pipe_t serial_flush(pipe_t pipe)
+static pipe_serial_t serial_flush(pipe_serial_t to)
 {
   int ret, count;
-  uint8_t len;
+  uint32_t len;
   lob_t packet;
-  uint8_t c1;
-  pipe_serial_t to;
-  if(!pipe || !(to = (pipe_serial_t)pipe->arg)) return NULL;
+  uint8_t buf[64];
+  if(!to) return NULL;
 
+  // read everything waiting, in bulk when we can
   count = 0;
-  while((ret = to->read()) >= 0)
+  if(to->readbulk)
   {
-    count++;
-    c1 = ret;
-    util_chunks_read(to->chunks, &c1, 1);
+    while((ret = to->readbulk(buf, sizeof(buf))) > 0)
+    {
+      count += ret;
+      util_chunks_read(to->chunks, buf, (size_t)ret);
+    }
+  }else{
+    while((ret = to->read()) >= 0)
+    {
+      buf[count % sizeof(buf)] = (uint8_t)ret;
+      if(++count % sizeof(buf) == 0) util_chunks_read(to->chunks, buf, sizeof(buf));
+    }
+    if(count % sizeof(buf)) util_chunks_read(to->chunks, buf, count % sizeof(buf));
   }
   if(count)
   {
-    LOG("read %d bytes from %s",count,pipe->id);
+    LOG("read %d bytes from %s",count,to->name);
   }
 
   // any incoming full packets can be received
-  while((packet = util_chunks_receive(to->chunks))) mesh_receive(to->net->mesh, packet, pipe);
+  while((packet = util_chunks_receive(to->chunks)))
+  {
+    // shed handshake floods before they're decrypted
+    lob_t reply = NULL;
+    TRACE(UTIL_TRACE_TRANSPORT, packet = mesh_admit(to->net->mesh, packet, &to->bucket, (uint8_t*)to->name, strlen(to->name), &reply));
+    if(!packet)
+    {
+      if(reply) util_chunks_send(to->chunks, reply);
+      continue;
+    }
+    link_t link = mesh_receive(to->net->mesh, packet);
+    if(!link || link == to->link) continue;
+    LOG("adding new link to pipe %s for %s",to->name,hashname_short(link->id));
+    to->link = link;
+    link_pipe(link, serial_send, to);
+  }
 
   // write the next waiting chunk
   while((len = util_chunks_len(to->chunks)))
   {
     if((ret = to->write(util_chunks_write(to->chunks), len)) > 0)
     {
-      LOG("wrote %d size chunk to %s",ret,pipe->id);
-      // blocks till next incoming chunk is read before sending more
-      util_chunks_written(to->chunks,len);
+      LOG("wrote %d size chunk to %s",ret,to->name);
+      util_chunks_written(to->chunks, (size_t)ret);
+      count += ret;
     }else{
-      LOG("chunk write failed, %d != %d",ret,len);
-      // TODO, write a full chunk of zeros to clear any line errors and reset state?
+      // line is busy, try again next loop
       break;
     }
   }
 
-  return pipe;
+  // framed pipes resync if a lost ack, reset or partial chunk leaves the line quiet w/ work pending
+  to->idle = count ? 0 : to->idle + 1;
+  if(to->chunks->framed && to->idle >= NET_SERIAL_STALL && (to->chunks->writing || to->chunks->readlen || to->chunks->readheadat || to->chunks->resync))
+  {
+    LOG("resyncing stalled pipe %s",to->name);
+    util_chunks_resync(to->chunks);
+    to->idle = 0;
+  }
+  if(to->link) to->link->queued = util_chunks_writing(to->chunks) + (uint32_t)to->chunks->readlen;
+
+  return to;
 }
 
 // chunkize a packet
-void serial_send(pipe_t pipe, lob_t packet, link_t link)
+link_t serial_send(link_t link, lob_t packet, void *arg)
 {
-  pipe_serial_t to;
-  if(!pipe || !packet || !(to = (pipe_serial_t)pipe->arg)) return;
+  pipe_serial_t to = (pipe_serial_t)arg;
+  if(!to) return NULL;
+
+  // request to drop
+  if(!packet)
+  {
+    if(to->link == link) to->link = NULL;
+    return link;
+  }
 
   LOG("chunking a packet of len %d",lob_len(packet));
   util_chunks_send(to->chunks, packet);
-  serial_flush(pipe);
+  serial_flush(to);
+  return link;
 }
 
 net_serial_t net_serial_send(net_serial_t net, const char *name, lob_t packet)
 {
-  if(!net || !name || !packet) return NULL;
-  serial_send(xht_get(net->pipes, name), packet, NULL);
+  pipe_serial_t to;
+  if(!net || !name || !packet) return LOG("bad args");
+  if(!(to = serial_get(net, name)))
+  {
+    lob_free(packet);
+    return LOG("unknown pipe %s",name);
+  }
+  util_chunks_send(to->chunks, packet);
+  serial_flush(to);
   return net;
 }
 
-net_serial_t net_serial_add(net_serial_t net, const char *name, int (*read)(void), int (*write)(uint8_t *buf, size_t len), uint8_t buffer)
+static pipe_serial_t serial_add(net_serial_t net, const char *name, int (*write)(uint8_t *buf, size_t len), uint8_t buffer)
 {
-  pipe_t pipe;
   pipe_serial_t to;
 
-  // just sanity checks
-  if(!net || !name || !read || !write) return NULL;
-
-  pipe = xht_get(net->pipes, name);
-  if(!pipe)
+  if((to = serial_get(net, name)))
   {
-    if(!(pipe = pipe_new("serial"))) return NULL;
-    if(!(pipe->arg = to = malloc(sizeof (struct pipe_serial_struct)))) return pipe_free(pipe);
-    memset(to,0,sizeof (struct pipe_serial_struct));
-    to->net = net;
-    if(!(to->chunks = util_chunks_new(buffer)))
-    {
-      free(to);
-      return pipe_free(pipe);
-    }
+    // these can be modified
+    to->write = write;
+    return to;
+  }
 
-    // set up pipe
-    pipe->id = strdup(name);
-    xht_set(net->pipes,pipe->id,pipe);
-    pipe->send = serial_send;
-    
-  }else{
-    if(!(to = (pipe_serial_t)pipe->arg)) return NULL;
+  if(!(to = malloc(sizeof (struct pipe_serial_struct)))) return LOG("OOM");
+  memset(to,0,sizeof (struct pipe_serial_struct));
+  to->net = net;
+  to->write = write;
+  if(!(to->name = strdup(name)) || !(to->chunks = util_chunks_new(buffer)))
+  {
+    free(to->name);
+    free(to);
+    return LOG("OOM");
   }
 
-  // these can be modified
+  to->next = net->pipes;
+  net->pipes = to;
+  return to;
+}
+
+net_serial_t net_serial_add(net_serial_t net, const char *name, int (*read)(void), int (*write)(uint8_t *buf, size_t len), uint8_t buffer)
+{
+  pipe_serial_t to;
+
+  // just sanity checks
+  if(!net || !name || !read || !write) return LOG("bad args");
+  if(!(to = serial_add(net, name, write, buffer))) return NULL;
   to->read = read;
-  to->write = write;
+  to->readbulk = NULL;
+  return net;
+}
 
+net_serial_t net_serial_add_bulk(net_serial_t net, const char *name, int (*read)(uint8_t *buf, size_t len), int (*write)(uint8_t *buf, size_t len), uint8_t buffer)
+{
+  pipe_serial_t to;
+
+  if(!net || !name || !read || !write) return LOG("bad args");
+  if(!(to = serial_add(net, name, write, buffer))) return NULL;
+  to->readbulk = read;
+  to->read = NULL;
+  return net;
+}
+
+net_serial_t net_serial_framed(net_serial_t net, const char *name, uint16_t size, uint8_t window)
+{
+  pipe_serial_t to;
+
+  if(!net || !name) return LOG("bad args");
+  if(!(to = serial_get(net, name))) return LOG("unknown pipe %s",name);
+  if(!util_chunks_framed(util_chunks_v2(to->chunks, size, window))) return NULL;
   return net;
 }
 
 net_serial_t net_serial_new(mesh_t mesh, lob_t options)
 {
   net_serial_t net;
-  unsigned int pipes;
-  
 
+  if(!mesh) return LOG("bad args");
   if(!(net = malloc(sizeof (struct net_serial_struct)))) return LOG("OOM");
   memset(net,0,sizeof (struct net_serial_struct));
-  pipes = lob_get_uint(options,"pipes");
-  if(!pipes) pipes = 3; // hashtable for active pipes
-  net->pipes = xht_new(pipes);
-
-  // connect us to this mesh
   net->mesh = mesh;
-  xht_set(mesh->index, "net_serial", net);
-  
+
   return net;
 }
 
 void net_serial_free(net_serial_t net)
 {
+  pipe_serial_t to;
   if(!net) return;
-  // TODO free pipes!
-  xht_free(net->pipes);
+  while((to = net->pipes))
+  {
+    net->pipes = to->next;
+    // unhook any link still using us
+    if(to->link && to->link->send_arg == to)
+    {
+      to->link->send_cb = NULL;
+      to->link->send_arg = NULL;
+    }
+    util_chunks_free(to->chunks);
+    free(to->name);
+    free(to);
+  }
   free(net);
   return;
 }
 
-// check a single pipe's socket for any read/write activity
-static void _walkflush(xht_t h, const char *key, void *val, void *arg)
-{
-  serial_flush((pipe_t)val);
-}
-
 net_serial_t net_serial_loop(net_serial_t net)
 {
-  xht_walk(net->pipes, _walkflush, NULL);
+  pipe_serial_t to;
+  if(!net) return LOG("bad args");
+  for(to = net->pipes; to; to = to->next) serial_flush(to);
   return net;
 }
@@ -0,0 +1,324 @@
+#include <string.h>
+#include <stdlib.h>
+#include "net_sim.h"
+
+// one direction between two meshes
+typedef struct sim_dir_struct
+{
+  net_sim_t sim;
+  mesh_t from, to;
+  net_sim_cfg_s cfg;
+  net_sim_stats_s stats;
+  uint64_t busy; // when the bandwidth frees up
+  util_bucket_s bucket; // handshake admission for this source
+  struct sim_dir_struct *next;
+} *sim_dir_t;
+
+// a packet in flight, ordered by when it arrives and then when it was sent
+typedef struct sim_event_struct
+{
+  uint64_t at, seq;
+  sim_dir_t dir;
+  lob_t packet;
+} sim_event_s;
+
+struct net_sim_struct
+{
+  uint64_t now, seq, rng;
+  uint32_t secs; // last virtual second the meshes were processed for
+  sim_dir_t dirs;
+  sim_event_s *events; // min heap
+  uint32_t count, size;
+  mesh_t *meshes;
+  uint32_t meshes_len;
+};
+
+// xorshift64*, only the network's choices come from here so runs repeat exactly
+static uint32_t sim_rand(net_sim_t sim)
+{
+  sim->rng ^= sim->rng >> 12;
+  sim->rng ^= sim->rng << 25;
+  sim->rng ^= sim->rng >> 27;
+  return (uint32_t)((sim->rng * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// chance is per million
+static uint8_t sim_chance(net_sim_t sim, uint32_t chance)
+{
+  if(!chance) return 0;
+  return (sim_rand(sim) % 1000000) < chance;
+}
+
+static uint8_t sim_before(sim_event_s *a, sim_event_s *b)
+{
+  return a->at < b->at || (a->at == b->at && a->seq < b->seq);
+}
+
+static uint8_t sim_push(net_sim_t sim, sim_event_s *ev)
+{
+  sim_event_s tmp;
+  uint32_t at, up;
+
+  if(sim->count == sim->size)
+  {
+    uint32_t size = sim->size ? sim->size * 2 : 64;
+    sim_event_s *events = realloc(sim->events, size * sizeof(sim_event_s));
+    if(!events) return 0;
+    sim->events = events;
+    sim->size = size;
+  }
+
+  at = sim->count++;
+  sim->events[at] = *ev;
+  while(at)
+  {
+    up = (at - 1) / 2;
+    if(!sim_before(&sim->events[at], &sim->events[up])) break;
+    tmp = sim->events[up];
+    sim->events[up] = sim->events[at];
+    sim->events[at] = tmp;
+    at = up;
+  }
+  return 1;
+}
+
+static void sim_pop(net_sim_t sim, sim_event_s *ev)
+{
+  sim_event_s tmp;
+  uint32_t at = 0, child;
+
+  *ev = sim->events[0];
+  sim->events[0] = sim->events[--sim->count];
+  while((child = at * 2 + 1) < sim->count)
+  {
+    if(child + 1 < sim->count && sim_before(&sim->events[child + 1], &sim->events[child])) child++;
+    if(!sim_before(&sim->events[child], &sim->events[at])) break;
+    tmp = sim->events[child];
+    sim->events[child] = sim->events[at];
+    sim->events[at] = tmp;
+    at = child;
+  }
+}
+
+static sim_dir_t sim_dir(net_sim_t sim, mesh_t from, mesh_t to)
+{
+  sim_dir_t dir;
+  for(dir = sim->dirs; dir; dir = dir->next) if(dir->from == from && dir->to == to) return dir;
+  return NULL;
+}
+
+// apply the pipe's loss/bandwidth/latency and queue it, takes ownership of packet
+static void sim_enqueue(sim_dir_t dir, lob_t packet)
+{
+  net_sim_t sim = dir->sim;
+  net_sim_cfg_s *cfg = &dir->cfg;
+  sim_event_s ev;
+  uint64_t start, backlog;
+  size_t len = lob_len(packet);
+
+  dir->stats.sent++;
+  if(cfg->mtu && len > cfg->mtu)
+  {
+    dir->stats.mtu++;
+    lob_free(packet);
+    return;
+  }
+  if(sim_chance(sim, cfg->loss))
+  {
+    dir->stats.lost++;
+    lob_free(packet);
+    return;
+  }
+
+  // serialize behind anything still being sent
+  ev.at = sim->now;
+  if(cfg->bandwidth)
+  {
+    start = (dir->busy > sim->now) ? dir->busy : sim->now;
+    backlog = ((start - sim->now) * cfg->bandwidth) / 1000000;
+    if(cfg->queue && backlog + len > cfg->queue)
+    {
+      dir->stats.queue++;
+      lob_free(packet);
+      return;
+    }
+    dir->busy = start + ((uint64_t)len * 1000000) / cfg->bandwidth;
+    ev.at = dir->busy;
+  }
+
+  ev.at += cfg->latency;
+  if(cfg->jitter)
+  {
+    uint32_t spread = sim_rand(sim) % (2 * cfg->jitter + 1);
+    ev.at = (ev.at + spread < sim->now + cfg->jitter) ? sim->now : ev.at + spread - cfg->jitter;
+  }
+  if(sim_chance(sim, cfg->reorder))
+  {
+    dir->stats.reordered++;
+    ev.at += (cfg->latency > 1000 ? cfg->latency : 1000) + cfg->jitter;
+  }
+
+  ev.seq = sim->seq++;
+  ev.dir = dir;
+  ev.packet = packet;
+  if(!sim_push(sim, &ev))
+  {
+    LOG_WARN("OOM, dropping packet");
+    dir->stats.queue++;
+    lob_free(packet);
+  }
+}
+
+// the link's pipe, the arg is the direction
+static link_t sim_send(link_t link, lob_t packet, void *arg)
+{
+  // link is being dropped, nothing to clean up
+  if(!packet) return link;
+  sim_enqueue((sim_dir_t)arg, packet);
+  return link;
+}
+
+static void sim_deliver(sim_event_s *ev)
+{
+  sim_dir_t dir = ev->dir, back;
+  lob_t packet, reply = NULL;
+  link_t link;
+
+  dir->stats.delivered++;
+  dir->stats.bytes += lob_len(ev->packet);
+  back = sim_dir(dir->sim, dir->to, dir->from);
+  TRACE(UTIL_TRACE_TRANSPORT, packet = mesh_admit(dir->to, ev->packet, &dir->bucket, dir->from->id->bin, sizeof(dir->from->id->bin), &reply));
+  if(!packet)
+  {
+    if(reply && back) sim_enqueue(back, reply);
+    else lob_free(reply);
+    return;
+  }
+
+  // any new link on the receiving side gets the pipe back
+  if((link = mesh_receive(dir->to, packet)) && back) link_pipe(link, sim_send, back);
+}
+
+// every mesh sees each virtual second pass
+static void sim_process(net_sim_t sim)
+{
+  uint32_t secs = (uint32_t)(sim->now / 1000000) + 1, i;
+  while(sim->secs < secs)
+  {
+    sim->secs++;
+    for(i = 0; i < sim->meshes_len; i++) mesh_process(sim->meshes[i], sim->secs);
+  }
+}
+
+net_sim_t net_sim_new(uint32_t seed)
+{
+  net_sim_t sim;
+  if(!(sim = malloc(sizeof (struct net_sim_struct)))) return LOG("OOM");
+  memset(sim, 0, sizeof (struct net_sim_struct));
+  sim->rng = ((uint64_t)seed << 32) ^ 0x9E3779B97F4A7C15ULL;
+  return sim;
+}
+
+void net_sim_free(net_sim_t sim)
+{
+  sim_dir_t dir;
+  if(!sim) return;
+  while(sim->count) lob_free(sim->events[--sim->count].packet);
+  while((dir = sim->dirs))
+  {
+    sim->dirs = dir->next;
+    free(dir);
+  }
+  free(sim->events);
+  free(sim->meshes);
+  free(sim);
+}
+
+static sim_dir_t sim_dir_get(net_sim_t sim, mesh_t from, mesh_t to)
+{
+  sim_dir_t dir;
+  mesh_t *meshes;
+  uint32_t i;
+
+  if((dir = sim_dir(sim, from, to))) return dir;
+  if(!(dir = malloc(sizeof (struct sim_dir_struct)))) return LOG("OOM");
+  memset(dir, 0, sizeof (struct sim_dir_struct));
+  dir->sim = sim;
+  dir->from = from;
+  dir->to = to;
+  dir->next = sim->dirs;
+  sim->dirs = dir;
+
+  // track each mesh once for processing
+  for(i = 0; i < sim->meshes_len && sim->meshes[i] != from; i++);
+  if(i == sim->meshes_len && (meshes = realloc(sim->meshes, (i + 1) * sizeof(mesh_t))))
+  {
+    sim->meshes = meshes;
+    sim->meshes[sim->meshes_len++] = from;
+  }
+  return dir;
+}
+
+net_sim_t net_sim_direction(net_sim_t sim, mesh_t from, mesh_t to, net_sim_cfg_s *cfg)
+{
+  sim_dir_t dir;
+  if(!sim || !from || !to || from == to) return LOG("bad args");
+  if(!(dir = sim_dir_get(sim, from, to))) return NULL;
+  if(cfg) dir->cfg = *cfg;
+  else memset(&dir->cfg, 0, sizeof(net_sim_cfg_s));
+  return sim;
+}
+
+net_sim_t net_sim_pipe(net_sim_t sim, mesh_t a, mesh_t b, net_sim_cfg_s *cfg)
+{
+  sim_dir_t ab, ba;
+  if(!net_sim_direction(sim, a, b, cfg) || !net_sim_direction(sim, b, a, cfg)) return NULL;
+  ab = sim_dir(sim, a, b);
+  ba = sim_dir(sim, b, a);
+
+  // link and pipe them, the handshakes go out as the first events
+  link_pipe(link_get_keys(a, b->keys), sim_send, ab);
+  link_pipe(link_get_keys(b, a->keys), sim_send, ba);
+  return sim;
+}
+
+net_sim_stats_s *net_sim_stats(net_sim_t sim, mesh_t from, mesh_t to)
+{
+  sim_dir_t dir;
+  if(!sim || !(dir = sim_dir(sim, from, to))) return NULL;
+  return &dir->stats;
+}
+
+uint64_t net_sim_now(net_sim_t sim)
+{
+  if(!sim) return 0;
+  return sim->now;
+}
+
+uint32_t net_sim_run(net_sim_t sim, uint64_t us)
+{
+  sim_event_s ev;
+  uint64_t end;
+  uint32_t count = 0;
+
+  if(!sim) return 0;
+  end = sim->now + us;
+  sim_process(sim);
+  while(sim->count && sim->events[0].at <= end)
+  {
+    sim_pop(sim, &ev);
+    sim->now = ev.at;
+    sim_process(sim);
+    sim_deliver(&ev);
+    count++;
+  }
+  sim->now = end;
+  sim_process(sim);
+  return count;
+}
+
+uint32_t net_sim_pending(net_sim_t sim)
+{
+  if(!sim) return 0;
+  return sim->count;
+}
@@ -3,8 +3,13 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include "net_udp4.h"
 
+// largest udp payload, minus our datagram header
+#define UDP4_MAX (65507 - UTIL_FRAMES_DGRAM_HDR)
+#define UDP4_MAGIC 42
+
 // individual pipe local info
 typedef struct pipe_struct
 {
@@ -13,6 +18,7 @@ typedef struct pipe_struct
   net_udp4_t net;
   struct pipe_struct *next;
   struct sockaddr_in sa;
+  util_bucket_s bucket; // handshake admission for this source
 } *pipe_t;
 
 // overall server
@@ -79,7 +85,7 @@ pipe_t udp4_pipe(net_udp4_t net, struct sockaddr_in *from)
   to->sa.sin_family = AF_INET;
   to->sa.sin_addr = from->sin_addr;
   to->sa.sin_port = from->sin_port;
-  to->frames = util_frames_new(1280,42);
+  to->frames = util_frames_new(UDP4_MAGIC,UDP4_MAX);
   
   // link into list
   to->next = net->pipes;
@@ -143,7 +149,7 @@ net_udp4_t net_udp4_process(net_udp4_t net)
   struct sockaddr_in sa;
   size_t salen = sizeof(sa);
   memset(&sa,0,salen);
-  uint8_t frame[1280];
+  uint8_t frame[UDP4_MAX + UTIL_FRAMES_DGRAM_HDR];
   
   // try receiving anything waiting
   pipe_t pipe = NULL;
@@ -162,7 +168,7 @@ net_udp4_t net_udp4_process(net_udp4_t net)
     if(pipe)
     {
       LOG_CRAZY("receive from %s at %s:%u",(pipe->link)?hashname_short(pipe->link->id):"unknown",inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port));
-      util_frames_inbox(pipe->frames, frame, len);
+      util_frames_dgram_inbox(pipe->frames, frame, (uint32_t)len);
     }
   }
 
@@ -176,6 +182,14 @@ net_udp4_t net_udp4_process(net_udp4_t net)
     lob_t packet = NULL;
     while((packet = util_frames_receive(pipe->frames)))
     {
+      // shed handshake floods before they're decrypted
+      lob_t reply = NULL;
+      TRACE(UTIL_TRACE_TRANSPORT, packet = mesh_admit(net->mesh, packet, &pipe->bucket, (uint8_t*)&(pipe->sa), sizeof(pipe->sa), &reply));
+      if(!packet)
+      {
+        if(reply) util_frames_send(pipe->frames, reply);
+        continue;
+      }
       link_t link = mesh_receive(net->mesh, packet);
       if(!link) continue;
       if(link != pipe->link)
@@ -186,11 +200,20 @@ net_udp4_t net_udp4_process(net_udp4_t net)
       }
     }
     
-    // send all/any waiting frames
+    // send all/any waiting packets, header and packet together in one datagram
+    uint8_t hdr[UTIL_FRAMES_DGRAM_HDR];
+    uint32_t len = 0;
     uint8_t *out = NULL;
-    while((out = util_frames_outbox(pipe->frames)))
+    while((out = util_frames_dgram_outbox(pipe->frames, hdr, &len)))
     {
-      if(sendto(net->server, out, util_frames_pending(pipe->frames), 0, (struct sockaddr *)&(pipe->sa), sizeof(struct sockaddr_in)) < 0)
+      struct iovec iov[2] = {{hdr, sizeof(hdr)}, {out, len}};
+      struct msghdr msg;
+      memset(&msg,0,sizeof(msg));
+      msg.msg_name = &(pipe->sa);
+      msg.msg_namelen = sizeof(struct sockaddr_in);
+      msg.msg_iov = iov;
+      msg.msg_iovlen = 2;
+      if(sendmsg(net->server, &msg, 0) < 0)
       {
         LOG_WARN("sendto failed: %s to %s:%u",strerror(errno),inet_ntoa(pipe->sa.sin_addr), ntohs(pipe->sa.sin_port));
         break;
@@ -198,6 +221,7 @@ net_udp4_t net_udp4_process(net_udp4_t net)
       // only continue if sent says there's more
       if(!util_frames_sent(pipe->frames)) break;
     }
+    if(pipe->link) pipe->link->queued = util_frames_inlen(pipe->frames) + util_frames_outlen(pipe->frames);
   }
   
   return net;
@@ -221,10 +245,11 @@ net_udp4_t net_udp4_direct(net_udp4_t net, lob_t packet, char *ip, uint16_t port
 
   struct sockaddr_in sa;
   memset(&sa,0,sizeof(sa));
+  sa.sin_family = AF_INET;
   inet_aton(ip, &(sa.sin_addr));
   sa.sin_port = htons(port);
   pipe_t pipe = udp4_pipe(net, &sa);
-  if(!port)
+  if(!pipe)
   {
     lob_free(packet);
     return LOG_WARN("direct pipe failed to %s:%u",ip,port);
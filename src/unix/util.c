@@ -7,17 +7,18 @@
 #include <time.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "telehash.h"
 
 #include "telehash.h"
 
-lob_t util_fjson(char *file)
+// whole file into a new buffer
+static uint8_t *util_fread(char *file, size_t *len)
 {
-  unsigned char *buf;
-  size_t len;
+  uint8_t *buf;
   struct stat fs;
   FILE *fd;
-  lob_t p;
   
   fd = fopen(file,"rb");
   if(!fd) return LOG("fopen error %s: %s",file,strerror(errno));
@@ -32,13 +33,24 @@ lob_t util_fjson(char *file)
     fclose(fd);
     return LOG("OOM");
   }
-  len = fread(buf,1,(size_t)fs.st_size,fd);
+  *len = fread(buf,1,(size_t)fs.st_size,fd);
   fclose(fd);
-  if(len != (size_t)fs.st_size)
+  if(*len != (size_t)fs.st_size)
   {
     free(buf);
-    return LOG("fread %d != %d for %s: %s",len,fs.st_size,file,strerror(errno));
+    return LOG("fread %d != %d for %s: %s",*len,fs.st_size,file,strerror(errno));
   }
+
+  return buf;
+}
+
+lob_t util_fjson(char *file)
+{
+  uint8_t *buf;
+  size_t len = 0;
+  lob_t p;
+  
+  if(!(buf = util_fread(file,&len))) return NULL;
   
   p = lob_new();
   lob_head(p, buf, len);
@@ -47,6 +59,63 @@ lob_t util_fjson(char *file)
   return p;
 }
 
+mesh_t util_fsave(mesh_t mesh, char *file)
+{
+  char tmp[256];
+  FILE *fd;
+  int fdn;
+  size_t len;
+  lob_t saved;
+
+  if(!mesh || !file || strlen(file) > sizeof(tmp)-5) return LOG("bad args");
+  if(!(saved = mesh_save(mesh))) return NULL;
+
+  // only readable by us, and swapped in whole
+  snprintf(tmp,sizeof(tmp),"%s.tmp",file);
+  if((fdn = open(tmp,O_WRONLY|O_CREAT|O_TRUNC,0600)) < 0 || !(fd = fdopen(fdn,"wb")))
+  {
+    if(fdn >= 0) close(fdn);
+    lob_free(saved);
+    return LOG("open error %s: %s",tmp,strerror(errno));
+  }
+  len = fwrite(lob_raw(saved),1,lob_len(saved),fd);
+  fclose(fd);
+  if(len != lob_len(saved) || rename(tmp,file) != 0)
+  {
+    unlink(tmp);
+    lob_free(saved);
+    return LOG("write error %s: %s",file,strerror(errno));
+  }
+
+  lob_free(saved);
+  return mesh;
+}
+
+uint32_t util_frestore(mesh_t mesh, char *file)
+{
+  uint8_t *buf;
+  size_t len = 0;
+  uint32_t count;
+  lob_t saved;
+
+  if(!mesh || !file) return 0;
+  if(!(buf = util_fread(file,&len))) return 0;
+
+  // consumed before any resumed link can send, a crash after this just means new handshakes
+  if(unlink(file) != 0)
+  {
+    free(buf);
+    LOG("can't consume %s, not restoring: %s",file,strerror(errno));
+    return 0;
+  }
+  saved = lob_parse(buf,len);
+  util_zero(buf,len);
+  free(buf);
+  count = mesh_restore(mesh, saved);
+  lob_free(saved);
+  return count;
+}
+
 mesh_t util_links(mesh_t mesh, char *file)
 {
   lob_t links = util_fjson(file);
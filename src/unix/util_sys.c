@@ -23,6 +23,13 @@ unsigned long long util_sys_ms(long epoch)
   return (unsigned long long)(tv.tv_sec - epoch) * 1000 + (unsigned long long)(tv.tv_usec) / 1000;
 }
 
+uint64_t util_sys_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
 unsigned short util_sys_short(unsigned short x)
 {
   return ntohs(x);
@@ -52,9 +59,27 @@ long util_sys_random(void)
 
 #ifdef DEBUG
 static int _logging = 1;
+int util_sys_log_max = 8;
 #else
 static int _logging = 0;
+int util_sys_log_max = -1;
 #endif
+static int _log_level = 8;
+
+// async ring, each slot's seq says whose turn it is (bounded mpsc queue)
+#define LOG_LINE 384
+typedef struct log_slot_struct
+{
+  uint32_t seq;
+  char line[LOG_LINE];
+} log_slot_s;
+static log_slot_s *_ring = NULL;
+static uint32_t _ring_mask = 0, _ring_head = 0, _ring_tail = 0, _ring_dropped = 0;
+
+static void util_sys_log_update(void)
+{
+  util_sys_log_max = _logging ? _log_level : -1;
+}
 
 void util_sys_logging(int enabled)
 {
@@ -64,14 +89,87 @@ void util_sys_logging(int enabled)
   }else{
     _logging = enabled;    
   }
+  util_sys_log_update();
   LOG("log output enabled");
 }
 
+void util_sys_log_level(int level)
+{
+  _log_level = level;
+  util_sys_log_update();
+}
+
+uint8_t util_sys_log_async(uint16_t slots)
+{
+  uint32_t i, size = 1;
+
+  util_sys_log_flush();
+  free(_ring);
+  _ring = NULL;
+  _ring_mask = _ring_head = _ring_tail = 0;
+  if(!slots) return 0;
+
+  while(size < slots) size <<= 1;
+  if(!(_ring = malloc(size * sizeof(log_slot_s)))) return 1;
+  for(i = 0; i < size; i++) _ring[i].seq = i;
+  _ring_mask = size - 1;
+  return 0;
+}
+
+uint32_t util_sys_log_flush(void)
+{
+  uint32_t count = 0;
+  log_slot_s *slot;
+
+  if(!_ring) return 0;
+  for(;;)
+  {
+    slot = &_ring[_ring_tail & _ring_mask];
+    if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != _ring_tail + 1) break;
+    fputs(slot->line, stderr);
+    __atomic_store_n(&slot->seq, _ring_tail + _ring_mask + 1, __ATOMIC_RELEASE);
+    _ring_tail++;
+    count++;
+  }
+  if(count) fflush(stderr);
+  return count;
+}
+
+uint32_t util_sys_log_dropped(void)
+{
+  return __atomic_load_n(&_ring_dropped, __ATOMIC_RELAXED);
+}
+
+// claim the next free slot, NULL when full
+static log_slot_s *util_sys_log_claim(uint32_t *at)
+{
+  log_slot_s *slot;
+  uint32_t pos = __atomic_load_n(&_ring_head, __ATOMIC_RELAXED);
+  for(;;)
+  {
+    slot = &_ring[pos & _ring_mask];
+    int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+    if(diff == 0)
+    {
+      if(__atomic_compare_exchange_n(&_ring_head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+    }else if(diff < 0){
+      __atomic_fetch_add(&_ring_dropped, 1, __ATOMIC_RELAXED);
+      return NULL;
+    }else{
+      pos = __atomic_load_n(&_ring_head, __ATOMIC_RELAXED);
+    }
+  }
+  *at = pos;
+  return slot;
+}
+
 void *util_sys_log(uint8_t level, const char *file, int line, const char *function, const char * format, ...)
 {
   char buffer[256];
   va_list args;
-  if(!_logging) return NULL;
+  log_slot_s *slot;
+  uint32_t at;
+  if(!_logging || level > _log_level) return NULL;
   // https://en.wikipedia.org/wiki/Syslog#Severity_level
   char *lstr = NULL;
   switch(level)
@@ -89,9 +187,19 @@ void *util_sys_log(uint8_t level, const char *file, int line, const char *functi
   }
   va_start (args, format);
   vsnprintf (buffer, 256, format, args);
+  va_end (args);
+
+  // queued lines are written out by util_sys_log_flush()
+  if(_ring)
+  {
+    if(!(slot = util_sys_log_claim(&at))) return NULL;
+    snprintf(slot->line, LOG_LINE, "%s%s:%d %s() %s\n",lstr,file, line, function, buffer);
+    __atomic_store_n(&slot->seq, at + 1, __ATOMIC_RELEASE);
+    return NULL;
+  }
+
   fprintf(stderr,"%s%s:%d %s() %s\n",lstr,file, line, function, buffer);
   fflush(stderr);
-  va_end (args);
   return NULL;
 }
 
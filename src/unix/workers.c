@@ -0,0 +1,630 @@
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "telehash.h"
+#include "mesh_workers.h"
+
+#define WORK_PACKET 1
+#define WORK_CALL 2
+#define WORK_DECRYPT 3 // a handshake to decrypt on a crypto thread
+#define WORK_HANDSHAKE 4 // and its result back on the mesh's worker
+
+// how many queued items a worker handles before checking its timers
+#define WORK_BATCH 64
+
+// a queue slot, seq says whose turn it is (bounded, same as the async log ring)
+typedef struct work_item_struct
+{
+  uint32_t seq;
+  uint8_t kind;
+  mesh_t mesh;
+  lob_t packet, inner;
+  mesh_workers_pipe_t pipe;
+  void (*call)(mesh_t mesh, void *arg);
+  void *arg;
+} work_item_s;
+
+typedef struct work_queue_struct
+{
+  work_item_s *ring;
+  uint32_t mask, head, tail;
+  pthread_mutex_t lock; // only to sleep/wake on
+  pthread_cond_t wake;
+  uint32_t idle; // threads sleeping on it
+  uint32_t dropped;
+} work_queue_s;
+
+typedef struct worker_struct
+{
+  mesh_workers_t w;
+  uint8_t index;
+  pthread_t thread;
+  work_queue_s *queue; // its own, or the shared crypto one
+  uint32_t processed;
+} *worker_t;
+
+struct mesh_workers_struct
+{
+  struct worker_struct *workers;
+  work_queue_s *queues;
+  uint8_t count, started;
+  struct worker_struct *cryptos; // the handshake decrypt pool, see mesh_workers_offload()
+  work_queue_s crypto;
+  uint8_t cryptos_count, cryptos_started;
+  uint32_t offloaded;
+  uint32_t running;
+  mesh_t meshes[MESH_WORKERS_MAX];
+  uint8_t csids[MESH_WORKERS_MAX][32]; // bitmap of each mesh's cipher sets, for handshakes
+  uint8_t meshes_len;
+  uint64_t *tokens; // 7 bytes of token and the mesh index + 1 packed so they change together
+  uint32_t routed, broadcast, unrouted;
+};
+
+static uint8_t work_queue_init(work_queue_s *q, uint32_t size)
+{
+  uint32_t i;
+  memset(q, 0, sizeof(work_queue_s));
+  if(!(q->ring = malloc(size * sizeof(work_item_s)))) return 0;
+  for(i = 0; i < size; i++) q->ring[i].seq = i;
+  q->mask = size - 1;
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->wake, NULL);
+  return 1;
+}
+
+static uint8_t work_push(work_queue_s *q, work_item_s *item)
+{
+  work_item_s *slot;
+  uint32_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+  for(;;)
+  {
+    slot = &q->ring[pos & q->mask];
+    int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+    if(diff == 0)
+    {
+      if(__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+    }else if(diff < 0){
+      __atomic_fetch_add(&q->dropped, 1, __ATOMIC_RELAXED);
+      return 0;
+    }else{
+      pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+  }
+  slot->kind = item->kind;
+  slot->mesh = item->mesh;
+  slot->packet = item->packet;
+  slot->inner = item->inner;
+  slot->pipe = item->pipe;
+  slot->call = item->call;
+  slot->arg = item->arg;
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+  // wake one only if any are (about to be) sleeping
+  if(__atomic_load_n(&q->idle, __ATOMIC_SEQ_CST))
+  {
+    pthread_mutex_lock(&q->lock);
+    pthread_cond_signal(&q->wake);
+    pthread_mutex_unlock(&q->lock);
+  }
+  return 1;
+}
+
+// the crypto threads share a queue so popping claims the slot too
+static uint8_t work_pop(work_queue_s *q, work_item_s *item)
+{
+  work_item_s *slot;
+  uint32_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+  for(;;)
+  {
+    slot = &q->ring[pos & q->mask];
+    int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) - (pos + 1));
+    if(diff == 0)
+    {
+      if(__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+    }else if(diff < 0){
+      return 0;
+    }else{
+      pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    }
+  }
+  *item = *slot;
+  __atomic_store_n(&slot->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+static uint8_t work_waiting(work_queue_s *q)
+{
+  uint32_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+  return __atomic_load_n(&q->ring[pos & q->mask].seq, __ATOMIC_SEQ_CST) == pos + 1;
+}
+
+// sleep until woken or the next timer check
+static void work_wait(mesh_workers_t w, work_queue_s *q)
+{
+  struct timespec until;
+
+  pthread_mutex_lock(&q->lock);
+  __atomic_add_fetch(&q->idle, 1, __ATOMIC_SEQ_CST);
+  if(!work_waiting(q) && __atomic_load_n(&w->running, __ATOMIC_ACQUIRE))
+  {
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += 100000000;
+    if(until.tv_nsec >= 1000000000)
+    {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&q->wake, &q->lock, &until);
+  }
+  __atomic_sub_fetch(&q->idle, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static void work_wake(work_queue_s *q)
+{
+  pthread_mutex_lock(&q->lock);
+  pthread_cond_broadcast(&q->wake);
+  pthread_mutex_unlock(&q->lock);
+}
+
+// only once every thread is stopped
+static void work_queue_free(work_queue_s *q)
+{
+  work_item_s item;
+  if(!q->ring) return;
+  while(work_pop(q, &item))
+  {
+    lob_free(item.packet);
+    lob_free(item.inner);
+  }
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->wake);
+  free(q->ring);
+  q->ring = NULL;
+}
+
+static int work_index(mesh_workers_t w, mesh_t mesh)
+{
+  uint8_t i;
+  for(i = 0; i < w->meshes_len; i++) if(w->meshes[i] == mesh) return i;
+  return -1;
+}
+
+static uint64_t work_token_key(uint8_t *token)
+{
+  uint64_t key = 0;
+  uint8_t i;
+  for(i = 0; i < 7; i++) key = (key << 8) | token[i];
+  return key << 8;
+}
+
+// tokens are random, the first bytes are a fine hash
+static uint32_t work_token_slot(uint8_t *token)
+{
+  return ((uint32_t)token[0] | (uint32_t)token[1] << 8 | (uint32_t)token[2] << 16) & (MESH_WORKERS_TOKENS - 1);
+}
+
+static int work_token_get(mesh_workers_t w, uint8_t *token)
+{
+  uint64_t key = work_token_key(token), slot;
+  uint32_t at = work_token_slot(token), i;
+  for(i = 0; i < 4; i++)
+  {
+    slot = __atomic_load_n(&w->tokens[(at + i) & (MESH_WORKERS_TOKENS - 1)], __ATOMIC_ACQUIRE);
+    if(slot && (slot & ~0xffULL) == key) return (int)(slot & 0xff) - 1;
+  }
+  return -1;
+}
+
+// stale entries only ever misroute to a mesh that drops it, so a full probe just takes the first slot
+static void work_token_set(mesh_workers_t w, uint8_t *token, uint8_t index)
+{
+  uint64_t key = work_token_key(token), slot, want = key | (uint64_t)(index + 1);
+  uint32_t at = work_token_slot(token), i;
+  uint64_t *tokens = w->tokens;
+  for(i = 0; i < 4; i++)
+  {
+    uint64_t *one = &tokens[(at + i) & (MESH_WORKERS_TOKENS - 1)];
+    slot = __atomic_load_n(one, __ATOMIC_ACQUIRE);
+    if(slot == want) return;
+    if(!slot || (slot & ~0xffULL) == key)
+    {
+      if(__atomic_compare_exchange_n(one, &slot, want, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return;
+    }
+  }
+  __atomic_store_n(&tokens[at], want, __ATOMIC_RELEASE);
+}
+
+// so channel packets for this link route straight to its mesh
+static void work_publish(mesh_workers_t w, link_t link, uint8_t index)
+{
+  if(!link || !link->x) return;
+  if(work_token_get(w, link->x->token) != index) work_token_set(w, link->x->token, index);
+}
+
+// the packet a worker is in mesh_receive() for, so an offloaded handshake keeps its pipe
+static UTIL_TLS work_item_s *work_current = NULL;
+
+static void work_handle(worker_t worker, work_item_s *item)
+{
+  mesh_workers_t w = worker->w;
+  link_t link;
+  int index = work_index(w, item->mesh);
+
+  if(item->kind == WORK_CALL)
+  {
+    item->call(item->mesh, item->arg);
+    // whatever it did may have created or resumed links
+    for(link = item->mesh->links; link; link = link->next) work_publish(w, link, (uint8_t)index);
+    return;
+  }
+
+  if(item->kind == WORK_HANDSHAKE)
+  {
+    link = mesh_receive_decrypted(item->mesh, item->packet, item->inner);
+  }else{
+    work_current = item;
+    link = mesh_receive(item->mesh, item->packet);
+    work_current = NULL;
+  }
+  if(link)
+  {
+    if(item->pipe) link_pipe(link, item->pipe, item->arg);
+    work_publish(w, link, (uint8_t)index);
+  }
+}
+
+static void *work_run(void *arg)
+{
+  worker_t worker = (worker_t)arg;
+  mesh_workers_t w = worker->w;
+  work_item_s item;
+  uint32_t now, last = 0, count;
+  uint8_t i;
+
+  while(__atomic_load_n(&w->running, __ATOMIC_ACQUIRE))
+  {
+    for(count = 0; count < WORK_BATCH && work_pop(worker->queue, &item); count++) work_handle(worker, &item);
+    __atomic_fetch_add(&worker->processed, count, __ATOMIC_RELAXED);
+
+    // timers for every mesh this thread owns
+    if((now = util_sys_seconds()) != last)
+    {
+      last = now;
+      for(i = worker->index; i < w->meshes_len; i += w->count) mesh_process(w->meshes[i], now);
+    }
+    if(!count) work_wait(w, worker->queue);
+  }
+
+  return NULL;
+}
+
+// the mesh's offload hook, on its worker inside mesh_receive(), a full queue drops it rather than block the worker
+static uint8_t work_offload(mesh_t mesh, lob_t outer, void *arg)
+{
+  mesh_workers_t w = (mesh_workers_t)arg;
+  work_item_s item;
+
+  memset(&item, 0, sizeof(item));
+  item.kind = WORK_DECRYPT;
+  item.mesh = mesh;
+  item.packet = outer;
+  if(work_current)
+  {
+    item.pipe = work_current->pipe;
+    item.arg = work_current->arg;
+  }
+  if(work_push(&w->crypto, &item))
+  {
+    __atomic_fetch_add(&w->offloaded, 1, __ATOMIC_RELAXED);
+    return 1;
+  }
+  mesh->metrics.dropped++;
+  LOG_DEBUG("handshake queue full, dropping");
+  lob_free(outer);
+  return 1;
+}
+
+// only decrypts, the locals are safe to share (cs1c locks its secret cache) so any thread can, everything else happens back on the mesh's worker
+static void *work_crypto(void *arg)
+{
+  worker_t crypto = (worker_t)arg;
+  mesh_workers_t w = crypto->w;
+  work_item_s item;
+  int index;
+
+  while(__atomic_load_n(&w->running, __ATOMIC_ACQUIRE))
+  {
+    if(!work_pop(&w->crypto, &item))
+    {
+      work_wait(w, &w->crypto);
+      continue;
+    }
+    item.kind = WORK_HANDSHAKE;
+    item.inner = e3x_self_decrypt(item.mesh->self, item.packet);
+    index = work_index(w, item.mesh);
+    if(!work_push(&w->queues[index % w->count], &item))
+    {
+      lob_free(item.packet);
+      lob_free(item.inner);
+    }
+    __atomic_fetch_add(&crypto->processed, 1, __ATOMIC_RELAXED);
+  }
+
+  return NULL;
+}
+
+static uint32_t work_size(uint32_t depth)
+{
+  uint32_t size = 1;
+  while(size < depth) size <<= 1;
+  return size;
+}
+
+mesh_workers_t mesh_workers_new(uint8_t threads, uint32_t depth)
+{
+  mesh_workers_t w;
+  uint32_t i;
+
+  if(!threads)
+  {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (cpus < 1) ? 1 : (cpus > 255) ? 255 : (uint8_t)cpus;
+  }
+  if(!depth) return LOG("bad args");
+
+  if(!(w = malloc(sizeof (struct mesh_workers_struct)))) return LOG("OOM");
+  memset(w, 0, sizeof (struct mesh_workers_struct));
+  if(!(w->tokens = malloc(MESH_WORKERS_TOKENS * sizeof(uint64_t))) || !(w->workers = malloc(threads * sizeof (struct worker_struct))) || !(w->queues = malloc(threads * sizeof(work_queue_s))))
+  {
+    free(w->tokens);
+    free(w->workers);
+    free(w);
+    return LOG("OOM");
+  }
+  memset(w->tokens, 0, MESH_WORKERS_TOKENS * sizeof(uint64_t));
+  memset(w->workers, 0, threads * sizeof (struct worker_struct));
+
+  for(i = 0; i < threads; i++)
+  {
+    worker_t worker = &w->workers[i];
+    worker->w = w;
+    worker->index = (uint8_t)i;
+    worker->queue = &w->queues[i];
+    if(!work_queue_init(worker->queue, work_size(depth))) break;
+    w->count++;
+  }
+  if(w->count != threads)
+  {
+    mesh_workers_free(w);
+    return LOG("OOM");
+  }
+
+  return w;
+}
+
+mesh_workers_t mesh_workers_offload(mesh_workers_t w, uint8_t threads, uint32_t depth)
+{
+  uint8_t i;
+
+  if(!w || !threads || !depth || w->started || w->cryptos) return LOG("bad args");
+  if(!(w->cryptos = malloc(threads * sizeof (struct worker_struct)))) return LOG("OOM");
+  memset(w->cryptos, 0, threads * sizeof (struct worker_struct));
+  if(!work_queue_init(&w->crypto, work_size(depth)))
+  {
+    free(w->cryptos);
+    w->cryptos = NULL;
+    return LOG("OOM");
+  }
+  for(i = 0; i < threads; i++)
+  {
+    w->cryptos[i].w = w;
+    w->cryptos[i].index = i;
+    w->cryptos[i].queue = &w->crypto;
+  }
+  w->cryptos_count = threads;
+  return w;
+}
+
+// stop and join every thread
+static void work_stop(mesh_workers_t w)
+{
+  uint8_t i;
+
+  __atomic_store_n(&w->running, 0, __ATOMIC_RELEASE);
+  for(i = 0; i < w->count; i++) work_wake(&w->queues[i]);
+  if(w->cryptos) work_wake(&w->crypto);
+  for(i = 0; i < w->started; i++) pthread_join(w->workers[i].thread, NULL);
+  for(i = 0; i < w->cryptos_started; i++) pthread_join(w->cryptos[i].thread, NULL);
+  w->started = w->cryptos_started = 0;
+  for(i = 0; i < w->meshes_len; i++) mesh_offload(w->meshes[i], NULL, NULL);
+}
+
+mesh_workers_t mesh_workers_free(mesh_workers_t w)
+{
+  uint8_t i;
+
+  if(!w) return NULL;
+  work_stop(w);
+
+  for(i = 0; i < w->count; i++) work_queue_free(&w->queues[i]);
+  work_queue_free(&w->crypto);
+  free(w->cryptos);
+  free(w->queues);
+  free(w->workers);
+  free(w->tokens);
+  free(w);
+  return NULL;
+}
+
+int mesh_workers_add(mesh_workers_t w, mesh_t mesh)
+{
+  uint8_t i, index;
+  e3x_cipher_t cs;
+
+  if(!w || !mesh || !mesh->id || w->started) return -1;
+  if(work_index(w, mesh) >= 0) return work_index(w, mesh) % w->count;
+  if(w->meshes_len == MESH_WORKERS_MAX) return -1;
+
+  index = w->meshes_len++;
+  w->meshes[index] = mesh;
+  for(i = 0; i < CS_MAX; i++)
+  {
+    if(!(cs = e3x_cipher_sets[i]) || !lob_get(mesh->keys, cs->hex)) continue;
+    w->csids[index][cs->csid >> 3] |= (uint8_t)(1 << (cs->csid & 7));
+  }
+
+  // links it already has
+  link_t link;
+  for(link = mesh->links; link; link = link->next) work_publish(w, link, index);
+
+  return index % w->count;
+}
+
+mesh_workers_t mesh_workers_start(mesh_workers_t w)
+{
+  uint8_t i;
+
+  if(!w || w->started) return LOG("bad args");
+  for(i = 0; w->cryptos && i < w->meshes_len; i++) mesh_offload(w->meshes[i], work_offload, w);
+  __atomic_store_n(&w->running, 1, __ATOMIC_RELEASE);
+  for(i = 0; i < w->cryptos_count; i++)
+  {
+    if(pthread_create(&w->cryptos[i].thread, NULL, work_crypto, &w->cryptos[i]) != 0) break;
+    w->cryptos_started++;
+  }
+  for(i = 0; w->cryptos_started == w->cryptos_count && i < w->count; i++)
+  {
+    if(pthread_create(&w->workers[i].thread, NULL, work_run, &w->workers[i]) != 0) break;
+    w->started++;
+  }
+  if(w->started == w->count) return w;
+
+  // stop any that did start
+  work_stop(w);
+  return LOG("failed to start %u threads",w->count + w->cryptos_count);
+}
+
+uint8_t mesh_workers_call(mesh_workers_t w, mesh_t mesh, void (*fn)(mesh_t mesh, void *arg), void *arg)
+{
+  work_item_s item;
+  int index;
+
+  if(!w || !fn || (index = work_index(w, mesh)) < 0) return 0;
+  memset(&item, 0, sizeof(item));
+  item.kind = WORK_CALL;
+  item.mesh = mesh;
+  item.call = fn;
+  item.arg = arg;
+  return work_push(&w->queues[index % w->count], &item);
+}
+
+// queue it to the mesh at index
+static uint8_t work_deliver(mesh_workers_t w, uint8_t index, lob_t packet, mesh_workers_pipe_t pipe, void *arg)
+{
+  work_item_s item;
+
+  memset(&item, 0, sizeof(item));
+  item.kind = WORK_PACKET;
+  item.mesh = w->meshes[index];
+  item.packet = packet;
+  item.pipe = pipe;
+  item.arg = arg;
+  if(work_push(&w->queues[index % w->count], &item)) return 1;
+  lob_free(packet);
+  return 0;
+}
+
+uint8_t mesh_workers_deliver(mesh_workers_t w, mesh_t mesh, lob_t packet, mesh_workers_pipe_t pipe, void *arg)
+{
+  int index;
+
+  if(!w || !packet || (index = work_index(w, mesh)) < 0)
+  {
+    lob_free(packet);
+    return 0;
+  }
+  return work_deliver(w, (uint8_t)index, packet, pipe, arg);
+}
+
+uint8_t mesh_workers_receive(mesh_workers_t w, lob_t packet, mesh_workers_pipe_t pipe, void *arg)
+{
+  int index = -1;
+  uint8_t i, count = 0, csid = 0;
+
+  if(!w || !packet)
+  {
+    lob_free(packet);
+    return 0;
+  }
+
+  // channel packets start w/ the token of the link they're for
+  if(!packet->head_len)
+  {
+    if(packet->body_len >= 16) index = work_token_get(w, packet->body);
+    if(index < 0)
+    {
+      __atomic_fetch_add(&w->unrouted, 1, __ATOMIC_RELAXED);
+      lob_free(packet);
+      return 0;
+    }
+    __atomic_fetch_add(&w->routed, 1, __ATOMIC_RELAXED);
+    return work_deliver(w, (uint8_t)index, packet, pipe, arg);
+  }
+
+  // routed to a short hashname, when it's one of ours the inner packet is for that mesh alone
+  if(packet->head_len == 5)
+  {
+    for(i = 0; i < w->meshes_len; i++)
+    {
+      if(memcmp(w->meshes[i]->id->bin, packet->head, 5) != 0) continue;
+      lob_t inner = lob_parse(packet->body, packet->body_len);
+      lob_free(packet);
+      if(!inner) return 0;
+      __atomic_fetch_add(&w->routed, 1, __ATOMIC_RELAXED);
+      return work_deliver(w, i, inner, pipe, arg);
+    }
+  }
+
+  // handshakes don't say who they're for, every mesh w/ that cipher set tries
+  if(packet->head_len == 1) csid = packet->head[0];
+  __atomic_fetch_add(&w->broadcast, 1, __ATOMIC_RELAXED);
+  for(i = 0; i < w->meshes_len; i++)
+  {
+    if(csid && !(w->csids[i][csid >> 3] & (1 << (csid & 7)))) continue;
+    count += work_deliver(w, i, lob_copy(packet), pipe, arg);
+  }
+  lob_free(packet);
+  return count;
+}
+
+lob_t mesh_workers_stats(mesh_workers_t w)
+{
+  lob_t json;
+  uint32_t processed = 0, dropped = 0, decrypted = 0;
+  uint8_t i;
+
+  if(!w) return NULL;
+  for(i = 0; i < w->count; i++)
+  {
+    processed += __atomic_load_n(&w->workers[i].processed, __ATOMIC_RELAXED);
+    dropped += __atomic_load_n(&w->queues[i].dropped, __ATOMIC_RELAXED);
+  }
+  for(i = 0; i < w->cryptos_count; i++) decrypted += __atomic_load_n(&w->cryptos[i].processed, __ATOMIC_RELAXED);
+  json = lob_new();
+  lob_set_uint(json,"routed",__atomic_load_n(&w->routed, __ATOMIC_RELAXED));
+  lob_set_uint(json,"broadcast",__atomic_load_n(&w->broadcast, __ATOMIC_RELAXED));
+  lob_set_uint(json,"unrouted",__atomic_load_n(&w->unrouted, __ATOMIC_RELAXED));
+  lob_set_uint(json,"processed",processed);
+  lob_set_uint(json,"dropped",dropped);
+  if(!w->cryptos) return json;
+  lob_set_uint(json,"offloaded",__atomic_load_n(&w->offloaded, __ATOMIC_RELAXED));
+  lob_set_uint(json,"decrypted",decrypted);
+  lob_set_uint(json,"offload_dropped",__atomic_load_n(&w->crypto.dropped, __ATOMIC_RELAXED));
+  return json;
+}
+
+#endif
@@ -51,11 +51,32 @@ util_chunks_t util_chunks_new(uint8_t size)
   return chunks;
 }
 
+util_chunks_t util_chunks_v2(util_chunks_t chunks, uint16_t size, uint8_t window)
+{
+  if(!chunks) return LOG("bad args");
+  if(!size || size > UTIL_CHUNKS_V2_MAX) size = UTIL_CHUNKS_V2_MAX;
+  chunks->v2 = 1;
+  chunks->max = size;
+  chunks->window = window ? window : 1;
+  chunks->blocked = 0;
+  return chunks;
+}
+
+util_chunks_t util_chunks_framed(util_chunks_t chunks)
+{
+  if(!chunks) return LOG("bad args");
+  if(!chunks->v2) util_chunks_v2(chunks, 0, 0);
+  chunks->framed = 1;
+  return chunks;
+}
+
 util_chunks_t util_chunks_free(util_chunks_t chunks)
 {
   if(!chunks) return NULL;
-  if(chunks->writing) lob_free(chunks->writing);
+  if(chunks->writing) lob_freeall(chunks->writing);
   util_chunk_free(chunks->reading);
+  lob_freeall(chunks->received);
+  free(chunks->readbuf);
   free(chunks);
   return NULL;
 }
@@ -86,7 +107,19 @@ lob_t util_chunks_receive(util_chunks_t chunks)
   util_chunk_t chunk, flush;
   size_t len = 0;
 
-  if(!chunks || !chunks->reading) return NULL;
+  if(!chunks) return NULL;
+
+  // v2 packets are parsed as soon as they're flushed
+  if(chunks->v2)
+  {
+    lob_t ret = lob_shift(chunks->received);
+    if(!ret) return NULL;
+    chunks->received = ret->next;
+    ret->next = NULL;
+    return ret;
+  }
+
+  if(!chunks->reading) return NULL;
   
   // add up total length of any sequence
   for(flush = NULL,chunk = chunks->reading;chunk;chunk=chunk->prev)
@@ -175,10 +208,337 @@ util_chunks_t _util_chunks_append(util_chunks_t chunks, uint8_t *block, size_t l
   return _util_chunks_append(chunks,block+quota,len-quota);
 }
 
+// v2 our current packet is all theirs
+static void _util_chunks_done2(util_chunks_t chunks)
+{
+  lob_t old = lob_shift(chunks->writing);
+  chunks->writing = old->next;
+  old->next = NULL;
+  lob_free(old);
+  chunks->writeat = 0;
+  chunks->flushed = 0;
+  chunks->writeodd ^= 1;
+}
+
+// v2 acts on a complete incoming chunk, data is already at readbuf+readlen
+static util_chunks_t _util_chunks_chunk2(util_chunks_t chunks, uint16_t head)
+{
+  uint8_t *body = chunks->readbuf+chunks->readlen;
+  size_t at;
+
+  if(head == UTIL_CHUNKS_V2_RESET)
+  {
+    // they lost sync, resume ours from whatever they have
+    chunks->resumeseq = body[1];
+    chunks->resumeat = (size_t)util_get_be(body+2, 4);
+    chunks->resumeodd = (body[0] & UTIL_CHUNKS_V2_ODD) ? 1 : 0;
+    chunks->resume = 1;
+
+    // they may have lost our acks too, tell them what we have of theirs
+    if(body[0] & UTIL_CHUNKS_V2_ASK)
+    {
+      chunks->resync = 1;
+      chunks->reset = 1;
+      chunks->acks = 0;
+    }
+    return chunks;
+  }
+
+  if(head == UTIL_CHUNKS_V2_RESUME)
+  {
+    // only the answer to our latest reset, everything before it was discarded
+    if(!chunks->resync || body[1] != chunks->resets) return chunks;
+    at = (size_t)util_get_be(body+2, 4);
+    if(at > chunks->readlen) chunks->skip = 1; // missing some, can't be put back together
+    else chunks->readlen = at;
+    chunks->resync = 0;
+    return chunks;
+  }
+
+  if(head & 0x8000)
+  {
+    // they've received some of ours
+    head &= UTIL_CHUNKS_V2_MAX;
+    chunks->unacked = (head > chunks->unacked) ? 0 : chunks->unacked - head;
+
+    // packets are only done once the flush is acked too
+    if(!chunks->unacked && chunks->flushed) _util_chunks_done2(chunks);
+    return chunks;
+  }
+
+  // until they resume, ignore everything
+  if(chunks->resync) return chunks;
+
+  if(!head)
+  {
+    // a full packet, parse it straight out of the reassembly buffer
+    if(chunks->acks < UTIL_CHUNKS_V2_ACKS) chunks->acks++;
+    chunks->readodd ^= 1;
+    if(chunks->skip || !chunks->readlen)
+    {
+      chunks->skip = 0;
+      chunks->readlen = 0;
+      return chunks;
+    }
+    lob_t ret = lob_parse(chunks->readbuf, chunks->readlen);
+    chunks->readlen = 0;
+    chunks->err = ret ? 0 : 1;
+    if(ret) chunks->received = lob_push(chunks->received, ret);
+    return chunks;
+  }
+
+  // whole chunk is in, owe an ack
+  if(!chunks->skip) chunks->readlen += head;
+  if(chunks->acks < UTIL_CHUNKS_V2_ACKS) chunks->acks++;
+  return chunks;
+}
+
+// v2 framing error, drop the partial chunk and hunt for the next sync, whole chunks are kept
+static void _util_chunks_lost2(util_chunks_t chunks)
+{
+  chunks->errors++;
+  chunks->readheadat = chunks->readcrcat = 0;
+  chunks->readsize = chunks->readgot = 0;
+  chunks->acks = 0;
+
+  // one reset per loss, a stall asks again
+  if(chunks->resync) return;
+  chunks->resync = 1;
+  chunks->reset = 1;
+  chunks->ask = 1; // acks to us may have been lost too
+}
+
+// v2 incoming stream, 2-byte big-endian headers, when framed they're prefixed w/ the sync marker and chunks end w/ a crc32
+static util_chunks_t _util_chunks_append2(util_chunks_t chunks, uint8_t *block, size_t len)
+{
+  uint8_t headlen = chunks->framed ? 4 : 2;
+  while(len)
+  {
+    // collect the chunk header
+    if(chunks->readheadat < headlen)
+    {
+      uint8_t byte = *block++;
+      len--;
+
+      // hunt for the sync marker, anything else between chunks means something was lost
+      if(chunks->framed && chunks->readheadat < 2 && byte != (chunks->readheadat ? UTIL_CHUNKS_SYNC1 : UTIL_CHUNKS_SYNC0))
+      {
+        if(!chunks->resync) _util_chunks_lost2(chunks);
+        chunks->readheadat = (byte == UTIL_CHUNKS_SYNC0) ? 1 : 0;
+        continue;
+      }
+
+      chunks->readhead[chunks->readheadat++] = byte;
+      if(chunks->readheadat < headlen) continue;
+
+      uint16_t head = (uint16_t)((chunks->readhead[headlen-2] << 8) | chunks->readhead[headlen-1]);
+      // resets and resumes have a body, other controls are empty
+      if(head == UTIL_CHUNKS_V2_RESET || head == UTIL_CHUNKS_V2_RESUME) chunks->readsize = UTIL_CHUNKS_V2_BODY;
+      else chunks->readsize = (head & 0x8000) ? 0 : head;
+      chunks->readgot = 0;
+      chunks->readcrcat = 0;
+
+      // noise can look like a huge chunk
+      if(chunks->framed && !(head & 0x8000) && chunks->readsize > chunks->max)
+      {
+        _util_chunks_lost2(chunks);
+        continue;
+      }
+
+      // a packet never grows past the max, the rest of it is still acked so the sender moves on
+      if(!(head & 0x8000) && chunks->readlen + chunks->readsize > UTIL_CHUNKS_PACKET_MAX)
+      {
+        LOG("dropping packet over %d bytes",UTIL_CHUNKS_PACKET_MAX);
+        chunks->readlen = 0;
+        chunks->skip = 1;
+        chunks->err = 1;
+      }
+
+      // make sure the whole chunk fits, buffer only ever grows
+      if(chunks->readlen + chunks->readsize > chunks->readcap)
+      {
+        size_t cap = chunks->readcap ? chunks->readcap : chunks->max;
+        while(cap < chunks->readlen + chunks->readsize) cap *= 2;
+        uint8_t *buf = realloc(chunks->readbuf, cap);
+        if(!buf) return LOG("OOM");
+        chunks->readbuf = buf;
+        chunks->readcap = cap;
+      }
+    }
+
+    // copy in as much of the chunk data as is here, only kept once it's all in (and verified)
+    if(chunks->readgot < chunks->readsize)
+    {
+      size_t quota = chunks->readsize - chunks->readgot;
+      if(len < quota) quota = len;
+      memcpy(chunks->readbuf+chunks->readlen+chunks->readgot, block, quota);
+      chunks->readgot += quota;
+      block += quota;
+      len -= quota;
+      if(chunks->readgot < chunks->readsize) break;
+    }
+
+    if(chunks->framed)
+    {
+      while(len && chunks->readcrcat < 4)
+      {
+        chunks->readcrc[chunks->readcrcat++] = *block++;
+        len--;
+      }
+      if(chunks->readcrcat < 4) break;
+
+      uint32_t crc = util_crc32(0, chunks->readhead+2, 2);
+      crc = util_crc32(crc, chunks->readbuf+chunks->readlen, chunks->readsize);
+      uint32_t got = ((uint32_t)chunks->readcrc[0] << 24) | ((uint32_t)chunks->readcrc[1] << 16) | ((uint32_t)chunks->readcrc[2] << 8) | chunks->readcrc[3];
+      if(crc != got)
+      {
+        LOG("dropping chunk w/ bad crc");
+        _util_chunks_lost2(chunks);
+        continue;
+      }
+    }
+
+    chunks->readheadat = 0;
+    if(!_util_chunks_chunk2(chunks, (uint16_t)((chunks->readhead[headlen-2] << 8) | chunks->readhead[headlen-1]))) return NULL;
+  }
+
+  return chunks;
+}
+
+// v2 sets up the next header to write, returns 0 if there's nothing to do
+static uint8_t _util_chunks_next2(util_chunks_t chunks)
+{
+  uint16_t head;
+  uint8_t headlen = chunks->framed ? 4 : 2;
+
+  chunks->size = 0;
+  chunks->control = 0;
+  if(chunks->reset)
+  {
+    // tell them how much of their packet we have, each reset is numbered so only its own resume ends the resync
+    chunks->body[0] = (chunks->ask ? UTIL_CHUNKS_V2_ASK : 0) | (chunks->readodd ? UTIL_CHUNKS_V2_ODD : 0);
+    chunks->body[1] = ++chunks->resets;
+    util_put_be(chunks->readlen, chunks->body+2, 4);
+    chunks->reset = chunks->ask = 0;
+    chunks->size = UTIL_CHUNKS_V2_BODY;
+    chunks->control = 1;
+    head = UTIL_CHUNKS_V2_RESET;
+  }else if(chunks->resume){
+    // they already got all of the current packet when only the flush ack was lost
+    if(chunks->writing && chunks->resumeodd != chunks->writeodd) _util_chunks_done2(chunks);
+    if(chunks->resumeat > (chunks->writing ? lob_len(chunks->writing) : 0))
+    {
+      LOG("bad resume offset %lu",(unsigned long)chunks->resumeat);
+      chunks->resumeat = 0;
+    }
+    // pick up the current packet from where they are
+    chunks->writeat = chunks->resumeat;
+    chunks->unacked = 0;
+    chunks->flushed = 0;
+    chunks->resume = 0;
+    chunks->body[0] = 0;
+    chunks->body[1] = chunks->resumeseq;
+    util_put_be(chunks->resumeat, chunks->body+2, 4);
+    chunks->size = UTIL_CHUNKS_V2_BODY;
+    chunks->control = 1;
+    head = UTIL_CHUNKS_V2_RESUME;
+  }else if(chunks->acks){
+    // acks first so the other side keeps going
+    head = 0x8000 | chunks->acks;
+  }else{
+    if(!chunks->writing || chunks->flushed || chunks->unacked >= chunks->window) return 0;
+    size_t avail = lob_len(chunks->writing) - chunks->writeat;
+    if(avail > chunks->max) avail = chunks->max;
+    chunks->size = (uint16_t)avail; // 0 flushes
+    head = chunks->size;
+  }
+
+  chunks->head[0] = UTIL_CHUNKS_SYNC0;
+  chunks->head[1] = UTIL_CHUNKS_SYNC1;
+  chunks->head[headlen-2] = (uint8_t)(head >> 8);
+  chunks->head[headlen-1] = (uint8_t)(head & 0xff);
+
+  if(chunks->framed)
+  {
+    uint32_t crc = util_crc32(0, chunks->head+2, 2);
+    if(chunks->size) crc = util_crc32(crc, chunks->control ? chunks->body : lob_raw(chunks->writing)+chunks->writeat, chunks->size);
+    chunks->tail[0] = (uint8_t)(crc >> 24);
+    chunks->tail[1] = (uint8_t)(crc >> 16);
+    chunks->tail[2] = (uint8_t)(crc >> 8);
+    chunks->tail[3] = (uint8_t)crc;
+  }
+
+  chunks->waitat = 0;
+  chunks->ready = 1;
+  return 1;
+}
+
+static uint32_t _util_chunks_len2(util_chunks_t chunks)
+{
+  uint8_t headlen = chunks->framed ? 4 : 2;
+  if(!chunks->ready && !_util_chunks_next2(chunks)) return 0;
+
+  // header, data, crc
+  if(chunks->waitat < headlen) return headlen - chunks->waitat;
+  if(chunks->waitat < headlen + chunks->size) return chunks->size - (chunks->waitat-headlen);
+  return 4 - (chunks->waitat-(headlen+chunks->size));
+}
+
+static uint8_t *_util_chunks_write2(util_chunks_t chunks)
+{
+  uint8_t headlen = chunks->framed ? 4 : 2;
+  if(chunks->waitat < headlen) return chunks->head+chunks->waitat;
+  if(chunks->waitat < headlen + chunks->size) return (chunks->control ? chunks->body : lob_raw(chunks->writing)+chunks->writeat)+(chunks->waitat-headlen);
+  return chunks->tail+(chunks->waitat-(headlen+chunks->size));
+}
+
+static util_chunks_t _util_chunks_written2(util_chunks_t chunks, size_t len)
+{
+  uint8_t headlen = chunks->framed ? 4 : 2;
+  if(len > _util_chunks_len2(chunks)) return LOG("len too big %d > %d",len,_util_chunks_len2(chunks));
+  chunks->waitat += len;
+
+  // wait for all of the header, data, and crc
+  if(chunks->waitat < headlen + chunks->size + (chunks->framed ? 4 : 0)) return chunks;
+
+  uint16_t head = (uint16_t)((chunks->head[headlen-2] << 8) | chunks->head[headlen-1]);
+  chunks->waitat = 0;
+  chunks->ready = 0;
+  if(chunks->control)
+  {
+    // resets and resumes took effect when they were set up
+    chunks->control = 0;
+  }else if(head & 0x8000){
+    // a loss may have cleared them while this was going out
+    head &= UTIL_CHUNKS_V2_MAX;
+    chunks->acks = (head > chunks->acks) ? 0 : chunks->acks - head;
+  }else if(chunks->size){
+    chunks->writeat += chunks->size;
+    chunks->unacked++;
+  }else{
+    // flushed, next packet waits for the ack so it can be resumed
+    chunks->unacked++;
+    chunks->flushed = 1;
+  }
+  chunks->size = 0;
+  return chunks;
+}
+
+util_chunks_t util_chunks_resync(util_chunks_t chunks)
+{
+  if(!chunks || !chunks->framed) return LOG("bad args");
+  _util_chunks_lost2(chunks);
+  // ask again, in case the last reset or resume was lost
+  chunks->reset = chunks->ask = 1;
+  return chunks;
+}
+
 // how many bytes are there waiting
 uint32_t util_chunks_len(util_chunks_t chunks)
 {
-  if(!chunks || chunks->blocked) return 0;
+  if(!chunks) return 0;
+  if(chunks->v2) return _util_chunks_len2(chunks);
+  if(chunks->blocked) return 0;
 
   // when no packet, only send an ack
   if(!chunks->writing) return (chunks->ack) ? 1 : 0;
@@ -201,6 +561,8 @@ uint8_t *util_chunks_write(util_chunks_t chunks)
 {
   // ensures consistency
   if(!util_chunks_len(chunks)) return NULL;
+
+  if(chunks->v2) return _util_chunks_write2(chunks);
   
   // always write the chunk size byte first, is also the ack/flush
   if(!chunks->waitat) return &chunks->waiting;
@@ -213,6 +575,7 @@ uint8_t *util_chunks_write(util_chunks_t chunks)
 util_chunks_t util_chunks_written(util_chunks_t chunks, size_t len)
 {
   if(!chunks || !len) return chunks;
+  if(chunks->v2) return _util_chunks_written2(chunks, len);
   if(len > util_chunks_len(chunks)) return LOG("len too big %d > %d",len,util_chunks_len(chunks));
   chunks->waitat += len;
   chunks->ack = 0; // any write is an ack
@@ -248,6 +611,8 @@ util_chunks_t util_chunks_written(util_chunks_t chunks, size_t len)
 // queues incoming stream based data
 util_chunks_t util_chunks_read(util_chunks_t chunks, uint8_t *block, size_t len)
 {
+  if(!chunks) return NULL;
+  if(chunks->v2) return (block && len) ? _util_chunks_append2(chunks,block,len) : chunks;
   if(!_util_chunks_append(chunks,block,len)) return NULL;
   if(!chunks->reading) return NULL; // paranoid
   return chunks;
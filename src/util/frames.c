@@ -4,55 +4,95 @@
 #include <stdbool.h>
 #include "telehash.h"
 
-// simple packet list
-typedef struct qlob_s {
-  struct qlob_s *next;
-  lob_t pkt;
-} qlob_s, *qlob_t;
+// packet queue is a ring of lob pointers, grows by doubling only when full
+typedef struct qring_s {
+  lob_t *pkts;
+  uint32_t cap, head, count;
+} qring_s;
 
 struct util_frames_s {
   uint32_t magic;
   uint32_t max;
 
-  // inlen is expected, inat is partial progress
+  // in points to inhdr or the packet being filled, inlen is expected, inat is partial progress
+  uint8_t inhdr[8];
   uint8_t *in;
   uint32_t inlen, inat;
 
-  // either header or lob_raw(outbox)
+  // either outhdr or lob_raw(outbox head)
+  uint8_t outhdr[8];
   uint8_t *out;
   uint32_t outlen;
 
   // internal queues for ISR safety
-  qlob_t inbox; // owned by inbox(), locked by receive()
-  qlob_t outbox; // owned by outbox(), locked by send()
+  qring_s inbox; // owned by inbox(), locked by receive()
+  qring_s outbox; // owned by outbox(), locked by send()
+
+  // running byte totals of each queue
+  uint32_t inbytes, outbytes;
 
   uint8_t is_receiving : 1;
   uint8_t is_sending : 1;
   uint8_t inbox_err : 1;
+  uint8_t out_done : 1; // head of outbox was sent during a send(), shift it later
 };
 
-qlob_t qlob_append(qlob_t q, lob_t lob)
+static uint8_t qring_init(qring_s *q)
+{
+  if(!(q->pkts = malloc(UTIL_FRAMES_QUEUE * sizeof(lob_t)))) return 0;
+  q->cap = UTIL_FRAMES_QUEUE;
+  q->head = q->count = 0;
+  return 1;
+}
+
+// O(1) append, only reallocs when full and the other side isn't active
+static uint8_t qring_push(qring_s *q, lob_t pkt, bool locked)
 {
-  if(!q)
+  if(q->count == q->cap)
   {
-    q = malloc(sizeof(qlob_s));
-    q->next = NULL;
-    q->pkt = lob;
-  } else if(!q->next) {
-    q->next = qlob_append(NULL, lob);
-  }else{
-    qlob_append(q->next, lob);
+    if(locked) return 0;
+    lob_t *pkts;
+    if(!(pkts = malloc(q->cap * 2 * sizeof(lob_t)))) return 0;
+    for(uint32_t i = 0; i < q->count; i++) pkts[i] = q->pkts[(q->head + i) % q->cap];
+    free(q->pkts);
+    q->pkts = pkts;
+    q->head = 0;
+    q->cap *= 2;
   }
-  return q;
+  q->pkts[(q->head + q->count) % q->cap] = pkt;
+  q->count++;
+  return 1;
+}
+
+static lob_t qring_peek(qring_s *q)
+{
+  return q->count ? q->pkts[q->head] : NULL;
 }
 
-qlob_t qlob_free(qlob_t q)
+static lob_t qring_shift(qring_s *q)
 {
-  if(!q) return NULL;
-  qlob_t next = q->next;
-  lob_free(q->pkt);
-  free(q);
-  return qlob_free(next);
+  if(!q->count) return NULL;
+  lob_t pkt = q->pkts[q->head];
+  q->head = (q->head + 1) % q->cap;
+  q->count--;
+  return pkt;
+}
+
+// drop the sent outbox head if that had to be deferred
+static void frames_out_done(util_frames_t frames)
+{
+  if(!frames->out_done || frames->is_sending) return;
+  lob_t pkt = qring_shift(&frames->outbox);
+  frames->outbytes -= lob_len(pkt);
+  lob_free(pkt);
+  frames->out_done = false;
+}
+
+static void qring_free(qring_s *q)
+{
+  lob_t pkt;
+  while((pkt = qring_shift(q))) lob_free(pkt);
+  free(q->pkts);
 }
 
 util_frames_t util_frames_new(uint32_t magic, uint32_t max)
@@ -63,16 +103,22 @@ util_frames_t util_frames_new(uint32_t magic, uint32_t max)
   frames->max = max;
   frames->magic = magic;
 
+  if(!qring_init(&frames->inbox) || !qring_init(&frames->outbox))
+  {
+    free(frames->inbox.pkts);
+    free(frames);
+    return LOG_WARN("OOM");
+  }
+
   return frames;
 }
 
 util_frames_t util_frames_free(util_frames_t frames)
 {
   if(!frames) return NULL;
-  qlob_free(frames->inbox);
-  qlob_free(frames->outbox);
-  if(frames->inlen == 8) free(frames->in);
-  if(frames->outlen == 8) free(frames->out);
+  qring_free(&frames->inbox);
+  qring_free(&frames->outbox);
+  if(frames->in != frames->inhdr) free(frames->in);
   free(frames);
   return NULL;
 }
@@ -80,15 +126,12 @@ util_frames_t util_frames_free(util_frames_t frames)
 util_frames_t util_frames_clear(util_frames_t frames)
 {
   if(!frames) return NULL;
-  if(frames->inlen == 8) free(frames->in);
+  if(frames->in != frames->inhdr) free(frames->in);
   frames->in = NULL;
   frames->inlen = frames->inat = 0;
   frames->inbox_err = false;
 
 // cannot clear out as it may be active
-//  if(frames->outlen == 8) free(frames->out);
-//  frames->out = NULL;
-//  frames->outlen = 0;
   return frames;
 }
 
@@ -109,8 +152,16 @@ util_frames_t util_frames_send(util_frames_t frames, lob_t out)
   }
 
   frames->is_sending = true;
-  frames->outbox = qlob_append(frames->outbox, out);
+  uint32_t len = lob_len(out);
+  if(!qring_push(&frames->outbox, out, false))
+  {
+    frames->is_sending = false;
+    lob_free(out);
+    return LOG_WARN("OOM");
+  }
+  frames->outbytes += len;
   frames->is_sending = false;
+  frames_out_done(frames);
   return frames;
 }
 
@@ -119,13 +170,8 @@ lob_t util_frames_receive(util_frames_t frames)
 {
   if(!frames) return LOG_WARN("bad args");
   frames->is_receiving = true;
-  lob_t ret = NULL;
-  for(qlob_t q = frames->inbox;q;q = q->next) if(q->pkt)
-  {
-    ret = q->pkt;
-    q->pkt = NULL;
-    break;
-  }
+  lob_t ret = qring_shift(&frames->inbox);
+  if(ret) frames->inbytes -= lob_len(ret);
   frames->is_receiving = false;
   return ret;
 }
@@ -134,17 +180,13 @@ lob_t util_frames_receive(util_frames_t frames)
 uint32_t util_frames_inlen(util_frames_t frames)
 {
   if(!frames) return 0;
-  uint32_t total = 0;
-  for(qlob_t q = frames->inbox; q; q = q->next) total += lob_len(q->pkt);
-  return total;
+  return frames->inbytes;
 }
 
 uint32_t util_frames_outlen(util_frames_t frames)
 {
   if(!frames) return 0;
-  uint32_t total = 0;
-  for(qlob_t q = frames->outbox; q; q = q->next) total += lob_len(q->pkt);
-  return total;
+  return frames->outbytes;
 }
 
 util_frames_t util_frames_pending(util_frames_t frames)
@@ -158,7 +200,7 @@ uint8_t *util_frames_awaiting(util_frames_t frames, uint32_t *len)
 
   // prepare for header if none
   if(!frames->inlen) {
-    frames->in = malloc(8);
+    frames->in = frames->inhdr;
     frames->inlen = 8;
     frames->inat = 0;
   }
@@ -172,68 +214,64 @@ util_frames_t util_frames_inbox(util_frames_t frames, uint8_t *data, uint32_t le
 {
   if(!frames || !data || !len) return LOG_WARN("bad args");
 
-  // init to header if none
-  if(!frames->inlen) util_frames_awaiting(frames, NULL);
-
-  uint32_t await = frames->inlen - frames->inat;
-
-  // take partial and advance
-  if(len < await){
-    if(data != (frames->in + frames->inat)) memcpy(frames->in + frames->inat, data, len);
-    frames->inat += len;
-    return frames;
-  }
-
-  // if there's a remainder, stash it
-  uint8_t *more = NULL;
-  uint32_t morelen = 0;
-  if(len > await)
+  while(len)
   {
-    more = data + await;
-    morelen = len - await;
-    len = await;
-  }
+    // init to header if none
+    if(!frames->inlen) util_frames_awaiting(frames, NULL);
 
-  // handle complete frame now
-  if(data != (frames->in + frames->inat)) memcpy(frames->in + frames->inat, data, len);
+    uint32_t await = frames->inlen - frames->inat;
+    uint32_t take = (len < await) ? len : await;
+    if(data != (frames->in + frames->inat)) memcpy(frames->in + frames->inat, data, take);
+    frames->inat += take;
+    data += take;
+    len -= take;
 
-  // is it a header
-  if(frames->inlen == 8)
-  {
-    uint32_t inmagic;
-    uint32_t inlen;
-    memcpy(&(inmagic),data,4);
-    memcpy(&(inlen),data+4,4);
-    free(frames->in);
-    frames->in = NULL;
-    frames->inlen = frames->inat = 0;
-    // ensure correct
-    if(inmagic != frames->magic || inlen > frames->max)
+    // partial, wait for more
+    if(frames->inat < frames->inlen) break;
+
+    // is it a header
+    if(frames->in == frames->inhdr)
     {
-      frames->inbox_err = true;
-      return LOG_INFO("magic/length header mismatch: %lu/%lu %lu<%lu",frames->magic,inmagic,inlen,frames->max);
-    }
-    frames->inbox_err = false;
-    // make space for full packet frame
-    if(!(frames->in = malloc(inlen))) return LOG_WARN("OOM");
-    frames->inlen = inlen;
-  }else{
-    // free any leading inbox empties
-    qlob_t q = NULL;
-    while(!frames->is_receiving && (q = frames->inbox) && !q->pkt) {
-      frames->inbox = q->next;
-      q->next = NULL;
-      qlob_free(q);
+      uint32_t inmagic;
+      uint32_t inlen;
+      memcpy(&(inmagic),frames->inhdr,4);
+      memcpy(&(inlen),frames->inhdr+4,4);
+      frames->in = NULL;
+      frames->inlen = frames->inat = 0;
+      // ensure correct
+      if(inmagic != frames->magic || inlen > frames->max || !inlen)
+      {
+        frames->inbox_err = true;
+        return LOG_INFO("magic/length header mismatch: %lu/%lu %lu<%lu",frames->magic,inmagic,inlen,frames->max);
+      }
+      frames->inbox_err = false;
+      // make space for full packet frame, handed directly to the lob once filled
+      if(!(frames->in = malloc(inlen))) return LOG_WARN("OOM");
+      frames->inlen = inlen;
+      continue;
     }
 
     // new inbox packet yay
     LOG_DEBUG("new pkt len %lu",frames->inlen);
-    frames->inbox = qlob_append(frames->inbox, lob_direct(frames->in,frames->inlen));
+    lob_t pkt = lob_direct(frames->in,frames->inlen);
+    if(!pkt) free(frames->in);
     frames->in = NULL;
     frames->inlen = frames->inat = 0;
+    if(!pkt)
+    {
+      frames->inbox_err = true;
+      return LOG_INFO("invalid packet frame");
+    }
+    uint32_t pktlen = lob_len(pkt);
+    if(!qring_push(&frames->inbox, pkt, frames->is_receiving))
+    {
+      lob_free(pkt);
+      return LOG_WARN("inbox full, dropped packet");
+    }
+    frames->inbytes += pktlen;
   }
 
-  return (more)?util_frames_inbox(frames,more,morelen):frames;
+  return frames;
 }
 
 uint8_t *util_frames_outbox(util_frames_t frames, uint32_t *len)
@@ -245,21 +283,17 @@ uint8_t *util_frames_outbox(util_frames_t frames, uint32_t *len)
   // load up next frame if none
   if(!frames->outlen)
   {
-    // free any leading empties
-    qlob_t q = NULL;
-    while(!frames->is_sending && (q = frames->outbox) && !q->pkt) {
-      frames->outbox = q->next;
-      q->next = NULL;
-      qlob_free(q);
-    }
-    if(!frames->outbox) return NULL; // empty
+    if(frames->is_sending) return NULL; // locked
+    frames_out_done(frames);
+    lob_t pkt = qring_peek(&frames->outbox);
+    if(!pkt) return NULL; // empty
 
     // add header for next pkt
     LOG_DEBUG("sending header");
-    frames->out = malloc(8);
+    frames->out = frames->outhdr;
     frames->outlen = 8;
     memcpy(frames->out,&(frames->magic),4);
-    uint32_t len = lob_len(frames->outbox->pkt);
+    uint32_t len = lob_len(pkt);
     memcpy(frames->out+4, &(len), 4);
   }
 
@@ -270,22 +304,23 @@ uint8_t *util_frames_outbox(util_frames_t frames, uint32_t *len)
 util_frames_t util_frames_sent(util_frames_t frames)
 {
   if(!frames) return LOG_WARN("bad args");
-  if(!frames->outlen || !frames->outbox) return LOG_WARN("invalid usage");
+  lob_t pkt = qring_peek(&frames->outbox);
+  if(!frames->outlen || !pkt || frames->out_done) return LOG_WARN("invalid usage");
 
   // check if header was just sent
-  if(frames->outlen == 8) {
-    free(frames->out);
-    frames->out = lob_raw(frames->outbox->pkt);
-    frames->outlen = lob_len(frames->outbox->pkt);
+  if(frames->out == frames->outhdr) {
+    frames->out = lob_raw(pkt);
+    frames->outlen = lob_len(pkt);
   }else{
     // packet is sent
     frames->out = NULL;
     frames->outlen = 0;
-    frames->outbox->pkt = lob_free(frames->outbox->pkt);
+    frames->out_done = true;
+    frames_out_done(frames);
   }
 
   // return if there's more to go
-  return util_frames_outlen(frames)?frames:NULL;
+  return (util_frames_outlen(frames) > (frames->out_done ? lob_len(pkt) : 0))?frames:NULL;
 }
 
 // are we active to sending/receiving frames
@@ -294,4 +329,71 @@ util_frames_t util_frames_busy(util_frames_t frames)
   return ((util_frames_inlen(frames) + util_frames_outlen(frames)) > 0)?frames:NULL;
 }
 
+uint8_t *util_frames_dgram_outbox(util_frames_t frames, uint8_t *hdr, uint32_t *len)
+{
+  if(!len) return LOG_WARN("invalid usage");
+  *len = 0;
+  if(!frames || !hdr) return LOG_WARN("bad args");
+
+  // no header frame, out is always the packet itself
+  if(!frames->outlen)
+  {
+    if(frames->is_sending) return NULL; // locked
+    frames_out_done(frames);
+    lob_t pkt = qring_peek(&frames->outbox);
+    if(!pkt) return NULL; // empty
+    if(lob_len(pkt) > 0xffff || lob_len(pkt) > frames->max)
+    {
+      LOG_WARN("dropping packet too large for a datagram: %lu",lob_len(pkt));
+      frames->outbytes -= lob_len(pkt);
+      lob_free(qring_shift(&frames->outbox));
+      return util_frames_dgram_outbox(frames, hdr, len);
+    }
+    frames->out = lob_raw(pkt);
+    frames->outlen = lob_len(pkt);
+  }
 
+  uint16_t magic = util_sys_short((uint16_t)frames->magic);
+  uint16_t plen = util_sys_short((uint16_t)frames->outlen);
+  memcpy(hdr, &magic, 2);
+  memcpy(hdr+2, &plen, 2);
+  *len = frames->outlen;
+  return frames->out;
+}
+
+util_frames_t util_frames_dgram_inbox(util_frames_t frames, uint8_t *data, uint32_t len)
+{
+  uint16_t magic, plen;
+  if(!frames || !data) return LOG_WARN("bad args");
+  if(len <= UTIL_FRAMES_DGRAM_HDR)
+  {
+    frames->inbox_err = true;
+    return LOG_INFO("datagram too small: %lu",len);
+  }
+
+  memcpy(&magic, data, 2);
+  memcpy(&plen, data+2, 2);
+  magic = util_sys_short(magic);
+  plen = util_sys_short(plen);
+  len -= UTIL_FRAMES_DGRAM_HDR;
+  if(magic != (uint16_t)frames->magic || plen != len || len > frames->max)
+  {
+    frames->inbox_err = true;
+    return LOG_INFO("datagram header mismatch: %u/%u %u/%lu",(uint16_t)frames->magic,magic,plen,len);
+  }
+
+  lob_t pkt = lob_parse(data+UTIL_FRAMES_DGRAM_HDR, len);
+  if(!pkt)
+  {
+    frames->inbox_err = true;
+    return LOG_INFO("invalid packet datagram");
+  }
+  frames->inbox_err = false;
+  if(!qring_push(&frames->inbox, pkt, frames->is_receiving))
+  {
+    lob_free(pkt);
+    return LOG_WARN("inbox full, dropped packet");
+  }
+  frames->inbytes += len;
+  return frames;
+}
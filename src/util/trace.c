@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <string.h>
+#include "telehash.h"
+
+#ifdef TELEHASH_TRACE_USDT
+#include <sys/sdt.h>
+#endif
+
+// histograms are process wide and any thread may record, so every counter is a relaxed atomic
+uint32_t util_trace_every = 0;
+static uint32_t trace_skip[UTIL_TRACE_STAGES];
+static uint64_t trace_count[UTIL_TRACE_STAGES];
+static uint64_t trace_max[UTIL_TRACE_STAGES];
+static uint32_t trace_hist[UTIL_TRACE_STAGES][UTIL_TRACE_BUCKETS];
+static void (*trace_hook)(uint8_t stage, uint64_t ns, void *arg) = NULL;
+static void *trace_arg = NULL;
+
+static char *trace_names[UTIL_TRACE_STAGES] = {"transport", "mesh", "handshake", "exchange", "parse", "link", "chan"};
+
+// values under 16 are exact, then 16 buckets for each power of two
+static uint32_t trace_bucket(uint64_t ns)
+{
+  uint32_t msb = 0;
+  uint64_t v = ns;
+  if(ns < 16) return (uint32_t)ns;
+  while(v >>= 1) msb++;
+  return (msb - 3) * 16 + (uint32_t)((ns >> (msb - 4)) & 15);
+}
+
+// highest value that lands in a bucket
+static uint64_t trace_value(uint32_t bucket)
+{
+  uint32_t msb;
+  if(bucket < 16) return bucket;
+  msb = bucket / 16 + 3;
+  return ((uint64_t)(16 + bucket % 16 + 1) << (msb - 4)) - 1;
+}
+
+void util_trace_start(uint32_t every)
+{
+  uint8_t stage;
+  for(stage = 0; stage < UTIL_TRACE_STAGES; stage++) __atomic_store_n(&trace_skip[stage], 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&util_trace_every, every, __ATOMIC_RELAXED);
+}
+
+void util_trace_hook(void (*hook)(uint8_t stage, uint64_t ns, void *arg), void *arg)
+{
+  trace_hook = hook;
+  trace_arg = arg;
+}
+
+uint8_t util_trace_sample(uint8_t stage)
+{
+  uint32_t every = __atomic_load_n(&util_trace_every, __ATOMIC_RELAXED);
+  if(!every || stage >= UTIL_TRACE_STAGES) return 0;
+  return (__atomic_add_fetch(&trace_skip[stage], 1, __ATOMIC_RELAXED) % every) == 0;
+}
+
+void util_trace(uint8_t stage, uint64_t ns)
+{
+  uint64_t max;
+  if(stage >= UTIL_TRACE_STAGES) return;
+  __atomic_add_fetch(&trace_hist[stage][trace_bucket(ns)], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&trace_count[stage], 1, __ATOMIC_RELAXED);
+  max = __atomic_load_n(&trace_max[stage], __ATOMIC_RELAXED);
+  while(ns > max && !__atomic_compare_exchange_n(&trace_max[stage], &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#ifdef TELEHASH_TRACE_USDT
+  DTRACE_PROBE2(telehash, trace, stage, ns);
+#endif
+  if(trace_hook) trace_hook(stage, ns, trace_arg);
+}
+
+void util_trace_reset(void)
+{
+  uint32_t i;
+  uint8_t stage;
+  for(stage = 0; stage < UTIL_TRACE_STAGES; stage++)
+  {
+    for(i = 0; i < UTIL_TRACE_BUCKETS; i++) __atomic_store_n(&trace_hist[stage][i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&trace_count[stage], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&trace_max[stage], 0, __ATOMIC_RELAXED);
+  }
+}
+
+uint64_t util_trace_count(uint8_t stage)
+{
+  if(stage >= UTIL_TRACE_STAGES) return 0;
+  return __atomic_load_n(&trace_count[stage], __ATOMIC_RELAXED);
+}
+
+uint64_t util_trace_percentile(uint8_t stage, double percentile)
+{
+  uint64_t want, seen = 0, count, max;
+  uint32_t i;
+  if(stage >= UTIL_TRACE_STAGES) return 0;
+  // other threads may still be recording, so this is a snapshot that's close but not exact
+  count = __atomic_load_n(&trace_count[stage], __ATOMIC_RELAXED);
+  max = __atomic_load_n(&trace_max[stage], __ATOMIC_RELAXED);
+  if(!count) return 0;
+  if(percentile >= 100) return max;
+  // nearest rank
+  want = (uint64_t)((percentile / 100.0) * count);
+  if(want < count && want < (percentile / 100.0) * count) want++;
+  if(!want) want = 1;
+  for(i = 0; i < UTIL_TRACE_BUCKETS; i++)
+  {
+    seen += __atomic_load_n(&trace_hist[stage][i], __ATOMIC_RELAXED);
+    if(seen >= want) break;
+  }
+  // never past what was actually seen
+  return (i < UTIL_TRACE_BUCKETS && trace_value(i) < max) ? trace_value(i) : max;
+}
+
+char *util_trace_name(uint8_t stage)
+{
+  if(stage >= UTIL_TRACE_STAGES) return NULL;
+  return trace_names[stage];
+}
+
+lob_t util_trace_json(void)
+{
+  lob_t json = lob_new(), one;
+  uint8_t stage;
+  char num[24];
+  for(stage = 0; stage < UTIL_TRACE_STAGES; stage++)
+  {
+    if(!util_trace_count(stage)) continue;
+    one = lob_new();
+    snprintf(num, sizeof(num), "%llu", (unsigned long long)util_trace_count(stage));
+    lob_set_raw(one, "count", 0, num, strlen(num));
+    snprintf(num, sizeof(num), "%llu", (unsigned long long)util_trace_percentile(stage, 50));
+    lob_set_raw(one, "p50", 0, num, strlen(num));
+    snprintf(num, sizeof(num), "%llu", (unsigned long long)util_trace_percentile(stage, 90));
+    lob_set_raw(one, "p90", 0, num, strlen(num));
+    snprintf(num, sizeof(num), "%llu", (unsigned long long)util_trace_percentile(stage, 99));
+    lob_set_raw(one, "p99", 0, num, strlen(num));
+    snprintf(num, sizeof(num), "%llu", (unsigned long long)util_trace_percentile(stage, 99.9));
+    lob_set_raw(one, "p999", 0, num, strlen(num));
+    snprintf(num, sizeof(num), "%llu", (unsigned long long)__atomic_load_n(&trace_max[stage], __ATOMIC_RELAXED));
+    lob_set_raw(one, "max", 0, num, strlen(num));
+    lob_set_raw(json, trace_names[stage], 0, (char*)one->head, one->head_len);
+    lob_free(one);
+  }
+  return json;
+}
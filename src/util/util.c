@@ -9,11 +9,15 @@ char *util_hex(uint8_t *in, size_t len, char *out)
     uint32_t j;
     char *c = out;
     static char *hex = "0123456789abcdef";
-    static char *buf = NULL;
+    static UTIL_TLS char buf[UTIL_HEX_TMP*2+1];
     if(!in || !len) return NULL;
 
     // utility mode only! use/return an internal buffer
-    if(!out && !(c = out = buf = realloc(buf,len*2+1))) return NULL;
+    if(!out)
+    {
+      if(len > UTIL_HEX_TMP) len = UTIL_HEX_TMP;
+      c = out = buf;
+    }
 
     for (j = 0; j < len; j++) {
       *c = hex[((in[j]&240)/16)];
@@ -184,6 +188,32 @@ int util_ct_memcmp(const void* s1, const void* s2, size_t n)
     return x;
 }
 
+void util_zero(void *ptr, size_t len)
+{
+  volatile uint8_t *p = ptr;
+  if(!p) return;
+  while(len--) *p++ = 0;
+}
+
+uint8_t *util_put_be(uint64_t val, uint8_t *out, uint8_t bytes)
+{
+  if(!out) return NULL;
+  while(bytes--)
+  {
+    out[bytes] = (uint8_t)val;
+    val >>= 8;
+  }
+  return out;
+}
+
+uint64_t util_get_be(const uint8_t *in, uint8_t bytes)
+{
+  uint64_t val = 0;
+  if(!in) return 0;
+  while(bytes--) val = (val << 8) | *in++;
+  return val;
+}
+
 // embedded may not have strdup but it's a kinda handy shortcut
 char *util_strdup(const char *str)
 {
@@ -196,3 +226,43 @@ char *util_strdup(const char *str)
   return ret;
 }
 
+
+// nibble-at-a-time table keeps this small for embedded
+static const uint32_t crc32_nibble[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+uint32_t util_crc32(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  crc = ~crc;
+  while(buf && len--)
+  {
+    crc ^= *buf++;
+    crc = (crc >> 4) ^ crc32_nibble[crc & 0x0f];
+    crc = (crc >> 4) ^ crc32_nibble[crc & 0x0f];
+  }
+  return ~crc;
+}
+
+uint8_t util_bucket_take(util_bucket_s *bucket, uint32_t rate, uint32_t burst, uint32_t now)
+{
+  uint64_t tokens, max;
+  if(!bucket) return 0;
+  if(!rate) return 1;
+  max = (uint64_t)(burst ? burst : 1) * 1000;
+
+  // rate tokens/sec is rate thousandths per ms
+  if(!bucket->at) tokens = max;
+  else tokens = bucket->tokens + (uint64_t)(uint32_t)(now - bucket->at) * rate;
+  if(tokens > max) tokens = max;
+  bucket->at = now;
+
+  if(tokens < 1000)
+  {
+    bucket->tokens = (uint32_t)tokens;
+    return 0;
+  }
+  bucket->tokens = (uint32_t)(tokens - 1000);
+  return 1;
+}
@@ -0,0 +1,77 @@
+#ifndef _bench_h_
+#define _bench_h_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// shared timing for the bench_* programs, every result is one json object per line on stdout so runs can be diffed between releases
+// anything else (notes, warnings) goes to stderr
+
+// how long each measurement runs, override w/ the BENCH_MS env var
+#ifndef BENCH_MS
+#define BENCH_MS 500
+#endif
+
+static inline unsigned long long bench_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static inline unsigned long long bench_budget(void)
+{
+  char *env = getenv("BENCH_MS");
+  unsigned long long ms = env ? strtoull(env, NULL, 10) : 0;
+  return (ms ? ms : BENCH_MS) * 1000000ULL;
+}
+
+// bytes is per op, 0 when throughput doesn't apply
+static inline void bench_report(const char *group, const char *name, unsigned long ops, unsigned long long ns, size_t bytes)
+{
+  double secs = ns / 1e9;
+  printf("{\"group\":\"%s\",\"bench\":\"%s\",\"ops\":%lu,\"ns\":%llu,\"ops_sec\":%.1f,\"ns_op\":%.1f", group, name, ops, ns, secs > 0 ? ops / secs : 0.0, ops ? (double)ns / ops : 0.0);
+  if(bytes) printf(",\"bytes\":%lu,\"mb_sec\":%.2f", (unsigned long)bytes, secs > 0 ? (ops * (double)bytes) / (secs * 1048576.0) : 0.0);
+  printf("}\n");
+  fflush(stdout);
+}
+
+// runs the statement(s) for the time budget and reports it
+#define BENCH(group, name, bytes, ...) do { \
+    unsigned long _ops = 0; \
+    unsigned long long _start = bench_ns(), _ns, _budget = bench_budget(); \
+    do { __VA_ARGS__; _ops++; } while((_ns = bench_ns() - _start) < _budget); \
+    bench_report(group, name, _ops, _ns, bytes); \
+  } while(0)
+
+// latency samples, reported as percentiles
+typedef struct bench_lat_struct
+{
+  unsigned long long *ns;
+  unsigned long count, max;
+} bench_lat_s;
+
+static inline int bench_lat_cmp(const void *a, const void *b)
+{
+  unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+  return (x > y) - (x < y);
+}
+
+static inline void bench_lat_add(bench_lat_s *lat, unsigned long long ns)
+{
+  if(lat->count < lat->max) lat->ns[lat->count++] = ns;
+}
+
+static inline void bench_lat_report(const char *group, const char *name, bench_lat_s *lat)
+{
+  unsigned long n = lat->count;
+  if(!n) return;
+  qsort(lat->ns, n, sizeof(unsigned long long), bench_lat_cmp);
+  printf("{\"group\":\"%s\",\"bench\":\"%s\",\"samples\":%lu,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n", group, name, n,
+    lat->ns[n*50/100], lat->ns[n*90/100], lat->ns[n*99/100], lat->ns[n*999/1000], lat->ns[n-1]);
+  fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#include "telehash.h"
+#include "bench.h"
+
+// keystream throughput for each chacha core the cpu supports, and what a cs3b channel packet's AEAD costs
+static uint8_t buf[16384];
+
+int main(int argc, char **argv)
+{
+  uint8_t key[32], nonce[12], tag[16], core, cores[] = {CHACHA_REF, CHACHA_SSE2, CHACHA_AVX2, CHACHA_NEON};
+  uint32_t sizes[] = {64, 1024, sizeof(buf)};
+  char name[64];
+  uint32_t c, s;
+
+  memset(key, 42, sizeof(key));
+  memset(nonce, 7, sizeof(nonce));
+#ifndef __OPTIMIZE__
+  fprintf(stderr, "built w/o optimization, the wide cores need -O2 to pay off\n");
+#endif
+
+  for(c = 0; c < sizeof(cores); c++)
+  {
+    if((core = chacha20_core(cores[c])) != cores[c]) continue;
+    for(s = 0; s < sizeof(sizes)/sizeof(uint32_t); s++)
+    {
+      snprintf(name, sizeof(name), "chacha20_%s_%u", chacha20_core_name(core), sizes[s]);
+      BENCH("chacha", name, sizes[s], chacha20_ietf(key, nonce, 1, buf, sizes[s]));
+    }
+
+    snprintf(name, sizeof(name), "seal_%s_1024", chacha20_core_name(core));
+    BENCH("chacha", name, 1024, chacha20poly1305_seal(key, nonce, key, 16, buf, 1024, tag));
+  }
+
+  chacha20_core(CHACHA_AUTO);
+  return 0;
+}
@@ -0,0 +1,84 @@
+#include "telehash.h"
+#include "bench.h"
+
+// handshake and channel packet costs for every cipher set built in
+static uint8_t body[1024];
+
+static void cs_bench(e3x_cipher_t cs, lob_t secretsA, lob_t secretsB)
+{
+  char name[64];
+  lob_t keysA = lob_linked(secretsA), keysB = lob_linked(secretsB), msg, outer, inner, open, couter, cinner;
+  lob_t keyA = lob_get_base32(keysA, cs->hex), keyB = lob_get_base32(keysB, cs->hex);
+  // these are void* defines, one per declaration
+  local_t localA = cs->local_new(keysA, secretsA);
+  local_t localB = cs->local_new(keysB, secretsB);
+  remote_t remoteA = cs->remote_new(keyA, NULL);
+  remote_t remoteB = cs->remote_new(keyB, NULL);
+  ephemeral_t ephemAB;
+  ephemeral_t ephemBA;
+  ephemeral_t ephem;
+
+  lob_free(keyA);
+  lob_free(keyB);
+
+  if(!localA || !localB || !remoteA || !remoteB)
+  {
+    fprintf(stderr, "skipping %s, keys failed\n", cs->hex);
+    return;
+  }
+
+  msg = lob_new();
+  lob_set(msg, "type", "link");
+  lob_body(msg, body, 64);
+
+  // the initiator's and the responder's halves of a handshake
+  snprintf(name, sizeof(name), "cs%s_handshake_encrypt", cs->hex);
+  BENCH("cs", name, 0, lob_free(cs->remote_encrypt(remoteB, localA, msg)));
+  outer = cs->remote_encrypt(remoteB, localA, msg);
+  snprintf(name, sizeof(name), "cs%s_handshake_decrypt", cs->hex);
+  BENCH("cs", name, 0, (inner = cs->local_decrypt(localB, outer), cs->remote_verify(remoteA, localB, outer), ephem = cs->ephemeral_new(remoteA, outer), cs->ephemeral_free(ephem), lob_free(inner)));
+
+  // channel packets once the session is up
+  ephemBA = cs->ephemeral_new(remoteA, outer);
+  lob_free(outer);
+  outer = cs->remote_encrypt(remoteA, localB, msg);
+  ephemAB = cs->ephemeral_new(remoteB, outer);
+  lob_free(outer);
+
+  open = lob_new();
+  lob_set_uint(open, "c", 1);
+  lob_body(open, body, sizeof(body));
+  snprintf(name, sizeof(name), "cs%s_channel_encrypt", cs->hex);
+  BENCH("cs", name, lob_len(open), lob_free(cs->ephemeral_encrypt(ephemBA, open)));
+  // every decrypt needs a fresh packet for the replay window
+  snprintf(name, sizeof(name), "cs%s_channel_roundtrip", cs->hex);
+  BENCH("cs", name, lob_len(open), (couter = cs->ephemeral_encrypt(ephemBA, open), cinner = cs->ephemeral_decrypt(ephemAB, couter), lob_free(couter), lob_free(cinner)));
+
+  lob_free(open);
+  lob_free(msg);
+  cs->ephemeral_free(ephemAB);
+  cs->ephemeral_free(ephemBA);
+  cs->remote_free(remoteA);
+  cs->remote_free(remoteB);
+  cs->local_free(localA);
+  cs->local_free(localB);
+}
+
+int main(int argc, char **argv)
+{
+  lob_t secretsA, secretsB;
+  uint8_t i;
+
+  util_sys_logging(0);
+  if(e3x_init(NULL)) return 1;
+  e3x_rand(body, sizeof(body));
+  secretsA = e3x_generate();
+  secretsB = e3x_generate();
+  if(!secretsA || !secretsB) return 1;
+
+  for(i = 0; i < CS_MAX; i++) if(e3x_cipher_sets[i] && lob_get(secretsA, e3x_cipher_sets[i]->hex)) cs_bench(e3x_cipher_sets[i], secretsA, secretsB);
+
+  lob_free(secretsA);
+  lob_free(secretsB);
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include "telehash.h"
+#include "bench.h"
+
+// operations per second for the secp256r1 calls cs1c makes per handshake and per ES256 validation
+#define BENCH_BATCH 64
+
+int main(int argc, char **argv)
+{
+  uECC_Curve curve = uECC_secp256r1();
+  uint8_t secret[32], key[64], secret2[32], key2[64], shared[32], hash[32], sig[64];
+  unsigned long long start;
+
+  // the table is built once up front so it isn't counted
+  start = bench_ns();
+  int comb = uECC_precompute(curve);
+  fprintf(stderr, "fixed-base comb %s, precompute %llu ms\n", comb ? "enabled" : "disabled", (bench_ns() - start) / 1000000);
+
+  memset(hash, 42, sizeof(hash));
+  uECC_make_key(key2, secret2, curve);
+
+  BENCH("ecc", "uECC_make_key", 0, uECC_make_key(key, secret, curve));
+  BENCH("ecc", "uECC_sign", 0, uECC_sign(secret, hash, 32, sig, curve));
+  BENCH("ecc", "uECC_verify", 0, uECC_verify(key, hash, 32, sig, curve));
+
+  // a gateway's view, batches of signatures by a few issuers, each op is one signature
+  uint8_t bkeys[4][64], bsecret[32], bhashes[BENCH_BATCH][32], bsigs[BENCH_BATCH][64], valid[BENCH_BATCH];
+  const uint8_t *kp[BENCH_BATCH], *hp[BENCH_BATCH], *sp[BENCH_BATCH];
+  unsigned i, j;
+  for(i = 0; i < 4; i++)
+  {
+    uECC_make_key(bkeys[i], bsecret, curve);
+    for(j = i; j < BENCH_BATCH; j += 4)
+    {
+      memset(bhashes[j], (int)j, 32);
+      uECC_sign(bsecret, bhashes[j], 32, bsigs[j], curve);
+      kp[j] = bkeys[i];
+      hp[j] = bhashes[j];
+      sp[j] = bsigs[j];
+    }
+  }
+  unsigned long ops = 0;
+  unsigned long long ns, budget = bench_budget();
+  start = bench_ns();
+  do {
+    uECC_verify_batch(kp, hp, 32, sp, BENCH_BATCH, valid, curve);
+    ops += BENCH_BATCH;
+  } while((ns = bench_ns() - start) < budget);
+  bench_report("ecc", "uECC_verify_batch", ops, ns, 0);
+
+  BENCH("ecc", "uECC_shared_secret", 0, uECC_shared_secret(key2, secret, shared, curve));
+
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include "telehash.h"
+#include "bench.h"
+
+// packet framing throughput for the datagram and stream transports, each op is one 1k packet through both ends
+
+// stream one side's bytes into the other
+static uint32_t chunks_pump(util_chunks_t from, util_chunks_t to)
+{
+  uint32_t len, total = 0;
+  while((len = util_chunks_len(from)))
+  {
+    util_chunks_read(to, util_chunks_write(from), len);
+    util_chunks_written(from, len);
+    total += len;
+  }
+  return total;
+}
+
+static lob_t chunks_roundtrip(util_chunks_t a, util_chunks_t b, lob_t packet)
+{
+  lob_t got = NULL;
+  uint8_t tries;
+  util_chunks_send(a, lob_copy(packet));
+  for(tries = 0; tries < 100 && !got; tries++)
+  {
+    chunks_pump(a, b);
+    chunks_pump(b, a); // v2 acks
+    got = util_chunks_receive(b);
+  }
+  return got;
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t dgram[UTIL_FRAMES_DGRAM_HDR + 2048], *frame;
+  uint32_t len;
+  util_frames_t fa, fb;
+  util_chunks_t ca, cb;
+  lob_t packet = lob_new();
+
+  util_sys_logging(0);
+  lob_set(packet, "type", "bench");
+  lob_body(packet, NULL, 1024);
+
+  fa = util_frames_new(42, 2048);
+  fb = util_frames_new(42, 2048);
+  BENCH("frames", "util_frames_dgram", lob_len(packet), {
+    util_frames_send(fa, lob_copy(packet));
+    while((frame = util_frames_dgram_outbox(fa, dgram, &len)))
+    {
+      memcpy(dgram+UTIL_FRAMES_DGRAM_HDR, frame, len);
+      util_frames_dgram_inbox(fb, dgram, UTIL_FRAMES_DGRAM_HDR+len);
+      util_frames_sent(fa);
+    }
+    lob_free(util_frames_receive(fb));
+  });
+  BENCH("frames", "util_frames_stream", lob_len(packet), {
+    util_frames_send(fa, lob_copy(packet));
+    while(util_frames_busy(fa) && (frame = util_frames_outbox(fa, &len)))
+    {
+      util_frames_inbox(fb, frame, len);
+      util_frames_sent(fa);
+    }
+    lob_free(util_frames_receive(fb));
+  });
+  util_frames_free(fa);
+  util_frames_free(fb);
+
+  ca = util_chunks_new(0);
+  cb = util_chunks_new(0);
+  BENCH("frames", "util_chunks_v1", lob_len(packet), lob_free(chunks_roundtrip(ca, cb, packet)));
+  util_chunks_free(ca);
+  util_chunks_free(cb);
+
+  ca = util_chunks_framed(util_chunks_v2(util_chunks_new(0), 0, 4));
+  cb = util_chunks_framed(util_chunks_v2(util_chunks_new(0), 0, 4));
+  BENCH("frames", "util_chunks_v2_framed", lob_len(packet), lob_free(chunks_roundtrip(ca, cb, packet)));
+  util_chunks_free(ca);
+  util_chunks_free(cb);
+
+  lob_free(packet);
+  return 0;
+}
@@ -0,0 +1,28 @@
+#include "telehash.h"
+#include "bench.h"
+
+// hashing and the aes ctr cs1c uses for channel packets
+static uint8_t buf[16384];
+
+int main(int argc, char **argv)
+{
+  uint8_t key[32], out[16384], iv[16], okm[64];
+  size_t sizes[] = {64, 1024, sizeof(buf)};
+  char name[64];
+  uint32_t s;
+
+  memset(key, 42, sizeof(key));
+  memset(buf, 7, sizeof(buf));
+  for(s = 0; s < sizeof(sizes)/sizeof(size_t); s++)
+  {
+    snprintf(name, sizeof(name), "sha256_%lu", (unsigned long)sizes[s]);
+    BENCH("hash", name, sizes[s], sha256(buf, sizes[s], out, 0));
+    snprintf(name, sizeof(name), "hmac_256_%lu", (unsigned long)sizes[s]);
+    BENCH("hash", name, sizes[s], hmac_256(key, 32, buf, sizes[s], out));
+    snprintf(name, sizeof(name), "aes_128_ctr_%lu", (unsigned long)sizes[s]);
+    BENCH("hash", name, sizes[s], (memset(iv, 0, 16), aes_128_ctr(key, sizes[s], iv, buf, out)));
+  }
+  BENCH("hash", "hkdf_sha256_64", 64, hkdf_sha256(key, 16, buf, 32, key, 16, okm, 64));
+
+  return 0;
+}
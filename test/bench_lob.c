@@ -0,0 +1,55 @@
+#include "telehash.h"
+#include "bench.h"
+
+// packet and encoding primitives on every packet's path
+static const char *json = "{\"type\":\"test\",\"c\":42,\"seq\":1234,\"ack\":1200,\"miss\":[1201,1203],\"hashname\":\"ufd2hx6tsdkqygk3dfz4cmrpzqu6pqjzzfajoqkdxwhurxsoteoq\"}";
+
+static void xht_bench(void)
+{
+  xht_t h = xht_new(101);
+  static char keys[64][8];
+  int i;
+  for(i = 0; i < 64; i++)
+  {
+    snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+    xht_set(h, keys[i], keys[i]);
+  }
+  i = 0;
+  BENCH("lob", "xht_get", 0, xht_get(h, keys[i++ & 63]));
+  BENCH("lob", "xht_set", 0, xht_set(h, keys[i++ & 63], keys[0]));
+  xht_free(h);
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t bin[1024], dec[1024];
+  char enc[2048];
+  size_t vlen, elen;
+  lob_t p, q;
+
+  util_sys_logging(0);
+  e3x_rand(bin, sizeof(bin));
+
+  p = lob_new();
+  lob_head(p, (uint8_t*)json, strlen(json));
+  lob_body(p, bin, 1024);
+  q = NULL;
+  BENCH("lob", "lob_parse", lob_len(p), (q = lob_parse(lob_raw(p), lob_len(p)), lob_free(q)));
+  BENCH("lob", "lob_get", 0, lob_get(p, "hashname"));
+  BENCH("lob", "lob_get_int", 0, lob_get_int(p, "seq"));
+  BENCH("lob", "lob_set", 0, (q = lob_new(), lob_set(q, "type", "test"), lob_set_uint(q, "c", 42), lob_set(q, "hashname", "ufd2hx6tsdkqygk3dfz4cmrpzqu6pqjzzfajoqkdxwhurxsoteoq"), lob_free(q)));
+  BENCH("lob", "lob_copy", lob_len(p), lob_free(lob_copy(p)));
+  BENCH("lob", "js0n", strlen(json), js0n("hashname", 8, (char*)json, strlen(json), &vlen));
+  lob_free(p);
+
+  xht_bench();
+
+  BENCH("lob", "base32_encode_32", 32, base32_encode(bin, 32, enc, sizeof(enc)));
+  elen = base32_encode(bin, 1024, enc, sizeof(enc));
+  BENCH("lob", "base32_decode_1024", 1024, base32_decode(enc, elen, dec, sizeof(dec)));
+  BENCH("lob", "base64_encode_1024", 1024, base64_encoder(bin, 1024, enc));
+  elen = base64_encoder(bin, 1024, enc);
+  BENCH("lob", "base64_decode_1024", 1024, base64_decoder(enc, elen, dec));
+
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "telehash.h"
+#include "net_loopback.h"
+#include "bench.h"
+
+// end to end channel packets between two meshes over the loopback transport, encrypt through the peer's open handler
+#define BENCH_SAMPLES 1000000
+
+static unsigned long received = 0;
+
+static lob_t on_open(link_t link, lob_t open)
+{
+  received++;
+  lob_free(open);
+  return NULL;
+}
+
+static lob_t packet(size_t len)
+{
+  lob_t open = lob_new();
+  lob_set(open, "type", "bench");
+  lob_body(open, NULL, len);
+  return open;
+}
+
+int main(int argc, char **argv)
+{
+  bench_lat_s lat;
+  unsigned long long start;
+  unsigned long sent = 0;
+  size_t sizes[] = {64, 1024};
+  char name[64];
+  uint32_t s;
+
+  util_sys_logging(0);
+  mesh_t meshA = mesh_new();
+  lob_free(mesh_generate(meshA));
+  mesh_t meshB = mesh_new();
+  lob_free(mesh_generate(meshB));
+  mesh_on_open(meshB, "bench", on_open);
+  net_loopback_t pair = net_loopback_new(meshA, meshB);
+  link_t linkAB = link_get(meshA, meshB->id);
+  if(!link_resync(linkAB) || !link_up(linkAB))
+  {
+    fprintf(stderr, "link failed\n");
+    return 1;
+  }
+
+  // a fresh pair's handshake to the link being up
+  BENCH("mesh", "loopback_handshake", 0, link_resync(linkAB));
+
+  for(s = 0; s < sizeof(sizes)/sizeof(size_t); s++)
+  {
+    snprintf(name, sizeof(name), "loopback_pps_%lu", (unsigned long)sizes[s]);
+    BENCH("mesh", name, sizes[s], (link_direct(linkAB, packet(sizes[s])), sent++));
+  }
+
+  // per packet latency, delivery is synchronous so this is all cpu
+  lat.max = BENCH_SAMPLES;
+  lat.count = 0;
+  if(!(lat.ns = malloc(sizeof(unsigned long long) * lat.max))) return 1;
+  BENCH("mesh", "loopback_timed_1024", 1024, (start = bench_ns(), link_direct(linkAB, packet(1024)), bench_lat_add(&lat, bench_ns() - start), sent++));
+  bench_lat_report("mesh", "loopback_latency_1024", &lat);
+  free(lat.ns);
+
+  if(received != sent) fprintf(stderr, "only %lu of %lu packets arrived\n", received, sent);
+
+  mesh_free(meshA);
+  mesh_free(meshB);
+  net_loopback_free(pair);
+  return received == sent ? 0 : 1;
+}
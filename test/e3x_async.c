@@ -0,0 +1,257 @@
+#include <pthread.h>
+#include <unistd.h>
+#include "net_sim.h"
+#include "unit_test.h"
+
+// slots held by a fake cipher set for the queue-only checks
+static void *held[8];
+static uint32_t holding = 0, take = 8;
+
+static uint32_t hold(void *ctx, lob_t *packets, void **slots, uint32_t count)
+{
+  uint32_t i;
+  if(count > take) count = take;
+  for(i = 0; i < count; i++) held[holding++] = slots[i];
+  return count;
+}
+
+lob_t numbered(uint32_t n)
+{
+  lob_t packet = lob_new();
+  lob_set_uint(packet,"n",n);
+  return packet;
+}
+
+// a stand-in offload engine, one thread that takes whatever's waiting and finishes it newest first
+#define JOBS 1024
+typedef struct job_struct
+{
+  e3x_cipher_t cs;
+  void *state;
+  uint8_t kind; // 0 local decrypt, 1 encrypt, 2 decrypt
+  lob_t packet;
+  e3x_cipher_done_t done;
+  void *arg;
+} job_s;
+
+static job_s jobs[JOBS];
+static uint32_t queued = 0, batches = 0, biggest = 0, readies = 0;
+static uint8_t stopping = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static uint32_t engine_submit(e3x_cipher_t cs, void *state, uint8_t kind, lob_t *packets, uint32_t count, e3x_cipher_done_t done, void **args)
+{
+  uint32_t i;
+  pthread_mutex_lock(&lock);
+  for(i = 0; i < count && queued < JOBS; i++, queued++)
+  {
+    jobs[queued].cs = cs;
+    jobs[queued].state = state;
+    jobs[queued].kind = kind;
+    jobs[queued].packet = packets[i];
+    jobs[queued].done = done;
+    jobs[queued].arg = args[i];
+  }
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&lock);
+  return i;
+}
+
+static void *engine(void *arg)
+{
+  static job_s taken[JOBS];
+  uint32_t count, i;
+  lob_t result;
+  for(;;)
+  {
+    pthread_mutex_lock(&lock);
+    while(!queued && !stopping) pthread_cond_wait(&cond, &lock);
+    if(!queued)
+    {
+      pthread_mutex_unlock(&lock);
+      return NULL;
+    }
+    pthread_mutex_unlock(&lock);
+
+    // let more pile up so they finish out of order
+    usleep(500);
+    pthread_mutex_lock(&lock);
+    count = queued;
+    memcpy(taken, jobs, count * sizeof(job_s));
+    queued = 0;
+    pthread_mutex_unlock(&lock);
+
+    for(i = count; i > 0; i--)
+    {
+      job_s *job = &taken[i-1];
+      if(job->kind == 0) result = job->cs->local_decrypt(job->state, job->packet);
+      else if(job->kind == 1) result = job->cs->ephemeral_encrypt(job->state, job->packet);
+      else result = job->cs->ephemeral_decrypt(job->state, job->packet);
+      job->done(result, job->arg);
+    }
+  }
+}
+
+// the async slots for every cipher set, routed to the engine w/ the cipher set they're for
+#define ENGINE_CS(i) \
+  static uint8_t local_submit_##i(local_t local, lob_t outer, e3x_cipher_done_t done, void *arg) { return engine_submit(e3x_cipher_sets[i], local, 0, &outer, 1, done, &arg); } \
+  static uint8_t encrypt_submit_##i(ephemeral_t ephem, lob_t inner, e3x_cipher_done_t done, void *arg) { return engine_submit(e3x_cipher_sets[i], ephem, 1, &inner, 1, done, &arg); } \
+  static uint8_t decrypt_submit_##i(ephemeral_t ephem, lob_t outer, e3x_cipher_done_t done, void *arg) { return engine_submit(e3x_cipher_sets[i], ephem, 2, &outer, 1, done, &arg); } \
+  static uint32_t submit_batch_##i(ephemeral_t ephem, uint8_t encrypt, lob_t *packets, uint32_t count, e3x_cipher_done_t done, void **args) \
+  { \
+    batches++; \
+    if(count > biggest) biggest = count; \
+    return engine_submit(e3x_cipher_sets[i], ephem, encrypt ? 1 : 2, packets, count, done, args); \
+  }
+ENGINE_CS(0)
+ENGINE_CS(1)
+ENGINE_CS(2)
+
+static void engine_slots(uint8_t on)
+{
+  uint8_t (*locals[])(local_t, lob_t, e3x_cipher_done_t, void *) = {local_submit_0, local_submit_1, local_submit_2};
+  uint8_t (*encrypts[])(ephemeral_t, lob_t, e3x_cipher_done_t, void *) = {encrypt_submit_0, encrypt_submit_1, encrypt_submit_2};
+  uint8_t (*decrypts[])(ephemeral_t, lob_t, e3x_cipher_done_t, void *) = {decrypt_submit_0, decrypt_submit_1, decrypt_submit_2};
+  uint32_t (*batch[])(ephemeral_t, uint8_t, lob_t *, uint32_t, e3x_cipher_done_t, void **) = {submit_batch_0, submit_batch_1, submit_batch_2};
+  uint8_t i;
+  for(i = 0; i < CS_MAX; i++)
+  {
+    if(!e3x_cipher_sets[i]) continue;
+    e3x_cipher_sets[i]->local_decrypt_submit = on ? locals[i] : NULL;
+    e3x_cipher_sets[i]->ephemeral_encrypt_submit = on ? encrypts[i] : NULL;
+    e3x_cipher_sets[i]->ephemeral_decrypt_submit = on ? decrypts[i] : NULL;
+    e3x_cipher_sets[i]->ephemeral_submit_batch = on ? batch[i] : NULL;
+  }
+}
+
+static void ready(mesh_t mesh, void *arg)
+{
+  __atomic_add_fetch(&readies, 1, __ATOMIC_RELAXED);
+}
+
+// channel opens in the order they were handed to the app
+static uint32_t arrived[128];
+static uint32_t arrivals = 0;
+
+lob_t open_arrive(link_t link, lob_t open)
+{
+  if(arrivals < 128) arrived[arrivals] = lob_get_uint(open,"n");
+  arrivals++;
+  lob_free(open);
+  return NULL;
+}
+
+mesh_t mesh_async_new(void)
+{
+  mesh_t mesh = mesh_new();
+  lob_free(mesh_generate(mesh));
+  mesh_on_open(mesh, "async", open_arrive);
+  mesh_async(mesh, ready, NULL);
+  return mesh;
+}
+
+static void settle(net_sim_t sim, mesh_t a, mesh_t b)
+{
+  net_sim_run(sim, 1000);
+  mesh_flush(a);
+  mesh_flush(b);
+  usleep(100);
+}
+
+int main(int argc, char **argv)
+{
+  lob_t packet, result;
+  pthread_t thread;
+  uint32_t i;
+
+  util_sys_logging(0);
+  fail_unless(e3x_init(NULL) == 0);
+
+  // results only come out in the order they went in
+  e3x_async_t q = e3x_async_new(3, NULL, NULL);
+  fail_unless(q);
+  for(i = 0; i < 4; i++) fail_unless(e3x_async_push(q, numbered(i), NULL));
+  fail_unless(!e3x_async_push(q, numbered(4), NULL));
+  take = 2;
+  fail_unless(e3x_async_flush(q, hold, NULL) == 2);
+  fail_unless(e3x_async_staged(q) == 2 && e3x_async_pending(q) == 2);
+  fail_unless(!e3x_async_pop(q, &packet, &result));
+  e3x_async_done(numbered(101), held[1]);
+  fail_unless(!e3x_async_pop(q, &packet, &result));
+  e3x_async_done(numbered(100), held[0]);
+  fail_unless(e3x_async_pending(q) == 0);
+  fail_unless(e3x_async_pop(q, &packet, &result));
+  fail_unless(lob_get_uint(packet,"n") == 0 && lob_get_uint(result,"n") == 100);
+  lob_free(packet);
+  lob_free(result);
+  fail_unless(e3x_async_pop(q, &packet, &result));
+  fail_unless(lob_get_uint(packet,"n") == 1 && lob_get_uint(result,"n") == 101);
+  lob_free(packet);
+  lob_free(result);
+  fail_unless(!e3x_async_pop(q, &packet, &result)); // still only staged
+  take = 8;
+  fail_unless(e3x_async_flush(q, hold, NULL) == 2);
+  e3x_async_done(numbered(103), held[3]);
+  e3x_async_done(NULL, held[2]);
+  fail_unless(e3x_async_pop(q, &packet, &result));
+  fail_unless(lob_get_uint(packet,"n") == 2 && !result);
+  lob_free(packet);
+  fail_unless(e3x_async_pop(q, NULL, &result));
+  fail_unless(lob_get_uint(result,"n") == 103);
+  lob_free(result);
+  fail_unless(!e3x_async_pop(q, NULL, NULL));
+  e3x_async_free(q);
+
+  // two meshes w/ every cipher set finishing on another thread, newest first
+  engine_slots(1);
+  fail_unless(pthread_create(&thread, NULL, engine, NULL) == 0);
+  net_sim_t sim = net_sim_new(1);
+  mesh_t a = mesh_async_new(), b = mesh_async_new();
+  fail_unless(net_sim_pipe(sim, a, b, NULL));
+  link_t ab = link_get(a, b->id);
+  link_t ba = link_get(b, a->id);
+  fail_unless(ab->x->sending && ba->x->receiving);
+  for(i = 0; i < 5000 && !(link_up(ab) && link_up(ba)); i++) settle(sim, a, b);
+  fail_unless(link_up(ab) && link_up(ba));
+
+  // a burst goes out in batches, each new channel id has to arrive in order or it's rejected
+  for(i = 0; i < 100; i++)
+  {
+    packet = numbered(i);
+    lob_set(packet,"type","async");
+    fail_unless(link_direct(ab, packet));
+  }
+  fail_unless(arrivals == 0);
+  for(i = 0; i < 5000 && arrivals < 100; i++) settle(sim, a, b);
+  fail_unless(arrivals == 100);
+  for(i = 0; i < 100; i++) fail_unless(arrived[i] == i);
+  fail_unless(ba->metrics.decrypt_fails == 0);
+  fail_unless(ab->metrics.packets_out >= 100);
+  fail_unless(batches > 0 && biggest > 1);
+  fail_unless(__atomic_load_n(&readies, __ATOMIC_RELAXED) > 0);
+
+  // turning it off goes back to inline crypto
+  mesh_async(a, NULL, NULL);
+  mesh_async(b, NULL, NULL);
+  fail_unless(!ab->x->sending && !ba->x->receiving);
+  arrivals = 0;
+  packet = numbered(7);
+  lob_set(packet,"type","async");
+  fail_unless(link_direct(ab, packet));
+  net_sim_run(sim, 1000);
+  fail_unless(arrivals == 1 && arrived[0] == 7);
+
+  net_sim_free(sim);
+  mesh_free(a);
+  mesh_free(b);
+
+  pthread_mutex_lock(&lock);
+  stopping = 1;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&lock);
+  pthread_join(thread, NULL);
+  engine_slots(0);
+
+  return 0;
+}
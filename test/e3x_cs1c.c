@@ -1,8 +1,34 @@
+#include <pthread.h>
 #include "e3x.h"
 #include "util.h"
 #include "unit_test.h"
 #include "util_sys.h"
 
+// counts pool locking
+int locks = 0;
+void test_lock(void *arg) { locks++; }
+void test_unlock(void *arg) { locks--; }
+
+// handshakes from more senders than the decrypt cache holds, decrypted from several threads at once
+#define SENDERS 16
+#define DECRYPTORS 4
+e3x_self_t selfShared = NULL;
+lob_t handshakes[SENDERS];
+int decrypt_fails = 0;
+
+void *decryptor(void *arg)
+{
+  int i, round, at;
+  for(round=0;round<20;round++) for(i=0;i<SENDERS;i++)
+  {
+    at = (i + round + (int)(intptr_t)arg) % SENDERS;
+    lob_t inner = e3x_self_decrypt(selfShared,handshakes[at]);
+    if(lob_get_int(inner,"a") != at) __atomic_add_fetch(&decrypt_fails,1,__ATOMIC_RELAXED);
+    lob_free(inner);
+  }
+  return NULL;
+}
+
 // fixtures
 #define A_KEY "ankhb3ue7pnplgcf4aedcdzolk7uwq5i42dyt25fj7e52vi4ujdfk";
 #define A_SEC "qgcfgiknve4bngeoyw6ekldlh4lzfqzp6w3qnicp5357chcgij5q";
@@ -15,6 +41,8 @@ int main(int argc, char **argv)
   fail_unless(e3x_init(opts) == 0);
   fail_unless(!e3x_err());
 
+  uint16_t i;
+
   // need cs1c support to continue testing
   e3x_cipher_t cs = e3x_cipher_set(0x1c,NULL);
   if(!cs) return 0;
@@ -69,6 +97,17 @@ int main(int argc, char **argv)
   fail_unless(lob_get_int(innerAB,"a") == 42);
   fail_unless(cs->remote_verify(remoteA,localB,outerAB) == 0);
 
+  // resent handshakes hit the cached secrets, which stay tied to the local that made them
+  lob_t againAB = cs->remote_encrypt(remoteB,localA,lob_set_int(lob_new(),"a",43));
+  fail_unless(againAB);
+  lob_t innerAgain = cs->local_decrypt(localB,againAB);
+  fail_unless(lob_get_int(innerAgain,"a") == 43);
+  fail_unless(cs->remote_verify(remoteA,localB,againAB) == 0);
+  fail_unless(cs->remote_verify(remoteA,localA,againAB) != 0);
+  fail_unless(cs->remote_verify(remoteA,localB,againAB) == 0);
+  lob_free(innerAgain);
+  lob_free(againAB);
+
   ephemeral_t ephemBA = cs->ephemeral_new(remoteA,outerAB);
   fail_unless(ephemBA);
   
@@ -84,10 +123,117 @@ int main(int argc, char **argv)
   ephemeral_t ephemAB = cs->ephemeral_new(remoteB,outerBA);
   fail_unless(ephemAB);
 
+  lob_t replayBA = lob_copy(couterBA);
   lob_t cinnerAB = cs->ephemeral_decrypt(ephemAB,couterBA);
   fail_unless(cinnerAB);
   fail_unless(util_cmp(lob_get(cinnerAB,"type"),"foo") == 0);
 
+  // replay window, duplicates and anything older than the window are dropped, out of order is fine
+  e3x_replay_t replay = cs->ephemeral_replay(ephemAB);
+  fail_unless(replay);
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,replayBA));
+  fail_unless(replay->dups == 1);
+  lob_t oldBA = cs->ephemeral_encrypt(ephemBA,channelBA);
+  lob_t nextBA = cs->ephemeral_encrypt(ephemBA,channelBA);
+  uint32_t seqOld = 0, seqNext = 0;
+  for(i=4;i>0;i--) seqOld = (seqOld << 8) | oldBA->body[16+i-1];
+  for(i=4;i>0;i--) seqNext = (seqNext << 8) | nextBA->body[16+i-1];
+  fail_unless(seqNext == seqOld + 1); // little-endian on the wire
+  nextBA->body[nextBA->body_len-1] ^= 1; // forged ones don't move the window
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,nextBA));
+  nextBA->body[nextBA->body_len-1] ^= 1;
+  lob_t cnext = cs->ephemeral_decrypt(ephemAB,nextBA);
+  fail_unless(cnext);
+  lob_free(cnext);
+  for(i=0;i<E3X_REPLAY_WINDOW;i++) lob_free(cs->ephemeral_encrypt(ephemBA,channelBA));
+  lob_t lastBA = cs->ephemeral_encrypt(ephemBA,channelBA);
+  cnext = cs->ephemeral_decrypt(ephemAB,lastBA);
+  fail_unless(cnext);
+  lob_free(cnext);
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,oldBA));
+  fail_unless(replay->stale == 1 && replay->dups == 1);
+  lob_free(lastBA);
+  lob_free(nextBA);
+  lob_free(oldBA);
+  lob_free(replayBA);
+
+  // saved and resumed sessions keep decrypting, and keep their replay window
+  lob_t savedAB = cs->ephemeral_save(ephemAB);
+  fail_unless(savedAB);
+  fail_unless(savedAB->body[0] == 1); // format version
+  savedAB->body[0] = 2;
+  fail_unless(!cs->ephemeral_load(savedAB));
+  savedAB->body[0] = 1;
+  ephemeral_t resumedAB = cs->ephemeral_load(savedAB);
+  fail_unless(resumedAB);
+  lob_body(savedAB,NULL,8);
+  fail_unless(!cs->ephemeral_load(savedAB));
+  lastBA = cs->ephemeral_encrypt(ephemBA,channelBA);
+  replayBA = lob_copy(lastBA);
+  cnext = cs->ephemeral_decrypt(resumedAB,lastBA);
+  fail_unless(util_cmp(lob_get(cnext,"type"),"foo") == 0);
+  fail_unless(!cs->ephemeral_decrypt(resumedAB,replayBA));
+  lob_free(cnext);
+  lob_free(lastBA);
+  lob_free(replayBA);
+  lob_free(savedAB);
+  cs->ephemeral_free(resumedAB);
+
+  // a window saved by a build w/ another E3X_REPLAY_WINDOW never accepts anything it may have seen
+  uint8_t window[E3X_REPLAY_SAVE_BYTES];
+  struct e3x_replay_struct loaded;
+  fail_unless(e3x_replay_save(replay,window) == E3X_REPLAY_SAVE_BYTES);
+  fail_unless(e3x_replay_load(&loaded,window,sizeof(window)) == sizeof(window));
+  fail_unless(loaded.top == replay->top && memcmp(loaded.bits,replay->bits,sizeof(loaded.bits)) == 0);
+  window[9] = 0; window[10] = 64;
+  fail_unless(e3x_replay_load(&loaded,window,11+8) == 11+8);
+  fail_unless(e3x_replay_check(&loaded,replay->top-1) && !e3x_replay_check(&loaded,replay->top+1));
+  fail_unless(!e3x_replay_load(&loaded,window,11+7));
+
+  // the shared local's cache is safe to hit from any thread
+  selfShared = e3x_self_new(secretsB,NULL);
+  fail_unless(selfShared);
+  for(i=0;i<SENDERS;i++)
+  {
+    remote_t sender = cs->remote_new(lob_get_base32(lob_linked(secretsB),"1c"), NULL);
+    fail_unless(sender);
+    handshakes[i] = cs->remote_encrypt(sender,localA,lob_set_int(lob_new(),"a",i));
+    fail_unless(handshakes[i]);
+    cs->remote_free(sender);
+  }
+  pthread_t decryptors[DECRYPTORS];
+  for(i=0;i<DECRYPTORS;i++) fail_unless(pthread_create(&decryptors[i],NULL,decryptor,(void*)(intptr_t)(i*5)) == 0);
+  for(i=0;i<DECRYPTORS;i++) pthread_join(decryptors[i],NULL);
+  fail_unless(decrypt_fails == 0);
+  for(i=0;i<SENDERS;i++) lob_free(handshakes[i]);
+  e3x_self_free(selfShared);
+
+  // pre-generated ephemeral keypairs
+  fail_unless(e3x_cipher_pool(4, test_lock, test_unlock, NULL) == 0);
+  fail_unless(cs->pool && cs->pool->depth == 4 && cs->pool->count == 0);
+  uint16_t pools = 0;
+  for(i=0;i<CS_MAX;i++) if(e3x_cipher_sets[i] && e3x_cipher_sets[i]->pool) pools++;
+  fail_unless(e3x_cipher_pool_fill(4*CS_MAX) == 4*pools);
+  fail_unless(e3x_cipher_pool_fill(4*CS_MAX) == 0);
+  fail_unless(locks == 0);
+  remote_t remotePool = cs->remote_new(lob_get_base32(lob_linked(secretsB),"1c"), NULL);
+  fail_unless(remotePool);
+  fail_unless(cs->pool->count == 3 && cs->pool->hits == 1);
+  lob_t outerPool = cs->remote_encrypt(remotePool,localA,lob_set_int(lob_new(),"a",44));
+  lob_t innerPool = cs->local_decrypt(localB,outerPool);
+  fail_unless(lob_get_int(innerPool,"a") == 44);
+  lob_t stats = e3x_cipher_pool_stats();
+  LOG("pool %s",lob_json(stats));
+  lob_t stats1c = lob_get_json(stats,"1c");
+  fail_unless(lob_get_int(stats1c,"filled") == 4 && lob_get_int(stats1c,"count") == 3);
+  fail_unless(e3x_cipher_pool(0, NULL, NULL, NULL) == 0);
+  fail_unless(!cs->pool);
+  lob_free(stats1c);
+  lob_free(stats);
+  lob_free(innerPool);
+  lob_free(outerPool);
+  cs->remote_free(remotePool);
+
   return 0;
 }
 
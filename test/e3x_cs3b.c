@@ -0,0 +1,130 @@
+#include "e3x.h"
+#include "util.h"
+#include "unit_test.h"
+#include "util_sys.h"
+
+int main(int argc, char **argv)
+{
+  lob_t opts = lob_new();
+  fail_unless(e3x_init(opts) == 0);
+  fail_unless(!e3x_err());
+
+  e3x_cipher_t cs = e3x_cipher_set(0,"3b");
+  fail_unless(cs);
+  fail_unless(cs->id == CS_3b);
+  fail_unless(cs->csid == 0x3b);
+
+  // its own csprng, and never the default over a set that's meant to be
+  uint8_t rand1[32] = {0}, rand2[32] = {0};
+  fail_unless(cs->rand && cs->rand(rand1,32) == rand1 && cs->rand(rand2,32));
+  fail_unless(memcmp(rand1,rand2,32) != 0);
+  fail_unless(e3x_cipher_default != cs);
+
+  lob_t secrets = e3x_generate();
+  fail_unless(secrets);
+  fail_unless(lob_get(secrets,"3b"));
+  lob_t keys = lob_linked(secrets);
+  fail_unless(keys);
+  fail_unless(lob_get(keys,"3b"));
+  LOG("generated key %s secret %s",lob_get(keys,"3b"),lob_get(secrets,"3b"));
+
+  local_t localA = cs->local_new(keys,secrets);
+  fail_unless(localA);
+  remote_t remoteA = cs->remote_new(lob_get_base32(keys,"3b"), NULL);
+  fail_unless(remoteA);
+
+  lob_t secretsB = e3x_generate();
+  fail_unless(lob_linked(secretsB));
+  local_t localB = cs->local_new(lob_linked(secretsB),secretsB);
+  fail_unless(localB);
+  remote_t remoteB = cs->remote_new(lob_get_base32(lob_linked(secretsB),"3b"), NULL);
+  fail_unless(remoteB);
+
+  // handshake
+  lob_t messageAB = lob_new();
+  lob_set_int(messageAB,"a",42);
+  lob_t outerAB = cs->remote_encrypt(remoteB,localA,messageAB);
+  fail_unless(outerAB);
+  LOG("len %lu",lob_len(outerAB));
+  fail_unless(lob_len(outerAB) == 89);
+
+  lob_t innerAB = cs->local_decrypt(localB,outerAB);
+  fail_unless(innerAB);
+  fail_unless(lob_get_int(innerAB,"a") == 42);
+  fail_unless(cs->remote_verify(remoteA,localB,outerAB) == 0);
+  fail_unless(cs->remote_verify(remoteA,localA,outerAB) != 0);
+
+  // any flipped bit fails the tag or the auth
+  outerAB->body[50] ^= 1;
+  fail_unless(!cs->local_decrypt(localB,outerAB));
+  fail_unless(cs->remote_verify(remoteA,localB,outerAB) != 0);
+  outerAB->body[50] ^= 1;
+
+  ephemeral_t ephemBA = cs->ephemeral_new(remoteA,outerAB);
+  fail_unless(ephemBA);
+
+  lob_t channelBA = lob_new();
+  lob_set(channelBA,"type","foo");
+  lob_t couterBA = cs->ephemeral_encrypt(ephemBA,channelBA);
+  fail_unless(couterBA);
+  LOG("len %lu",lob_len(couterBA));
+  fail_unless(lob_len(couterBA) == 58);
+
+  lob_t outerBA = cs->remote_encrypt(remoteA,localB,messageAB);
+  fail_unless(outerBA);
+  ephemeral_t ephemAB = cs->ephemeral_new(remoteB,outerBA);
+  fail_unless(ephemAB);
+
+  // tampering is caught before decrypting in place
+  couterBA->body[30] ^= 1;
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,couterBA));
+  couterBA->body[30] ^= 1;
+  couterBA->body[0] ^= 1; // token is the aad
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,couterBA));
+  couterBA->body[0] ^= 1;
+
+  lob_t replayBA = lob_copy(couterBA);
+  lob_t cinnerAB = cs->ephemeral_decrypt(ephemAB,couterBA);
+  fail_unless(cinnerAB);
+  fail_unless(util_cmp(lob_get(cinnerAB,"type"),"foo") == 0);
+
+  // a replay is dropped before the tag is checked
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,replayBA));
+  fail_unless(cs->ephemeral_replay(ephemAB)->dups == 1);
+  lob_free(replayBA);
+
+  // and the other direction, w/ a fresh nonce each time
+  lob_t c1 = cs->ephemeral_encrypt(ephemAB,channelBA);
+  lob_t c2 = cs->ephemeral_encrypt(ephemAB,channelBA);
+  fail_unless(c1 && c2);
+  fail_unless(memcmp(c1->body+16,c2->body+16,8) != 0);
+  uint64_t seq1 = 0, seq2 = 0;
+  uint8_t i;
+  for(i=0;i<8;i++) seq1 = (seq1 << 8) | c1->body[16+i];
+  for(i=0;i<8;i++) seq2 = (seq2 << 8) | c2->body[16+i];
+  fail_unless(seq2 == seq1 + 1); // big-endian on the wire
+  lob_t cinnerBA = cs->ephemeral_decrypt(ephemBA,c2);
+  fail_unless(util_cmp(lob_get(cinnerBA,"type"),"foo") == 0);
+  fail_unless(!cs->ephemeral_decrypt(ephemAB,c1)); // wrong direction key
+
+  lob_free(c1);
+  lob_free(c2);
+  lob_free(cinnerBA);
+  lob_free(cinnerAB);
+  lob_free(couterBA);
+  lob_free(channelBA);
+  lob_free(outerBA);
+  lob_free(innerAB);
+  lob_free(outerAB);
+  lob_free(messageAB);
+  cs->ephemeral_free(ephemAB);
+  cs->ephemeral_free(ephemBA);
+  cs->remote_free(remoteA);
+  cs->remote_free(remoteB);
+  cs->local_free(localA);
+  cs->local_free(localB);
+  lob_free(secrets);
+  lob_free(secretsB);
+
+  return 0;
+}
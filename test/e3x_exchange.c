@@ -89,9 +89,14 @@ int main(int argc, char **argv)
   lob_t coutAB = e3x_exchange_send(xAB,chanAB);
   fail_unless(coutAB);
   fail_unless(coutAB->body_len >= 33);
+  lob_t replayAB = lob_copy(coutAB);
   lob_t cinAB = e3x_exchange_receive(xBA,coutAB);
   fail_unless(cinAB);
   fail_unless(lob_get_int(cinAB,"c") == lob_get_int(chanAB,"c"));
+  fail_unless(e3x_exchange_replays(xBA) == 0);
+  fail_unless(!e3x_exchange_receive(xBA,replayAB));
+  fail_unless(e3x_exchange_replays(xBA) == 1);
+  lob_free(replayAB);
   lob_free(cinAB);
   lob_free(coutAB);
 
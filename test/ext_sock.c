@@ -0,0 +1,101 @@
+#include "ext.h"
+#include "net_loopback.h"
+#include "unit_test.h"
+
+sockc_t incoming = NULL;
+lob_t sock_on_open(link_t link, lob_t open)
+{
+  sockc_t sc = ext_sock(link, open);
+  if(!sc) return open;
+  incoming = sockc_accept(sc);
+  return NULL;
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t out[SOCKC_BUFSIZE], in[SOCKC_BUFSIZE];
+  uint32_t i, len;
+  int got;
+
+  mesh_t meshA = mesh_new();
+  fail_unless(meshA);
+  lob_t secretsA = mesh_generate(meshA);
+  fail_unless(secretsA);
+  lob_free(secretsA);
+
+  mesh_t meshB = mesh_new();
+  fail_unless(meshB);
+  lob_t secretsB = mesh_generate(meshB);
+  fail_unless(secretsB);
+  lob_free(secretsB);
+  mesh_on_open(meshB, "sock", sock_on_open);
+
+  net_loopback_t pair = net_loopback_new(meshA,meshB);
+  fail_unless(pair);
+  link_t linkAB = link_get(meshA, meshB->id);
+  fail_unless(link_resync(linkAB));
+  fail_unless(link_up(linkAB));
+
+  lob_t opts = lob_new();
+  lob_set_int(opts,"port",80);
+  sockc_t sc = sockc_connect(linkAB, opts);
+  lob_free(opts);
+  fail_unless(sc);
+  fail_unless(sc->state == SOCKC_OPEN);
+  fail_unless(incoming);
+  fail_unless(incoming->state == SOCKC_OPEN);
+  fail_unless(lob_get_int(incoming->opts,"port") == 80);
+  fail_unless(sockc_read(incoming, in, sizeof(in)) == 0); // nonblocking
+
+  // full packets go out immediately, the partial tail waits for a flush
+  for(i=0;i<sizeof(out);i++) out[i] = (uint8_t)i;
+  fail_unless(sockc_write(sc, out, 3000) == 3000);
+  fail_unless(sockc_available(incoming) == 2*SOCKC_MTU);
+  fail_unless(sockc_flush(sc));
+  fail_unless(sockc_available(incoming) == 3000);
+  got = sockc_read(incoming, in, sizeof(in));
+  fail_unless(got == 3000);
+  fail_unless(memcmp(in, out, 3000) == 0);
+
+  // wrap the rings and fill the reader, the rest stays queued on the channel
+  fail_unless(sockc_write(sc, out, sizeof(out)) == sizeof(out));
+  fail_unless(sockc_write(sc, out, 100) == 100);
+  fail_unless(sockc_flush(sc));
+  fail_unless(sockc_available(incoming) == SOCKC_BUFSIZE);
+  fail_unless(sockc_read(incoming, in, 100) == 100);
+  fail_unless(memcmp(in, out, 100) == 0);
+  uint8_t *zin = sockc_zpeek(incoming, &len);
+  fail_unless(zin && len > 0);
+  fail_unless(memcmp(zin, out+100, len) == 0);
+  sockc_zread(incoming, len);
+  got = sockc_read(incoming, in, sizeof(in));
+  fail_unless(got == SOCKC_BUFSIZE - (int)len);
+  fail_unless(memcmp(in, out+100+len, got - 100) == 0);
+  fail_unless(memcmp(in+got-100, out, 100) == 0);
+
+  // zero-copy writing
+  uint8_t *zout = sockc_zwrite(sc, &len);
+  fail_unless(zout && len > 0);
+  memcpy(zout, "hello", 5);
+  fail_unless(sockc_zwritten(sc, 5) == 5);
+  fail_unless(sockc_swrite(sc, '!') == 1);
+
+  // closing sends the tail w/ the end
+  fail_unless(sockc_close(sc) == NULL);
+  fail_unless(sockc_read(incoming, in, 5) == 5);
+  fail_unless(memcmp(in, "hello", 5) == 0);
+  fail_unless(sockc_sread(incoming) == '!');
+  fail_unless(incoming->state == SOCKC_CLOSED);
+  fail_unless(sockc_read(incoming, in, 1) == -1);
+  fail_unless(sockc_close(incoming) == NULL);
+
+  fail_unless(mesh_process(meshA, 1));
+  fail_unless(mesh_process(meshB, 1));
+  fail_unless(linkAB->chans == NULL);
+
+  mesh_free(meshA);
+  mesh_free(meshB);
+  net_loopback_free(pair);
+
+  return 0;
+}
@@ -6,6 +6,7 @@ int main(int argc, char **argv)
 {
   uint8_t key[32], nonce[8], test[9];
   char hex[65];
+  uint32_t i;
 
   memset(key,0,32);
   memset(nonce,0,8);
@@ -25,6 +26,44 @@ int main(int argc, char **argv)
   fail_unless(chacha20(key,nonce,test,9));
   fail_unless(util_cmp(util_hex(test,9,hex),"ffffffffffffffffff") == 0);
 
+  // RFC 8439 2.4.2, 96 bit nonce starting at block 1
+  uint8_t nonce12[12], text[114];
+  for(i=0;i<32;i++) key[i] = (uint8_t)i;
+  memset(nonce12,0,12);
+  nonce12[7] = 0x4a;
+  memcpy(text,"Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.",114);
+  fail_unless(chacha20_ietf(key,nonce12,1,text,114));
+  fail_unless(util_cmp(util_hex(text,16,hex),"6e2e359a2568f98041ba0728dd0d6981") == 0);
+  fail_unless(util_cmp(util_hex(text+112,2,hex),"874d") == 0);
+
+  // every wide core matches the scalar reference, across group edges and the 32-bit counter wrap
+  uint8_t ref[1100], wide[1100], cores[] = {CHACHA_SSE2, CHACHA_AVX2, CHACHA_NEON};
+  uint32_t lens[] = {1, 63, 64, 65, 255, 256, 257, 511, 512, 513, 1000, 1100};
+  uint32_t ctrs[] = {0, 1, 0xffffffe0};
+  uint32_t c, l, k;
+  for(i=0;i<sizeof(ref);i++) ref[i] = (uint8_t)(i*7);
+  for(c=0;c<sizeof(cores);c++)
+  {
+    if(chacha20_core(cores[c]) != cores[c]) continue;
+    LOG("cross-checking %s",chacha20_core_name(cores[c]));
+    for(l=0;l<sizeof(lens)/4;l++) for(k=0;k<sizeof(ctrs)/4;k++)
+    {
+      for(i=0;i<lens[l];i++) ref[i] = wide[i] = (uint8_t)(i*7);
+      fail_unless(chacha20_core(CHACHA_REF) == CHACHA_REF);
+      chacha20_ietf(key,nonce12,ctrs[k],ref,lens[l]);
+      chacha20_core(cores[c]);
+      chacha20_ietf(key,nonce12,ctrs[k],wide,lens[l]);
+      fail_unless(memcmp(ref,wide,lens[l]) == 0);
+    }
+    memcpy(wide,ref,sizeof(ref));
+    fail_unless(chacha20_core(CHACHA_REF) == CHACHA_REF);
+    chacha20(key,nonce,ref,sizeof(ref));
+    chacha20_core(cores[c]);
+    chacha20(key,nonce,wide,sizeof(wide));
+    fail_unless(memcmp(ref,wide,sizeof(ref)) == 0);
+  }
+  fail_unless(chacha20_core(CHACHA_AUTO) != CHACHA_AUTO);
+
 
   return 0;
 }
@@ -150,7 +150,179 @@ int main(int argc, char **argv)
   fail_unless(util_chunks_size(f1) == 0);
   fail_unless(util_chunks_next(f1));
   fail_unless(util_chunks_size(f1) == -1);
-  
+  util_chunks_free(f1);
+
+  LOG("testing v2 windowed chunking");
+  lob_t pv2 = lob_new();
+  lob_body(pv2,0,5000);
+  for(max=0;max<100;max++) pv2->body[max*50] = max;
+  c1 = util_chunks_v2(util_chunks_new(0), 1000, 2);
+  c2 = util_chunks_v2(util_chunks_new(0), 1000, 2);
+  fail_unless(c1 && c2);
+  fail_unless(util_chunks_send(c1, lob_copy(pv2)));
+  fail_unless(util_chunks_send(c1, lob_copy(packet)));
+  fail_unless(util_chunks_send(c2, lob_copy(packet)));
+
+  // window fills w/o acks
+  uint32_t total = 0;
+  while((len1 = util_chunks_len(c1)))
+  {
+    fail_unless(util_chunks_written(c1,len1));
+    total += len1;
+  }
+  fail_unless(total == 2*(2+1000));
+  fail_unless(c1->unacked == 2);
+  util_chunks_free(c1);
+
+  // exchange until both are done
+  c1 = util_chunks_v2(util_chunks_new(0), 1000, 2);
+  fail_unless(util_chunks_send(c1, lob_copy(pv2)));
+  fail_unless(util_chunks_send(c1, lob_copy(packet)));
+  for(max=0;max<50;max++)
+  {
+    len1 = util_chunks_len(c1);
+    buf = util_chunks_write(c1);
+    if(len1) fail_unless(util_chunks_read(c2,buf,len1));
+    fail_unless(util_chunks_written(c1,len1));
+    len2 = util_chunks_len(c2);
+    buf = util_chunks_write(c2);
+    if(len2) fail_unless(util_chunks_read(c1,buf,len2));
+    fail_unless(util_chunks_written(c2,len2));
+    if(!len1 && !len2) break;
+  }
+  LOG("v2 done in %d",max);
+  fail_unless(max < 50);
+  fail_unless(!c1->unacked && !c2->unacked);
+  p1 = util_chunks_receive(c2);
+  fail_unless(p1);
+  fail_unless(lob_cmp(p1,pv2) == 0);
+  lob_free(p1);
+  p1 = util_chunks_receive(c2);
+  fail_unless(p1);
+  fail_unless(p1->body_len == 100);
+  lob_free(p1);
+  fail_unless(!util_chunks_receive(c2));
+  p2 = util_chunks_receive(c1);
+  fail_unless(p2);
+  fail_unless(p2->body_len == 100);
+  lob_free(p2);
+  util_chunks_free(c1);
+  util_chunks_free(c2);
+
+  LOG("testing v2 w/ a packet over the max");
+  lob_t huge = lob_new();
+  lob_body(huge,0,UTIL_CHUNKS_PACKET_MAX);
+  c1 = util_chunks_v2(util_chunks_new(0), 0, 2);
+  c2 = util_chunks_v2(util_chunks_new(0), 0, 2);
+  fail_unless(util_chunks_send(c1, huge));
+  fail_unless(util_chunks_send(c1, lob_copy(packet)));
+  for(max=0;max<50;max++)
+  {
+    len1 = util_chunks_len(c1);
+    if(len1) fail_unless(util_chunks_read(c2,util_chunks_write(c1),len1));
+    fail_unless(util_chunks_written(c1,len1));
+    len2 = util_chunks_len(c2);
+    if(len2) fail_unless(util_chunks_read(c1,util_chunks_write(c2),len2));
+    fail_unless(util_chunks_written(c2,len2));
+    if(!len1 && !len2) break;
+  }
+  fail_unless(max < 50);
+  fail_unless(c2->readcap <= UTIL_CHUNKS_PACKET_MAX + UTIL_CHUNKS_V2_MAX);
+  p1 = util_chunks_receive(c2);
+  fail_unless(p1);
+  fail_unless(p1->body_len == 100);
+  lob_free(p1);
+  fail_unless(!util_chunks_receive(c2));
+  util_chunks_free(c1);
+  util_chunks_free(c2);
+
+  LOG("testing framed chunks over a noisy line");
+  uint8_t noisy[1100];
+  uint32_t idle = 0, sent = 0, back = 0, loop;
+  c1 = util_chunks_framed(util_chunks_v2(util_chunks_new(0), 1000, 2));
+  c2 = util_chunks_framed(util_chunks_v2(util_chunks_new(0), 1000, 2));
+  fail_unless(c1 && c2 && c1->framed);
+  fail_unless(util_chunks_send(c1, lob_copy(pv2)));
+  fail_unless(util_chunks_send(c1, lob_copy(packet)));
+  fail_unless(util_chunks_read(c2,(uint8_t*)"junk",4)); // line noise before anything
+  for(loop=0;loop<500;loop++)
+  {
+    len1 = util_chunks_len(c1);
+    if(len1)
+    {
+      memcpy(noisy,util_chunks_write(c1),len1);
+      sent++;
+      if(sent == 5 || sent == 17 || sent == 30) noisy[len1/2] ^= 0x10; // flip a bit in a few writes
+      fail_unless(util_chunks_read(c2,noisy,len1));
+      fail_unless(util_chunks_written(c1,len1));
+    }
+    len2 = util_chunks_len(c2);
+    if(len2)
+    {
+      memcpy(noisy,util_chunks_write(c2),len2);
+      if(++back == 10) noisy[0] ^= 0x01; // and the other way
+      fail_unless(util_chunks_read(c1,noisy,len2));
+      fail_unless(util_chunks_written(c2,len2));
+    }
+    if(len1 || len2) continue;
+    if(!c1->writing) break;
+    // stalled on a lost ack
+    idle++;
+    fail_unless(util_chunks_resync(c1));
+  }
+  LOG("framed done in %d w/ %d/%d errors %d idle",loop,c2->errors,c1->errors,idle);
+  fail_unless(loop < 500);
+  fail_unless(c2->errors > 0 && c1->errors > 0);
+  p1 = util_chunks_receive(c2);
+  fail_unless(p1);
+  fail_unless(lob_cmp(p1,pv2) == 0);
+  lob_free(p1);
+  p1 = util_chunks_receive(c2);
+  fail_unless(p1);
+  fail_unless(p1->body_len == 100);
+  lob_free(p1);
+  fail_unless(!util_chunks_receive(c2));
+  util_chunks_free(c1);
+  util_chunks_free(c2);
+
+  LOG("testing framed chunks w/ noise more often than a whole packet");
+  c1 = util_chunks_framed(util_chunks_v2(util_chunks_new(0), 100, 4));
+  c2 = util_chunks_framed(util_chunks_v2(util_chunks_new(0), 100, 4));
+  fail_unless(util_chunks_send(c1, lob_copy(pv2)));
+  sent = idle = 0;
+  for(loop=0;loop<2000;loop++)
+  {
+    len1 = util_chunks_len(c1);
+    if(len1)
+    {
+      memcpy(noisy,util_chunks_write(c1),len1);
+      // the packet takes ~150 writes, so it only gets through by resuming
+      if(++sent % 60 == 0) noisy[len1/2] ^= 0x10;
+      fail_unless(util_chunks_read(c2,noisy,len1));
+      fail_unless(util_chunks_written(c1,len1));
+    }
+    len2 = util_chunks_len(c2);
+    if(len2)
+    {
+      fail_unless(util_chunks_read(c1,util_chunks_write(c2),len2));
+      fail_unless(util_chunks_written(c2,len2));
+    }
+    if(len1 || len2) continue;
+    if(!c1->writing) break;
+    idle++;
+    fail_unless(util_chunks_resync(c1));
+  }
+  LOG("resumed done in %d w/ %d errors %d idle",loop,c2->errors,idle);
+  fail_unless(loop < 2000);
+  fail_unless(c2->errors > 1);
+  p1 = util_chunks_receive(c2);
+  fail_unless(p1);
+  fail_unless(lob_cmp(p1,pv2) == 0);
+  lob_free(p1);
+  fail_unless(!util_chunks_receive(c2));
+  util_chunks_free(c1);
+  util_chunks_free(c2);
+  lob_free(pv2);
 
   return 0;
 }
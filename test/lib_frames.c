@@ -83,10 +83,38 @@ int main(int argc, char **argv)
   lob_t msg2 = util_frames_receive(fb);
   fail_unless(msg2);
   fail_unless(msg2->body_len == 1000);
+  lob_free(msg2);
 
   fail_unless(!util_frames_free(fa));
   fail_unless(!util_frames_free(fb));
   
+  // datagram mode, header and packet in one
+  fa = util_frames_new(42,2048);
+  fb = util_frames_new(42,2048);
+  lob_body(msg, NULL, 1500);
+  fail_unless(util_frames_send(fa,lob_copy(msg)));
+  fail_unless(util_frames_send(fa,lob_copy(msg)));
+  uint8_t dgram[UTIL_FRAMES_DGRAM_HDR + 2048];
+  while((frame = util_frames_dgram_outbox(fa, dgram, &len)))
+  {
+    fail_unless(len == 1502);
+    memcpy(dgram+UTIL_FRAMES_DGRAM_HDR, frame, len);
+    fail_unless(util_frames_dgram_inbox(fb, dgram, UTIL_FRAMES_DGRAM_HDR+len));
+    util_frames_sent(fa);
+  }
+  fail_unless(!util_frames_outlen(fa));
+  fail_unless(util_frames_inlen(fb) == 2*1502);
+  msg2 = util_frames_receive(fb);
+  fail_unless(lob_cmp(msg,msg2) == 0);
+  lob_free(msg2);
+  msg2 = util_frames_receive(fb);
+  fail_unless(msg2);
+  lob_free(msg2);
+  fail_unless(!util_frames_dgram_inbox(fb, dgram, UTIL_FRAMES_DGRAM_HDR+100)); // truncated
+  fail_unless(!util_frames_ok(fb));
+  fail_unless(!util_frames_free(fa));
+  fail_unless(!util_frames_free(fb));
+
   util_frames_t fuzz = util_frames_new(42,1024);
   uint32_t loops = 10000;
   uint8_t fframe[64];
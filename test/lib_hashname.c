@@ -43,6 +43,29 @@ int main(int argc, char **argv)
   fail_unless(hashname_isshort(hn));
   fail_unless(util_cmp(hashname_short(hn),"uvabrvfq") == 0);
 
+  // reentrant versions only touch the caller's buffers
+  struct hashname_struct a, b;
+  char str[53], sstr[9];
+  fail_unless(hashname_vkeys_r(keys, &a) == &a);
+  fail_unless(hashname_vchar_r("jvdoio6kjvf3yqnxfvck43twaibbg4pmb7y3mqnvxafb26rqllwa", &b) == &b);
+  fail_unless(hashname_cmp(&a, &b) == 0);
+  hn = hashname_vchar("uvabrvfqacyvgcu8kbrrmk9apjbvgvn2wjechqr3vf9c1zm3hv7a");
+  fail_unless(hashname_cmp(&a, &b) == 0);
+  fail_unless(hashname_char_r(&a, str) == str);
+  fail_unless(util_cmp(str,"jvdoio6kjvf3yqnxfvck43twaibbg4pmb7y3mqnvxafb26rqllwa") == 0);
+  fail_unless(hashname_vkey_r(im, 0, &b) == &b);
+  fail_unless(hashname_cmp(&a, &b) == 0);
+  fail_unless(hashname_vbin_r(a.bin, &b) == &b);
+  fail_unless(hashname_cmp(&a, &b) == 0);
+  fail_unless(hashname_short_r(&a, sstr) == sstr);
+  fail_unless(strlen(sstr) == 8 && strncmp(sstr, str, 8) == 0);
+  fail_unless(hashname_schar_r(sstr, &b) == &b);
+  fail_unless(hashname_isshort(&b) && hashname_scmp(&a, &b) == 0);
+  fail_unless(hashname_sbin_r(a.bin, &a) == &a);
+  fail_unless(hashname_cmp(&a, &b) == 0);
+  fail_unless(!hashname_vchar_r(NULL, &a));
+  fail_unless(!hashname_char_r(&a, NULL));
+
   return 0;
 }
 
@@ -151,6 +151,16 @@ int main(int argc, char **argv)
     LOG_DEBUG("deciphered JWT: %s",lob_json(jwt));
     fail_unless(memcmp(ckey,"just testing",12) == 0);
     fail_unless(jwt_verify(jwt,x));
+
+    // batched, w/ a tampered one mixed in
+    lob_t bad = jwt_decode(jwt_encode(es256),0);
+    lob_set_int(jwt_claims(bad),"sub",43);
+    lob_t tokens[3] = {es256, bad, jwt};
+    e3x_exchange_t xs[3] = {x, x, x};
+    uint8_t valid[3];
+    fail_unless(jwt_verify_batch(tokens, xs, valid, 3) == 2);
+    fail_unless(valid[0] && !valid[1] && valid[2]);
+    fail_unless(jwt_verify_batch(tokens, NULL, valid, 3) == 0);
   }
 
   // brunty
@@ -0,0 +1,54 @@
+#include "poly1305.h"
+#include "util.h"
+#include "unit_test.h"
+
+// RFC 8439 2.8.2
+#define SUNSCREEN "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it."
+
+int main(int argc, char **argv)
+{
+  uint8_t key[32], mac[16], nonce[12], aad[12], text[114], copy[114];
+  poly1305_s st;
+  char hex[65];
+  uint32_t i;
+
+  // RFC 8439 2.5.2
+  util_unhex("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b",64,key);
+  fail_unless(poly1305(key,(uint8_t*)"Cryptographic Forum Research Group",34,mac));
+  fail_unless(util_cmp(util_hex(mac,16,hex),"a8061dc1305136c6c22b8baf0c0127a9") == 0);
+
+  // same again, fed in uneven pieces
+  poly1305_init(&st,key);
+  for(i=0;i<34;i+=5) poly1305_update(&st,(uint8_t*)"Cryptographic Forum Research Group"+i,(34-i) < 5 ? 34-i : 5);
+  poly1305_finish(&st,mac);
+  fail_unless(util_cmp(util_hex(mac,16,hex),"a8061dc1305136c6c22b8baf0c0127a9") == 0);
+
+  // AEAD
+  for(i=0;i<32;i++) key[i] = 0x80+i;
+  util_unhex("070000004041424344454647",24,nonce);
+  util_unhex("50515253c0c1c2c3c4c5c6c7",24,aad);
+  memcpy(text,SUNSCREEN,114);
+  fail_unless(chacha20poly1305_seal(key,nonce,aad,12,text,114,mac));
+  fail_unless(util_cmp(util_hex(text,16,hex),"d31a8d34648e60db7b86afbc53ef7ec2") == 0);
+  fail_unless(util_cmp(util_hex(text+96,16,hex),"3ff4def08e4b7a9de576d26586cec64b") == 0);
+  fail_unless(util_cmp(util_hex(mac,16,hex),"1ae10b594f09e26a7e902ecbd0600691") == 0);
+
+  // any change fails w/o touching the ciphertext
+  memcpy(copy,text,114);
+  aad[0] ^= 1;
+  fail_unless(!chacha20poly1305_open(key,nonce,aad,12,text,114,mac));
+  fail_unless(memcmp(copy,text,114) == 0);
+  aad[0] ^= 1;
+  text[113] ^= 1;
+  fail_unless(!chacha20poly1305_open(key,nonce,aad,12,text,114,mac));
+  text[113] ^= 1;
+  fail_unless(chacha20poly1305_open(key,nonce,aad,12,text,114,mac));
+  fail_unless(memcmp(text,SUNSCREEN,114) == 0);
+
+  // empty bodies still authenticate
+  fail_unless(chacha20poly1305_seal(key,nonce,NULL,0,NULL,0,mac));
+  fail_unless(chacha20poly1305_open(key,nonce,NULL,0,NULL,0,mac));
+  fail_unless(!chacha20poly1305_open(key,nonce,aad,12,NULL,0,mac));
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <pthread.h>
+#include "net_loopback.h"
+#include "unit_test.h"
+
+static uint32_t hooked = 0;
+
+void hook(uint8_t stage, uint64_t ns, void *arg)
+{
+  if(stage == UTIL_TRACE_LINK) hooked++;
+}
+
+// records from several threads at once
+static void *recorder(void *arg)
+{
+  uint64_t i, base = (uint64_t)(uintptr_t)arg;
+  for(i = 1; i <= 10000; i++) util_trace(UTIL_TRACE_TRANSPORT, base + i);
+  return NULL;
+}
+
+int main(int argc, char **argv)
+{
+  uint64_t i;
+
+  fail_unless(util_trace_name(UTIL_TRACE_MESH));
+  fail_unless(!util_trace_name(UTIL_TRACE_STAGES));
+  fail_unless(util_trace_count(UTIL_TRACE_MESH) == 0);
+  fail_unless(util_trace_percentile(UTIL_TRACE_MESH, 50) == 0);
+
+  // sampling picks 1 of every n per stage
+  fail_unless(!util_trace_sample(UTIL_TRACE_MESH));
+  util_trace_start(4);
+  fail_unless(!util_trace_sample(UTIL_TRACE_MESH));
+  fail_unless(!util_trace_sample(UTIL_TRACE_MESH));
+  fail_unless(!util_trace_sample(UTIL_TRACE_MESH));
+  fail_unless(util_trace_sample(UTIL_TRACE_MESH));
+  fail_unless(!util_trace_sample(UTIL_TRACE_MESH));
+  util_trace_start(0);
+  fail_unless(!util_trace_sample(UTIL_TRACE_MESH));
+
+  // small values are exact, larger ones within a bucket (~6%)
+  for(i = 1; i <= 10; i++) util_trace(UTIL_TRACE_PARSE, i);
+  fail_unless(util_trace_percentile(UTIL_TRACE_PARSE, 50) == 5);
+  fail_unless(util_trace_percentile(UTIL_TRACE_PARSE, 100) == 10);
+  for(i = 1; i <= 100000; i++) util_trace(UTIL_TRACE_MESH, i * 100);
+  fail_unless(util_trace_count(UTIL_TRACE_MESH) == 100000);
+  uint64_t p50 = util_trace_percentile(UTIL_TRACE_MESH, 50), p99 = util_trace_percentile(UTIL_TRACE_MESH, 99);
+  LOG("p50 %llu p99 %llu",(unsigned long long)p50,(unsigned long long)p99);
+  fail_unless(p50 >= 5000000 && p50 <= 5000000 * 1.07);
+  fail_unless(p99 >= 9900000 && p99 <= 9900000 * 1.07);
+  fail_unless(util_trace_percentile(UTIL_TRACE_MESH, 100) == 10000000);
+  util_trace(UTIL_TRACE_CHAN, UINT64_MAX);
+  fail_unless(util_trace_percentile(UTIL_TRACE_CHAN, 50) == UINT64_MAX);
+
+  lob_t json = util_trace_json();
+  LOG("%s",lob_json(json));
+  lob_t mesh = lob_get_json(json,"mesh");
+  fail_unless(lob_get_uint(mesh,"count") == 100000);
+  fail_unless(lob_get_uint(mesh,"max") == 10000000);
+  fail_unless(!lob_get(json,"link"));
+  lob_free(mesh);
+  lob_free(json);
+
+  util_trace_hook(hook, NULL);
+  util_trace(UTIL_TRACE_LINK, 42);
+  util_trace_hook(NULL, NULL);
+  util_trace(UTIL_TRACE_LINK, 42);
+  fail_unless(hooked == 1);
+
+  util_trace_reset();
+  fail_unless(util_trace_count(UTIL_TRACE_MESH) == 0);
+  json = util_trace_json();
+  fail_unless(!lob_get(json,"mesh"));
+  lob_free(json);
+
+  // nothing lost when threads record at the same time
+  pthread_t threads[4];
+  for(i = 0; i < 4; i++) fail_unless(pthread_create(&threads[i], NULL, recorder, (void*)(uintptr_t)(i * 1000)) == 0);
+  for(i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+  fail_unless(util_trace_count(UTIL_TRACE_TRANSPORT) == 40000);
+  fail_unless(util_trace_percentile(UTIL_TRACE_TRANSPORT, 100) == 13000);
+  util_trace_reset();
+
+#ifdef TELEHASH_TRACE
+  // the probes see a real handshake
+  util_trace_start(1);
+  mesh_t meshA = mesh_new();
+  mesh_t meshB = mesh_new();
+  lob_free(mesh_generate(meshA));
+  lob_free(mesh_generate(meshB));
+  net_loopback_t pair = net_loopback_new(meshA,meshB);
+  fail_unless(pair);
+  link_t linkAB = link_get(meshA, meshB->id);
+  link_t linkBA = link_get(meshB, meshA->id);
+  fail_unless(link_resync(linkAB));
+  fail_unless(link_up(linkAB) && link_up(linkBA));
+  fail_unless(util_trace_count(UTIL_TRACE_MESH) > 0);
+  fail_unless(util_trace_count(UTIL_TRACE_HANDSHAKE) > 0);
+  fail_unless(util_trace_count(UTIL_TRACE_PARSE) > 0);
+  json = util_trace_json();
+  LOG("%s",lob_json(json));
+  lob_free(json);
+  util_trace_start(0);
+  net_loopback_free(pair);
+  mesh_free(meshA);
+  mesh_free(meshB);
+#endif
+
+  return 0;
+}
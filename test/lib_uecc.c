@@ -0,0 +1,69 @@
+#include "telehash.h"
+#include "unit_test.h"
+
+// k*G for a few scalars, hex of the private key and the expected public key
+static int pubcheck(char *priv, char *pub)
+{
+  uint8_t secret[32], key[64], check[64];
+  util_unhex(priv, 64, secret);
+  util_unhex(pub, 128, check);
+  if(!uECC_compute_public_key(secret, key, uECC_secp256r1())) return 0;
+  return memcmp(key, check, 64) == 0;
+}
+
+int main(int argc, char **argv)
+{
+  uECC_Curve curve = uECC_secp256r1();
+  uint8_t secretA[32], keyA[64], secretB[32], keyB[64];
+  uint8_t sharedA[32], sharedB[32], hash[32], sig[64];
+  int i;
+
+  // uses the comb table on hosted builds
+  fail_unless(uECC_precompute(curve) == uECC_FIXED_BASE_COMB);
+
+  // G, -G, and the rfc6979 p-256 key
+  fail_unless(pubcheck("0000000000000000000000000000000000000000000000000000000000000001","6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c2964fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5"));
+  fail_unless(pubcheck("ffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632550","6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296b01cbd1c01e58065711814b583f061e9d431cca994cea1313449bf97c840ae0a"));
+  fail_unless(pubcheck("c9afa9d845ba75166b5c215767b1d6934e50c3db36e89b127b8a622b120f6721","60fed4ba255a9d31c961eb74c6356d68c049b8923b61fa6ce669622e60f29fb67903fe1008b8bc99a41ae9e95628bc64f2f1b20c2d7e9f5177a3c294d4462299"));
+
+  // generated keys must agree w/ the generic multiplication used by ecdh and verify
+  for(i=0;i<16;i++)
+  {
+    fail_unless(uECC_make_key(keyA, secretA, curve));
+    fail_unless(uECC_make_key(keyB, secretB, curve));
+    fail_unless(uECC_valid_public_key(keyA, curve));
+    fail_unless(uECC_shared_secret(keyB, secretA, sharedA, curve));
+    fail_unless(uECC_shared_secret(keyA, secretB, sharedB, curve));
+    fail_unless(memcmp(sharedA, sharedB, 32) == 0);
+
+    sha256(keyA, 64, hash, 0);
+    fail_unless(uECC_sign(secretA, hash, 32, sig, curve));
+    fail_unless(uECC_verify(keyA, hash, 32, sig, curve));
+    hash[0] ^= 1;
+    fail_unless(!uECC_verify(keyA, hash, 32, sig, curve));
+  }
+
+  // batches must agree w/ uECC_verify on each, across chunks, repeated keys, and bad sigs
+  uint8_t bkeys[4][64], bsecrets[4][32], bhashes[40][32], bsigs[40][64], valid[40];
+  const uint8_t *kp[40], *hp[40], *sp[40];
+  unsigned expect = 0;
+  for(i=0;i<4;i++) fail_unless(uECC_make_key(bkeys[i], bsecrets[i], curve));
+  for(i=0;i<40;i++)
+  {
+    memset(bhashes[i], i, 32);
+    fail_unless(uECC_sign(bsecrets[i % 4], bhashes[i], 32, bsigs[i], curve));
+    if(i % 5 == 1) bhashes[i][0] ^= 1;
+    if(i == 7) memset(bsigs[i], 0, 32);
+    if(i == 9) memset(bsigs[i] + 32, 0xff, 32);
+    kp[i] = bkeys[i % 4];
+    hp[i] = bhashes[i];
+    sp[i] = bsigs[i];
+    expect += uECC_verify(kp[i], hp[i], 32, sp[i], curve);
+  }
+  fail_unless(expect == 30);
+  fail_unless(uECC_verify_batch(kp, hp, 32, sp, 40, valid, curve) == expect);
+  for(i=0;i<40;i++) fail_unless(valid[i] == uECC_verify(kp[i], hp[i], 32, sp[i], curve));
+  fail_unless(uECC_verify_batch(kp, hp, 32, sp, 0, valid, curve) == 0);
+
+  return 0;
+}
@@ -2,6 +2,12 @@
 #include "util.h"
 #include "unit_test.h"
 
+static int evals = 0;
+static int eval(void)
+{
+  return ++evals;
+}
+
 int main(int argc, char **argv)
 {
   char hex[32];
@@ -9,6 +15,10 @@ int main(int argc, char **argv)
   uint32_t len = strlen((char*)str);
 
   fail_unless(strcmp("666f6f20626172",util_hex(str,len,hex)) == 0);
+  fail_unless(strcmp("666f6f20626172",util_hex(str,len,NULL)) == 0);
+  uint8_t big[UTIL_HEX_TMP+10];
+  memset(big,0xab,sizeof(big));
+  fail_unless(strlen(util_hex(big,sizeof(big),NULL)) == UTIL_HEX_TMP*2);
 
   uint64_t at = util_at();
   fail_unless(at > 0);
@@ -35,5 +45,58 @@ int main(int argc, char **argv)
   fail_unless(util_ct_memcmp(buf4, buf6, sizeof(buf5)) != 0);
   fail_unless(util_ct_memcmp(buf4, buf7, sizeof(buf5)) != 0);
 
+  // big-endian ints read the same on every host
+  uint8_t be[8];
+  fail_unless(util_put_be(0x0102030405060708ULL, be, 8) == be);
+  fail_unless(be[0] == 0x01 && be[7] == 0x08);
+  fail_unless(util_get_be(be, 8) == 0x0102030405060708ULL);
+  util_put_be(0xabcd, be, 2);
+  fail_unless(be[0] == 0xab && be[1] == 0xcd && util_get_be(be, 2) == 0xabcd);
+
+  // crc32 check value, and continuing
+  fail_unless(util_crc32(0, (uint8_t*)"123456789", 9) == 0xcbf43926);
+  fail_unless(util_crc32(util_crc32(0, (uint8_t*)"1234", 4), (uint8_t*)"56789", 5) == 0xcbf43926);
+
+  // token buckets start full and refill at rate/sec
+  util_bucket_s bucket = {0};
+  fail_unless(util_bucket_take(&bucket, 10, 2, 1));
+  fail_unless(util_bucket_take(&bucket, 10, 2, 1));
+  fail_unless(!util_bucket_take(&bucket, 10, 2, 50));
+  fail_unless(util_bucket_take(&bucket, 10, 2, 101));
+  fail_unless(!util_bucket_take(&bucket, 10, 2, 101));
+  fail_unless(util_bucket_take(&bucket, 10, 2, 5000));
+  fail_unless(util_bucket_take(&bucket, 10, 2, 5000));
+  fail_unless(!util_bucket_take(&bucket, 10, 2, 5000));
+  fail_unless(util_bucket_take(&bucket, 0, 0, 5000));
+
+  // arguments are only evaluated for levels that will print
+  util_sys_logging(1);
+  LOG("eval %d",eval());
+  fail_unless(evals == 1);
+  util_sys_log_level(6);
+  LOG("eval %d",eval());
+  fail_unless(evals == 1);
+  LOG_INFO("eval %d",eval());
+  fail_unless(evals == 2);
+  util_sys_logging(0);
+  LOG_ERROR("eval %d",eval());
+  fail_unless(evals == 2);
+  fail_unless(util_sys_log_max == -1);
+  util_sys_logging(1);
+  util_sys_log_level(8);
+
+  // queued lines go out on flush, and drop when the ring is full
+  fail_unless(util_sys_log_async(3) == 0);
+  LOG("one");
+  LOG("two");
+  fail_unless(util_sys_log_flush() == 2);
+  fail_unless(util_sys_log_flush() == 0);
+  int i;
+  for(i=0;i<6;i++) LOG("line %d",i);
+  fail_unless(util_sys_log_dropped() == 2);
+  fail_unless(util_sys_log_flush() == 4);
+  fail_unless(util_sys_log_async(0) == 0);
+  fail_unless(util_sys_log_flush() == 0);
+
   return 0;
 }
@@ -0,0 +1,33 @@
+#include "x25519.h"
+#include "util.h"
+#include "unit_test.h"
+
+int main(int argc, char **argv)
+{
+  uint8_t scalar[32], point[32], out[32], a[32], b[32], apub[32], bpub[32], sa[32], sb[32];
+  char hex[65];
+
+  // RFC 7748 5.2
+  util_unhex("a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4",64,scalar);
+  util_unhex("e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c",64,point);
+  fail_unless(x25519(out,scalar,point));
+  fail_unless(util_cmp(util_hex(out,32,hex),"c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552") == 0);
+
+  // RFC 7748 6.1
+  util_unhex("77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a",64,a);
+  util_unhex("5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb",64,b);
+  fail_unless(x25519_base(apub,a));
+  fail_unless(util_cmp(util_hex(apub,32,hex),"8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a") == 0);
+  fail_unless(x25519_base(bpub,b));
+  fail_unless(util_cmp(util_hex(bpub,32,hex),"de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f") == 0);
+  fail_unless(x25519(sa,a,bpub));
+  fail_unless(x25519(sb,b,apub));
+  fail_unless(memcmp(sa,sb,32) == 0);
+  fail_unless(util_cmp(util_hex(sa,32,hex),"4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742") == 0);
+
+  // low order points give an all zero secret
+  memset(point,0,32);
+  fail_unless(!x25519(out,a,point));
+
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include <unistd.h>
+#include "telehash.h"
+#include "mesh_workers.h"
+#include "unit_test.h"
+
+#define OPENS 50
+
+static uint32_t ups = 0, checks = 0, opens = 0;
+
+// the whole network is the pool, every packet finds its mesh by routing
+link_t pool_send(link_t link, lob_t packet, void *arg)
+{
+  if(!packet) return link;
+  mesh_workers_receive((mesh_workers_t)arg, packet, pool_send, arg);
+  return link;
+}
+
+lob_t open_count(link_t link, lob_t open)
+{
+  __atomic_fetch_add(&opens, 1, __ATOMIC_RELAXED);
+  lob_free(open);
+  return NULL;
+}
+
+// these run on the mesh's own worker
+void check_up(mesh_t mesh, void *arg)
+{
+  if(mesh->links && link_up(mesh->links)) __atomic_fetch_or(&ups, (uint32_t)(uintptr_t)arg, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&checks, 1, __ATOMIC_RELEASE);
+}
+
+// until all four have their link up, one check each at a time so they don't pile up in the queues
+uint8_t wait_up(mesh_workers_t workers, mesh_t *meshes)
+{
+  uint32_t i, j;
+  for(i = 0; i < 5000 && __atomic_load_n(&ups, __ATOMIC_ACQUIRE) != 15; i++)
+  {
+    if(i % 10 == 0 && __atomic_load_n(&checks, __ATOMIC_ACQUIRE) % 4 == 0)
+    {
+      for(j = 0; j < 4; j++) mesh_workers_call(workers, meshes[j], check_up, (void*)(uintptr_t)(1 << j));
+    }
+    usleep(1000);
+  }
+  return __atomic_load_n(&ups, __ATOMIC_ACQUIRE) == 15;
+}
+
+void send_opens(mesh_t mesh, void *arg)
+{
+  uint32_t i;
+  for(i = 0; i < OPENS; i++)
+  {
+    lob_t open = lob_new();
+    lob_set(open,"type","test");
+    link_direct(mesh->links, open);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  mesh_t meshes[4];
+  uint32_t i;
+
+  fail_unless(e3x_init(NULL) == 0);
+  util_sys_logging(0); // every mesh tries each handshake, most fail to decrypt
+
+  fail_unless(!mesh_workers_new(2, 0));
+  mesh_workers_t workers = mesh_workers_new(2, 256);
+  fail_unless(workers);
+  for(i = 0; i < 4; i++)
+  {
+    meshes[i] = mesh_new();
+    lob_free(mesh_generate(meshes[i]));
+    mesh_on_open(meshes[i], "test", open_count);
+    fail_unless(mesh_workers_add(workers, meshes[i]) == (int)(i % 2));
+  }
+  fail_unless(mesh_workers_add(workers, meshes[2]) == 0);
+
+  // 0-1 and 2-3 each span both threads, the handshakes queue up until started
+  for(i = 0; i < 4; i++) link_pipe(link_get_keys(meshes[i], meshes[i ^ 1]->keys), pool_send, workers);
+  fail_unless(mesh_workers_start(workers));
+  fail_unless(mesh_workers_add(workers, meshes[0]) == -1);
+
+  fail_unless(wait_up(workers, meshes));
+
+  // channel packets route straight to their mesh by token
+  fail_unless(mesh_workers_call(workers, meshes[0], send_opens, NULL));
+  fail_unless(mesh_workers_call(workers, meshes[2], send_opens, NULL));
+  for(i = 0; i < 500 && __atomic_load_n(&opens, __ATOMIC_RELAXED) < OPENS * 2; i++) usleep(10000);
+  fail_unless(__atomic_load_n(&opens, __ATOMIC_RELAXED) == OPENS * 2);
+
+  lob_t stats = mesh_workers_stats(workers);
+  fail_unless(stats);
+  fail_unless(lob_get_uint(stats,"routed") >= OPENS * 2);
+  fail_unless(lob_get_uint(stats,"broadcast") >= 2);
+  fail_unless(lob_get_uint(stats,"dropped") == 0);
+  lob_free(stats);
+
+  // a token nobody has
+  lob_t bogus = lob_new();
+  lob_body(bogus, NULL, 32);
+  fail_unless(mesh_workers_receive(workers, bogus, NULL, NULL) == 0);
+
+  fail_unless(!mesh_workers_free(workers));
+  for(i = 0; i < 4; i++) mesh_free(meshes[i]);
+
+  // again w/ the handshakes decrypted on their own threads
+  ups = checks = opens = 0;
+  workers = mesh_workers_new(2, 256);
+  fail_unless(workers);
+  for(i = 0; i < 4; i++)
+  {
+    meshes[i] = mesh_new();
+    lob_free(mesh_generate(meshes[i]));
+    mesh_on_open(meshes[i], "test", open_count);
+    fail_unless(mesh_workers_add(workers, meshes[i]) >= 0);
+  }
+  fail_unless(mesh_workers_offload(workers, 2, 64));
+  fail_unless(!mesh_workers_offload(workers, 2, 64));
+  for(i = 0; i < 4; i++) link_pipe(link_get_keys(meshes[i], meshes[i ^ 1]->keys), pool_send, workers);
+  fail_unless(mesh_workers_start(workers));
+  fail_unless(meshes[0]->offload);
+
+  fail_unless(wait_up(workers, meshes));
+  fail_unless(mesh_workers_call(workers, meshes[0], send_opens, NULL));
+  for(i = 0; i < 500 && __atomic_load_n(&opens, __ATOMIC_RELAXED) < OPENS; i++) usleep(10000);
+  fail_unless(__atomic_load_n(&opens, __ATOMIC_RELAXED) == OPENS);
+
+  stats = mesh_workers_stats(workers);
+  LOG("stats %s",lob_json(stats));
+  fail_unless(lob_get_uint(stats,"offloaded") >= 4);
+  fail_unless(lob_get_uint(stats,"decrypted") >= 4 && lob_get_uint(stats,"decrypted") <= lob_get_uint(stats,"offloaded"));
+  fail_unless(lob_get_uint(stats,"offload_dropped") == 0);
+  lob_free(stats);
+
+  fail_unless(!mesh_workers_free(workers));
+  fail_unless(!meshes[0]->offload);
+  for(i = 0; i < 4; i++) mesh_free(meshes[i]);
+
+  return 0;
+}
@@ -1,7 +1,9 @@
+#include <unistd.h>
 #include "net_loopback.h"
 #include "unit_test.h"
 
 static uint8_t status = 0;
+static uint32_t opens = 0;
 
 void link_check(link_t link)
 {
@@ -9,6 +11,20 @@ void link_check(link_t link)
   LOG("link state change to %s",status?"up":"down");
 }
 
+lob_t open_count(link_t link, lob_t open)
+{
+  opens++;
+  lob_free(open);
+  return NULL;
+}
+
+lob_t open_new(void)
+{
+  lob_t open = lob_new();
+  lob_set(open,"type","test");
+  return open;
+}
+
 int main(int argc, char **argv)
 {
   mesh_t meshA = mesh_new();
@@ -42,6 +58,228 @@ int main(int argc, char **argv)
   fail_unless(!mesh_linked(meshA, hashname_char(meshB->id),0));
   fail_unless(!status);
 
+  // handshake admission w/ cookies, challenges go back through the pair
+  mesh_t meshC = mesh_new();
+  lob_free(mesh_generate(meshC));
+  mesh_t meshD = mesh_new();
+  lob_free(mesh_generate(meshD));
+  fail_unless(mesh_admission(meshD, 1, 2, 0, 1));
+  net_loopback_t pair2 = net_loopback_new(meshC,meshD);
+  link_t linkCD = link_get(meshC, meshD->id); // the pair syncs it
+  fail_unless(link_up(linkCD));
+  fail_unless(linkCD->cookied);
+  fail_unless(!linkCD->cookie); // dropped once D took the handshake
+  lob_t stats = mesh_admission_stats(meshD);
+  LOG("admission %s",lob_json(stats));
+  fail_unless(lob_get_int(stats,"challenged") == 1);
+  fail_unless(lob_get_int(stats,"cookied") >= 1);
+  fail_unless(lob_get_int(stats,"admitted") >= 1);
+  lob_free(stats);
+
+  // a challenge w/o an outstanding handshake is ignored
+  lob_t challenge = lob_new();
+  lob_set(challenge,"type","cookie");
+  lob_set_base32(challenge,"token",linkCD->x->token,16);
+  lob_set(challenge,"cookie","aaaaaaaaaaaaaaaaaaaaaaaaaa");
+  uint32_t cookied = linkCD->cookied;
+  fail_unless(!linkCD->pinged);
+  fail_unless(!mesh_receive(meshC, lob_copy(challenge)));
+  fail_unless(!linkCD->cookie);
+  fail_unless(linkCD->cookied == cookied);
+
+  // and only one is answered per interval
+  fail_unless(link_resync(linkCD));
+  fail_unless(linkCD->pinged);
+  fail_unless(!mesh_receive(meshC, challenge));
+  fail_unless(!linkCD->cookie);
+  fail_unless(linkCD->cookied == cookied);
+
+  // the source's burst runs out, pretending each interval passed
+  linkCD->cookied = 0;
+  fail_unless(link_resync(linkCD));
+  linkCD->cookied = 0;
+  fail_unless(link_resync(linkCD));
+  linkCD->cookied = 0;
+  fail_unless(link_resync(linkCD));
+  stats = mesh_admission_stats(meshD);
+  LOG("admission %s",lob_json(stats));
+  fail_unless(lob_get_int(stats,"admitted") == 2);
+  fail_unless(lob_get_int(stats,"dropped") >= 2);
+  lob_free(stats);
+
+  fail_unless(mesh_admission(meshD, 0, 0, 0, 0));
+  fail_unless(!mesh_admission_stats(meshD));
+
+  // cookie envelopes are dropped once admission is off
+  lob_t envelope = lob_new();
+  lob_set(envelope,"cookie","aaaaaaaaaaaaaaaaaaaaaaaaaa");
+  lob_body(envelope,lob_raw(linkCD->handshake),lob_len(linkCD->handshake));
+  uint32_t dropped = meshD->metrics.dropped;
+  fail_unless(!mesh_receive(meshD, envelope));
+  fail_unless(meshD->metrics.dropped == dropped+1);
+  mesh_free(meshC);
+  mesh_free(meshD);
+  net_loopback_free(pair2);
+
+  // rekey after a few packets, in-flight packets on the previous keys still get through until the overlap ends
+  mesh_t meshE = mesh_new();
+  lob_free(mesh_generate(meshE));
+  mesh_t meshF = mesh_new();
+  lob_free(mesh_generate(meshF));
+  mesh_on_open(meshE, "test", open_count);
+  mesh_on_open(meshF, "test", open_count);
+  fail_unless(mesh_rekey(meshE, 3, 0, 0, 10));
+  net_loopback_t pair3 = net_loopback_new(meshE,meshF);
+  link_t linkEF = link_get(meshE, meshF->id);
+  link_t linkFE = link_get(meshF, meshE->id);
+  fail_unless(link_resync(linkEF));
+  fail_unless(link_up(linkEF) && link_up(linkFE));
+  uint8_t token[16];
+  memcpy(token,linkEF->x->token,16);
+  lob_t open = open_new();
+  lob_set_uint(open,"c",e3x_exchange_cid(linkEF->x, NULL));
+  lob_t oldEF = e3x_exchange_send(linkEF->x, open);
+  lob_free(open);
+  open = open_new();
+  lob_set_uint(open,"c",e3x_exchange_cid(linkFE->x, NULL));
+  lob_t oldFE = e3x_exchange_send(linkFE->x, open);
+  lob_free(open);
+  open = open_new();
+  lob_set_uint(open,"c",e3x_exchange_cid(linkFE->x, NULL));
+  lob_t oldFE2 = e3x_exchange_send(linkFE->x, open);
+  lob_free(open);
+  fail_unless(oldEF && oldFE && oldFE2);
+  fail_unless(link_direct(linkEF, open_new()));
+  fail_unless(opens == 1 && meshE->rekey.rekeys == 0);
+  fail_unless(link_direct(linkEF, open_new())); // third packet sent, rekeys and syncs
+  fail_unless(opens == 2 && meshE->rekey.rekeys == 1);
+  fail_unless(memcmp(token,linkEF->x->token,16) != 0);
+  fail_unless(linkEF->x->rekeyed && linkEF->x->ephem_old && linkFE->x->ephem_old);
+  fail_unless(linkEF->x->packets == 0);
+  fail_unless(link_up(linkEF) && link_up(linkFE));
+  fail_unless(mesh_receive(meshF, oldEF));
+  fail_unless(mesh_receive(meshE, oldFE));
+  fail_unless(opens == 4);
+  fail_unless(link_direct(linkEF, open_new()));
+  fail_unless(link_direct(linkFE, open_new()));
+  fail_unless(opens == 6);
+
+  // overlap ends
+  fail_unless(mesh_process(meshE, 1));
+  fail_unless(linkEF->x->ephem_old);
+  fail_unless(mesh_process(meshE, 11));
+  fail_unless(!linkEF->x->ephem_old && !linkEF->x->rekeyed);
+  fail_unless(!mesh_receive(meshE, oldFE2));
+  fail_unless(opens == 6);
+
+  // and by age, the keys were first seen at 1
+  fail_unless(mesh_rekey(meshE, 0, 0, 5, 10));
+  fail_unless(mesh_process(meshE, 5));
+  fail_unless(meshE->rekey.rekeys == 1);
+  fail_unless(mesh_process(meshE, 6));
+  fail_unless(meshE->rekey.rekeys == 2);
+  fail_unless(mesh_process(meshE, 7));
+  fail_unless(mesh_process(meshE, 11));
+  fail_unless(meshE->rekey.rekeys == 2);
+  fail_unless(mesh_process(meshE, 12));
+  fail_unless(meshE->rekey.rekeys == 3);
+  fail_unless(link_direct(linkFE, open_new()));
+  fail_unless(link_direct(linkEF, open_new()));
+  fail_unless(opens == 8);
+  fail_unless(e3x_exchange_replays(linkEF->x) == 0 && e3x_exchange_replays(linkFE->x) == 0);
+
+  // metrics, a replay fails on the link and the stale packet above was dropped w/o one
+  open = open_new();
+  lob_set_uint(open,"c",e3x_exchange_cid(linkFE->x, NULL));
+  lob_t replay = e3x_exchange_send(linkFE->x, open);
+  lob_free(open);
+  fail_unless(mesh_receive(meshE, lob_copy(replay)));
+  fail_unless(!mesh_receive(meshE, replay));
+  lob_t metrics = link_metrics(linkEF);
+  LOG("metrics %s",lob_json(metrics));
+  fail_unless(lob_get_uint(metrics,"decrypt_fails") == 1);
+  fail_unless(lob_get_uint(metrics,"replays") == 1);
+  fail_unless(lob_get_uint(metrics,"handshakes_out") >= 3);
+  fail_unless(lob_get_uint(metrics,"packets_out") >= lob_get_uint(metrics,"handshakes_out") + 4);
+  fail_unless(lob_get_uint(metrics,"last") > 0);
+  lob_free(metrics);
+  metrics = mesh_metrics(meshE);
+  LOG("metrics %s",lob_json(metrics));
+  fail_unless(lob_get_uint(metrics,"links") == 1);
+  fail_unless(lob_get_uint(metrics,"dropped") == 1);
+  fail_unless(lob_get_uint(metrics,"decrypt_fails") == 1);
+  fail_unless(lob_get_uint(metrics,"packets_in") == linkEF->metrics.packets_in + 1);
+  fail_unless(lob_get_uint(metrics,"bytes_out") == linkEF->metrics.bytes_out);
+  lob_free(metrics);
+  metrics = mesh_prometheus(meshE);
+  fail_unless(metrics && metrics->body_len);
+  LOG("prometheus\n%.*s",(int)metrics->body_len,metrics->body);
+  fail_unless(strstr((char*)metrics->body,"\ntelehash_decrypt_fails_total{mesh=\""));
+  fail_unless(strstr((char*)metrics->body,"# TYPE telehash_link_rtt_ms gauge\n"));
+  lob_free(metrics);
+
+  mesh_free(meshE);
+  mesh_free(meshF);
+  net_loopback_free(pair3);
+
+  // resume a session after a restart w/o a new handshake
+  mesh_t meshG = mesh_new();
+  lob_t secretsG = mesh_generate(meshG);
+  mesh_t meshH = mesh_new();
+  lob_free(mesh_generate(meshH));
+  mesh_on_open(meshG, "test", open_count);
+  mesh_on_open(meshH, "test", open_count);
+  net_loopback_t pair4 = net_loopback_new(meshG,meshH);
+  link_t linkGH = link_get(meshG, meshH->id);
+  link_t linkHG = link_get(meshH, meshG->id);
+  fail_unless(link_resync(linkGH));
+  fail_unless(link_direct(linkGH, open_new()));
+  fail_unless(opens == 10);
+  lob_t saved = mesh_save(meshG);
+  fail_unless(saved);
+  fail_unless(lob_get_cmp(saved,"hashname",hashname_char(meshG->id)) == 0);
+  net_loopback_free(pair4);
+  mesh_free(meshG);
+
+  mesh_t meshG2 = mesh_new();
+  mesh_on_open(meshG2, "test", open_count);
+  fail_unless(mesh_load(meshG2, secretsG, lob_linked(secretsG)) == 0);
+  fail_unless(mesh_restore(meshH, saved) == 0); // wrong identity
+  saved->body[20] ^= 1;
+  fail_unless(mesh_restore(meshG2, saved) == 0);
+  saved->body[20] ^= 1;
+  fail_unless(mesh_restore(meshG2, saved) == 1);
+  link_t linkG2H = link_get(meshG2, meshH->id);
+  fail_unless(link_up(linkG2H));
+  fail_unless(mesh_restore(meshG2, saved) == 0); // single use
+  fail_unless(saved->body_len == 0);
+
+  // channel packets flow both ways right away
+  open = open_new();
+  lob_set_uint(open,"c",e3x_exchange_cid(linkG2H->x, NULL));
+  fail_unless(mesh_receive(meshH, e3x_exchange_send(linkG2H->x, open)));
+  lob_free(open);
+  open = open_new();
+  lob_set_uint(open,"c",e3x_exchange_cid(linkHG->x, NULL));
+  fail_unless(mesh_receive(meshG2, e3x_exchange_send(linkHG->x, open)));
+  lob_free(open);
+  fail_unless(opens == 12);
+
+  // saved again for the next restart, the file is consumed by restoring from it
+  fail_unless(util_fsave(meshG2,"resume.tmp"));
+  mesh_free(meshG2);
+  mesh_t meshG3 = mesh_new();
+  fail_unless(mesh_load(meshG3, secretsG, lob_linked(secretsG)) == 0);
+  fail_unless(util_frestore(meshG3, "resume.tmp") == 1);
+  fail_unless(link_up(link_get(meshG3, meshH->id)));
+  fail_unless(access("resume.tmp", F_OK) != 0);
+  fail_unless(util_frestore(meshG3, "resume.tmp") == 0);
+
+  lob_free(saved);
+  lob_free(secretsG);
+  mesh_free(meshG3);
+  mesh_free(meshH);
+
   return 0;
 }
 
@@ -1,49 +1,58 @@
 #include "net_serial.h"
 #include "util_sys.h"
-#include "util_unix.h"
 #include "unit_test.h"
 
-// hard coding two fake serial buffers to each other
-uint8_t ABx[64], BAx[64];
-int ABy = -1, BAy = -1;
+// two fake serial lines between A and B, w/ optional noise
+typedef struct line_struct
+{
+  uint8_t buf[4096];
+  size_t len;
+  uint32_t writes, noisy;
+} line_s;
+line_s AB, BA;
+
+static int line_write(line_s *line, uint8_t *buf, size_t len)
+{
+  if(len > sizeof(line->buf) - line->len) len = sizeof(line->buf) - line->len;
+  if(!len) return 0; // full
+  memcpy(line->buf+line->len,buf,len);
+  // corrupt a byte in every noisy'th write
+  if(line->noisy && ++line->writes % line->noisy == 0) line->buf[line->len+len/2] ^= 0x42;
+  line->len += len;
+  return (int)len;
+}
+
+static int line_read(line_s *line, uint8_t *buf, size_t len)
+{
+  if(len > line->len) len = line->len;
+  memcpy(buf,line->buf,len);
+  line->len -= len;
+  memmove(line->buf,line->buf+len,line->len);
+  return (int)len;
+}
 
 int readerA(void)
 {
-  int ret;
-  if(BAy <= 0) return -1; // empty
-  ret = BAx[0];
-  BAy--;
-  if(BAy > 0) memmove(BAx,BAx+1,BAy);
-  return ret;
+  uint8_t byte;
+  if(!line_read(&BA,&byte,1)) return -1; // empty
+  return byte;
 }
 
 int writerA(uint8_t *buf, size_t len)
 {
-  if(!len || ABy > 0 || len > 64) return 0; // full
-  memcpy(ABx,buf,len);
-  ABy = len;
-  return len;
+  return line_write(&AB,buf,len);
 }
 
-int readerB(void)
+int readerB(uint8_t *buf, size_t len)
 {
-  int ret;
-  if(ABy <= 0) return -1; // empty
-  ret = ABx[0];
-  ABy--;
-  if(ABy > 0) memmove(ABx,ABx+1,ABy);
-  return ret;
+  return line_read(&AB,buf,len);
 }
 
 int writerB(uint8_t *buf, size_t len)
 {
-  if(!len || BAy > 0 || len > 64) return 0; // full
-  memcpy(BAx,buf,len);
-  BAy = len;
-  return len;
+  return line_write(&BA,buf,len);
 }
 
-
 int main(int argc, char **argv)
 {
   mesh_t meshA = mesh_new();
@@ -55,36 +64,50 @@ int main(int argc, char **argv)
   fail_unless(meshB);
   lob_t secretsB = mesh_generate(meshB);
   fail_unless(secretsB);
-  
+
   net_serial_t netA = net_serial_new(meshA, NULL);
   fail_unless(netA);
-  pipe_t pAB = net_serial_add(netA, "sAB", readerA, writerA, 64);
-  fail_unless(pAB);
+  fail_unless(net_serial_add(netA, "sAB", readerA, writerA, 64));
+  fail_unless(net_serial_framed(netA, "sAB", 64, 4));
 
   net_serial_t netB = net_serial_new(meshB, NULL);
   fail_unless(netB);
-  pipe_t pBA = net_serial_add(netB, "sBA", readerB, writerB, 64);
-  fail_unless(pBA);
+  fail_unless(net_serial_add_bulk(netB, "sBA", readerB, writerB, 64));
+  fail_unless(net_serial_framed(netB, "sBA", 64, 4));
+  fail_unless(!net_serial_framed(netB, "nope", 64, 4));
 
-  link_t linkAB = link_pipe(link_keys(meshA, meshB->keys), pAB);
-  link_t linkBA = link_pipe(link_keys(meshB, meshA->keys), pBA);
+  link_t linkAB = link_get_keys(meshA, meshB->keys);
+  link_t linkBA = link_get_keys(meshB, meshA->keys);
   fail_unless(linkAB);
   fail_unless(linkBA);
 
-  link_sync(linkAB);
-  // let serial go go go
+  // garbage on the line before anything and noise throughout
+  fail_unless(writerA((uint8_t*)"\xa5\x5a\xff",3) == 3);
+  AB.noisy = 13;
+  BA.noisy = 17;
+
+  // kickstart w/ a handshake down the pipe
+  fail_unless(net_serial_send(netA, "sAB", link_handshake(linkAB)));
+
   int loop;
   for(loop = 2000; loop; loop--)
   {
     net_serial_loop(netB);
     net_serial_loop(netA);
+    if(link_up(linkAB) && link_up(linkBA)) break;
   }
-
-  LOG("BA %d AB %d",e3x_exchange_out(linkBA->x,0),e3x_exchange_out(linkAB->x,0));
-  fail_unless(e3x_exchange_out(linkBA->x,0) >= e3x_exchange_out(linkAB->x,0));
+  LOG("done in %d loops",2000-loop);
+  fail_unless(loop);
+  fail_unless(link_up(linkAB));
+  fail_unless(link_up(linkBA));
   fail_unless(e3x_exchange_out(linkBA->x,0) == e3x_exchange_out(linkAB->x,0));
 
+  net_serial_free(netA);
+  net_serial_free(netB);
+  mesh_free(meshA);
+  mesh_free(meshB);
+  lob_free(secretsA);
+  lob_free(secretsB);
 
   return 0;
 }
-
@@ -0,0 +1,147 @@
+#include "net_sim.h"
+#include "unit_test.h"
+
+// arrival time of each open in order, per receiving mesh
+static uint64_t arrived[64];
+static uint32_t arrivals = 0;
+static net_sim_t now_sim = NULL;
+
+lob_t open_arrive(link_t link, lob_t open)
+{
+  if(arrivals < 64) arrived[arrivals] = net_sim_now(now_sim);
+  arrivals++;
+  lob_free(open);
+  return NULL;
+}
+
+lob_t open_new(size_t len)
+{
+  lob_t open = lob_new();
+  lob_set(open,"type","sim");
+  lob_body(open,NULL,len);
+  return open;
+}
+
+mesh_t mesh_sim(void)
+{
+  mesh_t mesh = mesh_new();
+  lob_free(mesh_generate(mesh));
+  mesh_on_open(mesh, "sim", open_arrive);
+  return mesh;
+}
+
+// sends a few packets over a lossy reordering pipe and returns a fingerprint of what arrived when
+uint64_t lossy_run(uint32_t seed)
+{
+  uint64_t print = 0;
+  uint32_t i;
+  net_sim_cfg_s cfg = {0};
+  net_sim_t sim = now_sim = net_sim_new(seed);
+  mesh_t a = mesh_sim(), b = mesh_sim();
+  cfg.latency = 5000;
+  cfg.jitter = 2000;
+  net_sim_pipe(sim, a, b, NULL);
+  net_sim_run(sim, 1000000);
+  cfg.loss = 200000;
+  cfg.reorder = 200000;
+  net_sim_direction(sim, a, b, &cfg);
+  link_t ab = link_get(a, b->id);
+  arrivals = 0;
+  for(i = 0; i < 20; i++) link_direct(ab, open_new(100));
+  net_sim_run(sim, 1000000);
+  for(i = 0; i < arrivals && i < 64; i++) print = print * 31 + arrived[i];
+  print = print * 31 + arrivals;
+  net_sim_free(sim);
+  mesh_free(a);
+  mesh_free(b);
+  return print;
+}
+
+int main(int argc, char **argv)
+{
+  net_sim_stats_s *stats;
+  net_sim_cfg_s cfg = {0};
+  uint32_t i;
+
+  util_sys_logging(0);
+  net_sim_t sim = now_sim = net_sim_new(1);
+  fail_unless(sim);
+  mesh_t a = mesh_sim(), b = mesh_sim(), c = mesh_sim();
+
+  // a-b is ideal, a-c is 20ms away
+  fail_unless(net_sim_pipe(sim, a, b, NULL));
+  cfg.latency = 20000;
+  fail_unless(net_sim_pipe(sim, a, c, &cfg));
+  link_t ab = link_get(a, b->id);
+  link_t ac = link_get(a, c->id);
+
+  // nothing moves until the clock does
+  fail_unless(!link_up(ab) && !link_up(ac));
+  fail_unless(net_sim_pending(sim) > 0);
+  net_sim_run(sim, 1000);
+  fail_unless(link_up(ab));
+  fail_unless(!link_up(ac));
+  net_sim_run(sim, 100000);
+  fail_unless(link_up(ac) && link_up(link_get(c, a->id)));
+  fail_unless(net_sim_now(sim) == 101000);
+
+  // one way latency
+  arrivals = 0;
+  fail_unless(link_direct(ac, open_new(100)));
+  fail_unless(arrivals == 0);
+  net_sim_run(sim, 19999);
+  fail_unless(arrivals == 0);
+  net_sim_run(sim, 1);
+  fail_unless(arrivals == 1);
+  fail_unless(arrived[0] == 121000);
+
+  // bandwidth serializes, 10 x ~1k at 100KB/s takes ~100ms
+  cfg.latency = 0;
+  cfg.bandwidth = 100000;
+  fail_unless(net_sim_direction(sim, a, b, &cfg));
+  arrivals = 0;
+  uint64_t start = net_sim_now(sim);
+  for(i = 0; i < 10; i++) fail_unless(link_direct(ab, open_new(1000)));
+  net_sim_run(sim, 1000000);
+  fail_unless(arrivals == 10);
+  fail_unless(arrived[9] - start >= 100000 && arrived[9] - start < 120000);
+  fail_unless(arrived[0] - start >= 10000);
+
+  // a small queue drops the rest, the one being sent counts too
+  cfg.queue = 3000;
+  fail_unless(net_sim_direction(sim, a, b, &cfg));
+  stats = net_sim_stats(sim, a, b);
+  fail_unless(stats && stats->queue == 0);
+  arrivals = 0;
+  for(i = 0; i < 10; i++) link_direct(ab, open_new(1000));
+  net_sim_run(sim, 1000000);
+  fail_unless(arrivals == 2);
+  fail_unless(stats->queue == 10 - arrivals);
+
+  // mtu
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.mtu = 500;
+  fail_unless(net_sim_direction(sim, a, b, &cfg));
+  arrivals = 0;
+  link_direct(ab, open_new(1000));
+  link_direct(ab, open_new(100));
+  net_sim_run(sim, 1000);
+  fail_unless(arrivals == 1 && stats->mtu == 1);
+  fail_unless(stats->delivered > 0 && stats->bytes > 0);
+
+  // meshes get processed every virtual second
+  fail_unless(net_sim_run(sim, 10000000) == 0);
+  fail_unless(net_sim_now(sim) > 10000000);
+
+  net_sim_free(sim);
+  mesh_free(a);
+  mesh_free(b);
+  mesh_free(c);
+
+  // loss and reordering are random but repeat exactly for the same seed
+  uint64_t one = lossy_run(7);
+  fail_unless(one == lossy_run(7));
+  fail_unless(one != lossy_run(8));
+
+  return 0;
+}
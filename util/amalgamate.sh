@@ -0,0 +1,91 @@
+#!/bin/sh
+# builds the single translation unit amalgamation, NAME.h (every public header) and NAME.c (every source after it)
+# usage: amalgamate.sh NAME header.h [more.h] -- src.c [more.c]
+# local "..." includes are inlined the first time they're seen and dropped after that, <...> ones are left alone
+# they're searched for next to the including file, then in include/, include/lib/, unix/ and throwback/
+
+set -e
+name=$1
+shift
+headers=
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+  headers="$headers $1"
+  shift
+done
+[ "$1" = "--" ] && shift
+if [ -z "$name" ] || [ -z "$headers" ] || [ $# -eq 0 ]; then
+  echo "usage: $0 NAME header.h [more.h] -- src.c [more.c]" >&2
+  exit 1
+fi
+
+awk -v name="$name" -v base="$(basename "$name")" -v headers="$headers" -v sources="$*" '
+function dirname(path) {
+  if(path !~ /\//) return "."
+  sub(/\/[^\/]*$/, "", path)
+  return path
+}
+function exists(path,   line) {
+  if((getline line < path) < 0) return 0
+  close(path)
+  return 1
+}
+# anything seen may be open further up, probing it would close it under the reader
+function found(path) {
+  return (path in seen) || exists(path)
+}
+function locate(inc, dir,   i) {
+  if(found(dir "/" inc)) return dir "/" inc
+  for(i = 1; i <= ndirs; i++) if(found(dirs[i] "/" inc)) return dirs[i] "/" inc
+  return ""
+}
+function emit(path, out,   line, inc, at) {
+  while((getline line < path) > 0)
+  {
+    if(line ~ /^[ \t]*#[ \t]*include[ \t]*"/)
+    {
+      inc = line
+      sub(/^[^"]*"/, "", inc)
+      sub(/".*$/, "", inc)
+      if((at = locate(inc, dirname(path))) != "")
+      {
+        if(!(at in seen))
+        {
+          seen[at] = 1
+          print "/* begin " at " */" > out
+          emit(at, out)
+          print "/* end " at " */" > out
+        }
+        continue
+      }
+      print "amalgamate: " path " includes missing " inc > "/dev/stderr"
+      failed = 1
+    }
+    print line > out
+  }
+  close(path)
+}
+BEGIN {
+  ndirs = split("include include/lib unix throwback", dirs, " ")
+  n = split(headers, list, " ")
+  print "#ifndef " base "_amalgamation_h" > (name ".h")
+  print "#define " base "_amalgamation_h" > (name ".h")
+  for(i = 1; i <= n; i++)
+  {
+    seen[list[i]] = 1
+    emit(list[i], name ".h")
+  }
+  print "#endif" > (name ".h")
+
+  # everything the header has is already there
+  print "#include \"" base ".h\"" > (name ".c")
+  n = split(sources, list, " ")
+  for(i = 1; i <= n; i++)
+  {
+    seen[list[i]] = 1
+    print "/* begin " list[i] " */" > (name ".c")
+    emit(list[i], name ".c")
+    print "/* end " list[i] " */" > (name ".c")
+  }
+  exit failed
+}
+'